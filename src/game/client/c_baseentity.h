@@ -156,6 +156,7 @@ struct thinkfunc_t
 {
 	BASEPTR		m_pfnThink;
 	string_t	m_iszContext;
+	int			m_nContextID;			// CBaseEntity::GetThinkContextID( m_iszContext )
 	int			m_nNextThinkTick;
 	int			m_nLastThinkTick;
 };
@@ -1128,6 +1129,7 @@ public:
 	void	NetworkStateForceUpdate()					{ }
 
 	// Think functions with contexts
+	static int GetThinkContextID( const char *szContext );		// same ID for every entity, for any name that matches in the first MAX_CONTEXT_LENGTH characters
 	int		RegisterThinkContext( const char *szContext );
 	BASEPTR	ThinkSet( BASEPTR func, float flNextThinkTime = 0, const char *szContext = NULL );
 	void	SetNextThink( float nextThinkTime, const char *szContext = NULL );
@@ -51,6 +51,7 @@ struct model_t;
 
 ConVar cl_detaildist( "cl_detaildist", "1200", 0, "Distance at which detail props are no longer visible" );
 ConVar cl_detailfade( "cl_detailfade", "400", 0, "Distance across which detail props fade in" );
+ConVar cl_detail_sort_coherence_dist( "cl_detail_sort_coherence_dist", "16", 0, "Distance the camera may move before fast detail sprites are re-sorted (0 = re-sort every frame)" );
 #if defined( USE_DETAIL_SHAPES ) 
 ConVar cl_detail_max_sway( "cl_detail_max_sway", "0", FCVAR_ARCHIVE, "Amplitude of the detail prop sway" );
 ConVar cl_detail_avoid_radius( "cl_detail_avoid_radius", "0", FCVAR_ARCHIVE, "radius around detail sprite to avoid players" );
@@ -335,12 +336,20 @@ class CFastDetailLeafSpriteList : public CClientLeafSubSystemData
 	// simd pointers into larger array - don't free individually or you will be sad
 	FastSpriteX4_t *m_pSprites;
 
+	// back-to-front order of every sprite in the leaf, as seen from m_vecSortOrigin.
+	// also points into a larger array.
+	int *m_pSortedOrder;
+	Vector m_vecSortOrigin;
+	bool m_bSortedOrderValid;
+
 	// state for partially drawn sprite lists
 	int m_nNumPendingSprites;
 	int m_nStartSpriteIndex;
 
 	CFastDetailLeafSpriteList( void )
 	{
+		m_pSortedOrder = NULL;
+		m_bSortedOrderValid = false;
 		m_nNumPendingSprites = 0;
 		m_nStartSpriteIndex = 0;
 	}
@@ -456,12 +465,14 @@ private:
 	// Count the number of detail sprite quads in the leaf list
 	int CountSpriteQuadsInLeafList( int nLeafCount, LeafIndex_t *pLeafList ) const;
 
-	int CountFastSpritesInLeafList( int nLeafCount, LeafIndex_t const *pLeafList, int *nMaxInLeaf ) const;
+	int CountFastSpritesInLeafList( int nLeafCount, LeafIndex_t const *pLeafList, int *nMaxInLeaf,
+									CFastDetailLeafSpriteList **ppLeafData = NULL ) const;
 
 	void FreeSortBuffers( void );
 
 	// Sorts sprites in back-to-front order
 	static bool SortLessFunc( const SortInfo_t &left, const SortInfo_t &right );
+	void RadixSortBackToFront( SortInfo_t *pSortInfo, int nCount );
 	int SortSpritesBackToFront( int nLeaf, const Vector &viewOrigin, const Vector &viewForward, SortInfo_t *pSortInfo );
 
 	// For fast detail object insertion
@@ -473,6 +484,7 @@ private:
 	CUtlVector<DetailPropSpriteDict_t>		m_DetailSpriteDictFlipped;
 	CUtlVector<DetailPropLightstylesLump_t>	m_DetailLighting;
 	FastSpriteX4_t *m_pFastSpriteData;
+	int *m_pFastSpriteSortOrder;
 
 	// Necessary to get sprites to batch correctly
 	CMaterialReference m_DetailSpriteMaterial;
@@ -485,8 +497,13 @@ private:
 	int m_nSortedFastLeaf;
 	SortInfo_t *m_pSortInfo;
 	SortInfo_t *m_pFastSortInfo;
+	SortInfo_t *m_pSortScratch;
 	FastSpriteQuadBuildoutBufferX4_t *m_pBuildoutBuffer;
 
+	// per simd sprite results of the cull pass in BuildOutSortedSprites
+	fltx4 *m_pFastSpriteDistances;
+	int *m_pFastSpriteSlots;
+
 	float m_flDefaultFadeStart;
 	float m_flDefaultFadeEnd;
 
@@ -1400,9 +1417,13 @@ void CDetailModel::DrawSwayingQuad( CMeshBuilder &meshBuilder, Vector vecOrigin,
 CDetailObjectSystem::CDetailObjectSystem() : m_DetailSpriteDict( 0, 32 ), m_DetailObjectDict( 0, 32 ), m_DetailSpriteDictFlipped( 0, 32 )
 {
 	m_pFastSpriteData = NULL;
+	m_pFastSpriteSortOrder = NULL;
 	m_pSortInfo = NULL;
 	m_pFastSortInfo = NULL;
+	m_pSortScratch = NULL;
 	m_pBuildoutBuffer = NULL;
+	m_pFastSpriteDistances = NULL;
+	m_pFastSpriteSlots = NULL;
 }
 
 void CDetailObjectSystem::FreeSortBuffers( void )
@@ -1417,11 +1438,31 @@ void CDetailObjectSystem::FreeSortBuffers( void )
 		MemAlloc_FreeAligned(  m_pFastSortInfo );
 		m_pFastSortInfo = NULL;
 	}
+	if ( m_pSortScratch )
+	{
+		MemAlloc_FreeAligned(  m_pSortScratch );
+		m_pSortScratch = NULL;
+	}
 	if ( m_pBuildoutBuffer )
 	{
 		MemAlloc_FreeAligned(  m_pBuildoutBuffer );
 		m_pBuildoutBuffer = NULL;
 	}
+	if ( m_pFastSpriteDistances )
+	{
+		MemAlloc_FreeAligned(  m_pFastSpriteDistances );
+		m_pFastSpriteDistances = NULL;
+	}
+	if ( m_pFastSpriteSlots )
+	{
+		MemAlloc_FreeAligned(  m_pFastSpriteSlots );
+		m_pFastSpriteSlots = NULL;
+	}
+	if ( m_pFastSpriteSortOrder )
+	{
+		MemAlloc_FreeAligned(  m_pFastSpriteSortOrder );
+		m_pFastSpriteSortOrder = NULL;
+	}
 }
 
 CDetailObjectSystem::~CDetailObjectSystem()
@@ -1748,6 +1789,16 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 			MemAlloc_AllocAligned( 
 				( 1 + nMaxFastInLeaf / 4 ) * sizeof( FastSpriteQuadBuildoutBufferX4_t ),
 				sizeof( fltx4 ) ) );
+
+		m_pFastSpriteDistances = reinterpret_cast<fltx4 *> (
+			MemAlloc_AllocAligned( ( 1 + nMaxFastInLeaf / 4 ) * sizeof( fltx4 ), sizeof( fltx4 ) ) );
+		m_pFastSpriteSlots = reinterpret_cast<int *> (
+			MemAlloc_AllocAligned( ( 1 + nMaxFastInLeaf / 4 ) * sizeof( int ), sizeof( fltx4 ) ) );
+	}
+	if ( nMaxOldInLeaf || nMaxFastInLeaf )
+	{
+		m_pSortScratch = reinterpret_cast<SortInfo_t *> (
+			MemAlloc_AllocAligned( (3 + MAX( nMaxOldInLeaf, nMaxFastInLeaf ) ) * sizeof( SortInfo_t ), sizeof( fltx4 ) ) );
 	}
 
 	if ( nNumFastSpritesToAllocate )
@@ -1758,6 +1809,8 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 			MemAlloc_AllocAligned( 
 				( nNumFastSpritesToAllocate >> 2 ) * sizeof( FastSpriteX4_t ),
 				sizeof( fltx4 ) ) );
+		m_pFastSpriteSortOrder = reinterpret_cast<int *> (
+			MemAlloc_AllocAligned( nNumFastSpritesToAllocate * sizeof( int ), sizeof( fltx4 ) ) );
 	}
 
 	m_DetailObjects.EnsureCapacity( nNumOldStyleObjects  );
@@ -1787,6 +1840,7 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 					pNew->m_nNumSprites = nNumFastObjectsInCurLeaf;
 					pNew->m_nNumSIMDSprites = ( 3 + nNumFastObjectsInCurLeaf ) >> 2;
 					pNew->m_pSprites = pCurFastSpriteOut;
+					pNew->m_pSortedOrder = m_pFastSpriteSortOrder + ( pCurFastSpriteOut - m_pFastSpriteData ) * 4;
 					pCurFastSpriteOut += pNew->m_nNumSIMDSprites;
 					ClientLeafSystem()->SetSubSystemDataInLeaf( 
 						detailObjectLeaf, CLSUBSYSTEM_DETAILOBJECTS, pNew );
@@ -1872,6 +1926,7 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 			pNew->m_nNumSprites = nNumFastObjectsInCurLeaf;
 			pNew->m_nNumSIMDSprites = ( 3 + nNumFastObjectsInCurLeaf ) >> 2;
 			pNew->m_pSprites = pCurFastSpriteOut;
+			pNew->m_pSortedOrder = m_pFastSpriteSortOrder + ( pCurFastSpriteOut - m_pFastSpriteData ) * 4;
 			pCurFastSpriteOut += pNew->m_nNumSIMDSprites;
 			ClientLeafSystem()->SetSubSystemDataInLeaf( 
 				detailObjectLeaf, CLSUBSYSTEM_DETAILOBJECTS, pNew );
@@ -1980,7 +2035,8 @@ int CDetailObjectSystem::CountSpritesInLeafList( int nLeafCount, LeafIndex_t *pL
 // Count the number of fast sprites in the leaf list
 //-----------------------------------------------------------------------------
 int CDetailObjectSystem::CountFastSpritesInLeafList( int nLeafCount, LeafIndex_t const *pLeafList,
-													 int *nMaxFoundInLeaf ) const
+													 int *nMaxFoundInLeaf,
+													 CFastDetailLeafSpriteList **ppLeafData ) const
 {
 	VPROF_BUDGET( "CDetailObjectSystem::CountSpritesInLeafList", VPROF_BUDGETGROUP_DETAILPROP_RENDERING );
 	int nCount = 0;
@@ -1989,6 +2045,11 @@ int CDetailObjectSystem::CountFastSpritesInLeafList( int nLeafCount, LeafIndex_t
 	{
 		CFastDetailLeafSpriteList *pData = reinterpret_cast< CFastDetailLeafSpriteList *> (
 			ClientLeafSystem()->GetSubSystemDataInLeaf( pLeafList[i], CLSUBSYSTEM_DETAILOBJECTS ) );
+		// hand the leaf data back so the caller doesn't have to look it up a second time
+		if ( ppLeafData )
+		{
+			ppLeafData[i] = pData;
+		}
 		if ( pData )
 		{
 			nCount += pData->m_nNumSprites;
@@ -2039,6 +2100,67 @@ inline bool CDetailObjectSystem::SortLessFunc( const CDetailObjectSystem::SortIn
 }
 
 
+//-----------------------------------------------------------------------------
+// Sorts sprites in back-to-front order using an LSD radix sort on the bits of
+// the (never negative) squared distance. Uses m_pSortScratch as the ping-pong buffer.
+//-----------------------------------------------------------------------------
+#define DETAIL_RADIX_SORT_MIN_COUNT 64
+
+void CDetailObjectSystem::RadixSortBackToFront( SortInfo_t *pSortInfo, int nCount )
+{
+	if ( nCount < DETAIL_RADIX_SORT_MIN_COUNT )
+	{
+		HeapSort( pSortInfo, nCount, SortLessFunc );
+		return;
+	}
+
+	// keys are inverted so that ascending key order is descending distance
+	int nHistogram[4][256];
+	memset( nHistogram, 0, sizeof( nHistogram ) );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		uint32 nKey = ~( uint32 )TREATASINT( pSortInfo[i].m_flDistance );
+		nHistogram[0][nKey & 0xff]++;
+		nHistogram[1][( nKey >> 8 ) & 0xff]++;
+		nHistogram[2][( nKey >> 16 ) & 0xff]++;
+		nHistogram[3][nKey >> 24]++;
+	}
+
+	SortInfo_t *pSrc = pSortInfo;
+	SortInfo_t *pDst = m_pSortScratch;
+	for ( int nPass = 0; nPass < 4; ++nPass )
+	{
+		int nShift = nPass * 8;
+		int *pOffsets = nHistogram[nPass];
+
+		// every key has the same value for this digit, so the pass would be a plain copy
+		uint32 nFirstKey = ~( uint32 )TREATASINT( pSrc[0].m_flDistance );
+		if ( pOffsets[( nFirstKey >> nShift ) & 0xff] == nCount )
+			continue;
+
+		int nOffset = 0;
+		for ( int nDigit = 0; nDigit < 256; ++nDigit )
+		{
+			int nDigitCount = pOffsets[nDigit];
+			pOffsets[nDigit] = nOffset;
+			nOffset += nDigitCount;
+		}
+
+		for ( int i = 0; i < nCount; ++i )
+		{
+			uint32 nKey = ~( uint32 )TREATASINT( pSrc[i].m_flDistance );
+			pDst[pOffsets[( nKey >> nShift ) & 0xff]++] = pSrc[i];
+		}
+		V_swap( pSrc, pDst );
+	}
+
+	if ( pSrc != pSortInfo )
+	{
+		memcpy( pSortInfo, pSrc, nCount * sizeof( SortInfo_t ) );
+	}
+}
+
+
 int CDetailObjectSystem::SortSpritesBackToFront( int nLeaf, const Vector &viewOrigin, const Vector &viewForward, SortInfo_t *pSortInfo )
 {
 	VPROF_BUDGET( "CDetailObjectSystem::SortSpritesBackToFront", VPROF_BUDGETGROUP_DETAILPROP_RENDERING );
@@ -2109,7 +2231,7 @@ int CDetailObjectSystem::SortSpritesBackToFront( int nLeaf, const Vector &viewOr
 	if ( nCount )
 	{
 		VPROF( "CDetailObjectSystem::SortSpritesBackToFront -- Sort" );
-		HeapSort( pSortInfo, nCount, SortLessFunc );
+		RadixSortBackToFront( pSortInfo, nCount );
 	}
 
 	return nCount;
@@ -2134,13 +2256,15 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 												Vector const &viewRight,
 												Vector const &viewUp )
 {
-	// part 1 - do all vertex math, fading, etc into a buffer, using as much simd as we can
+	// part 1 - cull, then do all vertex math, fading, etc into a buffer, using as much simd as we can.
+	// the distance and visible lane mask of every simd sprite is kept for the sort.
 	int nSIMDSprites = pData->m_nNumSIMDSprites;
 	FastSpriteX4_t const *pSprites = pData->m_pSprites;
-	SortInfo_t *pOut = m_pFastSortInfo;
 	FastSpriteQuadBuildoutBufferX4_t *pQuadBufferOut = m_pBuildoutBuffer;
-	int curidx = 0;
-	int nLastBfMask = 0;
+	int nSlot = 0;
+
+	// the last simd sprite is padded with copies of its first entry - never draw those
+	int nLastGroupMask = ( 1 << ( pData->m_nNumSprites - ( ( nSIMDSprites - 1 ) << 2 ) ) ) - 1;
 
 	FourVectors vecViewPos;
 	vecViewPos.DuplicateVector( viewOrigin );
@@ -2154,15 +2278,22 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 	FourVectors vecFwd;
 	vecFwd.DuplicateVector( viewForward );
 
-	do
+	for ( int nGroup = 0; nGroup < nSIMDSprites; nGroup++, pSprites++ )
 	{
 		// calculate alpha
 		FourVectors ofs = pSprites->m_Pos;
 		ofs -= vecViewPos;
 		fltx4 ofsDotFwd = ofs * vecFwd;
 		fltx4 distanceSquared = ofs * ofs;
-		nLastBfMask = TestSignSIMD( OrSIMD( ofsDotFwd, CmpGtSIMD( distanceSquared, maxsqdist ) ) );		//  cull
-		if ( nLastBfMask != 0xf )
+		int nVisibleMask = ~TestSignSIMD( OrSIMD( ofsDotFwd, CmpGtSIMD( distanceSquared, maxsqdist ) ) ) & 0xf;		//  cull
+		if ( nGroup == nSIMDSprites - 1 )
+		{
+			nVisibleMask &= nLastGroupMask;
+		}
+
+		m_pFastSpriteDistances[nGroup] = distanceSquared;
+		m_pFastSpriteSlots[nGroup] = ( nSlot << 4 ) | nVisibleMask;
+		if ( nVisibleMask )
 		{
 			FourVectors dx1;
 			dx1.x = fnegate( ofs.y );
@@ -2217,48 +2348,87 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 			fetch4 = *( ( fltx4 *) ( &pSprites->m_RGBColor[0][0] ) );
 			*( (fltx4 *) ( & ( pQuadBufferOut->m_RGBColor[0][0] ) ) ) = fetch4;
 #endif
-
-			//!! bug!! store distance
-			// !! speed!! simd?
-			pOut[0].m_nIndex = curidx;
-			pOut[0].m_flDistance = SubFloat( distanceSquared, 0 );
-			pOut[1].m_nIndex = curidx+1;
-			pOut[1].m_flDistance = SubFloat( distanceSquared, 1 );
-			pOut[2].m_nIndex = curidx+2;
-			pOut[2].m_flDistance = SubFloat( distanceSquared, 2 );
-			pOut[3].m_nIndex = curidx+3;
-			pOut[3].m_flDistance = SubFloat( distanceSquared, 3 );
-			curidx += 4;
-			pOut += 4;
+			nSlot++;
 			pQuadBufferOut++;
 		}
-		pSprites++;
-	} while( --nSIMDSprites );
+	}
 
-	// adjust count for tail
-	int nCount = pOut - m_pFastSortInfo;
-	if ( nLastBfMask != 0xf )						// if last not skipped
-		nCount -= ( 0 - pData->m_nNumSprites ) & 3;
+	if ( nSlot == 0 )
+		return 0;
+
+	SortInfo_t *pOut = m_pFastSortInfo;
 
 	// part 2 - sort
-	if ( nCount )
+	float flCoherenceDist = cl_detail_sort_coherence_dist.GetFloat();
+	if ( flCoherenceDist <= 0.0f )
 	{
+		// sort only what survived the cull
+		for ( int nGroup = 0; nGroup < nSIMDSprites; nGroup++ )
+		{
+			int nSlotAndMask = m_pFastSpriteSlots[nGroup];
+			for ( int nLane = 0; nLane < 4; nLane++ )
+			{
+				if ( nSlotAndMask & ( 1 << nLane ) )
+				{
+					pOut->m_nIndex = ( ( nSlotAndMask >> 4 ) << 2 ) | nLane;
+					pOut->m_flDistance = SubFloat( m_pFastSpriteDistances[nGroup], nLane );
+					pOut++;
+				}
+			}
+		}
+
+		int nCount = pOut - m_pFastSortInfo;
 		VPROF( "CDetailObjectSystem::SortSpritesBackToFront -- Sort" );
-		HeapSort( m_pFastSortInfo, nCount, SortLessFunc );
+		RadixSortBackToFront( m_pFastSortInfo, nCount );
+		return nCount;
 	}
-	return nCount;
+
+	// sort every sprite in the leaf, and keep that order around until the camera has moved far enough
+	// for it to be noticeably wrong. culling changes with view direction, so it is applied afterwards.
+	if ( !pData->m_bSortedOrderValid ||
+		 viewOrigin.DistToSqr( pData->m_vecSortOrigin ) > flCoherenceDist * flCoherenceDist )
+	{
+		VPROF( "CDetailObjectSystem::SortSpritesBackToFront -- Sort" );
+		for ( int i = 0; i < pData->m_nNumSprites; i++ )
+		{
+			pOut[i].m_nIndex = i;
+			pOut[i].m_flDistance = SubFloat( m_pFastSpriteDistances[i >> 2], i & 3 );
+		}
+		RadixSortBackToFront( pOut, pData->m_nNumSprites );
+		for ( int i = 0; i < pData->m_nNumSprites; i++ )
+		{
+			pData->m_pSortedOrder[i] = pOut[i].m_nIndex;
+		}
+		pData->m_vecSortOrigin = viewOrigin;
+		pData->m_bSortedOrderValid = true;
+	}
+
+	int const *pOrder = pData->m_pSortedOrder;
+	for ( int i = 0; i < pData->m_nNumSprites; i++ )
+	{
+		int nSprite = pOrder[i];
+		int nSlotAndMask = m_pFastSpriteSlots[nSprite >> 2];
+		int nLane = nSprite & 3;
+		if ( nSlotAndMask & ( 1 << nLane ) )
+		{
+			pOut->m_nIndex = ( ( nSlotAndMask >> 4 ) << 2 ) | nLane;
+			pOut->m_flDistance = SubFloat( m_pFastSpriteDistances[nSprite >> 2], nLane );
+			pOut++;
+		}
+	}
+	return pOut - m_pFastSortInfo;
 }
 
 
 void CDetailObjectSystem::RenderFastSprites( const Vector &viewOrigin, const Vector &viewForward, const Vector &viewRight, const Vector &viewUp, int nLeafCount, LeafIndex_t const * pLeafList )
 {
 	// Here, we must draw all detail objects back-to-front
-	// FIXME: Cache off a sorted list so we don't have to re-sort every frame
 
 	// Count the total # of detail quads we possibly could render
 	int nMaxInLeaf;
 
-	int nQuadCount = CountFastSpritesInLeafList( nLeafCount, pLeafList, &nMaxInLeaf );
+	CFastDetailLeafSpriteList **ppLeafData = (CFastDetailLeafSpriteList **)stackalloc( nLeafCount * sizeof( CFastDetailLeafSpriteList * ) );
+	int nQuadCount = CountFastSpritesInLeafList( nLeafCount, pLeafList, &nMaxInLeaf, ppLeafData );
 	if ( nQuadCount == 0 )
 		return;
 	if  ( r_DrawDetailProps.GetInt() == 0 )
@@ -2300,10 +2470,7 @@ void CDetailObjectSystem::RenderFastSprites( const Vector &viewOrigin, const Vec
 	// Sort detail sprites in each leaf independently; then render them
 	for ( int i = 0; i < nLeafCount; ++i )
 	{
-		int nLeaf = pLeafList[i];
-
-		CFastDetailLeafSpriteList *pData = reinterpret_cast<CFastDetailLeafSpriteList *> (
-			ClientLeafSystem()->GetSubSystemDataInLeaf( nLeaf, CLSUBSYSTEM_DETAILOBJECTS ) );
+		CFastDetailLeafSpriteList *pData = ppLeafData[i];
 
 		if ( pData )
 		{
@@ -6,6 +6,7 @@
 
 #include "NextBotManager.h"
 #include "NextBotInterface.h"
+#include "Path/NextBotLocalAvoidance.h"
 
 #ifdef TERROR
 #include "ZombieBot/Infected/Infected.h"
@@ -270,6 +271,8 @@ void NextBotManager::Reset( void )
 	}
 
 	m_selectedBot = NULL;
+
+	TheNextBotNeighbors().Reset();
 }
 
 
@@ -407,6 +410,8 @@ void NextBotManager::Update( void )
 
 			Msg( "Frame %8d/tick %8d: %3d run of %3d, %3d sliders, %3d blocked slides, scheduled %3d for next tick, %3d intentional sliders, %d nonresponsive, %d dead\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, g_nRun, m_botList.Count() - nDead, g_nSlid, g_nBlockedSlides, nScheduled, nIntentionalSliders, nNonResponsive, nDead );
 			g_nRun = g_nSlid = g_nBlockedSlides = 0;
+
+			TheNextBotNeighbors().PrintAvoidStats();
 		}
 
 	}
@@ -200,6 +200,38 @@ private:
 };
 
 
+//--------------------------------------------------------------------------------------------
+/**
+ * Trace filter that skips "traversable" entities and living teammates, for when nearby
+ * teammates are steered around using the neighbor grid instead of traces. Enemies and
+ * everything else still block.
+ */
+class NextBotTraversableIgnoreTeammatesTraceFilter : public NextBotTraversableTraceFilter
+{
+public:
+	NextBotTraversableIgnoreTeammatesTraceFilter( INextBot *bot, ILocomotion::TraverseWhenType when = ILocomotion::EVENTUALLY ) : NextBotTraversableTraceFilter( bot, when )
+	{
+		m_me = bot->GetEntity();
+	}
+
+	virtual bool ShouldHitEntity( IHandleEntity *pServerEntity, int contentsMask )
+	{
+		CBaseEntity *entity = EntityFromEntityHandle( pServerEntity );
+
+		// same actors the neighbor grid avoidance steers around
+		if ( ( entity->MyNextBotPointer() || entity->IsPlayer() ) && entity->IsAlive() && m_me->InSameTeam( entity ) )
+		{
+			return false;
+		}
+
+		return NextBotTraversableTraceFilter::ShouldHitEntity( pServerEntity, contentsMask );
+	}
+
+private:
+	CBaseEntity *m_me;
+};
+
+
 //---------------------------------------------------------------------------------------------
 /**
  * Given a vector of entities, a nav area, and a max travel distance, return 
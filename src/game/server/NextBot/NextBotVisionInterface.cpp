@@ -587,18 +587,10 @@ bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV,
 	}
 
 	CBaseCombatCharacter *combat = subject->MyCombatCharacterPointer();
-	if ( combat )
+	if ( combat && !IsPotentiallyVisible( combat ) )
 	{
-		CNavArea *subjectArea = combat->GetLastKnownArea();
-		CNavArea *myArea = GetBot()->GetEntity()->GetLastKnownArea();
-		if ( myArea && subjectArea )
-		{
-			if ( !myArea->IsPotentiallyVisible( subjectArea ) )
-			{
-				// subject is not potentially visible, skip the expensive raycast
-				return false;
-			}
-		}
+		// subject is not potentially visible, skip the expensive raycast
+		return false;
 	}
 
 	// do actual line-of-sight trace
@@ -611,6 +603,24 @@ bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV,
 }
 
 
+//------------------------------------------------------------------------------------------
+/**
+ * Return true if the subject's nav area is potentially visible from ours.
+ * Returns true if either of us is off the mesh.
+ */
+bool IVision::IsPotentiallyVisible( CBaseCombatCharacter *subject ) const
+{
+	CNavArea *subjectArea = subject->GetLastKnownArea();
+	CNavArea *myArea = GetBot()->GetEntity()->GetLastKnownArea();
+	if ( myArea && subjectArea )
+	{
+		return myArea->IsPotentiallyVisible( subjectArea );
+	}
+
+	return true;
+}
+
+
 //------------------------------------------------------------------------------------------
 bool IVision::IsAbleToSee( const Vector &pos, FieldOfViewCheckType checkFOV ) const
 {
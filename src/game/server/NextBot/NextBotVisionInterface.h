@@ -86,6 +86,7 @@ public:
 
 	virtual bool IsIgnored( CBaseEntity *subject ) const;		// return true to completely ignore this entity (may not be in sight when this is called)
 	virtual bool IsVisibleEntityNoticed( CBaseEntity *subject ) const;		// return true if we 'notice' the subject, even though we have LOS to it
+	virtual bool IsPotentiallyVisible( CBaseCombatCharacter *subject ) const;	// return true if the subject's nav area is potentially visible from ours (very fast)
 
 	/**
 	 * Check if 'subject' is within the viewer's field of view
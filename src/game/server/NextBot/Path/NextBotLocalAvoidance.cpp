@@ -0,0 +1,421 @@
+// NextBotLocalAvoidance.cpp
+// Neighbor lists and velocity obstacle avoidance between actors
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#include "cbase.h"
+
+#include "NextBot.h"
+#include "NextBotManager.h"
+#include "NextBotLocalAvoidance.h"
+
+#include "NextBotLocomotionInterface.h"
+#include "NextBotBodyInterface.h"
+
+#include "tier0/vprof.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar NextBotAvoidTimeHorizon( "nb_avoid_time_horizon", "1", FCVAR_CHEAT, "How far ahead in time bots look for collisions with other actors" );
+ConVar NextBotAvoidCollisionWeight( "nb_avoid_collision_weight", "0.5", FCVAR_CHEAT, "How strongly bots prefer directions that delay collisions with other actors, relative to keeping their heading" );
+
+static const float neighborCellSize = 128.0f;
+
+
+//--------------------------------------------------------------------------------------------------------------
+NextBotNeighborGrid &TheNextBotNeighbors( void )
+{
+	static NextBotNeighborGrid grid;
+	return grid;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+NextBotNeighborGrid::NextBotNeighborGrid( void )
+{
+	Reset();
+	m_avoidCount = 0;
+	m_avoidNeighborsTested = 0;
+	m_avoidTime = 0.0;
+	m_avoidMaxTime = 0.0;
+	m_avoidMaxEntIndex = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void NextBotNeighborGrid::Reset( void )
+{
+	m_tick = -1;
+	m_neighborVector.RemoveAll();
+	m_cellMap.RemoveAll();
+	m_maxRadius = 0.0f;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+int NextBotNeighborGrid::GetCell( float value )
+{
+	return (int)floor( value / neighborCellSize );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void NextBotNeighborGrid::AddActor( CBaseCombatCharacter *entity, INextBot *bot )
+{
+	int index = m_neighborVector.AddToTail();
+	Neighbor &neighbor = m_neighborVector[ index ];
+
+	neighbor.m_entity = entity;
+	neighbor.m_bot = bot;
+	neighbor.m_feet = entity->GetAbsOrigin();
+	neighbor.m_velocity = bot ? bot->GetLocomotionInterface()->GetVelocity() : entity->GetAbsVelocity();
+	neighbor.m_radius = entity->CollisionProp()->OBBMaxs().x;
+	neighbor.m_height = entity->CollisionProp()->OBBMaxs().z;
+
+	m_maxRadius = MAX( m_maxRadius, neighbor.m_radius );
+
+	// link into cell
+	bool inserted;
+	UtlHashHandle_t h = m_cellMap.Insert( GetCellKey( GetCell( neighbor.m_feet.x ), GetCell( neighbor.m_feet.y ) ), index, &inserted );
+	if ( inserted )
+	{
+		neighbor.m_next = -1;
+	}
+	else
+	{
+		neighbor.m_next = m_cellMap.Element( h );
+		m_cellMap.Element( h ) = index;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Rebuild the grid if it is from a previous tick
+ */
+void NextBotNeighborGrid::Update( void )
+{
+	if ( m_tick == gpGlobals->tickcount )
+		return;
+
+	VPROF_BUDGET( "NextBotNeighborGrid::Update", "NextBot" );
+
+	m_tick = gpGlobals->tickcount;
+	m_neighborVector.RemoveAll();
+	m_cellMap.RemoveAll();
+	m_maxRadius = 0.0f;
+
+	CUtlVector< INextBot * > botVector;
+	TheNextBots().CollectAllBots( &botVector );
+
+	FOR_EACH_VEC( botVector, it )
+	{
+		CBaseCombatCharacter *entity = botVector[ it ]->GetEntity();
+		if ( entity && entity->IsAlive() )
+		{
+			AddActor( entity, botVector[ it ] );
+		}
+	}
+
+	// players that aren't bots
+	for( int i=1; i<=gpGlobals->maxClients; ++i )
+	{
+		CBasePlayer *player = UTIL_PlayerByIndex( i );
+
+		if ( !player || !player->IsAlive() || player->MyNextBotPointer() )
+			continue;
+
+#ifdef TERROR
+		if ( player->IsGhost() )
+			continue;
+#endif // TERROR
+
+		AddActor( player, NULL );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+class FindActorAlongSegmentScan
+{
+public:
+	FindActorAlongSegmentScan( INextBot *bot, const Vector &from, const Vector &to, float halfWidth, float zMin, float zMax )
+	{
+		m_bot = bot;
+		m_from = from;
+		m_along = to - from;
+		m_along.z = 0.0f;
+		m_lengthSq = m_along.LengthSqr();
+		m_halfWidth = halfWidth;
+		m_zMin = MIN( from.z, to.z ) + zMin;
+		m_zMax = MAX( from.z, to.z ) + zMax;
+		m_closeActor = NULL;
+		m_closeFraction = FLT_MAX;
+		m_tested = 0;
+	}
+
+	bool operator() ( const NextBotNeighborGrid::Neighbor &neighbor )
+	{
+		if ( m_bot->IsSelf( neighbor.m_entity ) )
+			return true;
+
+		++m_tested;
+
+		if ( neighbor.m_feet.z > m_zMax || neighbor.m_feet.z + neighbor.m_height < m_zMin )
+			return true;
+
+		// closest point on segment to the neighbor, in the XY plane
+		Vector to = neighbor.m_feet - m_from;
+		to.z = 0.0f;
+
+		float t = ( m_lengthSq > 0.0f ) ? clamp( DotProduct( to, m_along ) / m_lengthSq, 0.0f, 1.0f ) : 0.0f;
+		Vector offset = to - t * m_along;
+
+		float reach = m_halfWidth + neighbor.m_radius;
+		if ( offset.LengthSqr() < reach * reach && t < m_closeFraction )
+		{
+			m_closeFraction = t;
+			m_closeActor = neighbor.m_entity;
+		}
+
+		return true;
+	}
+
+	INextBot *m_bot;
+	Vector m_from;
+	Vector m_along;
+	float m_lengthSq;
+	float m_halfWidth;
+	float m_zMin, m_zMax;
+	CBaseCombatCharacter *m_closeActor;
+	float m_closeFraction;
+	int m_tested;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the actor closest to 'from' whose hull overlaps a box of the given half width and
+ * height range swept from 'from' to 'to'. This is the neighbor list version of a hull trace
+ * with NextBotTraceFilterOnlyActors.
+ */
+CBaseCombatCharacter *NextBotNeighborGrid::FindActorAlongSegment( INextBot *bot, const Vector &from, const Vector &to, float halfWidth, float zMin, float zMax, int *neighborsTested )
+{
+	FindActorAlongSegmentScan scan( bot, from, to, halfWidth, zMin, zMax );
+
+	Vector center = 0.5f * ( from + to );
+	float range = 0.5f * ( to - from ).Length2D() + halfWidth;
+	ForEachNeighbor( center, range, scan );
+
+	if ( neighborsTested )
+	{
+		*neighborsTested += scan.m_tested;
+	}
+
+	return scan.m_closeActor;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+class CollectAvoidNeighbors
+{
+public:
+	CollectAvoidNeighbors( INextBot *bot, float range )
+	{
+		m_bot = bot;
+		m_feet = bot->GetLocomotionInterface()->GetFeet();
+		m_range = range;
+		m_height = bot->GetBodyInterface()->GetHullHeight();
+		m_tested = 0;
+	}
+
+	bool operator() ( const NextBotNeighborGrid::Neighbor &neighbor )
+	{
+		if ( m_bot->IsSelf( neighbor.m_entity ) )
+			return true;
+
+		++m_tested;
+
+		// enemies are something to fight, not to politely step around
+		if ( !m_bot->GetEntity()->InSameTeam( neighbor.m_entity ) )
+			return true;
+
+		if ( neighbor.m_feet.z > m_feet.z + m_height || neighbor.m_feet.z + neighbor.m_height < m_feet.z )
+			return true;
+
+		float reach = m_range + neighbor.m_radius;
+		if ( ( neighbor.m_feet - m_feet ).AsVector2D().LengthSqr() < reach * reach )
+		{
+			m_neighborVector.AddToTail( &neighbor );
+		}
+
+		return true;
+	}
+
+	INextBot *m_bot;
+	Vector m_feet;
+	float m_range;
+	float m_height;
+	int m_tested;
+	CUtlVectorFixedGrowable< const NextBotNeighborGrid::Neighbor *, 32 > m_neighborVector;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return time until a circle at 'pos' relative to us, moving with relative velocity 'velocity'
+ * towards us, comes within 'radius'. Returns FLT_MAX if it never does.
+ */
+static float TimeToCollision( const Vector2D &pos, const Vector2D &velocity, float radius )
+{
+	float closing = DotProduct2D( pos, velocity );
+	float distSq = pos.LengthSqr();
+	float excessSq = distSq - radius * radius;
+
+	if ( excessSq < 0.0f )
+	{
+		// already touching - only a problem if we're moving further in
+		return ( closing > 0.0f ) ? 0.0f : FLT_MAX;
+	}
+
+	if ( closing <= 0.0f )
+		return FLT_MAX;
+
+	float speedSq = velocity.LengthSqr();
+	float discriminant = closing * closing - speedSq * excessSq;
+	if ( discriminant < 0.0f )
+		return FLT_MAX;
+
+	return ( closing - sqrt( discriminant ) ) / speedSq;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Pick the direction closest to 'preferredDir' that doesn't run into any nearby actor
+ * within the time horizon. Other actors are assumed to do half the work of avoiding us
+ * (reciprocal velocity obstacles), which keeps pairs of bots from oscillating.
+ * Returns false if moving along 'preferredDir' is already fine.
+ */
+bool NextBotNeighborGrid::ComputeAvoidanceDirection( INextBot *bot, const Vector &preferredDir, float speed, Vector *avoidDir, int *neighborsTested )
+{
+	VPROF_BUDGET( "NextBotNeighborGrid::ComputeAvoidanceDirection", "NextBot" );
+
+	if ( speed <= 0.0f )
+		return false;
+
+	ILocomotion *mover = bot->GetLocomotionInterface();
+	float myRadius = bot->GetBodyInterface()->GetHullWidth() / 2.0f;
+
+	const float timeHorizon = NextBotAvoidTimeHorizon.GetFloat();
+	float range = 2.0f * speed * timeHorizon + myRadius;
+
+	CollectAvoidNeighbors collect( bot, range );
+	ForEachNeighbor( mover->GetFeet(), range, collect );
+
+	if ( neighborsTested )
+	{
+		*neighborsTested += collect.m_tested;
+	}
+
+	if ( collect.m_neighborVector.Count() == 0 )
+		return false;
+
+	Vector2D myVelocity = mover->GetVelocity().AsVector2D();
+	Vector2D preferredVelocity = speed * preferredDir.AsVector2D();
+	const float collisionWeight = NextBotAvoidCollisionWeight.GetFloat();
+	const float minTime = 0.01f;
+
+	// candidate headings, relative to the preferred one, in order of preference
+	static const float candidateAngle[] = { 0.0f, 15.0f, -15.0f, 30.0f, -30.0f, 45.0f, -45.0f, 60.0f, -60.0f, 90.0f, -90.0f, 120.0f, -120.0f };
+	const int candidateCount = ARRAYSIZE( candidateAngle );
+
+	int bestCandidate = 0;
+	float bestPenalty = FLT_MAX;
+	Vector2D bestDir = preferredDir.AsVector2D();
+
+	for( int c=0; c<candidateCount; ++c )
+	{
+		float s, co;
+		SinCos( DEG2RAD( candidateAngle[c] ), &s, &co );
+
+		Vector2D dir( co * preferredDir.x - s * preferredDir.y, s * preferredDir.x + co * preferredDir.y );
+		Vector2D velocity = speed * dir;
+
+		float penalty = ( velocity - preferredVelocity ).Length() / speed;
+		if ( penalty >= bestPenalty )
+		{
+			// candidates only get further from the preferred heading
+			continue;
+		}
+
+		float firstCollision = FLT_MAX;
+		FOR_EACH_VEC( collect.m_neighborVector, it )
+		{
+			const NextBotNeighborGrid::Neighbor *neighbor = collect.m_neighborVector[ it ];
+
+			Vector2D toNeighbor = ( neighbor->m_feet - mover->GetFeet() ).AsVector2D();
+			Vector2D relativeVelocity = 2.0f * velocity - myVelocity - neighbor->m_velocity.AsVector2D();
+
+			const float margin = 2.0f;
+			float t = TimeToCollision( toNeighbor, relativeVelocity, myRadius + neighbor->m_radius + margin );
+			firstCollision = MIN( firstCollision, t );
+		}
+
+		if ( firstCollision < timeHorizon )
+		{
+			penalty += collisionWeight / MAX( firstCollision, minTime );
+		}
+
+		if ( penalty < bestPenalty )
+		{
+			bestPenalty = penalty;
+			bestCandidate = c;
+			bestDir = dir;
+		}
+	}
+
+	if ( bestCandidate == 0 )
+		return false;
+
+	avoidDir->x = bestDir.x;
+	avoidDir->y = bestDir.y;
+	avoidDir->z = 0.0f;
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void NextBotNeighborGrid::AddAvoidCost( INextBot *bot, double seconds, int neighborsTested )
+{
+	++m_avoidCount;
+	m_avoidNeighborsTested += neighborsTested;
+	m_avoidTime += seconds;
+
+	if ( seconds > m_avoidMaxTime )
+	{
+		m_avoidMaxTime = seconds;
+		m_avoidMaxEntIndex = bot->GetEntity()->entindex();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Print and clear avoidance cost since last call
+ */
+void NextBotNeighborGrid::PrintAvoidStats( void )
+{
+	if ( m_avoidCount )
+	{
+		Msg( "                    avoidance: %3d checks, %d neighbors tested, %.3fms total, %.3fms per bot, %.3fms max (#%d), %d actors in grid\n",
+			 m_avoidCount, m_avoidNeighborsTested, m_avoidTime * 1000.0, m_avoidTime * 1000.0 / m_avoidCount, m_avoidMaxTime * 1000.0, m_avoidMaxEntIndex, m_neighborVector.Count() );
+	}
+
+	m_avoidCount = 0;
+	m_avoidNeighborsTested = 0;
+	m_avoidTime = 0.0;
+	m_avoidMaxTime = 0.0;
+	m_avoidMaxEntIndex = 0;
+}
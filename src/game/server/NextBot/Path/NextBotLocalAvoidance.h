@@ -0,0 +1,119 @@
+// NextBotLocalAvoidance.h
+// Neighbor lists and velocity obstacle avoidance between actors
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#ifndef _NEXT_BOT_LOCAL_AVOIDANCE_H_
+#define _NEXT_BOT_LOCAL_AVOIDANCE_H_
+
+#include "tier1/utlhashtable.h"
+
+class INextBot;
+class CBaseCombatCharacter;
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Positions and velocities of all living actors (NextBots and players), bucketed into a 2D grid
+ * once per tick. Lets path followers find nearby actors without tracing against them.
+ */
+class NextBotNeighborGrid
+{
+public:
+	NextBotNeighborGrid( void );
+
+	struct Neighbor
+	{
+		CBaseCombatCharacter *m_entity;
+		INextBot *m_bot;							// NULL if this is a player that isn't a bot
+		Vector m_feet;
+		Vector m_velocity;
+		float m_radius;								// half of hull width
+		float m_height;
+		int m_next;									// next neighbor in the same cell, or -1
+	};
+
+	void Reset( void );
+
+	/**
+	 * Invoke functor on each actor whose hull may be within 'range' of 'pos' in the XY plane.
+	 * If functor returns false, stop iterating and return false.
+	 */
+	template < typename Functor >
+	bool ForEachNeighbor( const Vector &pos, float range, Functor &func );
+
+	float GetMaxRadius( void ) const				{ return m_maxRadius; }
+
+	// return the actor closest to 'from' whose hull overlaps a box of the given half width and height range swept from 'from' to 'to'
+	CBaseCombatCharacter *FindActorAlongSegment( INextBot *bot, const Vector &from, const Vector &to, float halfWidth, float zMin, float zMax, int *neighborsTested );
+
+	/**
+	 * Pick the direction closest to 'preferredDir' (unit, XY) that doesn't run into any nearby actor
+	 * within the time horizon, treating other actors as also avoiding us (reciprocal velocity obstacles).
+	 * Returns false if moving along 'preferredDir' is already fine.
+	 */
+	bool ComputeAvoidanceDirection( INextBot *bot, const Vector &preferredDir, float speed, Vector *avoidDir, int *neighborsTested );
+
+	// avoidance cost accounting, reported by nb_update_debug
+	void AddAvoidCost( INextBot *bot, double seconds, int neighborsTested );
+	void PrintAvoidStats( void );					// print and clear
+
+private:
+	void Update( void );							// rebuild the grid if it is from a previous tick
+	void AddActor( CBaseCombatCharacter *entity, INextBot *bot );
+
+	static unsigned int GetCellKey( int x, int y )	{ return ( (unsigned int)( x & 0xFFFF ) ) | ( (unsigned int)( y & 0xFFFF ) << 16 ); }
+	static int GetCell( float value );
+
+	int m_tick;
+	CUtlVector< Neighbor > m_neighborVector;
+	CUtlHashtable< unsigned int, int > m_cellMap;	// cell key -> first neighbor in cell
+	float m_maxRadius;
+
+	int m_avoidCount;
+	int m_avoidNeighborsTested;
+	double m_avoidTime;
+	double m_avoidMaxTime;
+	int m_avoidMaxEntIndex;
+};
+
+
+//--------------------------------------------------------------------------------------------------------
+template < typename Functor >
+inline bool NextBotNeighborGrid::ForEachNeighbor( const Vector &pos, float range, Functor &func )
+{
+	Update();
+
+	if ( m_neighborVector.Count() == 0 )
+		return true;
+
+	range += m_maxRadius;
+
+	int loX = GetCell( pos.x - range );
+	int hiX = GetCell( pos.x + range );
+	int loY = GetCell( pos.y - range );
+	int hiY = GetCell( pos.y + range );
+
+	for( int y = loY; y <= hiY; ++y )
+	{
+		for( int x = loX; x <= hiX; ++x )
+		{
+			UtlHashHandle_t h = m_cellMap.Find( GetCellKey( x, y ) );
+			if ( h == m_cellMap.InvalidHandle() )
+				continue;
+
+			for( int i = m_cellMap.Element( h ); i >= 0; i = m_neighborVector[i].m_next )
+			{
+				if ( !func( m_neighborVector[i] ) )
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+extern NextBotNeighborGrid &TheNextBotNeighbors( void );
+
+
+#endif // _NEXT_BOT_LOCAL_AVOIDANCE_H_
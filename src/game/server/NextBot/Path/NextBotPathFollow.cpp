@@ -11,6 +11,7 @@
 #include "NextBot.h"
 #include "NextBotPathFollow.h"
 #include "NextBotUtil.h"
+#include "NextBotLocalAvoidance.h"
 
 #include "NextBotLocomotionInterface.h"
 #include "NextBotBodyInterface.h"
@@ -26,11 +27,14 @@ ConVar NextBotGoalLookAheadRange( "nb_goal_look_ahead_range", "50", FCVAR_CHEAT
 ConVar NextBotLadderAlignRange( "nb_ladder_align_range", "50", FCVAR_CHEAT );
 
 ConVar NextBotAllowAvoiding( "nb_allow_avoiding", "1", FCVAR_CHEAT );
+ConVar NextBotAvoidNeighbors( "nb_avoid_neighbors", "1", FCVAR_CHEAT, "If nonzero, bots find nearby teammates with the neighbor grid and steer around them with velocity obstacles, instead of tracing against them" );
 ConVar NextBotAllowClimbing( "nb_allow_climbing", "1", FCVAR_CHEAT );
 ConVar NextBotAllowGapJumping( "nb_allow_gap_jumping", "1", FCVAR_CHEAT );
 
 ConVar NextBotDebugClimbing( "nb_debug_climbing", "0", FCVAR_CHEAT );
 
+extern ConVar nb_update_debug;
+
 
 //--------------------------------------------------------------------------------------------------------------
 /**
@@ -743,7 +747,24 @@ void PathFollower::Update( INextBot *bot )
 		const float nearLedgeRange = 50.0f;
 		if ( rangeToGoal > nearLedgeRange || ( m_goal && m_goal->type != CLIMB_UP ) )
 		{
-			goalPos = Avoid( bot, goalPos, forward, left );
+			if ( m_avoidTimer.IsElapsed() )
+			{
+				int neighborsTested = 0;
+
+				if ( nb_update_debug.GetBool() )
+				{
+					// track how expensive avoidance is, printed and cleared each frame by the bot manager
+					double startTime = Plat_FloatTime();
+
+					goalPos = Avoid( bot, goalPos, forward, left, &neighborsTested );
+
+					TheNextBotNeighbors().AddAvoidCost( bot, Plat_FloatTime() - startTime, neighborsTested );
+				}
+				else
+				{
+					goalPos = Avoid( bot, goalPos, forward, left, &neighborsTested );
+				}
+			}
 		}
 	}
 
@@ -790,7 +811,7 @@ void PathFollower::Update( INextBot *bot )
 /**
  * If entity is returned, it is blocking us from continuing along our path
  */
-CBaseEntity *PathFollower::FindBlocker( INextBot *bot )
+CBaseEntity *PathFollower::FindBlocker( INextBot *bot, int *neighborsTested )
 {
 	IIntention *think = bot->GetIntentionInterface();
 
@@ -831,12 +852,25 @@ CBaseEntity *PathFollower::FindBlocker( INextBot *bot )
 			traceRange = minTraceRange;
 		}
 
-		mover->TraceHull( from, from + traceRange * traceForward, blockerMins, blockerMaxs, body->GetSolidMask(), &filter, &result );
+		CBaseEntity *blocker = NULL;
+		if ( NextBotAvoidNeighbors.GetBool() )
+		{
+			blocker = TheNextBotNeighbors().FindActorAlongSegment( bot, from, from + traceRange * traceForward, size, blockerMins.z, blockerMaxs.z, neighborsTested );
+		}
+		else
+		{
+			mover->TraceHull( from, from + traceRange * traceForward, blockerMins, blockerMaxs, body->GetSolidMask(), &filter, &result );
 
-		if ( result.DidHitNonWorldEntity() )
+			if ( result.DidHitNonWorldEntity() )
+			{
+				blocker = result.m_pEnt;
+			}
+		}
+
+		if ( blocker )
 		{
 			// if blocker is close, they could be behind us - check
-			Vector toBlocker = result.m_pEnt->GetAbsOrigin() - bot->GetLocomotionInterface()->GetFeet();
+			Vector toBlocker = blocker->GetAbsOrigin() - bot->GetLocomotionInterface()->GetFeet();
 
 			Vector alongPath = s->pos - from;
 			alongPath.z = 0.0f;
@@ -844,16 +878,16 @@ CBaseEntity *PathFollower::FindBlocker( INextBot *bot )
 			if ( DotProduct( toBlocker, alongPath ) > 0.0f )
 			{
 				// ask the bot if this really is a hindrance
-				if ( think->IsHindrance( bot, result.m_pEnt ) == ANSWER_YES )
+				if ( think->IsHindrance( bot, blocker ) == ANSWER_YES )
 				{
 					if ( bot->IsDebugging( NEXTBOT_PATH ) )
 					{
 						NDebugOverlay::Circle( bot->GetLocomotionInterface()->GetFeet(), QAngle( -90.0f, 0, 0 ), 10.0f, 255, 0, 0, 255, true, 1.0f );
-						NDebugOverlay::HorzArrow( bot->GetLocomotionInterface()->GetFeet(), result.m_pEnt->GetAbsOrigin(), 1.0f, 255, 0, 0, 255, true, 1.0f );
+						NDebugOverlay::HorzArrow( bot->GetLocomotionInterface()->GetFeet(), blocker->GetAbsOrigin(), 1.0f, 255, 0, 0, 255, true, 1.0f );
 					}
 
 					// we are blocked
-					return result.m_pEnt;
+					return blocker;
 				}
 			}
 		}
@@ -871,7 +905,7 @@ CBaseEntity *PathFollower::FindBlocker( INextBot *bot )
  * Do reflex avoidance movements of very nearby obstacles.
  * Return adjusted goal.
  */
-Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &forward, const Vector &left )
+Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &forward, const Vector &left, int *neighborsTested )
 {
 	VPROF_BUDGET( "PathFollower::Avoid", "NextBotExpensive" );
 
@@ -899,7 +933,7 @@ Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &
 	//
 	// Check for potential blockers along our path and wait if we're blocked
 	//
-	m_hindrance = FindBlocker( bot );
+	m_hindrance = FindBlocker( bot, neighborsTested );
 	if ( m_hindrance != NULL )
 	{
 		// wait 
@@ -948,8 +982,12 @@ Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &
 	m_isLeftClear = true;
 	float leftAvoid = 0.0f;
 
-	NextBotTraversableTraceFilter traverseFilter( bot );
-	mover->TraceHull( m_leftFrom, m_leftTo, m_hullMin, m_hullMax, mask, &traverseFilter, &result );
+	// if teammates are handled by the neighbor grid, only trace against enemies and the environment
+	NextBotTraversableTraceFilter actorTraverseFilter( bot );
+	NextBotTraversableIgnoreTeammatesTraceFilter teammateTraverseFilter( bot );
+	ITraceFilter *traverseFilter = NextBotAvoidNeighbors.GetBool() ? static_cast< ITraceFilter * >( &teammateTraverseFilter ) : &actorTraverseFilter;
+
+	mover->TraceHull( m_leftFrom, m_leftTo, m_hullMin, m_hullMax, mask, traverseFilter, &result );
 	if ( result.fraction < 1.0f || result.startsolid )
 	{
 		// if this sensor is starting in a solid, set fraction to emulate being against a wall
@@ -985,7 +1023,7 @@ Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &
 	m_isRightClear = true;
 	float rightAvoid = 0.0f;
 
-	mover->TraceHull( m_rightFrom, m_rightTo, m_hullMin, m_hullMax, mask, &traverseFilter, &result );
+	mover->TraceHull( m_rightFrom, m_rightTo, m_hullMin, m_hullMax, mask, traverseFilter, &result );
 	if ( result.fraction < 1.0f || result.startsolid )
 	{
 		// if this sensor is starting in a solid, set fraction to emulate being against a wall
@@ -1078,6 +1116,25 @@ Vector PathFollower::Avoid( INextBot *bot, const Vector &goalPos, const Vector &
 		// do avoid check again next frame
 		m_avoidTimer.Invalidate();
 	}
+	else if ( NextBotAvoidNeighbors.GetBool() )
+	{
+		// the way is clear of enemies and static obstacles - steer around teammates
+		float speed = mover->IsRunning() ? mover->GetRunSpeed() : mover->GetWalkSpeed();
+
+		Vector avoidDir;
+		if ( TheNextBotNeighbors().ComputeAvoidanceDirection( bot, forward, speed, &avoidDir, neighborsTested ) )
+		{
+			adjustedGoal = mover->GetFeet() + 100.0f * avoidDir;
+
+			if ( bot->IsDebugging( NEXTBOT_PATH ) )
+			{
+				NDebugOverlay::HorzArrow( mover->GetFeet(), adjustedGoal, 2.0f, 255, 100, 0, 255, true, 0.1f );
+			}
+
+			// do avoid check again next frame
+			m_avoidTimer.Invalidate();
+		}
+	}
 	
 	return adjustedGoal;
 }
@@ -71,12 +71,12 @@ private:
 
 	void AdjustSpeed( INextBot *bot );				// adjust speed based on path curvature
 
-	Vector Avoid( INextBot *bot, const Vector &goalPos, const Vector &forward, const Vector &left );		// avoidance movements for very nearby obstacles. returns modified goal position
+	Vector Avoid( INextBot *bot, const Vector &goalPos, const Vector &forward, const Vector &left, int *neighborsTested );		// avoidance movements for very nearby obstacles. returns modified goal position
 	bool Climbing( INextBot *bot, const Path::Segment *goal, const Vector &forward, const Vector &left, float goalRange );		// climb up ledges 
 	bool JumpOverGaps( INextBot *bot, const Path::Segment *goal, const Vector &forward, const Vector &left, float goalRange );	// jump over gaps
 
 	bool LadderUpdate( INextBot *bot );				// move bot along ladder
-	CBaseEntity *FindBlocker( INextBot *bot );		// if entity is returned, it is blocking us from continuing along our path
+	CBaseEntity *FindBlocker( INextBot *bot, int *neighborsTested );		// if entity is returned, it is blocking us from continuing along our path
 
 	float m_goalTolerance;
 };
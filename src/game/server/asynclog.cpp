@@ -0,0 +1,1076 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Background formatting of server log lines, and an optional JSON copy
+//			written from the same thread.
+//
+// UTIL_LogPrintf() used to format every line with Q_vsnprintf() and hand it to
+// engine->LogPrint() on the main thread, which shows up when a lot of players die
+// at once. With sv_logasync on, the main thread only copies the format string and
+// its arguments into a slot of a lock-free ring. The log thread formats them and
+// optionally writes them as newline-delimited JSON to a file or Unix socket.
+// The engine's log targets aren't thread safe, so writing the text log still
+// happens on the main thread: the formatted lines are handed back to it, and it
+// passes them to engine->LogPrint() once per frame, in order. Lines the engine
+// logs itself don't go through the queue, so it is off by default; turn it on
+// where the log is only read for game events.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "asynclog.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlbuffer.h"
+#include <time.h>
+
+#ifdef POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static void AsyncLogJsonTargetChanged( IConVar *var, const char *pOldValue, float flOldValue );
+static void AsyncLogEnabledChanged( IConVar *var, const char *pOldValue, float flOldValue );
+
+ConVar sv_logasync( "sv_logasync", "0", FCVAR_NONE, "Format log lines on a background thread; the main thread still writes them to the log. Game lines reach the log up to a frame late, so they can be out of order with, and timestamped after, lines the engine logs directly. Required by sv_logjson.", AsyncLogEnabledChanged );
+ConVar sv_logasync_drop( "sv_logasync_drop", "0", FCVAR_NONE, "If the log queue is full, drop lines instead of waiting for the log thread" );
+ConVar sv_logjson( "sv_logjson", "", FCVAR_NONE, "Also write log lines as newline-delimited JSON to this file (relative to the game directory), or to a Unix socket given as 'unix:<path>'. Only works with sv_logasync 1.", AsyncLogJsonTargetChanged );
+
+// Matches the buffer UTIL_LogPrintf() always formatted into, so long lines get clipped the same way
+#define ASYNCLOG_LINE_SIZE		1024
+#define ASYNCLOG_SLOT_COUNT		2048		// power of two
+#define ASYNCLOG_JSON_RETRY		5.0f		// seconds between attempts to reopen a JSON target
+
+enum LogRecordType_t
+{
+	LOG_RECORD_TEXT,			// already formatted on the main thread
+	LOG_RECORD_TYPED,			// format string followed by the captured arguments
+};
+
+struct LogRecord_t
+{
+	int m_nType;
+	int m_nSize;				// bytes used in m_data
+	int m_nTick;
+	int64 m_nTime;				// unix time
+	char m_data[ASYNCLOG_LINE_SIZE];
+};
+
+struct LogSlot_t
+{
+	CInterlockedUInt m_nSequence;
+	LogRecord_t m_record;
+};
+
+
+//-----------------------------------------------------------------------------
+// printf conversions. The main thread and the log thread both walk the format
+// string with this, so they agree on the type of every argument.
+//-----------------------------------------------------------------------------
+enum LogArgLength_t
+{
+	LOG_ARG_DEFAULT,			// int, or double
+	LOG_ARG_LONG,
+	LOG_ARG_LONGLONG,
+	LOG_ARG_SIZE,
+};
+
+struct LogConversion_t
+{
+	const char *m_pStart;		// the '%'
+	int m_nLength;				// of the whole conversion spec
+	char m_type;				// the conversion character
+	LogArgLength_t m_argLength;
+};
+
+//-----------------------------------------------------------------------------
+// Parses the conversion at pFormat (which points at a '%'). Returns false for
+// anything this doesn't know how to capture, like '*' widths or %n.
+//-----------------------------------------------------------------------------
+static bool ParseLogConversion( const char *pFormat, LogConversion_t *pConversion )
+{
+	const char *p = pFormat + 1;
+
+	while ( *p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' )
+		p++;
+
+	while ( *p >= '0' && *p <= '9' )
+		p++;
+
+	if ( *p == '.' )
+	{
+		p++;
+		while ( *p >= '0' && *p <= '9' )
+			p++;
+	}
+
+	pConversion->m_argLength = LOG_ARG_DEFAULT;
+	if ( p[0] == 'h' )
+	{
+		// promoted to int anyway
+		p += ( p[1] == 'h' ) ? 2 : 1;
+	}
+	else if ( p[0] == 'l' && p[1] == 'l' )
+	{
+		pConversion->m_argLength = LOG_ARG_LONGLONG;
+		p += 2;
+	}
+	else if ( p[0] == 'l' )
+	{
+		pConversion->m_argLength = LOG_ARG_LONG;
+		p++;
+	}
+	else if ( p[0] == 'z' )
+	{
+		pConversion->m_argLength = LOG_ARG_SIZE;
+		p++;
+	}
+
+	pConversion->m_type = *p;
+	switch ( *p )
+	{
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		break;
+
+	case 'c': case 's': case 'p':
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+	case '%':
+		// wide characters and long doubles aren't supported
+		if ( pConversion->m_argLength != LOG_ARG_DEFAULT )
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	pConversion->m_pStart = pFormat;
+	pConversion->m_nLength = p + 1 - pFormat;
+	return true;
+}
+
+static bool IsLogConversionSigned( char type )
+{
+	return type == 'd' || type == 'i';
+}
+
+static bool IsLogConversionFloat( char type )
+{
+	return V_strchr( "fFeEgGaA", type ) != NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Writes the arguments of a printf style call into a record. Integers and
+// pointers are stored as 8 bytes, doubles as 8 bytes, and strings as a present
+// byte followed by the characters and a terminator. Returns false if the
+// format isn't supported or the arguments don't fit.
+//-----------------------------------------------------------------------------
+class CLogRecordWriter
+{
+public:
+	CLogRecordWriter( LogRecord_t *pRecord ) : m_pRecord( pRecord ), m_nSize( 0 ), m_bOverflow( false ) {}
+
+	void Put( const void *pData, int nSize )
+	{
+		if ( m_nSize + nSize > (int)sizeof( m_pRecord->m_data ) )
+		{
+			m_bOverflow = true;
+			return;
+		}
+		memcpy( m_pRecord->m_data + m_nSize, pData, nSize );
+		m_nSize += nSize;
+	}
+
+	void PutInt64( int64 nValue )		{ Put( &nValue, sizeof( nValue ) ); }
+	void PutDouble( double flValue )	{ Put( &flValue, sizeof( flValue ) ); }
+
+	LogRecord_t *m_pRecord;
+	int m_nSize;
+	bool m_bOverflow;
+};
+
+static bool ValidateLogFormat( const char *fmt )
+{
+	for ( const char *p = fmt; *p; p++ )
+	{
+		if ( *p != '%' )
+			continue;
+
+		LogConversion_t conversion;
+		if ( !ParseLogConversion( p, &conversion ) )
+			return false;
+		p += conversion.m_nLength - 1;
+	}
+	return true;
+}
+
+static bool CaptureLogArgs( LogRecord_t *pRecord, const char *fmt, va_list argptr )
+{
+	CLogRecordWriter writer( pRecord );
+	writer.Put( fmt, V_strlen( fmt ) + 1 );
+
+	for ( const char *p = fmt; *p && !writer.m_bOverflow; p++ )
+	{
+		if ( *p != '%' )
+			continue;
+
+		LogConversion_t conversion;
+		ParseLogConversion( p, &conversion );
+		p += conversion.m_nLength - 1;
+
+		char type = conversion.m_type;
+		if ( type == '%' )
+		{
+			continue;
+		}
+		else if ( type == 's' )
+		{
+			const char *pString = va_arg( argptr, const char * );
+			char bPresent = ( pString != NULL );
+			writer.Put( &bPresent, 1 );
+			if ( pString )
+			{
+				writer.Put( pString, V_strlen( pString ) + 1 );
+			}
+		}
+		else if ( type == 'p' )
+		{
+			writer.PutInt64( (int64)(intp)va_arg( argptr, void * ) );
+		}
+		else if ( IsLogConversionFloat( type ) )
+		{
+			writer.PutDouble( va_arg( argptr, double ) );
+		}
+		else
+		{
+			bool bSigned = IsLogConversionSigned( type );
+			switch ( conversion.m_argLength )
+			{
+			case LOG_ARG_LONG:		writer.PutInt64( bSigned ? (int64)va_arg( argptr, long ) : (int64)va_arg( argptr, unsigned long ) ); break;
+			case LOG_ARG_LONGLONG:	writer.PutInt64( (int64)va_arg( argptr, long long ) ); break;
+			case LOG_ARG_SIZE:		writer.PutInt64( (int64)va_arg( argptr, size_t ) ); break;
+			default:				writer.PutInt64( bSigned ? (int64)va_arg( argptr, int ) : (int64)va_arg( argptr, unsigned int ) ); break;
+			}
+		}
+	}
+
+	pRecord->m_nSize = writer.m_nSize;
+	return !writer.m_bOverflow;
+}
+
+
+//-----------------------------------------------------------------------------
+// Walks a typed record, producing the text line and/or the JSON argument array
+//-----------------------------------------------------------------------------
+class CLogRecordReader
+{
+public:
+	CLogRecordReader( const LogRecord_t *pRecord ) : m_pRecord( pRecord )
+	{
+		m_pFormat = pRecord->m_data;
+		m_nPos = V_strlen( m_pFormat ) + 1;
+	}
+
+	int64 GetInt64()
+	{
+		int64 nValue;
+		memcpy( &nValue, m_pRecord->m_data + m_nPos, sizeof( nValue ) );
+		m_nPos += sizeof( nValue );
+		return nValue;
+	}
+
+	double GetDouble()
+	{
+		double flValue;
+		memcpy( &flValue, m_pRecord->m_data + m_nPos, sizeof( flValue ) );
+		m_nPos += sizeof( flValue );
+		return flValue;
+	}
+
+	const char *GetString()
+	{
+		char bPresent = m_pRecord->m_data[m_nPos++];
+		if ( !bPresent )
+			return NULL;
+		const char *pString = m_pRecord->m_data + m_nPos;
+		m_nPos += V_strlen( pString ) + 1;
+		return pString;
+	}
+
+	const LogRecord_t *m_pRecord;
+	const char *m_pFormat;
+	int m_nPos;
+};
+
+// Appends as much of the printf output as fits, the way one big Q_vsnprintf() would have clipped it
+static void AppendLogText( char *pLine, int *pLength, const char *pSpec, ... )
+{
+	int nRemaining = ASYNCLOG_LINE_SIZE - *pLength;
+	if ( nRemaining <= 1 )
+		return;
+
+	va_list argptr;
+	va_start( argptr, pSpec );
+	int nWritten = vsnprintf( pLine + *pLength, nRemaining, pSpec, argptr );
+	va_end( argptr );
+
+	if ( nWritten > 0 )
+	{
+		*pLength += MIN( nWritten, nRemaining - 1 );
+	}
+}
+
+static void AppendJsonString( CUtlBuffer &buf, const char *pString )
+{
+	buf.PutChar( '"' );
+	for ( const unsigned char *p = (const unsigned char *)pString; *p; p++ )
+	{
+		switch ( *p )
+		{
+		case '"':	buf.PutString( "\\\"" ); break;
+		case '\\':	buf.PutString( "\\\\" ); break;
+		case '\n':	buf.PutString( "\\n" ); break;
+		case '\r':	buf.PutString( "\\r" ); break;
+		case '\t':	buf.PutString( "\\t" ); break;
+		default:
+			if ( *p < 0x20 )
+			{
+				buf.Printf( "\\u%04x", *p );
+			}
+			else
+			{
+				buf.PutChar( *p );
+			}
+			break;
+		}
+	}
+	buf.PutChar( '"' );
+}
+
+//-----------------------------------------------------------------------------
+// Formats a record into pLine (ASYNCLOG_LINE_SIZE bytes). If pJsonArgs is given, also
+// appends the arguments to it as a JSON array.
+//-----------------------------------------------------------------------------
+static void FormatLogRecord( const LogRecord_t &record, char *pLine, CUtlBuffer *pJsonArgs )
+{
+	if ( record.m_nType == LOG_RECORD_TEXT )
+	{
+		V_strncpy( pLine, record.m_data, ASYNCLOG_LINE_SIZE );
+		return;
+	}
+
+	CLogRecordReader reader( &record );
+	int nLength = 0;
+	pLine[0] = 0;
+
+	if ( pJsonArgs )
+	{
+		pJsonArgs->PutChar( '[' );
+	}
+	bool bFirstArg = true;
+
+	const char *p = reader.m_pFormat;
+	while ( *p )
+	{
+		// copy literal text
+		const char *pLiteral = p;
+		while ( *p && *p != '%' )
+			p++;
+		if ( p > pLiteral )
+		{
+			int nCopy = MIN( (int)( p - pLiteral ), ASYNCLOG_LINE_SIZE - 1 - nLength );
+			memcpy( pLine + nLength, pLiteral, nCopy );
+			nLength += nCopy;
+			pLine[nLength] = 0;
+		}
+		if ( !*p )
+			break;
+
+		LogConversion_t conversion;
+		ParseLogConversion( p, &conversion );
+		p += conversion.m_nLength;
+
+		char spec[32];
+		V_strncpy( spec, conversion.m_pStart, MIN( conversion.m_nLength + 1, (int)sizeof( spec ) ) );
+
+		char type = conversion.m_type;
+		if ( type == '%' )
+		{
+			AppendLogText( pLine, &nLength, "%%" );
+			continue;
+		}
+
+		if ( pJsonArgs && !bFirstArg )
+		{
+			pJsonArgs->PutChar( ',' );
+		}
+		bFirstArg = false;
+
+		if ( type == 's' )
+		{
+			const char *pString = reader.GetString();
+			AppendLogText( pLine, &nLength, spec, pString );
+			if ( pJsonArgs )
+			{
+				if ( pString )
+				{
+					AppendJsonString( *pJsonArgs, pString );
+				}
+				else
+				{
+					pJsonArgs->PutString( "null" );
+				}
+			}
+		}
+		else if ( type == 'p' )
+		{
+			void *pPointer = (void *)(intp)reader.GetInt64();
+			AppendLogText( pLine, &nLength, spec, pPointer );
+			if ( pJsonArgs )
+			{
+				pJsonArgs->Printf( "\"%p\"", pPointer );
+			}
+		}
+		else if ( IsLogConversionFloat( type ) )
+		{
+			double flValue = reader.GetDouble();
+			AppendLogText( pLine, &nLength, spec, flValue );
+			if ( pJsonArgs )
+			{
+				if ( IsFinite( flValue ) )
+				{
+					pJsonArgs->Printf( "%.17g", flValue );
+				}
+				else
+				{
+					pJsonArgs->PutString( "null" );
+				}
+			}
+		}
+		else if ( type == 'c' )
+		{
+			int nChar = (int)reader.GetInt64();
+			AppendLogText( pLine, &nLength, spec, nChar );
+			if ( pJsonArgs )
+			{
+				char szChar[2] = { (char)nChar, 0 };
+				AppendJsonString( *pJsonArgs, szChar );
+			}
+		}
+		else
+		{
+			int64 nValue = reader.GetInt64();
+			bool bSigned = IsLogConversionSigned( type );
+			switch ( conversion.m_argLength )
+			{
+			case LOG_ARG_LONG:		bSigned ? AppendLogText( pLine, &nLength, spec, (long)nValue ) : AppendLogText( pLine, &nLength, spec, (unsigned long)nValue ); break;
+			case LOG_ARG_LONGLONG:	AppendLogText( pLine, &nLength, spec, (long long)nValue ); break;
+			case LOG_ARG_SIZE:		AppendLogText( pLine, &nLength, spec, (size_t)nValue ); break;
+			default:				bSigned ? AppendLogText( pLine, &nLength, spec, (int)nValue ) : AppendLogText( pLine, &nLength, spec, (unsigned int)nValue ); break;
+			}
+
+			if ( pJsonArgs )
+			{
+				if ( bSigned )
+				{
+					pJsonArgs->Printf( "%lld", (long long)nValue );
+				}
+				else
+				{
+					// unsigned values were stored without sign extension
+					unsigned long long nUnsigned = ( conversion.m_argLength == LOG_ARG_DEFAULT ) ? (unsigned int)nValue : (unsigned long long)nValue;
+					pJsonArgs->Printf( "%llu", nUnsigned );
+				}
+			}
+		}
+	}
+
+	if ( pJsonArgs )
+	{
+		pJsonArgs->PutChar( ']' );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// The log thread, and the main thread side that feeds it and prints its output
+//-----------------------------------------------------------------------------
+class CAsyncLog : public CThread, public CAutoGameSystemPerFrame
+{
+public:
+	CAsyncLog();
+	~CAsyncLog();
+
+	bool LogPrintV( const char *fmt, va_list argptr );
+	void Flush( void );
+	void PrintStats( void );
+	void ResetStats( void );
+	void OnJsonTargetChanged( void );
+
+	// CThread
+	virtual int Run() OVERRIDE;
+
+	// CAutoGameSystemPerFrame
+	virtual const char *Name( void ) OVERRIDE			{ return "CAsyncLog"; }
+	virtual void FrameUpdatePostEntityThink( void ) OVERRIDE	{ PrintFormattedLines(); }
+	virtual void LevelShutdownPostEntity( void ) OVERRIDE		{ Flush(); }
+	virtual void Shutdown( void ) OVERRIDE;
+
+private:
+	LogRecord_t *BeginRecord( uint32 *pPos );
+	void EndRecord( uint32 nPos );
+	bool ProcessRecords( void );					// log thread
+	void PrintFormattedLines( void );				// main thread
+
+	void WriteJson( const LogRecord_t &record, const char *pLine, CUtlBuffer &jsonArgs );
+	void OpenJsonTarget( void );
+	void CloseJsonTarget( void );
+	bool WriteJsonTarget( const void *pData, int nSize );
+
+	LogSlot_t *m_pSlots;
+	CInterlockedUInt m_nEnqueuePos;
+	uint32 m_nDequeuePos;							// log thread only
+	CInterlockedUInt m_nCompletedPos;				// every record before this has been formatted
+	CThreadEvent m_wake;
+	volatile bool m_bExit;
+
+	// formatted lines waiting for the main thread, null separated
+	CThreadFastMutex m_textMutex;
+	CUtlVector< char > m_pendingText;
+	CUtlVector< char > m_printText;
+
+	// JSON target, owned by the log thread
+	CThreadFastMutex m_jsonMutex;
+	char m_szJsonTarget[MAX_PATH];					// protected by m_jsonMutex
+	CInterlockedInt m_nJsonTargetGeneration;
+	int m_nJsonOpenGeneration;
+	bool m_bJsonWanted;								// a target is set, even if it couldn't be opened
+	FILE *m_pJsonFile;
+	int m_nJsonSocket;
+	float m_flJsonRetryTime;
+
+	// statistics
+	CInterlockedInt m_nTypedRecords;
+	CInterlockedInt m_nTextRecords;
+	CInterlockedInt m_nDropped;
+	CInterlockedInt m_nStalls;
+	CInterlockedInt m_nMaxDepth;
+	int m_nLinesPrinted;
+	CInterlockedInt m_nJsonLines;
+	CInterlockedInt m_nJsonDropped;
+};
+
+static CAsyncLog g_AsyncLog;
+
+
+//-----------------------------------------------------------------------------
+CAsyncLog::CAsyncLog()
+{
+	SetName( "AsyncLog" );
+
+	m_pSlots = NULL;
+	m_nEnqueuePos = 0;
+	m_nDequeuePos = 0;
+	m_nCompletedPos = 0;
+	m_bExit = false;
+
+	m_szJsonTarget[0] = 0;
+	m_nJsonTargetGeneration = 0;
+	m_nJsonOpenGeneration = 0;
+	m_bJsonWanted = false;
+	m_pJsonFile = NULL;
+	m_nJsonSocket = -1;
+	m_flJsonRetryTime = 0.0f;
+
+	ResetStats();
+}
+
+CAsyncLog::~CAsyncLog()
+{
+	delete [] m_pSlots;
+}
+
+void CAsyncLog::ResetStats( void )
+{
+	m_nTypedRecords = 0;
+	m_nTextRecords = 0;
+	m_nDropped = 0;
+	m_nStalls = 0;
+	m_nMaxDepth = 0;
+	m_nLinesPrinted = 0;
+	m_nJsonLines = 0;
+	m_nJsonDropped = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Claims the next slot of the ring. This is a bounded multi-producer queue, so log
+// lines from other threads are safe, although nearly all come from the main thread.
+//-----------------------------------------------------------------------------
+LogRecord_t *CAsyncLog::BeginRecord( uint32 *pPos )
+{
+	bool bStalled = false;
+	for ( ;; )
+	{
+		uint32 nPos = m_nEnqueuePos;
+		LogSlot_t *pSlot = &m_pSlots[nPos & ( ASYNCLOG_SLOT_COUNT - 1 )];
+		int nDiff = (int)( pSlot->m_nSequence - nPos );
+
+		if ( nDiff == 0 )
+		{
+			if ( m_nEnqueuePos.AssignIf( nPos, nPos + 1 ) )
+			{
+				*pPos = nPos;
+				return &pSlot->m_record;
+			}
+		}
+		else if ( nDiff < 0 )
+		{
+			// full
+			if ( sv_logasync_drop.GetBool() )
+			{
+				m_nDropped++;
+				return NULL;
+			}
+
+			if ( !bStalled )
+			{
+				m_nStalls++;
+				bStalled = true;
+			}
+			m_wake.Set();
+			ThreadSleep( 0 );
+		}
+	}
+}
+
+void CAsyncLog::EndRecord( uint32 nPos )
+{
+	LogSlot_t *pSlot = &m_pSlots[nPos & ( ASYNCLOG_SLOT_COUNT - 1 )];
+	ThreadMemoryBarrier();
+	pSlot->m_nSequence = nPos + 1;
+
+	int nDepth = (int)( nPos + 1 - m_nCompletedPos );
+	if ( nDepth > m_nMaxDepth )
+	{
+		m_nMaxDepth = nDepth;
+	}
+
+	if ( nDepth > ASYNCLOG_SLOT_COUNT / 2 )
+	{
+		// getting full, don't wait for the thread's next poll
+		m_wake.Set();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+bool CAsyncLog::LogPrintV( const char *fmt, va_list argptr )
+{
+	if ( !sv_logasync.GetBool() )
+	{
+		if ( IsAlive() && m_nCompletedPos != m_nEnqueuePos )
+		{
+			// sv_logasync was just turned off - keep lines in order
+			Flush();
+		}
+		return false;
+	}
+
+	if ( !m_pSlots )
+	{
+		m_pSlots = new LogSlot_t[ASYNCLOG_SLOT_COUNT];
+		for ( int i = 0; i < ASYNCLOG_SLOT_COUNT; i++ )
+		{
+			m_pSlots[i].m_nSequence = i;
+		}
+	}
+
+	if ( !IsAlive() )
+	{
+		m_bExit = false;
+		if ( !Start() )
+			return false;
+	}
+
+	uint32 nPos;
+	LogRecord_t *pRecord = BeginRecord( &nPos );
+	if ( !pRecord )
+		return true;
+
+	pRecord->m_nTick = gpGlobals ? gpGlobals->tickcount : 0;
+	pRecord->m_nTime = (int64)time( NULL );
+
+	bool bCaptured = false;
+	if ( ValidateLogFormat( fmt ) )
+	{
+		va_list argcopy;
+		va_copy( argcopy, argptr );
+		pRecord->m_nType = LOG_RECORD_TYPED;
+		bCaptured = CaptureLogArgs( pRecord, fmt, argcopy );
+		va_end( argcopy );
+	}
+
+	if ( bCaptured )
+	{
+		m_nTypedRecords++;
+	}
+	else
+	{
+		// a format we can't capture, or arguments too long for a slot
+		pRecord->m_nType = LOG_RECORD_TEXT;
+		Q_vsnprintf( pRecord->m_data, sizeof( pRecord->m_data ), fmt, argptr );
+		pRecord->m_nSize = V_strlen( pRecord->m_data ) + 1;
+		m_nTextRecords++;
+	}
+
+	EndRecord( nPos );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Formats everything queued so far. Returns true if there was anything.
+//-----------------------------------------------------------------------------
+bool CAsyncLog::ProcessRecords( void )
+{
+	char line[ASYNCLOG_LINE_SIZE];
+	CUtlBuffer jsonArgs( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	bool bAny = false;
+
+	if ( m_nJsonOpenGeneration != m_nJsonTargetGeneration )
+	{
+		OpenJsonTarget();
+	}
+	else if ( m_bJsonWanted && m_pJsonFile == NULL && m_nJsonSocket < 0 && Plat_FloatTime() > m_flJsonRetryTime )
+	{
+		OpenJsonTarget();
+	}
+
+	bool bJson = ( m_pJsonFile != NULL || m_nJsonSocket >= 0 );
+
+	for ( ;; )
+	{
+		LogSlot_t *pSlot = &m_pSlots[m_nDequeuePos & ( ASYNCLOG_SLOT_COUNT - 1 )];
+		if ( (int)( pSlot->m_nSequence - ( m_nDequeuePos + 1 ) ) < 0 )
+			break;
+
+		ThreadMemoryBarrier();
+
+		jsonArgs.Clear();
+		FormatLogRecord( pSlot->m_record, line, bJson ? &jsonArgs : NULL );
+
+		{
+			AUTO_LOCK( m_textMutex );
+			m_pendingText.AddMultipleToTail( V_strlen( line ) + 1, line );
+		}
+
+		if ( bJson )
+		{
+			WriteJson( pSlot->m_record, line, jsonArgs );
+		}
+
+		// release the slot
+		ThreadMemoryBarrier();
+		pSlot->m_nSequence = m_nDequeuePos + ASYNCLOG_SLOT_COUNT;
+		m_nDequeuePos++;
+		m_nCompletedPos = m_nDequeuePos;
+		bAny = true;
+	}
+
+	if ( bAny && m_pJsonFile )
+	{
+		fflush( m_pJsonFile );
+	}
+
+	return bAny;
+}
+
+int CAsyncLog::Run()
+{
+	while ( !m_bExit )
+	{
+		// poll, so a burst of lines doesn't cost an event signal each
+		m_wake.Wait( 10 );
+		ProcessRecords();
+	}
+
+	ProcessRecords();
+	CloseJsonTarget();
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Main thread: hands formatted lines to the engine log, in order
+//-----------------------------------------------------------------------------
+void CAsyncLog::PrintFormattedLines( void )
+{
+	{
+		AUTO_LOCK( m_textMutex );
+		if ( !m_pendingText.Count() )
+			return;
+		m_pendingText.Swap( m_printText );
+	}
+
+	const char *pEnd = m_printText.Base() + m_printText.Count();
+	for ( const char *pLine = m_printText.Base(); pLine < pEnd; pLine += V_strlen( pLine ) + 1 )
+	{
+		engine->LogPrint( pLine );
+		m_nLinesPrinted++;
+	}
+	m_printText.RemoveAll();
+}
+
+void CAsyncLog::Flush( void )
+{
+	if ( IsAlive() )
+	{
+		uint32 nTarget = m_nEnqueuePos;
+		while ( (int)( m_nCompletedPos - nTarget ) < 0 )
+		{
+			m_wake.Set();
+			ThreadSleep( 1 );
+		}
+	}
+
+	PrintFormattedLines();
+}
+
+void CAsyncLog::Shutdown( void )
+{
+	if ( IsAlive() )
+	{
+		m_bExit = true;
+		m_wake.Set();
+		Join();
+	}
+
+	PrintFormattedLines();
+}
+
+
+//-----------------------------------------------------------------------------
+// JSON output, on the log thread
+//-----------------------------------------------------------------------------
+void CAsyncLog::WriteJson( const LogRecord_t &record, const char *pLine, CUtlBuffer &jsonArgs )
+{
+	CUtlBuffer json( 0, ASYNCLOG_LINE_SIZE * 2, CUtlBuffer::TEXT_BUFFER );
+	json.Printf( "{\"time\":%lld,\"tick\":%d,\"line\":", (long long)record.m_nTime, record.m_nTick );
+
+	// the engine adds its own timestamp prefix, and the newline is implied by the JSON line
+	char szLine[ASYNCLOG_LINE_SIZE];
+	V_strncpy( szLine, pLine, sizeof( szLine ) );
+	int nLength = V_strlen( szLine );
+	if ( nLength && szLine[nLength - 1] == '\n' )
+	{
+		szLine[nLength - 1] = 0;
+	}
+	AppendJsonString( json, szLine );
+
+	if ( record.m_nType == LOG_RECORD_TYPED )
+	{
+		json.PutString( ",\"format\":" );
+		AppendJsonString( json, record.m_data );
+		json.PutString( ",\"args\":" );
+		json.Put( jsonArgs.Base(), jsonArgs.TellPut() );
+	}
+	json.PutString( "}\n" );
+
+	if ( WriteJsonTarget( json.Base(), json.TellPut() ) )
+	{
+		m_nJsonLines++;
+	}
+	else
+	{
+		m_nJsonDropped++;
+	}
+}
+
+bool CAsyncLog::WriteJsonTarget( const void *pData, int nSize )
+{
+	if ( m_pJsonFile )
+	{
+		return fwrite( pData, 1, nSize, m_pJsonFile ) == (size_t)nSize;
+	}
+
+#ifdef POSIX
+	if ( m_nJsonSocket >= 0 )
+	{
+#ifdef MSG_NOSIGNAL
+		const int nFlags = MSG_NOSIGNAL;
+#else
+		const int nFlags = 0;
+#endif
+		ssize_t nSent = send( m_nJsonSocket, pData, nSize, nFlags );
+		if ( nSent == nSize )
+			return true;
+
+		if ( nSent < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+		{
+			// reader isn't keeping up
+			return false;
+		}
+
+		// reader went away, or a partial write left the stream mid-line. reconnect later.
+		CloseJsonTarget();
+		m_flJsonRetryTime = Plat_FloatTime() + ASYNCLOG_JSON_RETRY;
+		return false;
+	}
+#endif
+
+	return false;
+}
+
+void CAsyncLog::OpenJsonTarget( void )
+{
+	CloseJsonTarget();
+
+	char szTarget[MAX_PATH];
+	{
+		AUTO_LOCK( m_jsonMutex );
+		V_strncpy( szTarget, m_szJsonTarget, sizeof( szTarget ) );
+		m_nJsonOpenGeneration = m_nJsonTargetGeneration;
+	}
+
+	m_bJsonWanted = ( szTarget[0] != 0 );
+	if ( !m_bJsonWanted )
+		return;
+
+	m_flJsonRetryTime = Plat_FloatTime() + ASYNCLOG_JSON_RETRY;
+
+	if ( StringHasPrefix( szTarget, "unix:" ) )
+	{
+#ifdef POSIX
+		const char *pPath = szTarget + 5;
+		struct sockaddr_un address;
+		if ( V_strlen( pPath ) >= (int)sizeof( address.sun_path ) )
+			return;
+
+		int nSocket = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( nSocket < 0 )
+			return;
+
+		memset( &address, 0, sizeof( address ) );
+		address.sun_family = AF_UNIX;
+		V_strncpy( address.sun_path, pPath, sizeof( address.sun_path ) );
+		if ( connect( nSocket, (struct sockaddr *)&address, sizeof( address ) ) < 0 )
+		{
+			close( nSocket );
+			return;
+		}
+
+#ifdef SO_NOSIGPIPE
+		int nOn = 1;
+		setsockopt( nSocket, SOL_SOCKET, SO_NOSIGPIPE, &nOn, sizeof( nOn ) );
+#endif
+		// never let a slow reader hold up the log
+		fcntl( nSocket, F_SETFL, fcntl( nSocket, F_GETFL, 0 ) | O_NONBLOCK );
+		m_nJsonSocket = nSocket;
+#endif
+		return;
+	}
+
+	m_pJsonFile = fopen( szTarget, "a" );
+}
+
+void CAsyncLog::CloseJsonTarget( void )
+{
+	if ( m_pJsonFile )
+	{
+		fclose( m_pJsonFile );
+		m_pJsonFile = NULL;
+	}
+
+#ifdef POSIX
+	if ( m_nJsonSocket >= 0 )
+	{
+		close( m_nJsonSocket );
+		m_nJsonSocket = -1;
+	}
+#endif
+}
+
+void CAsyncLog::OnJsonTargetChanged( void )
+{
+	const char *pTarget = sv_logjson.GetString();
+
+	AUTO_LOCK( m_jsonMutex );
+	if ( !pTarget[0] || StringHasPrefix( pTarget, "unix:" ) || V_IsAbsolutePath( pTarget ) )
+	{
+		V_strncpy( m_szJsonTarget, pTarget, sizeof( m_szJsonTarget ) );
+	}
+	else
+	{
+		char szGameDir[MAX_PATH];
+		engine->GetGameDir( szGameDir, sizeof( szGameDir ) );
+		V_ComposeFileName( szGameDir, pTarget, m_szJsonTarget, sizeof( m_szJsonTarget ) );
+	}
+	m_nJsonTargetGeneration++;
+}
+
+// the JSON copy is written by the log thread, so nothing is written while it's off
+static void WarnIfJsonNeedsAsync( void )
+{
+	if ( sv_logjson.GetString()[0] && !sv_logasync.GetBool() )
+	{
+		Warning( "sv_logjson is set but sv_logasync is 0; no JSON log lines will be written until sv_logasync is 1\n" );
+	}
+}
+
+static void AsyncLogJsonTargetChanged( IConVar *var, const char *pOldValue, float flOldValue )
+{
+	g_AsyncLog.OnJsonTargetChanged();
+	WarnIfJsonNeedsAsync();
+}
+
+static void AsyncLogEnabledChanged( IConVar *var, const char *pOldValue, float flOldValue )
+{
+	WarnIfJsonNeedsAsync();
+}
+
+
+//-----------------------------------------------------------------------------
+void CAsyncLog::PrintStats( void )
+{
+	uint32 nQueued = m_nEnqueuePos - m_nCompletedPos;
+	Msg( "Log thread: %s\n", IsAlive() ? "running" : "not running" );
+	Msg( "  records:       %d typed, %d formatted on the main thread\n", (int)m_nTypedRecords, (int)m_nTextRecords );
+	Msg( "  queue:         %u waiting, %d max, %d slots\n", nQueued, (int)m_nMaxDepth, ASYNCLOG_SLOT_COUNT );
+	Msg( "  dropped:       %d (queue full, sv_logasync_drop)\n", (int)m_nDropped );
+	Msg( "  stalls:        %d (queue full, waited for the log thread)\n", (int)m_nStalls );
+	Msg( "  lines printed: %d\n", m_nLinesPrinted );
+	Msg( "  JSON:          %d lines written, %d dropped%s\n", (int)m_nJsonLines, (int)m_nJsonDropped, !sv_logjson.GetString()[0] ? " (sv_logjson not set)" : ( !sv_logasync.GetBool() ? " (sv_logasync is 0)" : "" ) );
+}
+
+CON_COMMAND( sv_logasync_stats, "Show log thread statistics. 'sv_logasync_stats reset' clears them." )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		g_AsyncLog.ResetStats();
+		return;
+	}
+
+	g_AsyncLog.PrintStats();
+}
+
+
+//-----------------------------------------------------------------------------
+bool AsyncLog_LogPrintV( const char *fmt, va_list argptr )
+{
+	return g_AsyncLog.LogPrintV( fmt, argptr );
+}
+
+void AsyncLog_Flush( void )
+{
+	g_AsyncLog.Flush();
+}
@@ -0,0 +1,25 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Background formatting of server log lines
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+//-----------------------------------------------------------------------------
+// Queues a UTIL_LogPrintf() line for the log thread. The format and arguments are
+// captured as a typed record and formatted later, producing exactly the text
+// Q_vsnprintf() would have. Returns false if sv_logasync is off, in which case the
+// caller should print the line itself.
+//-----------------------------------------------------------------------------
+bool AsyncLog_LogPrintV( const char *fmt, va_list argptr );
+
+// Waits for every queued line to reach the log
+void AsyncLog_Flush( void );
+
+#endif // ASYNCLOG_H
@@ -1704,13 +1704,12 @@ int CBaseEntity::TakeDamage( const CTakeDamageInfo &inputInfo )
 
 		//Msg("%s took %.2f Damage, at %.2f\n", GetClassname(), info.GetDamage(), gpGlobals->curtime );
 
-		if ( ScriptHookEnabled( "OnTakeDamage" ) )
+		if ( ScriptHookEnabled( SCRIPT_HOOK_ON_TAKE_DAMAGE ) )
 		{
 			IScriptVM *pVM = g_pScriptVM;
 
-			ScriptVariant_t varTable;
-			pVM->CreateTable( varTable );
-		
+			HSCRIPT varTable = g_VScriptGameEventListener.AcquireParamsTable( "OnTakeDamage" );
+
 			pVM->SetValue( varTable, "const_entity", ToHScript( this ) );  // Purely informational.
 			pVM->SetValue( varTable, "inflictor", ToHScript( info.GetInflictor() ) );
 			pVM->SetValue( varTable, "weapon", ToHScript( info.GetWeapon() ) );
@@ -1755,8 +1754,13 @@ int CBaseEntity::TakeDamage( const CTakeDamageInfo &inputInfo )
 				info.SetDamagedOtherPlayers( pVM->Get<int>( varTable, "damaged_other_players" ) );
 				info.SetCritType( (CTakeDamageInfo::ECritType) pVM->Get<int>( varTable, "crit_type" ) );
 				if ( pVM->Get<bool>( varTable, "early_out" ) )
+				{
+					g_VScriptGameEventListener.ReleaseParamsTable( "OnTakeDamage", varTable );
 					return info.GetDamage();
+				}
 			}
+
+			g_VScriptGameEventListener.ReleaseParamsTable( "OnTakeDamage", varTable );
 		}
 
 		return OnTakeDamage( info );
@@ -1983,6 +1987,8 @@ class CThinkContextsSaveDataOps : public CDefSaveRestoreOps
 			{
 				*ppV = NULL;
 			}
+
+			(*pUtlVector)[i].m_nContextID = CBaseEntity::GetThinkContextID( STRING( (*pUtlVector)[i].m_iszContext ) );
 		}
 		pRestore->EndBlock();
 	}
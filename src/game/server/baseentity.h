@@ -342,6 +342,7 @@ struct thinkfunc_t
 {
 	BASEPTR		m_pfnThink;
 	string_t	m_iszContext;
+	int			m_nContextID;			// CBaseEntity::GetThinkContextID( m_iszContext )
 	int			m_nNextThinkTick;
 	int			m_nLastThinkTick;
 
@@ -818,6 +819,7 @@ public:
 	virtual void Think( void ) { if (m_pfnThink) (this->*m_pfnThink)();};
 
 	// Think functions with contexts
+	static int GetThinkContextID( const char *szContext );		// same ID for every entity, for any name that matches in the first MAX_CONTEXT_LENGTH characters
 	int		RegisterThinkContext( const char *szContext );
 	BASEPTR	ThinkSet( BASEPTR func, float flNextThinkTime = 0, const char *szContext = NULL );
 	void	SetNextThink( float nextThinkTime, const char *szContext = NULL );
@@ -0,0 +1,205 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-class memory pools for entities that are created and removed
+//			constantly, and a check that skips repeated precaching for them
+//
+//=============================================================================
+#include "cbase.h"
+#include "entity_pool.h"
+#include "tier1/utlrbtree.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar sv_entity_pools( "sv_entity_pools", "1", FCVAR_CHEAT, "Allocate high churn entities from per-class pools. Takes effect on the next map." );
+ConVar sv_entity_precache_once( "sv_entity_precache_once", "1", FCVAR_CHEAT, "Only precache pooled entities the first time one of each class and model spawns in a level" );
+ConVar sv_entity_pool_stats_interval( "sv_entity_pool_stats_interval", "0", 0, "If nonzero, log the entity pool totals and heap use every this many seconds, for tracking memory over long runs" );
+
+CEntityPool *CEntityPool::s_pFirst = NULL;
+bool CEntityPool::s_bEnabled = false;
+
+//-----------------------------------------------------------------------------
+CEntityPool::CEntityPool( const char *pszClassName, int nSize, int nAlignment, int nBlocksPerBlob ) :
+	m_pool( nSize, nBlocksPerBlob, CUtlMemoryPool::GROW_SLOW, pszClassName, nAlignment )
+{
+	m_pszClassName = pszClassName;
+	m_nSize = nSize;
+	m_nBlocksPerBlob = nBlocksPerBlob;
+	m_nAllocs = 0;
+	m_nUnpooledAllocs = 0;
+
+	m_pNext = s_pFirst;
+	s_pFirst = this;
+}
+
+//-----------------------------------------------------------------------------
+void *CEntityPool::Alloc( size_t nSize )
+{
+	Assert( nSize != 0 );
+
+	if ( !s_bEnabled || nSize != (size_t)m_nSize )
+	{
+		++m_nUnpooledAllocs;
+		return engine->PvAllocEntPrivateData( nSize );
+	}
+
+	// entities expect their memory zeroed, the way the engine hands it out
+	++m_nAllocs;
+	return m_pool.AllocZero( nSize );
+}
+
+//-----------------------------------------------------------------------------
+void CEntityPool::Free( void *pMem, size_t nSize )
+{
+	if ( !pMem )
+		return;
+
+	if ( !s_bEnabled || nSize != (size_t)m_nSize )
+	{
+		engine->FreeEntPrivateData( pMem );
+		return;
+	}
+
+	m_pool.Free( pMem );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Blocks allocated from the heap so far, which the pool keeps for reuse
+//-----------------------------------------------------------------------------
+int CEntityPool::GetReservedCount( void ) const
+{
+	int nBlobs = MAX( 1, ( m_pool.PeakCount() + m_nBlocksPerBlob - 1 ) / m_nBlocksPerBlob );
+	return nBlobs * m_nBlocksPerBlob;
+}
+
+//-----------------------------------------------------------------------------
+void CEntityPool::UpdateEnabled( void )
+{
+	// memory from the pools can't be handed back to the engine, or the other way around
+	for ( CEntityPool *pPool = s_pFirst; pPool; pPool = pPool->m_pNext )
+	{
+		Assert( pPool->GetLiveCount() == 0 );
+	}
+
+	s_bEnabled = sv_entity_pools.GetBool();
+}
+
+
+//-----------------------------------------------------------------------------
+// Remembers which classes and models have been precached this level, and
+// logs the pool totals every sv_entity_pool_stats_interval seconds
+//-----------------------------------------------------------------------------
+struct PrecachedEntity_t
+{
+	const char *m_pszClassname;
+	const char *m_pszModel;
+};
+
+class CEntityPoolSystem : public CAutoGameSystemPerFrame
+{
+public:
+	CEntityPoolSystem( void ) : CAutoGameSystemPerFrame( "CEntityPoolSystem" ), m_precached( 0, 0, PrecachedEntityLessFunc )
+	{
+		m_flNextLogTime = 0.0f;
+	}
+
+	virtual void LevelInitPreEntity( void )
+	{
+		// string pointers and precache tables don't survive the level change
+		m_precached.RemoveAll();
+		CEntityPool::UpdateEnabled();
+	}
+
+	virtual void FrameUpdatePostEntityThink( void )
+	{
+		double flInterval = sv_entity_pool_stats_interval.GetFloat();
+		if ( flInterval <= 0.0f || Plat_FloatTime() < m_flNextLogTime )
+			return;
+
+		m_flNextLogTime = Plat_FloatTime() + flInterval;
+		LogTotals();
+	}
+
+	bool NeedsPrecache( CBaseEntity *pEntity )
+	{
+		PrecachedEntity_t precached;
+		precached.m_pszClassname = pEntity->GetClassname();
+		precached.m_pszModel = STRING( pEntity->GetModelName() );
+
+		if ( m_precached.Find( precached ) != m_precached.InvalidIndex() )
+			return false;
+
+		m_precached.Insert( precached );
+		return true;
+	}
+
+	void PrintStats( void )
+	{
+		Msg( "Entity pools are %s\n", CEntityPool::IsEnabled() ? "on" : "off" );
+		Msg( "%-32s %8s %8s %8s %10s %12s %10s %10s\n", "class", "size", "live", "peak", "reserved", "reserved kb", "pooled", "unpooled" );
+
+		for ( CEntityPool *pPool = CEntityPool::GetFirst(); pPool; pPool = pPool->GetNext() )
+		{
+			Msg( "%-32s %8d %8d %8d %10d %12d %10d %10d\n", pPool->GetClassName(), pPool->GetSize(),
+				pPool->GetLiveCount(), pPool->GetPeakCount(), pPool->GetReservedCount(),
+				pPool->GetReservedCount() * pPool->GetSize() / 1024,
+				pPool->GetAllocCount(), pPool->GetUnpooledCount() );
+		}
+
+		LogTotals();
+	}
+
+private:
+	static bool PrecachedEntityLessFunc( const PrecachedEntity_t &lhs, const PrecachedEntity_t &rhs )
+	{
+		if ( lhs.m_pszClassname != rhs.m_pszClassname )
+			return lhs.m_pszClassname < rhs.m_pszClassname;
+
+		return lhs.m_pszModel < rhs.m_pszModel;
+	}
+
+	void LogTotals( void )
+	{
+		int nLive = 0;
+		int nReservedBytes = 0;
+		for ( CEntityPool *pPool = CEntityPool::GetFirst(); pPool; pPool = pPool->GetNext() )
+		{
+			nLive += pPool->GetLiveCount();
+			nReservedBytes += pPool->GetReservedCount() * pPool->GetSize();
+		}
+
+		Msg( "Entity pools: %d live, %d kb reserved. Uptime %.0f s\n", nLive, nReservedBytes / 1024, Plat_FloatTime() );
+
+#ifndef NO_MALLOC_OVERRIDE
+		size_t nUsedMemory = 0;
+		size_t nFreeMemory = 0;
+		g_pMemAlloc->GlobalMemoryStatus( &nUsedMemory, &nFreeMemory );
+
+		Msg( "Heap: %d kb used, %d kb free\n", (int)( nUsedMemory / 1024 ), (int)( nFreeMemory / 1024 ) );
+#endif
+	}
+
+	CUtlRBTree< PrecachedEntity_t > m_precached;
+	double m_flNextLogTime;
+};
+
+static CEntityPoolSystem g_EntityPoolSystem;
+
+//-----------------------------------------------------------------------------
+bool EntityNeedsPrecache( CBaseEntity *pEntity )
+{
+	if ( !sv_entity_precache_once.GetBool() )
+		return true;
+
+	return g_EntityPoolSystem.NeedsPrecache( pEntity );
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_entity_pool_stats, "Print the per-class entity pools and heap use" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	g_EntityPoolSystem.PrintStats();
+}
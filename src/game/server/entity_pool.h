@@ -0,0 +1,83 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-class memory pools for entities that are created and removed
+//			constantly, and a check that skips repeated precaching for them
+//
+//=============================================================================
+
+#ifndef ENTITY_POOL_H
+#define ENTITY_POOL_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/mempool.h"
+
+//-----------------------------------------------------------------------------
+// Holds the memory of one entity class. Freed entities go back to the pool
+// and the next one of the class is allocated in their place, so short lived
+// entities don't spread across the heap on long running servers.
+// Classes derived from a pooled class that are bigger than it are allocated
+// by the engine as usual, unless they declare a pool of their own.
+//-----------------------------------------------------------------------------
+class CEntityPool
+{
+public:
+	CEntityPool( const char *pszClassName, int nSize, int nAlignment, int nBlocksPerBlob );
+
+	void *Alloc( size_t nSize );
+	void Free( void *pMem, size_t nSize );
+
+	const char *GetClassName( void ) const { return m_pszClassName; }
+	int GetSize( void ) const { return m_nSize; }
+	int GetLiveCount( void ) const { return m_pool.Count(); }
+	int GetPeakCount( void ) const { return m_pool.PeakCount(); }
+	int GetReservedCount( void ) const;
+	int GetAllocCount( void ) const { return m_nAllocs; }
+	int GetUnpooledCount( void ) const { return m_nUnpooledAllocs; }
+
+	CEntityPool *GetNext( void ) const { return m_pNext; }
+	static CEntityPool *GetFirst( void ) { return s_pFirst; }
+
+	// Latched from sv_entity_pools when a level starts, when no pooled entities exist
+	static void UpdateEnabled( void );
+	static bool IsEnabled( void ) { return s_bEnabled; }
+
+private:
+	CUtlMemoryPool m_pool;
+	const char *m_pszClassName;
+	int m_nSize;
+	int m_nBlocksPerBlob;
+	int m_nAllocs;
+	int m_nUnpooledAllocs;
+
+	CEntityPool *m_pNext;
+	static CEntityPool *s_pFirst;
+	static bool s_bEnabled;
+};
+
+//-----------------------------------------------------------------------------
+// Put DECLARE_ENTITY_POOL in the class definition and DEFINE_ENTITY_POOL in
+// the .cpp file. Only for server entities; the delete has to be sized so the
+// pool can tell bigger derived classes apart.
+//-----------------------------------------------------------------------------
+#define DECLARE_ENTITY_POOL( _class )																				\
+	public:																											\
+		void *operator new( size_t size ) { return s_EntityPool.Alloc( size ); }									\
+		void *operator new( size_t size, int nBlockUse, const char *pFileName, int nLine ) { return s_EntityPool.Alloc( size ); }	\
+		void operator delete( void *pMem, size_t size ) { s_EntityPool.Free( pMem, size ); }						\
+		void operator delete( void *pMem, int nBlockUse, const char *pFileName, int nLine ) { s_EntityPool.Free( pMem, sizeof( _class ) ); }	\
+	private:																										\
+		static CEntityPool s_EntityPool
+
+#define DEFINE_ENTITY_POOL( _class, _blocksPerBlob )	\
+	CEntityPool _class::s_EntityPool( #_class, sizeof( _class ), alignof( _class ), _blocksPerBlob )
+
+//-----------------------------------------------------------------------------
+// Purpose: False if an entity of the same class with the same model has
+//			already been precached this level. For Spawn() functions that
+//			call Precache() on every spawn.
+//-----------------------------------------------------------------------------
+extern bool EntityNeedsPrecache( CBaseEntity *pEntity );
+
+#endif // ENTITY_POOL_H
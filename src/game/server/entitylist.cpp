@@ -12,11 +12,13 @@
 #include "collisionutils.h"
 #include "UtlSortVector.h"
 #include "tier0/vprof.h"
+#include "tier1/utlhashtable.h"
 #include "mapentities.h"
 #include "client.h"
 #include "ai_initutils.h"
 #include "globalstate.h"
 #include "datacache/imdlcache.h"
+#include "projectile_registry.h"
 
 #ifdef HL2_DLL
 #include "npc_playercompanion.h"
@@ -123,6 +125,9 @@ void AimTarget_ForceRepopulateList()
 }
 
 
+ConVar sv_think_wheel( "sv_think_wheel", "1", FCVAR_CHEAT, "Find entities due to think or simulate from a timing wheel instead of scanning every thinking entity each tick" );
+ConVar sv_think_stats( "sv_think_stats", "0", FCVAR_CHEAT, "Time each entity's think and simulation, by class, for think_stats" );
+
 // Manages a list of all entities currently doing game simulation or thinking
 // NOTE: This is usually a small subset of the global entity list, so it's
 // an optimization to maintain this list incrementally rather than polling each
@@ -133,6 +138,24 @@ struct simthinkentry_t
 	unsigned short	unused0;
 	int				nextThinkTick;
 };
+
+// Entries waiting in the timing wheel for their think tick. Stale entries (the entity has
+// since been rescheduled or removed) are dropped when their bucket comes around.
+struct simthinkwheelentry_t
+{
+	unsigned short	entEntry;
+	int				nextThinkTick;
+};
+
+#define SIMTHINK_WHEEL_SIZE		256			// must be a power of two
+
+struct simthinkclassstats_t
+{
+	const char		*pszClassname;
+	int				count;
+	double			time;
+};
+
 class CSimThinkManager : public IEntityListener
 {
 public:
@@ -147,6 +170,13 @@ public:
 		{
 			m_entinfoIndex[i] = 0xFFFF;
 		}
+		for ( int i = 0; i < SIMTHINK_WHEEL_SIZE; i++ )
+		{
+			m_wheel[i].Purge();
+		}
+		m_dueList.Purge();
+		m_wheelTick = -1;
+		ResetStats();
 	}
 	void LevelInitPreEntity()
 	{
@@ -193,6 +223,34 @@ public:
 	int ListCopy( CBaseEntity *pList[], int listMax )
 	{
 		int count = MIN(listMax, ListCount());
+
+		UpdateDueList();
+
+		if ( !sv_think_wheel.GetBool() )
+		{
+			return ListCopyAll( pList, count );
+		}
+
+		int out = 0;
+		FOR_EACH_VEC( m_dueHandles, i )
+		{
+			int listHandle = m_dueHandles[i];
+			if ( listHandle >= count )
+				break;
+
+			int entinfoIndex = m_simThinkList[listHandle].entEntry;
+			const CEntInfo *pInfo = gEntList.GetEntInfoPtrByIndex( entinfoIndex );
+			pList[out] = (CBaseEntity *)pInfo->m_pEntity;
+			Assert(m_simThinkList[listHandle].nextThinkTick==0 || pList[out]->GetFirstThinkTick()==m_simThinkList[listHandle].nextThinkTick);
+			Assert( gEntList.IsEntityPtr( pList[out] ) );
+			out++;
+		}
+
+		return out;
+	}
+
+	int ListCopyAll( CBaseEntity *pList[], int count )
+	{
 		int out = 0;
 		for ( int i = 0; i < count; i++ )
 		{
@@ -241,9 +299,12 @@ public:
 					m_simThinkList[m_entinfoIndex[index]].nextThinkTick = pEntity->GetFirstThinkTick();
 					Assert(m_simThinkList[m_entinfoIndex[index]].nextThinkTick>=0);
 				}
+				Schedule( index, m_simThinkList[m_entinfoIndex[index]].nextThinkTick );
 			}
 			else
 			{
+				int oldThinkTick = m_simThinkList[m_entinfoIndex[index]].nextThinkTick;
+
 				// updating existing entry - if no sim, reset think time
 				if ( pEntity->IsEFlagSet(EFL_NO_GAME_PHYSICS_SIMULATION) )
 				{
@@ -254,13 +315,208 @@ public:
 				{
 					m_simThinkList[m_entinfoIndex[index]].nextThinkTick = 0;
 				}
+
+				// an unchanged entry is still where it was scheduled
+				if ( m_simThinkList[m_entinfoIndex[index]].nextThinkTick != oldThinkTick )
+				{
+					Schedule( index, m_simThinkList[m_entinfoIndex[index]].nextThinkTick );
+				}
 			}
 		}
 	}
 
+	void RecordThinkCost( CBaseEntity *pEntity, double time )
+	{
+		const char *pszClassname = pEntity->GetClassname();
+
+		UtlHashHandle_t h = m_classStats.Find( pszClassname );
+		if ( h == m_classStats.InvalidHandle() )
+		{
+			simthinkclassstats_t stats = { pszClassname, 0, 0.0 };
+			h = m_classStats.Insert( pszClassname, stats );
+		}
+
+		simthinkclassstats_t &stats = m_classStats.Element( h );
+		++stats.count;
+		stats.time += time;
+	}
+
+	void ResetStats()
+	{
+		m_statTick = -1;
+		m_statTicks = 0;
+		m_statDue = 0;
+		m_statIdle = 0;
+		m_statMaxDue = 0;
+		m_statWheelChecked = 0;
+		m_classStats.RemoveAll();
+	}
+
+	void PrintStats()
+	{
+		int waiting = 0;
+		for ( int i = 0; i < SIMTHINK_WHEEL_SIZE; i++ )
+		{
+			waiting += m_wheel[i].Count();
+		}
+
+		Msg( "%d thinking/simulating entities, %d in the timing wheel (including stale), %d due this tick\n", m_simThinkList.Count(), waiting, m_dueHandles.Count() );
+
+		if ( m_statTicks )
+		{
+			Msg( "Over %d ticks: %.1f due, %.1f idle, %.1f wheel entries checked per tick, %d most due\n",
+				m_statTicks, (float)m_statDue / m_statTicks, (float)m_statIdle / m_statTicks, (float)m_statWheelChecked / m_statTicks, m_statMaxDue );
+		}
+
+		if ( m_classStats.Count() == 0 )
+		{
+			Msg( "No per-class costs recorded, set sv_think_stats 1 to collect them\n" );
+			return;
+		}
+
+		CUtlVector< simthinkclassstats_t > sorted;
+		FOR_EACH_HASHTABLE( m_classStats, it )
+		{
+			sorted.AddToTail( m_classStats.Element( it ) );
+		}
+		sorted.Sort( CompareClassStats );
+
+		Msg( "%-40s %10s %12s %10s\n", "class", "thinks", "total ms", "us/think" );
+		for ( int i = 0; i < sorted.Count() && i < 40; i++ )
+		{
+			const simthinkclassstats_t &stats = sorted[i];
+			Msg( "%-40s %10d %12.2f %10.2f\n", stats.pszClassname, stats.count, stats.time * 1000.0, stats.time * 1000000.0 / stats.count );
+		}
+	}
+
 private:
+	static int CompareClassStats( const simthinkclassstats_t *a, const simthinkclassstats_t *b )
+	{
+		if ( a->time == b->time )
+			return 0;
+
+		return ( a->time > b->time ) ? -1 : 1;
+	}
+
+	// Put an entry where it will be found on its think tick
+	void Schedule( int index, int nextThinkTick )
+	{
+		if ( nextThinkTick <= m_wheelTick )
+		{
+			// its bucket has been passed already (this includes simulating entities, which are always due)
+			m_dueList.AddToTail( (unsigned short)index );
+		}
+		else
+		{
+			simthinkwheelentry_t entry = { (unsigned short)index, nextThinkTick };
+			m_wheel[ nextThinkTick & ( SIMTHINK_WHEEL_SIZE - 1 ) ].AddToTail( entry );
+		}
+	}
+
+	// Move entries from the wheel buckets of every tick since the last update into the due list,
+	// then collect the list handles of everything due, in list order
+	void UpdateDueList()
+	{
+		int tick = gpGlobals->tickcount;
+
+		if ( tick < m_wheelTick )
+		{
+			// time went backwards, reschedule everything
+			for ( int i = 0; i < SIMTHINK_WHEEL_SIZE; i++ )
+			{
+				m_wheel[i].RemoveAll();
+			}
+			m_dueList.RemoveAll();
+			m_wheelTick = tick;
+
+			FOR_EACH_VEC( m_simThinkList, i )
+			{
+				Schedule( m_simThinkList[i].entEntry, m_simThinkList[i].nextThinkTick );
+			}
+		}
+
+		int wheelChecked = 0;
+		int firstTick = MAX( m_wheelTick + 1, tick - SIMTHINK_WHEEL_SIZE + 1 );
+		for ( int t = firstTick; t <= tick; t++ )
+		{
+			CUtlVector< simthinkwheelentry_t > &bucket = m_wheel[ t & ( SIMTHINK_WHEEL_SIZE - 1 ) ];
+			wheelChecked += bucket.Count();
+
+			for ( int i = bucket.Count() - 1; i >= 0; i-- )
+			{
+				const simthinkwheelentry_t &entry = bucket[i];
+				int listHandle = m_entinfoIndex[entry.entEntry];
+				if ( listHandle == 0xFFFF || m_simThinkList[listHandle].nextThinkTick != entry.nextThinkTick )
+				{
+					// rescheduled or removed since
+					bucket.FastRemove( i );
+				}
+				else if ( entry.nextThinkTick <= tick )
+				{
+					m_dueList.AddToTail( entry.entEntry );
+					bucket.FastRemove( i );
+				}
+			}
+		}
+		m_wheelTick = MAX( m_wheelTick, tick );
+
+		// entries stay in the due list until they are rescheduled, just as they stay due in m_simThinkList
+		m_dueHandles.RemoveAll();
+		FOR_EACH_VEC( m_dueList, i )
+		{
+			int listHandle = m_entinfoIndex[ m_dueList[i] ];
+			if ( listHandle != 0xFFFF && m_simThinkList[listHandle].nextThinkTick <= tick )
+			{
+				m_dueHandles.AddToTail( listHandle );
+			}
+		}
+
+		// think in the same order as a scan of m_simThinkList would
+		m_dueHandles.Sort( CompareListHandles );
+
+		int uniqueCount = 0;
+		m_dueList.RemoveAll();
+		FOR_EACH_VEC( m_dueHandles, i )
+		{
+			if ( uniqueCount > 0 && m_dueHandles[i] == m_dueHandles[uniqueCount-1] )
+				continue;
+
+			m_dueHandles[uniqueCount++] = m_dueHandles[i];
+			m_dueList.AddToTail( m_simThinkList[ m_dueHandles[i] ].entEntry );
+		}
+		m_dueHandles.RemoveMultipleFromTail( m_dueHandles.Count() - uniqueCount );
+
+		if ( m_statTick != tick )
+		{
+			m_statTick = tick;
+			++m_statTicks;
+			m_statDue += m_dueHandles.Count();
+			m_statIdle += m_simThinkList.Count() - m_dueHandles.Count();
+			m_statMaxDue = MAX( m_statMaxDue, m_dueHandles.Count() );
+			m_statWheelChecked += wheelChecked;
+		}
+	}
+
+	static int CompareListHandles( const int *a, const int *b )
+	{
+		return *a - *b;
+	}
+
 	unsigned short m_entinfoIndex[NUM_ENT_ENTRIES];
 	CUtlVector<simthinkentry_t>	m_simThinkList;
+
+	CUtlVector<simthinkwheelentry_t> m_wheel[SIMTHINK_WHEEL_SIZE];	// entries waiting for their think tick, by tick
+	int m_wheelTick;							// the last tick whose bucket has been emptied into m_dueList
+	CUtlVector<unsigned short> m_dueList;		// entinfo indices of due entries, may hold stale or duplicate entries until the next update
+	CUtlVector<int> m_dueHandles;				// m_simThinkList handles of the entries due on the last update, in order
+
+	int m_statTick;
+	int m_statTicks;
+	int64 m_statDue;
+	int64 m_statIdle;
+	int m_statMaxDue;
+	int64 m_statWheelChecked;
+	CUtlHashtable< const char *, simthinkclassstats_t > m_classStats;	// pooled classname -> cost of thinking and simulating
 };
 
 CSimThinkManager g_SimThinkManager;
@@ -280,6 +536,11 @@ void SimThink_EntityChanged( CBaseEntity *pEntity )
 	g_SimThinkManager.EntityChanged( pEntity );
 }
 
+void SimThink_RecordThinkCost( CBaseEntity *pEntity, double time )
+{
+	g_SimThinkManager.RecordThinkCost( pEntity, time );
+}
+
 static CBaseEntityClassList *s_pClassLists = NULL;
 CBaseEntityClassList::CBaseEntityClassList()
 {
@@ -453,6 +714,10 @@ void CGlobalEntityList::ReportEntityFlagsChanged( CBaseEntity *pEntity, unsigned
 			g_AimManager.RemoveEntity( pEntity );
 		}
 	}
+	if ( flagsChanged & FL_GRENADE )
+	{
+		ProjectileRegistry().OnFlagsChanged( pEntity, flagsOld, flagsNow );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -1648,6 +1913,21 @@ CON_COMMAND(report_touchlinks, "Lists all touchlinks")
 	list.ReportEntityList();
 }
 
+CON_COMMAND( think_stats, "Reports how many thinking entities are due or idle each tick, and think cost by class. Use 'think_stats reset' to start over." )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && !Q_stricmp( args[1], "reset" ) )
+	{
+		g_SimThinkManager.ResetStats();
+		Msg( "Think stats reset\n" );
+		return;
+	}
+
+	g_SimThinkManager.PrintStats();
+}
+
 CON_COMMAND(report_simthinklist, "Lists all simulating/thinking entities")
 {
 	if ( !UTIL_IsCommandIssuedByServerAdmin() )
@@ -57,6 +57,7 @@
 #include "timedeventmgr.h"
 #include "gameinterface.h"
 #include "eventqueue.h"
+#include "tick_time_stats.h"
 #include "hltvdirector.h"
 #if defined( REPLAY_ENABLED )
 #include "replay/iserverreplaycontext.h"
@@ -1217,6 +1218,8 @@ void CServerGameDLL::GameFrame( bool simulating )
 	g_flServerCurTime = gpGlobals->curtime;
 	float oldframetime = gpGlobals->frametime;
 
+	TickTimeStats().BeginTick();
+
 #ifdef _DEBUG
 	// For profiling.. let them enable/disable the networkvar manual mode stuff.
 	g_bUseNetworkVars = s_UseNetworkVars.GetBool();
@@ -1230,16 +1233,29 @@ void CServerGameDLL::GameFrame( bool simulating )
 	//  outside of server frameloop (e.g., in response to concommand)
 	gEntList.CleanupDeleteList();
 
-	IGameSystem::FrameUpdatePreEntityThinkAllSystems();
-	GameStartFrame();
+	{
+		TICK_PHASE( TICK_PHASE_SYSTEMS );
+		IGameSystem::FrameUpdatePreEntityThinkAllSystems();
+	}
+
+	{
+		TICK_PHASE( TICK_PHASE_GAMERULES );
+		GameStartFrame();
+	}
 
 #ifndef _XBOX
 #ifdef USE_NAV_MESH
-	TheNavMesh->Update();
+	{
+		TICK_PHASE( TICK_PHASE_NAV );
+		TheNavMesh->Update();
+	}
 #endif
 
 #ifdef NEXT_BOT
-	TheNextBots().Update();
+	{
+		TICK_PHASE( TICK_PHASE_BOTS );
+		TheNextBots().Update();
+	}
 #endif
 
 	gamestatsuploader->UpdateConnection();
@@ -1248,19 +1264,31 @@ void CServerGameDLL::GameFrame( bool simulating )
 	UpdateQueryCache();
 	g_pServerBenchmark->UpdateBenchmark();
 
-	Physics_RunThinkFunctions( simulating );
+	{
+		TICK_PHASE( TICK_PHASE_ENTITIES );
+		Physics_RunThinkFunctions( simulating );
+	}
 	
-	IGameSystem::FrameUpdatePostEntityThinkAllSystems();
+	{
+		TICK_PHASE( TICK_PHASE_SYSTEMS );
+		IGameSystem::FrameUpdatePostEntityThinkAllSystems();
+	}
 
 	// UNDONE: Make these systems IGameSystems and move these calls into FrameUpdatePostEntityThink()
 	// service event queue, firing off any actions whos time has come
-	ServiceEventQueue();
+	{
+		TICK_PHASE( TICK_PHASE_EVENTS );
+		ServiceEventQueue();
+	}
 
 	// free all ents marked in think functions
 	gEntList.CleanupDeleteList();
 
 	// FIXME:  Should this only occur on the final tick?
-	UpdateAllClientData();
+	{
+		TICK_PHASE( TICK_PHASE_CLIENTDATA );
+		UpdateAllClientData();
+	}
 
 	if ( g_pGameRules )
 	{
@@ -1289,6 +1317,8 @@ void CServerGameDLL::GameFrame( bool simulating )
 	g_NetworkPropertyEventMgr.FireEvents();
 
 	gpGlobals->frametime = oldframetime;
+
+	TickTimeStats().EndTick();
 }
 
 //-----------------------------------------------------------------------------
@@ -629,6 +629,7 @@ void CGib::Spawn( const char *szGibModel, float flLifetime )
 
 
 LINK_ENTITY_TO_CLASS( gib, CGib );
+DEFINE_ENTITY_POOL( CGib, 32 );
 
 CBaseEntity *CreateRagGib( const char *szModel, const Vector &vecOrigin, const QAngle &vecAngles, const Vector &vecForce, float flFadeTime, bool bShouldIgnite )
 {
@@ -17,6 +17,7 @@
 #include "baseanimating.h"
 #include "player_pickup.h"
 #include "Sprite.h"
+#include "entity_pool.h"
 
 extern CBaseEntity *CreateRagGib( const char *szModel, const Vector &vecOrigin, const QAngle &vecAngles, const Vector &vecForce, float flFadeTime = 0.0, bool bShouldIgnite = false );
 
@@ -101,6 +102,8 @@ private:
 
 	EHANDLE m_hSprite;
 	EHANDLE m_hFlame;
+
+	DECLARE_ENTITY_POOL( CGib );
 };
 
 class CRagGib : public CBaseAnimating
@@ -52,10 +52,8 @@ CBaseEntity *CreateEntityByName( const char *className, int iForceEdictIndex )
 	CBaseEntity *pEntity = pNetwork->GetBaseEntity();
 	Assert( pEntity );
 
-#if 0
-	if ( g_pScriptVM )
+	if ( g_pScriptVM && g_VScriptGameEventListener.HasListener( SCRIPT_EVENT_ON_ENTITY_CREATED ) )
 		g_VScriptGameEventListener.RunGameEventCallbacks( "OnEntityCreated", ToHScript( pEntity ) );
-#endif
 
 	return pEntity;
 }
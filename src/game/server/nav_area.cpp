@@ -5253,7 +5253,14 @@ CUtlHash< NavVisPair_t, CVisPairHashFuncs, CVisPairHashFuncs > *g_pNavVisPairHas
 void CNavArea::SetupPVS( void ) const
 {
 	m_nPVSSize = sizeof( m_PVS );
-	engine->ResetPVS( m_PVS, m_nPVSSize );
+	SetupPVS( m_PVS, m_nPVSSize );
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+void CNavArea::SetupPVS( byte *pvs, int pvsSize ) const
+{
+	engine->ResetPVS( pvs, pvsSize );
 
 	const float margin = GenerationStepSize/2.0f;
 	Vector eye( 0, 0, 0.75f * HumanHeight );
@@ -5303,6 +5310,24 @@ bool CNavArea::IsInPVS( void ) const
  * Do actual line-of-sight traces to determine if any part of given area is visible from this area
  */
 CNavArea::VisibilityType CNavArea::ComputeVisibility( const CNavArea *area, bool isPVSValid, bool bCheckPVS, bool *pOutsidePVS ) const
+{
+	if ( !isPVSValid )
+	{
+		float distanceSq = area->GetCenter().DistToSqr( GetCenter() );
+
+		// don't bother building the PVS if the range check below will fail
+		if ( nav_max_view_distance.GetFloat() <= 0.00001f || distanceSq <= Sqr( nav_max_view_distance.GetFloat() ) )
+		{
+			SetupPVS();
+		}
+	}
+
+	return ComputeVisibility( area, m_PVS, m_nPVSSize, bCheckPVS, pOutsidePVS );
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+CNavArea::VisibilityType CNavArea::ComputeVisibility( const CNavArea *area, const byte *pvs, int pvsSize, bool bCheckPVS, bool *pOutsidePVS ) const
 {
 	float distanceSq = area->GetCenter().DistToSqr( GetCenter() );
 
@@ -5316,11 +5341,6 @@ CNavArea::VisibilityType CNavArea::ComputeVisibility( const CNavArea *area, bool
 		}
 	}
 
-	if ( !isPVSValid )
-	{
-		SetupPVS();
-	}
-
 	Vector eye( 0, 0, 0.75f * HumanHeight );
 
 	if ( bCheckPVS )
@@ -5331,7 +5351,7 @@ CNavArea::VisibilityType CNavArea::ComputeVisibility( const CNavArea *area, bool
 		areaExtent.Encompass( area->GetCorner( NORTH_EAST ) + eye );
 		areaExtent.Encompass( area->GetCorner( SOUTH_WEST ) + eye );
 		areaExtent.Encompass( area->GetCorner( SOUTH_EAST ) + eye );
-		if ( !engine->CheckBoxInPVS( areaExtent.lo, areaExtent.hi, m_PVS, m_nPVSSize ) )
+		if ( !engine->CheckBoxInPVS( areaExtent.lo, areaExtent.hi, pvs, pvsSize ) )
 		{
 			if ( pOutsidePVS )
 				*pOutsidePVS = true;
@@ -5627,6 +5647,147 @@ void CNavArea::ComputeVisibilityToMesh( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Record the pairs ComputeVisibilityToMesh() would have computed, without tracing them
+ */
+void CNavArea::MarkVisibilityToMeshComputed( void )
+{
+	NavAreaCollector collector;
+	float radius = nav_max_view_distance.GetFloat();
+	if ( radius == 0.0f )
+	{
+		radius = DEF_NAV_VIEW_DISTANCE;
+	}
+	TheNavMesh->ForAllAreasInRadius( collector, GetCenter(), radius );
+
+	NavVisPair_t visPair;
+
+	FOR_EACH_VEC( collector.m_area, it )
+	{
+		visPair.SetPair( this, collector.m_area[it] );
+		if ( g_pNavVisPairHash->Find( visPair ) == g_pNavVisPairHash->InvalidHandle() )
+		{
+			g_pNavVisPairHash->Insert( visPair );
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Same as ComputeVisToArea(), for any area and with results stored in the job
+ */
+void CNavArea::ComputeVisPair( VisPairJob &job )
+{
+	CNavArea *area = job.m_area;
+	CNavArea *other = job.m_other;
+
+	job.m_visThisToOther = ( other == area ) ? COMPLETELY_VISIBLE : NOT_VISIBLE;
+	job.m_visOtherToThis = NOT_VISIBLE;
+
+	if ( other != area )
+	{
+		bool bOutsidePVS = false;
+
+		job.m_visOtherToThis = area->ComputeVisibility( other, job.m_pvs, job.m_pvsSize, true, &bOutsidePVS );
+
+		if ( !bOutsidePVS && ( job.m_visOtherToThis || ( area->GetCenter() - other->GetCenter() ).LengthSqr() < Sqr( nav_max_view_distance.GetFloat() ) ) )
+		{
+			job.m_visThisToOther = other->ComputeVisibility( area, job.m_pvs, job.m_pvsSize, false, NULL );
+		}
+
+		if ( !job.m_visOtherToThis && job.m_visThisToOther )
+		{
+			job.m_visOtherToThis = POTENTIALLY_VISIBLE;
+		}
+
+		if ( !job.m_visThisToOther && job.m_visOtherToThis )
+		{
+			job.m_visThisToOther = POTENTIALLY_VISIBLE;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Compute visibility for the given areas, in order, as if ComputeVisibilityToMesh() had been called on each.
+ * Late in the analysis most of an area's neighbors have already been paired, which leaves too little work
+ * per area to keep every core busy, so the remaining pairs of all the areas are processed together.
+ */
+void CNavArea::ComputeVisibilityToMesh( CNavArea **areas, int count )
+{
+	float radius = nav_max_view_distance.GetFloat();
+	if ( radius == 0.0f )
+	{
+		radius = DEF_NAV_VIEW_DISTANCE;
+	}
+
+	const int pvsSize = sizeof( m_PVS );
+	CUtlVector< byte > pvsBuffer;
+	pvsBuffer.SetCount( count * pvsSize );
+
+	CUtlVector< VisPairJob > jobVector;
+	NavVisPair_t visPair;
+
+	for( int i=0; i<count; ++i )
+	{
+		CNavArea *area = areas[i];
+
+		area->m_inheritVisibilityFrom.area = NULL;
+		area->m_isInheritedFrom = false;
+
+		NavAreaCollector collector;
+		collector.m_area.EnsureCapacity( 1000 );
+		TheNavMesh->ForAllAreasInRadius( collector, area->GetCenter(), radius );
+
+		// the engine builds PVS data one area at a time
+		byte *pvs = pvsBuffer.Base() + i * pvsSize;
+		area->SetupPVS( pvs, pvsSize );
+
+		FOR_EACH_VEC( collector.m_area, it )
+		{
+			// skip pairs already computed, including by earlier areas in this batch
+			visPair.SetPair( area, collector.m_area[it] );
+			if ( g_pNavVisPairHash->Find( visPair ) != g_pNavVisPairHash->InvalidHandle() )
+				continue;
+
+			g_pNavVisPairHash->Insert( visPair );
+
+			VisPairJob &job = jobVector[ jobVector.AddToTail() ];
+			job.m_area = area;
+			job.m_other = collector.m_area[it];
+			job.m_pvs = pvs;
+			job.m_pvsSize = pvsSize;
+		}
+	}
+
+	ParallelProcess( "CNavArea::ComputeVisibilityToMesh", jobVector.Base(), jobVector.Count(), &ComputeVisPair );
+
+	// store results in a fixed order so the lists don't depend on thread timing
+	FOR_EACH_VEC( jobVector, j )
+	{
+		const VisPairJob &job = jobVector[j];
+		AreaBindInfo info;
+
+		if ( job.m_visThisToOther != NOT_VISIBLE )
+		{
+			info.area = job.m_other;
+			info.attributes = job.m_visThisToOther;
+			job.m_area->m_potentiallyVisibleAreas.AddToTail( info );
+		}
+
+		if ( job.m_visOtherToThis != NOT_VISIBLE )
+		{
+			info.area = job.m_area;
+			info.attributes = job.m_visOtherToThis;
+			job.m_other->m_potentiallyVisibleAreas.AddToTail( info );
+		}
+	}
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 /**
  * The center and all four corners must ALL be visible
@@ -497,7 +497,9 @@ public:
 	};
 
 	VisibilityType ComputeVisibility( const CNavArea *area, bool isPVSValid, bool bCheckPVS = true, bool *pOutsidePVS = NULL ) const;	// do actual line-of-sight traces to determine if any part of given area is visible from this area
+	VisibilityType ComputeVisibility( const CNavArea *area, const byte *pvs, int pvsSize, bool bCheckPVS, bool *pOutsidePVS ) const;	// as above, checking against the given PVS (thread safe)
 	void SetupPVS( void ) const;
+	void SetupPVS( byte *pvs, int pvsSize ) const;	// build our PVS into the given buffer
 	bool IsInPVS( void ) const;					// return true if this area is within the current PVS
 
 	struct AreaBindInfo							// for pointer loading and binding
@@ -740,6 +742,19 @@ private:
 	void ComputeVisibilityToMesh( void );						// compute visibility to surrounding mesh
 	void ResetPotentiallyVisibleAreas();
 	static void ComputeVisToArea( CNavArea *&pOtherArea );
+	static void ComputeVisibilityToMesh( CNavArea **areas, int count );	// compute visibility for several areas at once, spreading all of their area pairs across threads
+	void MarkVisibilityToMeshComputed( void );				// remember that ComputeVisibilityToMesh() has already been done for this area
+
+	struct VisPairJob
+	{
+		CNavArea *m_area;										// the area visibility is being computed for
+		CNavArea *m_other;
+		const byte *m_pvs;										// PVS of m_area
+		int m_pvsSize;
+		VisibilityType m_visThisToOther;
+		VisibilityType m_visOtherToThis;
+	};
+	static void ComputeVisPair( VisPairJob &job );
 
 #ifndef _X360
 	typedef CUtlVectorConservative<AreaBindInfo> CAreaBindInfoArray; // shaves 8 bytes off structure caused by need to support editing
@@ -1002,6 +1002,22 @@ const char *CNavMesh::GetFilename( void ) const
 	return filename;
 }
 
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the filename of the analysis checkpoint kept next to this map's "nav map" file
+ */
+const char *CNavMesh::GetAnalysisCheckpointFilename( void ) const
+{
+	// persistant return value
+	static char filename[256];
+	Q_snprintf( filename, sizeof( filename ), FORMAT_NAVFILE ".analysis", STRING( gpGlobals->mapname ) );
+	V_FixSlashes( filename, '/' );
+
+	return filename;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /*
 ============
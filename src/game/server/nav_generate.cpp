@@ -10,6 +10,7 @@
 // Author: Michael S. Booth (mike@turtlerockstudios.com), 2003
 
 #include "cbase.h"
+#include "filesystem.h"
 #include "util_shared.h"
 #include "nav_mesh.h"
 #include "nav_node.h"
@@ -43,6 +44,8 @@ ConVar nav_generate_jump_connections( "nav_generate_jump_connections", "1", FCVA
 ConVar nav_generate_incremental_range( "nav_generate_incremental_range", "2000", FCVAR_CHEAT );
 ConVar nav_generate_incremental_tolerance( "nav_generate_incremental_tolerance", "0", FCVAR_CHEAT, "Z tolerance for adding new nav areas." );
 ConVar nav_area_max_size( "nav_area_max_size", "50", FCVAR_CHEAT, "Max area size created in nav generation" );
+ConVar nav_analyze_vis_batch_size( "nav_analyze_vis_batch_size", "16", FCVAR_CHEAT, "Number of areas whose mesh visibility is computed together across all threads" );
+ConVar nav_analyze_checkpoint_interval( "nav_analyze_checkpoint_interval", "300", FCVAR_CHEAT, "Seconds between saves of analysis progress that nav_analyze_scripted resume can continue from (0 = never)" );
 
 // Common bounding box for traces
 Vector NavTraceMins( -0.45, -0.45, 0 );
@@ -3448,6 +3451,7 @@ void CNavMesh::BeginGeneration( bool incremental )
 	m_sampleTick = 0;
 	m_generationMode = (incremental) ? GENERATE_INCREMENTAL : GENERATE_FULL;
 	lastMsgTime = 0.0f;
+	m_analysisCheckpointTime = Plat_FloatTime();
 
 	// clear any previous mesh
 	DestroyNavigationMesh( incremental );
@@ -3549,6 +3553,123 @@ void CNavMesh::BeginAnalysis( bool quitWhenFinished )
 	m_bQuitWhenFinished = quitWhenFinished;
 	lastMsgTime = 0.0f;
 	m_generationStartTime = Plat_FloatTime();
+	m_analysisCheckpointTime = m_generationStartTime;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return true if analysis can be continued from the current state using only the saved mesh.
+ * Light intensity needs a listen server host, and custom analysis may keep state between areas.
+ */
+bool CNavMesh::IsAnalysisCheckpointState( void ) const
+{
+	if ( m_generationMode != GENERATE_ANALYSIS_ONLY && m_generationMode != GENERATE_FULL )
+		return false;
+
+	switch( m_generationState )
+	{
+		case FIND_HIDING_SPOTS:
+		case FIND_ENCOUNTER_SPOTS:
+		case FIND_SNIPER_SPOTS:
+		case COMPUTE_MESH_VISIBILITY:
+		case FIND_EARLIEST_OCCUPY_TIMES:
+			return true;
+
+		case CUSTOM:
+			return m_generationIndex == 0;
+
+		default:
+			break;
+	}
+
+	return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Save the partially analyzed mesh, along with where analysis left off
+ */
+void CNavMesh::SaveAnalysisCheckpoint( void )
+{
+	if ( !Save() )
+	{
+		Warning( "Cannot save navigation map '%s' for analysis checkpoint.\n", GetFilename() );
+		return;
+	}
+
+	KeyValues *data = new KeyValues( "NavAnalysisCheckpoint" );
+	data->SetInt( "state", m_generationState );
+	data->SetInt( "index", m_generationIndex );
+	data->SetInt( "areaCount", TheNavAreas.Count() );
+	data->SetInt( "areaID", ( m_generationIndex < TheNavAreas.Count() ) ? TheNavAreas[ m_generationIndex ]->GetID() : 0 );
+
+	if ( data->SaveToFile( filesystem, GetAnalysisCheckpointFilename(), "MOD" ) )
+	{
+		Msg( "Analysis checkpoint saved at step %d, area %d of %d.\n", m_generationState, m_generationIndex, TheNavAreas.Count() );
+	}
+	else
+	{
+		Warning( "Cannot save analysis checkpoint '%s'.\n", GetAnalysisCheckpointFilename() );
+	}
+
+	data->deleteThis();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Continue an analysis from the checkpoint saved with the loaded mesh.
+ * Returns false if there is no usable checkpoint.
+ */
+bool CNavMesh::ResumeAnalysis( void )
+{
+	KeyValues *data = new KeyValues( "NavAnalysisCheckpoint" );
+	if ( !data->LoadFromFile( filesystem, GetAnalysisCheckpointFilename(), "MOD" ) )
+	{
+		data->deleteThis();
+		Msg( "No analysis checkpoint for this map, starting a new analysis.\n" );
+		return false;
+	}
+
+	GenerationStateType state = (GenerationStateType)data->GetInt( "state", SAVE_NAV_MESH );
+	int index = data->GetInt( "index", -1 );
+	int areaCount = data->GetInt( "areaCount", -1 );
+	unsigned int areaID = (unsigned int)data->GetInt( "areaID", 0 );
+	data->deleteThis();
+
+	// make sure the checkpoint was written for the mesh we loaded
+	bool isValid = ( areaCount == TheNavAreas.Count() && index >= 0 && index <= areaCount );
+	if ( isValid && index < areaCount )
+	{
+		isValid = ( TheNavAreas[ index ]->GetID() == areaID );
+	}
+
+	m_generationState = state;
+	m_generationIndex = index;
+	m_generationMode = GENERATE_ANALYSIS_ONLY;
+
+	if ( !isValid || !IsAnalysisCheckpointState() )
+	{
+		m_generationMode = GENERATE_NONE;
+		Warning( "Analysis checkpoint does not match the navigation mesh, starting a new analysis.\n" );
+		return false;
+	}
+
+	if ( m_generationState == COMPUTE_MESH_VISIBILITY )
+	{
+		ResumeVisibilityComputations();
+	}
+
+	m_bQuitWhenFinished = true;
+	lastMsgTime = 0.0f;
+	m_generationStartTime = Plat_FloatTime();
+	m_analysisCheckpointTime = m_generationStartTime;
+
+	Msg( "Resuming analysis at step %d, area %d of %d.\n", m_generationState, m_generationIndex, TheNavAreas.Count() );
+
+	return true;
 }
 
 
@@ -3642,6 +3763,15 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 
 	static ConVarRef host_thread_mode( "host_thread_mode" );
 
+	// every step leaves the mesh in a savable state when it returns
+	if ( nav_analyze_checkpoint_interval.GetFloat() > 0.0f && IsAnalysisCheckpointState() &&
+		 startTime - m_analysisCheckpointTime > nav_analyze_checkpoint_interval.GetFloat() )
+	{
+		SaveAnalysisCheckpoint();
+		m_analysisCheckpointTime = Plat_FloatTime();
+		startTime = m_analysisCheckpointTime;
+	}
+
 	switch( m_generationState )
 	{
 		//---------------------------------------------------------------------------
@@ -3795,10 +3925,16 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 		{
 			while( m_generationIndex < TheNavAreas.Count() )
 			{
-				CNavArea *area = TheNavAreas[ m_generationIndex ];
-				++m_generationIndex;
-
-				area->ComputeVisibilityToMesh();
+				int count = MIN( MAX( nav_analyze_vis_batch_size.GetInt(), 1 ), TheNavAreas.Count() - m_generationIndex );
+				if ( count == 1 )
+				{
+					TheNavAreas[ m_generationIndex ]->ComputeVisibilityToMesh();
+				}
+				else
+				{
+					CNavArea::ComputeVisibilityToMesh( &TheNavAreas[ m_generationIndex ], count );
+				}
+				m_generationIndex += count;
 
 				// don't go over our time allotment
 				if ( Plat_FloatTime() - startTime > maxTime )
@@ -4012,6 +4148,12 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			if (Save())
 			{
 				Msg( "Navigation map '%s' saved.\n", GetFilename() );
+
+				// analysis is complete, there is nothing left to resume
+				if ( filesystem->FileExists( GetAnalysisCheckpointFilename(), "MOD" ) )
+				{
+					filesystem->RemoveFile( GetAnalysisCheckpointFilename(), "MOD" );
+				}
 			}
 			else
 			{
@@ -16,6 +16,7 @@
 #include "fmtstr.h"
 #include "utlbuffer.h"
 #include "tier0/vprof.h"
+#include "mathlib/ssemath.h"
 #ifdef TERROR
 #include "func_simpleladder.h"
 #endif
@@ -53,6 +54,8 @@ ConVar nav_show_func_nav_avoid( "nav_show_func_nav_avoid", "0", FCVAR_GAMEDLL |
 ConVar nav_show_func_nav_prefer( "nav_show_func_nav_prefer", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show areas of designer-placed bot preference due to func_nav_prefer entities" );
 ConVar nav_show_func_nav_prerequisite( "nav_show_func_nav_prerequisite", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show areas of designer-placed bot preference due to func_nav_prerequisite entities" );
 ConVar nav_max_vis_delta_list_length( "nav_max_vis_delta_list_length", "64", FCVAR_CHEAT );
+ConVar nav_lookup_accel( "nav_lookup_accel", "1", FCVAR_CHEAT, "Use height-sorted per-cell area lists and last area neighbors to find nav areas at a position" );
+ConVar nav_analyze_frame_time( "nav_analyze_frame_time", "1.0", FCVAR_CHEAT, "Seconds of each frame spent on scripted (nav_analyze_scripted) analysis" );
 
 extern ConVar nav_show_potentially_visible;
 
@@ -68,6 +71,8 @@ CNavMesh::CNavMesh( void )
 	m_gridCellSize = 300.0f;
 	m_editMode = NORMAL;
 	m_bQuitWhenFinished = false;
+	m_analysisCheckpointTime = 0.0f;
+	m_isLookupGridValid = false;
 	m_hostThreadModeRestoreValue = 0;
 	m_placeCount = 0;
 	m_placeName = NULL;
@@ -214,6 +219,9 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 		m_gridSizeY = 0;
 	}
 
+	m_lookupGrid.RemoveAll();
+	m_isLookupGridValid = false;
+
 	// clear the hash table
 	for( int i=0; i<HASH_TABLE_SIZE; ++i )
 	{
@@ -258,7 +266,8 @@ void CNavMesh::Update( void )
 
 	if (IsGenerating())
 	{
-		UpdateGeneration( 0.03 );
+		// with nobody connected, spend most of each frame on generation
+		UpdateGeneration( m_bQuitWhenFinished ? nav_analyze_frame_time.GetFloat() : 0.03 );
 		return; // don't bother trying to draw stuff while we're generating
 	}
 
@@ -462,6 +471,7 @@ void CNavMesh::AllocateGrid( float minX, float maxX, float minY, float maxY )
 	m_gridSizeY = (int)((maxY - minY) / m_gridCellSize) + 1;
 
 	m_grid.SetCount( m_gridSizeX * m_gridSizeY );
+	m_isLookupGridValid = false;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -490,6 +500,8 @@ void CNavMesh::AddNavArea( CNavArea *area )
 		}
 	}
 
+	m_isLookupGridValid = false;
+
 	// add to hash table
 	int key = ComputeHashKey( area->GetID() );
 
@@ -537,6 +549,8 @@ void CNavMesh::RemoveNavArea( CNavArea *area )
 		}
 	}
 
+	m_isLookupGridValid = false;
+
 	// remove from hash table
 	int key = ComputeHashKey( area->GetID() );
 
@@ -687,6 +701,211 @@ inline void CNavMesh::GridToWorld( int gridX, int gridY, Vector *pos ) const
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return true if the lookup grid can be used to find areas, rebuilding it if the mesh has changed.
+ * Areas can be reshaped in place while editing or generating, so it is not used then.
+ */
+bool CNavMesh::IsLookupGridUsable( void ) const
+{
+	if ( !nav_lookup_accel.GetBool() || IsGenerating() || nav_edit.GetBool() || !m_grid.Count() )
+	{
+		m_isLookupGridValid = false;
+		return false;
+	}
+
+	if ( !m_isLookupGridValid )
+	{
+		BuildLookupGrid();
+		m_isLookupGridValid = true;
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+struct NavLookupSortEntry
+{
+	CNavArea *area;
+	float maxZ;
+	int order;
+};
+
+static int NavLookupSortEntryCompare( const NavLookupSortEntry *lhs, const NavLookupSortEntry *rhs )
+{
+	if ( lhs->maxZ != rhs->maxZ )
+		return ( lhs->maxZ > rhs->maxZ ) ? -1 : 1;
+
+	return lhs->order - rhs->order;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Copy each grid cell's areas into blocks of four, highest first, and find how far each cell
+ * is from the nearest cell with any areas in it.
+ */
+void CNavMesh::BuildLookupGrid( void ) const
+{
+	VPROF_BUDGET( "CNavMesh::BuildLookupGrid", "NextBot" );
+
+	const int noOccupiedCell = m_gridSizeX + m_gridSizeY;
+
+	m_lookupGrid.RemoveAll();
+	m_lookupGrid.SetCount( m_grid.Count() );
+
+	CUtlVector< NavLookupSortEntry > sortVector;
+	CUtlVector< int > openVector;
+
+	FOR_EACH_VEC( m_grid, c )
+	{
+		const NavAreaVector &areaVector = m_grid[c];
+		NavLookupCell &cell = m_lookupGrid[c];
+
+		if ( areaVector.Count() == 0 )
+		{
+			cell.m_occupiedShift = noOccupiedCell;
+			continue;
+		}
+
+		cell.m_occupiedShift = 0;
+		openVector.AddToTail( c );
+
+		sortVector.RemoveAll();
+		FOR_EACH_VEC( areaVector, it )
+		{
+			CNavArea *area = areaVector[it];
+
+			NavLookupSortEntry &entry = sortVector[ sortVector.AddToTail() ];
+			entry.area = area;
+			entry.maxZ = MAX( MAX( area->GetCorner( NORTH_WEST ).z, area->GetCorner( NORTH_EAST ).z ), MAX( area->GetCorner( SOUTH_EAST ).z, area->GetCorner( SOUTH_WEST ).z ) );
+			entry.order = it;
+		}
+		sortVector.Sort( NavLookupSortEntryCompare );
+
+		cell.m_block.SetCount( ( sortVector.Count() + 3 ) / 4 );
+
+		FOR_EACH_VEC( cell.m_block, b )
+		{
+			NavLookupBlock &block = cell.m_block[b];
+
+			// GetZ() interpolates between the corners, allow for rounding
+			block.m_maxZ = sortVector[ 4*b ].maxZ + 1.0f;
+
+			for( int i=0; i<4; ++i )
+			{
+				int n = 4*b + i;
+				if ( n < sortVector.Count() )
+				{
+					CNavArea *area = sortVector[n].area;
+					block.m_loX[i] = area->GetCorner( NORTH_WEST ).x;
+					block.m_loY[i] = area->GetCorner( NORTH_WEST ).y;
+					block.m_hiX[i] = area->GetCorner( SOUTH_EAST ).x;
+					block.m_hiY[i] = area->GetCorner( SOUTH_EAST ).y;
+					block.m_area[i] = area;
+					block.m_order[i] = sortVector[n].order;
+				}
+				else
+				{
+					// empty extent that no point overlaps
+					block.m_loX[i] = block.m_loY[i] = FLT_MAX;
+					block.m_hiX[i] = block.m_hiY[i] = -FLT_MAX;
+					block.m_area[i] = NULL;
+					block.m_order[i] = INT_MAX;
+				}
+			}
+		}
+	}
+
+	// breadth-first from the occupied cells gives the ring each cell's nearest areas are found in
+	for( int head=0; head<openVector.Count(); ++head )
+	{
+		int c = openVector[head];
+		int cx = c % m_gridSizeX;
+		int cy = c / m_gridSizeX;
+
+		for( int y = cy-1; y <= cy+1; ++y )
+		{
+			if ( y < 0 || y >= m_gridSizeY )
+				continue;
+
+			for( int x = cx-1; x <= cx+1; ++x )
+			{
+				if ( x < 0 || x >= m_gridSizeX )
+					continue;
+
+				NavLookupCell &cell = m_lookupGrid[ x + y*m_gridSizeX ];
+				if ( cell.m_occupiedShift == noOccupiedCell )
+				{
+					cell.m_occupiedShift = m_lookupGrid[c].m_occupiedShift + 1;
+					openVector.AddToTail( x + y*m_gridSizeX );
+				}
+			}
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the highest area overlapping 'pos' with Z in [loZ, hiZ], the same area a scan of
+ * the m_grid cell would pick.
+ */
+CNavArea *CNavMesh::FindLookupGridArea( const Vector &pos, float loZ, float hiZ, bool skipBlocked, int team ) const
+{
+	const NavLookupCell &cell = m_lookupGrid[ WorldToGridX( pos.x ) + WorldToGridY( pos.y )*m_gridSizeX ];
+
+	const fltx4 x = ReplicateX4( pos.x );
+	const fltx4 y = ReplicateX4( pos.y );
+
+	CNavArea *use = NULL;
+	float useZ = -99999999.9f;
+	int useOrder = INT_MAX;
+
+	FOR_EACH_VEC( cell.m_block, b )
+	{
+		const NavLookupBlock &block = cell.m_block[b];
+
+		// remaining areas are all too low
+		if ( block.m_maxZ < useZ || block.m_maxZ < loZ )
+			break;
+
+		fltx4 overlap = AndSIMD( CmpGeSIMD( x, LoadUnalignedSIMD( block.m_loX ) ), CmpLeSIMD( x, LoadUnalignedSIMD( block.m_hiX ) ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpGeSIMD( y, LoadUnalignedSIMD( block.m_loY ) ), CmpLeSIMD( y, LoadUnalignedSIMD( block.m_hiY ) ) ) );
+
+		int mask = TestSignSIMD( overlap );
+		if ( !mask )
+			continue;
+
+		for( int i=0; i<4; ++i )
+		{
+			if ( !( mask & ( 1 << i ) ) )
+				continue;
+
+			CNavArea *area = block.m_area[i];
+
+			if ( skipBlocked && area->IsBlocked( team ) )
+				continue;
+
+			float z = area->GetZ( pos );
+			if ( z > hiZ || z < loZ )
+				continue;
+
+			// on ties, keep the area that comes first in the cell
+			if ( z > useZ || ( z == useZ && block.m_order[i] < useOrder ) )
+			{
+				use = area;
+				useZ = z;
+				useOrder = block.m_order[i];
+			}
+		}
+	}
+
+	return use;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Given a position, return the nav area that IsOverlapping and is *immediately* beneath it
@@ -698,6 +917,13 @@ CNavArea *CNavMesh::GetNavArea( const Vector &pos, float beneathLimit ) const
 	if ( !m_grid.Count() )
 		return NULL;
 
+	Vector testPos = pos + Vector( 0, 0, 5 );
+
+	if ( IsLookupGridUsable() )
+	{
+		return FindLookupGridArea( testPos, pos.z - beneathLimit, testPos.z, false, TEAM_ANY );
+	}
+
 	// get list in cell that contains position
 	int x = WorldToGridX( pos.x );
 	int y = WorldToGridY( pos.y );
@@ -706,7 +932,6 @@ CNavArea *CNavMesh::GetNavArea( const Vector &pos, float beneathLimit ) const
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
-	Vector testPos = pos + Vector( 0, 0, 5 );
 
 	FOR_EACH_VEC( (*areaVector), it )
 	{
@@ -764,47 +989,83 @@ CNavArea *CNavMesh::GetNavArea( CBaseEntity *pEntity, int nFlags, float flBeneat
 				return pLastNavArea;
 		}
 		flStepHeight = StepHeight;
-	}
 
-	// get list in cell that contains position
-	int x = WorldToGridX( testPos.x );
-	int y = WorldToGridY( testPos.y );
-	NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
+		// Moving characters usually step into an area adjacent to the last one
+		if ( pLastNavArea && nav_lookup_accel.GetBool() )
+		{
+			bool bAllowBlocked = ( nFlags & GETNAVAREA_ALLOW_BLOCKED_AREAS ) != 0;
+
+			for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+			{
+				const NavConnectVector *pAdjacent = pLastNavArea->GetAdjacentAreas( (NavDirType)dir );
+				FOR_EACH_VEC( (*pAdjacent), it )
+				{
+					CNavArea *pArea = (*pAdjacent)[ it ].area;
+					if ( !pArea->IsOverlapping( testPos ) )
+						continue;
+
+					if ( !bAllowBlocked && pArea->IsBlocked( pEntity->GetTeamNumber() ) )
+						continue;
+
+					float flZ = pArea->GetZ( testPos );
+					if ( ( flZ <= testPos.z + StepHeight ) && ( flZ >= testPos.z - StepHeight ) )
+						return pArea;
+				}
+			}
+		}
+	}
 
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
 
 	bool bSkipBlockedAreas = ( ( nFlags & GETNAVAREA_ALLOW_BLOCKED_AREAS ) == 0 );
-	FOR_EACH_VEC( (*areaVector), it )
+
+	if ( IsLookupGridUsable() )
+	{
+		use = FindLookupGridArea( testPos, testPos.z - flBeneathLimit, testPos.z + flStepHeight, bSkipBlockedAreas, pEntity->GetTeamNumber() );
+		if ( use )
+		{
+			useZ = use->GetZ( testPos );
+		}
+	}
+	else
 	{
-		CNavArea *pArea = (*areaVector)[ it ];
+		// get list in cell that contains position
+		int x = WorldToGridX( testPos.x );
+		int y = WorldToGridY( testPos.y );
+		NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
 
-		// check if position is within 2D boundaries of this area
-		if ( !pArea->IsOverlapping( testPos ) )
-			continue;
+		FOR_EACH_VEC( (*areaVector), it )
+		{
+			CNavArea *pArea = (*areaVector)[ it ];
 
-		// don't consider blocked areas
-		if ( bSkipBlockedAreas && pArea->IsBlocked( pEntity->GetTeamNumber() ) )
-			continue;
+			// check if position is within 2D boundaries of this area
+			if ( !pArea->IsOverlapping( testPos ) )
+				continue;
 
-		// project position onto area to get Z
-		float z = pArea->GetZ( testPos );
+			// don't consider blocked areas
+			if ( bSkipBlockedAreas && pArea->IsBlocked( pEntity->GetTeamNumber() ) )
+				continue;
 
-		// if area is above us, skip it
-		if ( z > testPos.z + flStepHeight )
-			continue;
+			// project position onto area to get Z
+			float z = pArea->GetZ( testPos );
 
-		// if area is too far below us, skip it
-		if ( z < testPos.z - flBeneathLimit )
-			continue;
+			// if area is above us, skip it
+			if ( z > testPos.z + flStepHeight )
+				continue;
 
-		// if area is lower than the one we have, skip it
-		if ( z <= useZ )
-			continue;
+			// if area is too far below us, skip it
+			if ( z < testPos.z - flBeneathLimit )
+				continue;
+
+			// if area is lower than the one we have, skip it
+			if ( z <= useZ )
+				continue;
 
-		use = pArea;
-		useZ = z;
+			use = pArea;
+			useZ = z;
+		}
 	}
 
 	// Check LOS if necessary
@@ -884,6 +1145,17 @@ CNavArea *CNavMesh::GetNearestNavArea( const Vector &pos, bool anyZ, float maxDi
 
 	int shiftLimit = ceil(maxDist / m_gridCellSize);
 
+	// rings closer than the nearest occupied cell are empty
+	int shift = 0;
+	if ( IsLookupGridUsable() )
+	{
+		shift = m_lookupGrid[ originX + originY*m_gridSizeX ].m_occupiedShift;
+	}
+
+	// 'pos' moved out of the world, if LOS is checked
+	Vector safePos;
+	bool isSafePosValid = false;
+
 	//
 	// Search in increasing rings out from origin, starting with cell
 	// that contains the given position.
@@ -891,7 +1163,7 @@ CNavArea *CNavMesh::GetNearestNavArea( const Vector &pos, bool anyZ, float maxDi
 	// case our position is just against the edge of the cell boundary
 	// and an area in an adjacent cell is actually closer.
 	// 
-	for( int shift=0; shift <= shiftLimit; ++shift )
+	for( ; shift <= shiftLimit; ++shift )
 	{
 		for( int x = originX - shift; x <= originX + shift; ++x )
 		{
@@ -948,17 +1220,19 @@ CNavArea *CNavMesh::GetNearestNavArea( const Vector &pos, bool anyZ, float maxDi
 						trace_t result;
 
 						// make sure 'pos' is not embedded in the world
-						Vector safePos;
-
-						UTIL_TraceLine( pos, pos + Vector( 0, 0, StepHeight ), MASK_NPCSOLID_BRUSHONLY, NULL, COLLISION_GROUP_NONE, &result );
-						if ( result.startsolid )
-						{
-							// it was embedded - move it out
-							safePos = result.endpos + Vector( 0, 0, 1.0f );
-						}
-						else
+						if ( !isSafePosValid )
 						{
-							safePos = pos;
+							UTIL_TraceLine( pos, pos + Vector( 0, 0, StepHeight ), MASK_NPCSOLID_BRUSHONLY, NULL, COLLISION_GROUP_NONE, &result );
+							if ( result.startsolid )
+							{
+								// it was embedded - move it out
+								safePos = result.endpos + Vector( 0, 0, 1.0f );
+							}
+							else
+							{
+								safePos = pos;
+							}
+							isSafePosValid = true;
 						}
 
 						// Don't bother tracing from the nav area up to safePos.z if it's within StepHeight of the area, since areas can be embedded in the ground a bit
@@ -1021,6 +1295,113 @@ CNavArea *CNavMesh::GetNearestNavArea( CBaseEntity *pEntity, int nFlags, float m
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+static double NavLookupRate( int count, double startTime )
+{
+	return count / MAX( Plat_FloatTime() - startTime, 1.0e-6 );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Time area lookups with and without nav_lookup_accel, and make sure both find the same areas
+ */
+CON_COMMAND_F( nav_lookup_bench, "Reports nav area lookups per second with and without nav_lookup_accel. Argument: [number of positions]", FCVAR_GAMEDLL | FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( TheNavAreas.Count() == 0 )
+	{
+		Msg( "No navigation mesh loaded.\n" );
+		return;
+	}
+
+	int count = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 10000;
+
+	// most lookups are for positions on the mesh, but include some off of it
+	CUtlVector< Vector > posVector;
+	posVector.EnsureCapacity( count );
+	for( int i=0; i<count; ++i )
+	{
+		Vector pos = TheNavAreas[ RandomInt( 0, TheNavAreas.Count()-1 ) ]->GetRandomPoint();
+		if ( i & 1 )
+		{
+			pos.x += RandomFloat( -200.0f, 200.0f );
+			pos.y += RandomFloat( -200.0f, 200.0f );
+		}
+		pos.z += RandomFloat( 0.0f, HumanHeight );
+		posVector.AddToTail( pos );
+	}
+
+	CUtlVector< CBaseCombatCharacter * > characterVector;
+	for( int i=1; i<=gpGlobals->maxClients; ++i )
+	{
+		CBasePlayer *player = UTIL_PlayerByIndex( i );
+		if ( player && player->IsAlive() )
+		{
+			characterVector.AddToTail( player );
+		}
+	}
+
+	bool wasAccel = nav_lookup_accel.GetBool();
+
+	double areaRate[2], nearestRate[2], entityRate[2] = { 0.0, 0.0 };
+	CUtlVector< CNavArea * > resultVector[2];
+
+	for( int pass=0; pass<2; ++pass )
+	{
+		nav_lookup_accel.SetValue( pass );
+
+		double startTime = Plat_FloatTime();
+		FOR_EACH_VEC( posVector, i )
+		{
+			resultVector[pass].AddToTail( TheNavMesh->GetNavArea( posVector[i] ) );
+		}
+		areaRate[pass] = NavLookupRate( count, startTime );
+
+		startTime = Plat_FloatTime();
+		FOR_EACH_VEC( posVector, i )
+		{
+			resultVector[pass].AddToTail( TheNavMesh->GetNearestNavArea( posVector[i], false, 500.0f, false, false ) );
+		}
+		nearestRate[pass] = NavLookupRate( count, startTime );
+
+		// as UpdateLastKnownArea() does it - these may legitimately differ, so aren't compared
+		if ( characterVector.Count() )
+		{
+			startTime = Plat_FloatTime();
+			for( int i=0; i<count; ++i )
+			{
+				TheNavMesh->GetNearestNavArea( characterVector[ i % characterVector.Count() ], GETNAVAREA_CHECK_GROUND | GETNAVAREA_CHECK_LOS, 50.0f );
+			}
+			entityRate[pass] = NavLookupRate( count, startTime );
+		}
+	}
+
+	nav_lookup_accel.SetValue( wasAccel );
+
+	int mismatchCount = 0;
+	FOR_EACH_VEC( resultVector[0], i )
+	{
+		if ( resultVector[0][i] != resultVector[1][i] )
+		{
+			++mismatchCount;
+		}
+	}
+
+	Msg( "%d positions, %d areas\n", count, TheNavAreas.Count() );
+	Msg( "                     off (lookups/sec)   on (lookups/sec)\n" );
+	Msg( "GetNavArea           %18.0f %18.0f\n", areaRate[0], areaRate[1] );
+	Msg( "GetNearestNavArea    %18.0f %18.0f\n", nearestRate[0], nearestRate[1] );
+	if ( characterVector.Count() )
+	{
+		Msg( "GetNearestNavArea [ent] %15.0f %18.0f  (%d players)\n", entityRate[0], entityRate[1], characterVector.Count() );
+	}
+	Msg( "%d of %d results differ\n", mismatchCount, resultVector[0].Count() );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Given an ID, return the associated area
@@ -2648,6 +3029,7 @@ void CommandNavAnalyzeScripted( const CCommand &args )
 	}
 
 	bool bForceAnalyze = pszCmd && !Q_stricmp( pszCmd, "force" );
+	bool bResumeAnalyze = pszCmd && !Q_stricmp( pszCmd, "resume" );
 
 	if ( TheNavMesh->IsAnalyzed() && !bForceAnalyze )
 	{
@@ -2657,10 +3039,13 @@ void CommandNavAnalyzeScripted( const CCommand &args )
 
 	if ( nav_edit.GetBool() )
 	{
+		if ( bResumeAnalyze && TheNavMesh->ResumeAnalysis() )
+			return;
+
 		TheNavMesh->BeginAnalysis( true );
 	}
 }
-static ConCommand nav_analyze_scripted( "nav_analyze_scripted", CommandNavAnalyzeScripted, "commandline hook to run a nav_analyze and then quit.", FCVAR_GAMEDLL | FCVAR_CHEAT | FCVAR_HIDDEN );
+static ConCommand nav_analyze_scripted( "nav_analyze_scripted", CommandNavAnalyzeScripted, "commandline hook to run a nav_analyze and then quit. 'resume' continues from the last checkpoint, if any.", FCVAR_GAMEDLL | FCVAR_CHEAT | FCVAR_HIDDEN );
 
 
 //--------------------------------------------------------------------------------------------------------------
@@ -3453,6 +3838,29 @@ void CNavMesh::BeginVisibilityComputations( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Invoked when resuming visibility computations from a checkpoint. The visibility lists were
+ * loaded with the mesh; only the pairs already computed need to be remembered again.
+ */
+void CNavMesh::ResumeVisibilityComputations( void )
+{
+	if ( !g_pNavVisPairHash )
+	{
+		g_pNavVisPairHash = new CUtlHash< NavVisPair_t, CVisPairHashFuncs, CVisPairHashFuncs >( 16*1024 );
+	}
+	else
+	{
+		g_pNavVisPairHash->RemoveAll();
+	}
+
+	for( int i=0; i<m_generationIndex && i<TheNavAreas.Count(); ++i )
+	{
+		TheNavAreas[ i ]->MarkVisibilityToMeshComputed();
+	}
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 /**
  * Invoked when custom analysis step is complete
@@ -356,6 +356,7 @@ public:
 	#define INCREMENTAL_GENERATION true
 	void BeginGeneration( bool incremental = false );					// initiate the generation process
 	void BeginAnalysis( bool quitWhenFinished = false );						// re-analyze an existing Mesh.  Determine Hiding Spots, Encounter Spots, etc.
+	bool ResumeAnalysis( void );												// continue an interrupted analysis from its last checkpoint, and quit when finished
 
 	bool IsGenerating( void ) const		{ return m_generationMode != GENERATE_NONE; }	// return true while a Navigation Mesh is being generated
 	const char *GetPlayerSpawnName( void ) const;						// return name of player spawn entity
@@ -1113,6 +1114,30 @@ private:
 
 	void AddNavArea( CNavArea *area );							// add an area to the grid
 
+	struct NavLookupBlock										// up to four areas of a grid cell, tested against a point together
+	{
+		float m_loX[4];
+		float m_loY[4];
+		float m_hiX[4];
+		float m_hiY[4];
+		float m_maxZ;											// no area in this block, or any later block of the cell, is higher
+		CNavArea *m_area[4];
+		int m_order[4];											// index of each area in its m_grid cell, to break ties the same way
+	};
+
+	struct NavLookupCell
+	{
+		CUtlVector< NavLookupBlock > m_block;					// the areas of the m_grid cell, highest first
+		int m_occupiedShift;									// distance in cells to the nearest cell that has any areas
+	};
+
+	mutable CUtlVector< NavLookupCell > m_lookupGrid;			// rebuilt from m_grid whenever areas are added or removed
+	mutable bool m_isLookupGridValid;
+
+	bool IsLookupGridUsable( void ) const;						// return true if m_lookupGrid can be used, rebuilding it if needed
+	void BuildLookupGrid( void ) const;
+	CNavArea *FindLookupGridArea( const Vector &pos, float loZ, float hiZ, bool skipBlocked, int team ) const;	// return the highest area over 'pos' with Z in [loZ, hiZ]
+
 	void DestroyNavigationMesh( bool incremental = false );		// free all resources of the mesh and reset it to empty state
 	void DestroyHidingSpots( void );
 
@@ -1245,6 +1270,11 @@ private:
 	int m_sampleTick;											// counter for displaying pseudo-progress while sampling walkable space
 	bool m_bQuitWhenFinished;
 	float m_generationStartTime;
+	float m_analysisCheckpointTime;								// when analysis progress was last saved to disk
+
+	bool IsAnalysisCheckpointState( void ) const;				// return true if analysis can be resumed from the current generation state
+	const char *GetAnalysisCheckpointFilename( void ) const;
+	void SaveAnalysisCheckpoint( void );
 	Extent m_simplifyGenerationExtent;
 
 	char *m_spawnName;											// name of player spawn entity, used to initiate sampling
@@ -1273,6 +1303,7 @@ private:
 	CUtlVector< int > m_storedSelectedSet;						// "Stored" selected set, so we can do some editing and then restore the old selected set.  Done by ID, so we don't have to worry about split/delete/etc.
 
 	void BeginVisibilityComputations( void );
+	void ResumeVisibilityComputations( void );					// rebuild visibility state for the areas already computed before a checkpoint
 	void EndVisibilityComputations( void );
 
 	void TestAllAreasForBlockedStatus( void );					// Used to update blocked areas after a round restart. Need to delay so the map logic has all fired.
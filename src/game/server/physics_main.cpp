@@ -42,6 +42,7 @@
 #include "tier0/memdbgon.h"
 
 extern ConVar think_limit;
+extern ConVar sv_think_stats;
 #ifdef _XBOX
 ConVar vprof_think_limit( "vprof_think_limit", "0" );
 #endif
@@ -2066,12 +2067,26 @@ void Physics_RunThinkFunctions( bool simulating )
 		int count = SimThink_ListCopy( list, listMax );
 
 		//DevMsg(1, "Count: %d\n", count );
+		bool bRecordCost = sv_think_stats.GetBool();
 		for ( int i = 0; i < count; i++ )
 		{
 			if ( !list[i] )
 				continue;
 			// Always reset clock to real sv.time
 			gpGlobals->curtime = starttime;
+
+			if ( bRecordCost )
+			{
+				CFastTimer timer;
+				timer.Start();
+				Physics_SimulateEntity( list[i] );
+				timer.End();
+
+				// removal is deferred until after this loop, so the entity is still valid
+				SimThink_RecordThinkCost( list[i], timer.GetDuration().GetSeconds() );
+				continue;
+			}
+
 			Physics_SimulateEntity( list[i] );
 		}
 
@@ -69,6 +69,7 @@
 #include "dt_utlvector_send.h"
 #include "vote_controller.h"
 #include "ai_speech.h"
+#include "serverbenchmark_replay.h"
 
 #if defined USES_ECON_ITEMS
 #include "econ_wearable.h"
@@ -3779,6 +3780,11 @@ ConVar xc_crouch_debounce( "xc_crouch_debounce", "0", FCVAR_NONE );
 //-----------------------------------------------------------------------------
 void CBasePlayer::PlayerRunCommand(CUserCmd *ucmd, IMoveHelper *moveHelper)
 {
+	if ( ServerTickReplay().IsRecording() )
+	{
+		ServerTickReplay().RecordCommand( this, ucmd );
+	}
+
 	m_touchedPhysObject = false;
 
 	if ( pl.fixangle == FIXANGLE_NONE)
@@ -18,6 +18,7 @@
 #include "hintsystem.h"
 #include "SoundEmitterSystem/isoundemittersystembase.h"
 #include "util_shared.h"
+#include "player_registry.h"
 
 #if defined USES_ECON_ITEMS
 #include "game_item_schema.h"
@@ -1532,18 +1533,12 @@ int CollectPlayers( CUtlVector< T * > *playerVector, int team = TEAM_ANY, bool i
 		playerVector->RemoveAll();
 	}
 
-	for( int i=1; i<=gpGlobals->maxClients; ++i )
-	{
-		CBasePlayer *player = UTIL_PlayerByIndex( i );
-
-		if ( player == NULL )
-			continue;
+	CPlayerRegistry &registry = PlayerRegistry();
+	int count = registry.GetPlayerCount();
 
-		if ( FNullEnt( player->edict() ) )
-			continue;
-
-		if ( !player->IsPlayer() )
-			continue;
+	for( int i=0; i<count; ++i )
+	{
+		CBasePlayer *player = registry.GetPlayer( i );
 
 		if ( !player->IsConnected() )
 			continue;
@@ -1568,18 +1563,12 @@ int CollectHumanPlayers( CUtlVector< T * > *playerVector, int team = TEAM_ANY, b
 		playerVector->RemoveAll();
 	}
 
-	for( int i=1; i<=gpGlobals->maxClients; ++i )
-	{
-		CBasePlayer *player = UTIL_PlayerByIndex( i );
-
-		if ( player == NULL )
-			continue;
+	CPlayerRegistry &registry = PlayerRegistry();
+	int count = registry.GetPlayerCount();
 
-		if ( FNullEnt( player->edict() ) )
-			continue;
-
-		if ( !player->IsPlayer() )
-			continue;
+	for( int i=0; i<count; ++i )
+	{
+		CBasePlayer *player = registry.GetPlayer( i );
 
 		if ( player->IsBot() )
 			continue;
@@ -0,0 +1,149 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Dense list of the player entities in the game, kept current as they come and go
+//
+// $NoKeywords: $
+//=============================================================================//
+#include "cbase.h"
+#include "player.h"
+#include "player_registry.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar sv_player_registry( "sv_player_registry", "1", FCVAR_CHEAT, "If nonzero, player loops use a cached list of player entities instead of scanning every client slot" );
+
+static CPlayerRegistry g_PlayerRegistry;
+
+//-----------------------------------------------------------------------------
+CPlayerRegistry &PlayerRegistry( void )
+{
+	return g_PlayerRegistry;
+}
+
+//-----------------------------------------------------------------------------
+CPlayerRegistry::CPlayerRegistry( void ) : CAutoGameSystem( "CPlayerRegistry" )
+{
+	m_tick = -1;
+	m_isDirty = true;
+	m_isPositionDirty.SetAll();
+}
+
+//-----------------------------------------------------------------------------
+bool CPlayerRegistry::Init( void )
+{
+	gEntList.AddListenerEntity( this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::Shutdown( void )
+{
+	gEntList.RemoveListenerEntity( this );
+}
+
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::LevelShutdownPostEntity( void )
+{
+	m_players.Purge();
+	m_isDirty = true;
+	m_isPositionDirty.SetAll();
+}
+
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::OnEntityCreated( CBaseEntity *pEntity )
+{
+	if ( pEntity->IsPlayer() )
+	{
+		m_isDirty = true;
+		m_isPositionDirty.SetAll();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Players are deleted from their destructor, where IsPlayer() no longer
+//			answers for them, so look for the pointer instead.
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::OnEntityDeleted( CBaseEntity *pEntity )
+{
+	if ( m_players.FindAndRemove( static_cast< CBasePlayer * >( pEntity ) ) )
+	{
+		m_isDirty = true;
+		m_isPositionDirty.SetAll();
+	}
+}
+
+//-----------------------------------------------------------------------------
+int CPlayerRegistry::GetPlayerCount( void )
+{
+	if ( m_isDirty || m_tick != gpGlobals->tickcount || !sv_player_registry.GetBool() )
+	{
+		Rebuild();
+	}
+
+	return m_players.Count();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same test ForEachPlayer() and CollectPlayers() applied to each slot
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::Rebuild( void )
+{
+	m_players.RemoveAll();
+
+	for ( int i = 1; i <= gpGlobals->maxClients; ++i )
+	{
+		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
+
+		if ( pPlayer == NULL )
+			continue;
+
+		if ( FNullEnt( pPlayer->edict() ) )
+			continue;
+
+		if ( !pPlayer->IsPlayer() )
+			continue;
+
+		m_players.AddToTail( pPlayer );
+	}
+
+	m_tick = gpGlobals->tickcount;
+	m_isDirty = false;
+}
+
+//-----------------------------------------------------------------------------
+Vector CPlayerRegistry::GetEyePosition( CBasePlayer *pPlayer )
+{
+	int slot = pPlayer->entindex() - 1;
+
+	if ( slot < 0 || slot >= MAX_PLAYERS )
+	{
+		return pPlayer->GetAbsOrigin() + pPlayer->GetViewOffset();
+	}
+
+	if ( m_isPositionDirty.IsBitSet( slot ) || !sv_player_registry.GetBool() )
+	{
+		Vector vecEye = pPlayer->GetAbsOrigin();
+		vecEye += pPlayer->GetViewOffset();
+
+		m_eyeX[ slot ] = vecEye.x;
+		m_eyeY[ slot ] = vecEye.y;
+		m_eyeZ[ slot ] = vecEye.z;
+		m_isPositionDirty.Clear( slot );
+
+		return vecEye;
+	}
+
+	return Vector( m_eyeX[ slot ], m_eyeY[ slot ], m_eyeZ[ slot ] );
+}
+
+//-----------------------------------------------------------------------------
+void CPlayerRegistry::MarkPositionDirty( CBaseEntity *pPlayer )
+{
+	int slot = pPlayer->entindex() - 1;
+
+	if ( slot >= 0 && slot < MAX_PLAYERS )
+	{
+		m_isPositionDirty.Set( slot );
+	}
+}
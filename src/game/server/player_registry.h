@@ -0,0 +1,66 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Dense list of the player entities in the game, kept current as they come and go
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef PLAYER_REGISTRY_H
+#define PLAYER_REGISTRY_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+#include "bitvec.h"
+#include "shareddefs.h"
+
+class CBasePlayer;
+
+//-----------------------------------------------------------------------------
+// Replaces the 1..maxClients UTIL_PlayerByIndex() scans that player loops used to
+// do with a list that is only rebuilt when a player entity is created or deleted.
+// Connection, team and life state are deliberately not cached, since they change in
+// the middle of a tick; callers read them from the player as before.
+//-----------------------------------------------------------------------------
+class CPlayerRegistry : public CAutoGameSystem, public IEntityListener
+{
+public:
+	CPlayerRegistry( void );
+
+	// CAutoGameSystem
+	virtual bool Init( void );
+	virtual void Shutdown( void );
+	virtual void LevelShutdownPostEntity( void );
+
+	// IEntityListener
+	virtual void OnEntityCreated( CBaseEntity *pEntity );
+	virtual void OnEntityDeleted( CBaseEntity *pEntity );
+
+	// Every player UTIL_PlayerByIndex() would return, in entindex order
+	int GetPlayerCount( void );
+	CBasePlayer *GetPlayer( int i ) const	{ return m_players[i]; }
+
+	// Same as pPlayer->GetAbsOrigin() + pPlayer->GetViewOffset(), recomputed only after the player moves
+	Vector GetEyePosition( CBasePlayer *pPlayer );
+
+	// Called when a player's origin or view offset changes
+	void MarkPositionDirty( CBaseEntity *pPlayer );
+
+private:
+	void Rebuild( void );
+
+	CUtlVector< CBasePlayer * > m_players;
+	int m_tick;
+	bool m_isDirty;
+
+	// eye positions by entindex-1, valid where m_isPositionDirty is clear
+	float m_eyeX[ MAX_PLAYERS ];
+	float m_eyeY[ MAX_PLAYERS ];
+	float m_eyeZ[ MAX_PLAYERS ];
+	CBitVec< MAX_PLAYERS > m_isPositionDirty;
+};
+
+extern CPlayerRegistry &PlayerRegistry( void );
+
+#endif // PLAYER_REGISTRY_H
@@ -12,6 +12,8 @@
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+ConVar sv_player_resource_skip_empty( "sv_player_resource_skip_empty", "1", FCVAR_CHEAT, "If nonzero, the player resource only updates an empty slot when it loses its player" );
+
 // Datatable
 IMPLEMENT_SERVERCLASS_ST_NOBASE(CPlayerResource, DT_PlayerResource)
 //	SendPropArray( SendPropString( SENDINFO(m_szName[0]) ), SENDARRAYINFO(m_szName) ),
@@ -63,6 +65,7 @@ void CPlayerResource::Spawn( void )
 	SetThink( &CPlayerResource::ResourceThink );
 	SetNextThink( gpGlobals->curtime );
 	m_nUpdateCounter = 0;
+	m_isDisconnectedSlotCurrent.ClearAll();
 }
 
 void CPlayerResource::Init( int iIndex )
@@ -105,17 +108,33 @@ void CPlayerResource::ResourceThink( void )
 //-----------------------------------------------------------------------------
 void CPlayerResource::UpdatePlayerData( void )
 {
+	bool bSkipEmpty = sv_player_resource_skip_empty.GetBool() && CanSkipDisconnectedSlots();
+
+	// Index the registry's players by slot rather than asking the engine for every slot
+	CBasePlayer *pSlotPlayer[ MAX_PLAYERS_ARRAY_SAFE ];
+	V_memset( pSlotPlayer, 0, sizeof( pSlotPlayer ) );
+
+	CPlayerRegistry &registry = PlayerRegistry();
+	int nPlayerCount = registry.GetPlayerCount();
+	for ( int i = 0; i < nPlayerCount; i++ )
+	{
+		CBasePlayer *pPlayer = registry.GetPlayer( i );
+		pSlotPlayer[ pPlayer->entindex() ] = pPlayer;
+	}
+
 	for ( int i = 1; i <= MAX_PLAYERS; i++ )
 	{
-		CBasePlayer *pPlayer = (CBasePlayer*)UTIL_PlayerByIndex( i );
+		CBasePlayer *pPlayer = pSlotPlayer[i];
 		
 		if ( pPlayer && pPlayer->IsConnected() )
 		{
 			UpdateConnectedPlayer( i, pPlayer );
+			m_isDisconnectedSlotCurrent.Clear( i );
 		}
-		else
+		else if ( !bSkipEmpty || !m_isDisconnectedSlotCurrent.IsBitSet( i ) )
 		{
 			UpdateDisconnectedPlayer( i );
+			m_isDisconnectedSlotCurrent.Set( i, bSkipEmpty );
 		}
 	}
 }
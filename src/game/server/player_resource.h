@@ -12,6 +12,7 @@
 #endif
 
 #include "shareddefs.h"
+#include "bitvec.h"
 
 class CPlayerResource : public CBaseEntity
 {
@@ -32,6 +33,10 @@ protected:
 	virtual void UpdateConnectedPlayer( int iIndex, CBasePlayer *pPlayer );
 	virtual void UpdateDisconnectedPlayer( int iIndex );
 
+	// Return true while UpdateDisconnectedPlayer() would leave a slot it already updated unchanged,
+	// so empty slots are only visited when they lose their player
+	virtual bool CanSkipDisconnectedSlots( void ) { return true; }
+
 	// Data for each player that's propagated to all clients
 	// Stored in individual arrays so they can be sent down via datatables
 	CNetworkArray( int, m_iPing, MAX_PLAYERS_ARRAY_SAFE );
@@ -46,6 +51,8 @@ protected:
 	CNetworkArray( int, m_iUserID, MAX_PLAYERS_ARRAY_SAFE );
 		
 	int	m_nUpdateCounter;
+
+	CBitVec< MAX_PLAYERS_ARRAY_SAFE > m_isDisconnectedSlotCurrent;	// slots UpdateDisconnectedPlayer() has already been run on
 };
 
 extern CPlayerResource *g_pPlayerResource;
@@ -0,0 +1,239 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: List of the FL_GRENADE entities in the game with their bounds kept in flat arrays
+//
+// $NoKeywords: $
+//=============================================================================//
+#include "cbase.h"
+#include "projectile_registry.h"
+#include "tier0/vprof.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar sv_projectile_registry( "sv_projectile_registry", "1", FCVAR_CHEAT, "If nonzero, projectile sphere queries test a cached list of projectile bounds instead of walking the spatial partition" );
+
+static CProjectileRegistry g_ProjectileRegistry;
+
+//-----------------------------------------------------------------------------
+CProjectileRegistry &ProjectileRegistry( void )
+{
+	return g_ProjectileRegistry;
+}
+
+//-----------------------------------------------------------------------------
+CProjectileRegistry::CProjectileRegistry( void ) : CAutoGameSystem( "CProjectileRegistry" )
+{
+	m_isAnyBoundsDirty = false;
+
+	for ( int i = 0; i < NUM_ENT_ENTRIES; ++i )
+	{
+		m_index[i] = -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+bool CProjectileRegistry::Init( void )
+{
+	gEntList.AddListenerEntity( this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::Shutdown( void )
+{
+	gEntList.RemoveListenerEntity( this );
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::LevelShutdownPostEntity( void )
+{
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::Clear( void )
+{
+	for ( int i = 0; i < NUM_ENT_ENTRIES; ++i )
+	{
+		m_index[i] = -1;
+	}
+
+	m_projectiles.Purge();
+	m_minX.Purge();
+	m_minY.Purge();
+	m_minZ.Purge();
+	m_maxX.Purge();
+	m_maxY.Purge();
+	m_maxZ.Purge();
+	m_isBoundsDirty.Purge();
+	m_isAnyBoundsDirty = false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Flag changes aren't reported once an entity is marked for deletion,
+//			so remove by handle rather than by flag.
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::OnEntityDeleted( CBaseEntity *pEntity )
+{
+	Remove( pEntity );
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::OnFlagsChanged( CBaseEntity *pEntity, unsigned int flagsOld, unsigned int flagsNow )
+{
+	unsigned int flagsChanged = flagsOld ^ flagsNow;
+
+	if ( flagsChanged & flagsNow & FL_GRENADE )
+	{
+		Add( pEntity );
+	}
+	else if ( flagsChanged & flagsOld & FL_GRENADE )
+	{
+		Remove( pEntity );
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::MarkBoundsDirty( CBaseEntity *pEntity )
+{
+	int i = m_index[ pEntity->GetRefEHandle().GetEntryIndex() ];
+	if ( i >= 0 )
+	{
+		m_isBoundsDirty[i] = true;
+		m_isAnyBoundsDirty = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::Add( CBaseEntity *pEntity )
+{
+	int &index = m_index[ pEntity->GetRefEHandle().GetEntryIndex() ];
+	if ( index >= 0 )
+		return;
+
+	index = m_projectiles.AddToTail( pEntity );
+	m_minX.AddToTail();
+	m_minY.AddToTail();
+	m_minZ.AddToTail();
+	m_maxX.AddToTail();
+	m_maxY.AddToTail();
+	m_maxZ.AddToTail();
+	m_isBoundsDirty.AddToTail( true );
+	m_isAnyBoundsDirty = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove keeping the list in insertion order, so queries return
+//			entities in a stable order
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::Remove( CBaseEntity *pEntity )
+{
+	int &index = m_index[ pEntity->GetRefEHandle().GetEntryIndex() ];
+	if ( index < 0 )
+		return;
+
+	int i = index;
+	index = -1;
+
+	m_projectiles.Remove( i );
+	m_minX.Remove( i );
+	m_minY.Remove( i );
+	m_minZ.Remove( i );
+	m_maxX.Remove( i );
+	m_maxY.Remove( i );
+	m_maxZ.Remove( i );
+	m_isBoundsDirty.Remove( i );
+
+	for ( ; i < m_projectiles.Count(); ++i )
+	{
+		m_index[ m_projectiles[i]->GetRefEHandle().GetEntryIndex() ] = i;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same bounds CCollisionProperty::UpdatePartition() gives the partition
+//-----------------------------------------------------------------------------
+void CProjectileRegistry::UpdateBounds( int i )
+{
+	CCollisionProperty *pCollision = m_projectiles[i]->CollisionProp();
+
+	Vector vecMins, vecMaxs;
+	if ( pCollision->BoundingRadius() != 0.0f )
+	{
+		pCollision->WorldSpaceSurroundingBounds( &vecMins, &vecMaxs );
+		vecMins -= Vector( 1, 1, 1 );
+		vecMaxs += Vector( 1, 1, 1 );
+	}
+	else
+	{
+		vecMins = vecMaxs = pCollision->GetCollisionOrigin();
+	}
+
+	m_minX[i] = vecMins.x;
+	m_minY[i] = vecMins.y;
+	m_minZ[i] = vecMins.z;
+	m_maxX[i] = vecMaxs.x;
+	m_maxY[i] = vecMaxs.y;
+	m_maxZ[i] = vecMaxs.z;
+	m_isBoundsDirty[i] = false;
+}
+
+//-----------------------------------------------------------------------------
+int CProjectileRegistry::GetProjectilesInSphere( CBaseEntity **pList, int listMax, const Vector &center, float radius )
+{
+	if ( !sv_projectile_registry.GetBool() )
+	{
+		return UTIL_EntitiesInSphere( pList, listMax, center, radius, FL_GRENADE );
+	}
+
+	VPROF_BUDGET( "CProjectileRegistry::GetProjectilesInSphere", VPROF_BUDGETGROUP_GAME );
+
+	int nProjectiles = m_projectiles.Count();
+
+	if ( m_isAnyBoundsDirty )
+	{
+		for ( int i = 0; i < nProjectiles; ++i )
+		{
+			if ( m_isBoundsDirty[i] )
+			{
+				UpdateBounds( i );
+			}
+		}
+		m_isAnyBoundsDirty = false;
+	}
+
+	const float *pMinX = m_minX.Base();
+	const float *pMinY = m_minY.Base();
+	const float *pMinZ = m_minZ.Base();
+	const float *pMaxX = m_maxX.Base();
+	const float *pMaxY = m_maxY.Base();
+	const float *pMaxZ = m_maxZ.Base();
+	float flRadiusSqr = radius * radius;
+
+	int count = 0;
+	for ( int i = 0; i < nProjectiles && count < listMax; ++i )
+	{
+		// squared distance from the center to the box
+		float dx = fpmax( fpmax( pMinX[i] - center.x, center.x - pMaxX[i] ), 0.0f );
+		float dy = fpmax( fpmax( pMinY[i] - center.y, center.y - pMaxY[i] ), 0.0f );
+		float dz = fpmax( fpmax( pMinZ[i] - center.z, center.z - pMaxZ[i] ), 0.0f );
+
+		if ( dx * dx + dy * dy + dz * dz > flRadiusSqr )
+			continue;
+
+		// only what the partition would hold
+		CBaseEntity *pEntity = m_projectiles[i];
+		if ( !pEntity->edict() )
+			continue;
+
+		CCollisionProperty *pCollision = pEntity->CollisionProp();
+		if ( !pCollision->IsSolid() && !pCollision->IsSolidFlagSet( FSOLID_TRIGGER ) && !pEntity->IsEFlagSet( EFL_USE_PARTITION_WHEN_NOT_SOLID ) )
+			continue;
+
+		pList[ count++ ] = pEntity;
+	}
+
+	return count;
+}
@@ -0,0 +1,68 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: List of the FL_GRENADE entities in the game with their bounds kept in flat arrays
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef PROJECTILE_REGISTRY_H
+#define PROJECTILE_REGISTRY_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+
+//-----------------------------------------------------------------------------
+// Answers UTIL_EntitiesInSphere( ..., FL_GRENADE ) queries from a list that is
+// kept current as FL_GRENADE is added and removed, testing the sphere against
+// bounds stored one component per array so the test is a single tight loop.
+// Bounds are refreshed only for entries whose collision bounds have changed.
+//-----------------------------------------------------------------------------
+class CProjectileRegistry : public CAutoGameSystem, public IEntityListener
+{
+public:
+	CProjectileRegistry( void );
+
+	// CAutoGameSystem
+	virtual bool Init( void );
+	virtual void Shutdown( void );
+	virtual void LevelShutdownPostEntity( void );
+
+	// IEntityListener
+	virtual void OnEntityDeleted( CBaseEntity *pEntity );
+
+	// Called when an entity's flags change
+	void OnFlagsChanged( CBaseEntity *pEntity, unsigned int flagsOld, unsigned int flagsNow );
+
+	// Called when an entity's collision bounds change
+	void MarkBoundsDirty( CBaseEntity *pEntity );
+
+	// Same entities as UTIL_EntitiesInSphere( pList, listMax, center, radius, FL_GRENADE ), in the order they gained FL_GRENADE
+	int GetProjectilesInSphere( CBaseEntity **pList, int listMax, const Vector &center, float radius );
+
+private:
+	void Add( CBaseEntity *pEntity );
+	void Remove( CBaseEntity *pEntity );
+	void UpdateBounds( int i );
+	void Clear( void );
+
+	CUtlVector< CBaseEntity * > m_projectiles;
+
+	// bounds as the spatial partition sees them, valid where m_isBoundsDirty is false
+	CUtlVector< float > m_minX;
+	CUtlVector< float > m_minY;
+	CUtlVector< float > m_minZ;
+	CUtlVector< float > m_maxX;
+	CUtlVector< float > m_maxY;
+	CUtlVector< float > m_maxZ;
+	CUtlVector< bool > m_isBoundsDirty;
+	bool m_isAnyBoundsDirty;
+
+	// index into m_projectiles by entity handle entry, or -1
+	int m_index[ NUM_ENT_ENTRIES ];
+};
+
+extern CProjectileRegistry &ProjectileRegistry( void );
+
+#endif // PROJECTILE_REGISTRY_H
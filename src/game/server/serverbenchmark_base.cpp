@@ -6,6 +6,9 @@
 
 #include "cbase.h"
 #include "serverbenchmark_base.h"
+#include "serverbenchmark_replay.h"
+#include "tick_time_stats.h"
+#include "movehelper_server.h"
 #include "props.h"
 #include "filesystem.h"
 #include "tier0/icommandline.h"
@@ -19,6 +22,7 @@
 // Don't start measuring for the first N ticks to account for HD load.
 
 static ConVar sv_benchmark_numticks( "sv_benchmark_numticks", "3300", 0, "If > 0, then it only runs the benchmark for this # of ticks." );
+static ConVar sv_benchmark_replay( "sv_benchmark_replay", "", 0, "If set, the benchmark puts in a bot for each player in this sv_benchmark_record recording and runs their recorded commands until it ends, instead of sv_benchmark_numticks of its own bots." );
 static ConVar sv_benchmark_autovprofrecord( "sv_benchmark_autovprofrecord", "0", 0, "If running a benchmark and this is set, it will record a vprof file over the duration of the benchmark with filename benchmark.vprof." );
 
 static float s_flBenchmarkStartWaitSeconds = 3;	// Wait this many seconds after level load before starting the benchmark.
@@ -49,6 +53,7 @@ public:
 	CServerBenchmark()
 	{
 		m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
+		m_bReplay = false;
 		
 		// The benchmark should always have the same seed and do exactly the same thing on the same ticks.
 		m_RandomStream.SetSeed( 1111 ); 
@@ -88,6 +93,24 @@ public:
 		m_nBotsCreated = 0;
 		m_nStartWaitCounter = -1;
 
+		m_bReplay = false;
+		ServerTickReplay().StopReplay();
+		if ( sv_benchmark_replay.GetString()[0] )
+		{
+			if ( !ServerTickReplay().StartReplay( sv_benchmark_replay.GetString() ) )
+			{
+				m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
+				return false;
+			}
+
+			m_bReplay = true;
+		}
+
+		for ( int i = 0; i < MAX_PLAYERS; i++ )
+		{
+			m_ReplayBots[i] = NULL;
+		}
+
 		// Setup the benchmark environment.
 		engine->SetDedicatedServerBenchmarkMode( true );	// Run 1 tick per frame and ignore all timing stuff.
 
@@ -123,6 +146,7 @@ public:
 				m_BenchmarkState = BENCHMARKSTATE_RUNNING;
 
 				StartVProfRecord();
+				TickTimeStats().Reset();
 
 				RandomSeed( 0 );
 				m_RandomStream.SetSeed( 0 );
@@ -132,6 +156,17 @@ public:
 		int nTicksRunSoFar = gpGlobals->tickcount - m_nBenchmarkStartTick;
 		UpdateBenchmarkCounter();
 	
+		if ( m_bReplay )
+		{
+			if ( !UpdateReplay() )
+			{
+				EndVProfRecord();
+				OutputResults();
+				EndBenchmark();
+			}
+			return;
+		}
+
 		// Are we finished with the benchmark?
 		if ( nTicksRunSoFar >= sv_benchmark_numticks.GetInt() )
 		{
@@ -186,6 +221,59 @@ public:
 		
 		m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
 		engine->SetDedicatedServerBenchmarkMode( false );
+
+		ServerTickReplay().StopReplay();
+		m_bReplay = false;
+	}
+
+	// Run the recorded commands for this tick, false once the recording has run out.
+	bool UpdateReplay()
+	{
+		if ( !ServerTickReplay().ReadTick( &m_ReplayCommands ) )
+			return false;
+
+		for ( int i=0; i < m_ReplayCommands.Count(); i++ )
+		{
+			TickReplayCommand_t &command = m_ReplayCommands[i];
+
+			CBasePlayer *pBot = m_ReplayBots[ command.m_iPlayerSlot ];
+			if ( !pBot )
+			{
+				pBot = CServerBenchmarkHook::s_pBenchmarkHook->CreateBot();
+				if ( !pBot )
+					continue;
+
+				m_ReplayBots[ command.m_iPlayerSlot ] = pBot;
+				command.m_bTeamChanged = true;
+				++m_nBotsCreated;
+			}
+
+			if ( command.m_bTeamChanged )
+			{
+				CServerBenchmarkHook::s_pBenchmarkHook->SetupReplayBot( pBot, command.m_iTeam, command.m_iClass );
+			}
+
+			RunReplayCommand( pBot, command.m_cmd );
+		}
+
+		return true;
+	}
+
+	// Same as the bots run their own commands.
+	void RunReplayCommand( CBasePlayer *pBot, CUserCmd &cmd )
+	{
+		float flOldFrametime = gpGlobals->frametime;
+		float flOldCurtime = gpGlobals->curtime;
+
+		pBot->SetTimeBase( gpGlobals->curtime );
+
+		MoveHelperServer()->SetHost( pBot );
+		pBot->PlayerRunCommand( &cmd, MoveHelperServer() );
+		pBot->SetLastUserCommand( cmd );
+		pBot->pl.fixangle = FIXANGLE_NONE;
+
+		gpGlobals->frametime = flOldFrametime;
+		gpGlobals->curtime = flOldCurtime;
 	}
 
 	virtual bool IsLocalBenchmarkPlayer( CBasePlayer *pPlayer )
@@ -297,6 +385,11 @@ public:
 		return (m_BenchmarkState == BENCHMARKSTATE_RUNNING);
 	}
 
+	virtual bool IsReplayRunning()
+	{
+		return (m_BenchmarkState == BENCHMARKSTATE_RUNNING) && m_bReplay;
+	}
+
 	virtual int GetTickOffset()
 	{
 		if ( m_BenchmarkState == BENCHMARKSTATE_RUNNING )
@@ -329,12 +422,18 @@ public:
 	void OutputResults()
 	{
 		float flRunTime = Benchmark_ValidTime() - m_fl_ValidTime_BenchmarkStartTime;
+		int nTicks = m_bReplay ? ServerTickReplay().GetRecordedTicks() : sv_benchmark_numticks.GetInt();
 
 		Warning( "------------------ SERVER BENCHMARK RESULTS ------------------\n" );
+		if ( m_bReplay )
+		{
+			Warning( "Replay              : %s, %d players\n", sv_benchmark_replay.GetString(), m_nBotsCreated );
+		}
 		Warning( "Total time          : %.2f seconds\n", flRunTime );
-		Warning( "Num ticks simulated : %d\n", sv_benchmark_numticks.GetInt() );
-		Warning( "Ticks per second    : %.2f\n", sv_benchmark_numticks.GetInt() / flRunTime );
+		Warning( "Num ticks simulated : %d\n", nTicks );
+		Warning( "Ticks per second    : %.2f\n", nTicks / flRunTime );
 		Warning( "Benchmark CRC       : %d\n", CalculateBenchmarkCRC() );
+		TickTimeStats().PrintStats();
 		Warning( "--------------------------------------------------------------\n" );
 	}
 
@@ -394,6 +493,10 @@ private:
 	CUtlVector<char*> m_PhysicsModelNames;
 	int m_nBenchmarkMode;
 
+	bool m_bReplay;
+	CHandle< CBasePlayer > m_ReplayBots[ MAX_PLAYERS ];	// by recorded player slot
+	CUtlVector< TickReplayCommand_t > m_ReplayCommands;
+
 	CUniformRandomStream m_RandomStream;
 };
 
@@ -18,8 +18,9 @@ public:
 	virtual bool StartBenchmark() = 0;
 	virtual void UpdateBenchmark() = 0;
 	virtual void EndBenchmark() = 0;
-	
+
 	virtual bool IsBenchmarkRunning() = 0;
+	virtual bool IsReplayRunning() = 0;	// running on commands from sv_benchmark_replay
 	virtual bool IsLocalBenchmarkPlayer( CBasePlayer *pPlayer ) = 0;
 
 	// Game-specific benchmark code should use this.
@@ -56,8 +57,15 @@ public:
 	// If you want to manage the bots yourself, you can return NULL here.
 	virtual CBasePlayer* CreateBot() = 0;
 
+	// For tick recordings. The class is whatever the game uses to tell its player classes apart.
+	virtual int GetReplayPlayerClass( CBasePlayer *pPlayer ) { return 0; }
+
+	// The replay calls this the first time a recorded player runs a command, and when their team or class changes.
+	virtual void SetupReplayBot( CBasePlayer *pBot, int iTeam, int iClass ) { pBot->ChangeTeam( iTeam ); }
+
 private:
 	friend class CServerBenchmark;
+	friend class CServerTickReplay;
 	static CServerBenchmarkHook *s_pBenchmarkHook; // There can be only one!!
 };
 
@@ -0,0 +1,345 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Record the commands players run on a live server so the server
+//			benchmark can replay them offline
+//
+// sv_benchmark_record captures every command the players run, bots included, along
+// with each player's team and class. Setting sv_benchmark_replay to the recording's
+// name makes the server benchmark put a bot in for each recorded player and run the
+// recorded commands on them tick by tick instead of spawning its own bots.
+//
+//=============================================================================
+#include "cbase.h"
+#include "serverbenchmark_base.h"
+#include "serverbenchmark_replay.h"
+#include "filesystem.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define TICK_REPLAY_VERSION		1
+
+struct TickReplayHeader_t
+{
+	int		m_nVersion;
+	int		m_nCommandSize;				// the command deltas depend on CUserCmd, so only replay with the build that wrote them
+	int		m_nSeed;
+	int		m_nTicks;
+	float	m_flTickInterval;
+	char	m_szMap[ MAX_MAP_NAME ];
+};
+
+static CServerTickReplay g_ServerTickReplay;
+
+//-----------------------------------------------------------------------------
+CServerTickReplay &ServerTickReplay( void )
+{
+	return g_ServerTickReplay;
+}
+
+//-----------------------------------------------------------------------------
+CServerTickReplay::CServerTickReplay( void ) : CAutoGameSystemPerFrame( "CServerTickReplay" )
+{
+	m_mode = MODE_NONE;
+	Reset();
+}
+
+//-----------------------------------------------------------------------------
+void CServerTickReplay::Reset( void )
+{
+	m_data.Purge();
+	m_nSeed = 0;
+	m_nTick = 0;
+	m_nRecordedTicks = 0;
+	m_nTickCommands = 0;
+	m_tickBits.StartWriting( m_tickData, sizeof( m_tickData ) );
+
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		m_lastCmd[i].Reset();
+		m_lastTeam[i] = -1;
+		m_lastClass[i] = -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CServerTickReplay::LevelShutdownPreEntity( void )
+{
+	// a recording is only good for the map it was made on
+	StopRecording();
+	StopReplay();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Make the global random stream the same on each tick of the replay
+//			as it was on the same tick of the recording
+//-----------------------------------------------------------------------------
+void CServerTickReplay::FrameUpdatePreEntityThink( void )
+{
+	if ( m_mode != MODE_NONE )
+	{
+		RandomSeed( m_nSeed + m_nTick );
+	}
+}
+
+//-----------------------------------------------------------------------------
+void CServerTickReplay::FrameUpdatePostEntityThink( void )
+{
+	if ( m_mode != MODE_RECORDING )
+		return;
+
+	if ( m_tickBits.IsOverflowed() )
+	{
+		Warning( "Too many commands in one tick, stopping the tick recording\n" );
+		StopRecording();
+		return;
+	}
+
+	m_data.PutUnsignedShort( m_nTickCommands );
+	m_data.PutUnsignedShort( m_tickBits.GetNumBytesWritten() );
+	m_data.Put( m_tickData, m_tickBits.GetNumBytesWritten() );
+
+	m_tickBits.Reset();
+	m_nTickCommands = 0;
+	++m_nTick;
+}
+
+//-----------------------------------------------------------------------------
+bool CServerTickReplay::StartRecording( const char *pszName )
+{
+	if ( m_mode != MODE_NONE )
+	{
+		Warning( "Already recording or replaying\n" );
+		return false;
+	}
+
+	Reset();
+	m_name = pszName;
+	m_nSeed = RandomInt( 0, 0x3fffffff );
+	m_mode = MODE_RECORDING;
+
+	Msg( "Recording ticks to '%s'\n", pszName );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CServerTickReplay::StopRecording( void )
+{
+	if ( m_mode != MODE_RECORDING )
+		return;
+
+	m_mode = MODE_NONE;
+
+	TickReplayHeader_t header;
+	V_memset( &header, 0, sizeof( header ) );
+	header.m_nVersion = TICK_REPLAY_VERSION;
+	header.m_nCommandSize = sizeof( CUserCmd );
+	header.m_nSeed = m_nSeed;
+	header.m_nTicks = m_nTick;
+	header.m_flTickInterval = gpGlobals->interval_per_tick;
+	V_strncpy( header.m_szMap, STRING( gpGlobals->mapname ), sizeof( header.m_szMap ) );
+
+	CUtlBuffer buf;
+	buf.Put( &header, sizeof( header ) );
+	buf.Put( m_data.Base(), m_data.TellMaxPut() );
+
+	char filename[ MAX_PATH ];
+	V_snprintf( filename, sizeof( filename ), "%s/%s.%s", TICK_REPLAY_PATH, m_name.Get(), TICK_REPLAY_EXTENSION );
+
+	filesystem->CreateDirHierarchy( TICK_REPLAY_PATH, "MOD" );
+	if ( !filesystem->WriteFile( filename, "MOD", buf ) )
+	{
+		Warning( "Unable to write '%s'\n", filename );
+	}
+	else
+	{
+		Msg( "Wrote %d ticks (%d bytes) to '%s'\n", m_nTick, buf.TellMaxPut(), filename );
+	}
+
+	Reset();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called from CBasePlayer::PlayerRunCommand() before the command runs
+//-----------------------------------------------------------------------------
+void CServerTickReplay::RecordCommand( CBasePlayer *pPlayer, const CUserCmd *pCmd )
+{
+	int slot = pPlayer->entindex() - 1;
+	if ( slot < 0 || slot >= MAX_PLAYERS )
+		return;
+
+	int iTeam = pPlayer->GetTeamNumber();
+	int iClass = CServerBenchmarkHook::s_pBenchmarkHook ? CServerBenchmarkHook::s_pBenchmarkHook->GetReplayPlayerClass( pPlayer ) : 0;
+	bool bTeamChanged = ( iTeam != m_lastTeam[ slot ] || iClass != m_lastClass[ slot ] );
+
+	m_tickBits.WriteUBitLong( slot, 8 );
+	m_tickBits.WriteOneBit( bTeamChanged );
+	if ( bTeamChanged )
+	{
+		m_tickBits.WriteUBitLong( iTeam, 8 );
+		m_tickBits.WriteUBitLong( iClass, 8 );
+		m_lastTeam[ slot ] = iTeam;
+		m_lastClass[ slot ] = iClass;
+	}
+
+	WriteUsercmd( &m_tickBits, pCmd, &m_lastCmd[ slot ] );
+
+	// filled in by the server, so not part of the delta
+	m_tickBits.WriteUBitLong( pCmd->server_random_seed, 32 );
+
+	m_lastCmd[ slot ] = *pCmd;
+	++m_nTickCommands;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Load a recording, rejecting ones written by a different build or on a different map
+//-----------------------------------------------------------------------------
+bool CServerTickReplay::StartReplay( const char *pszName )
+{
+	if ( m_mode != MODE_NONE )
+	{
+		Warning( "Already recording or replaying\n" );
+		return false;
+	}
+
+	Reset();
+
+	char filename[ MAX_PATH ];
+	V_snprintf( filename, sizeof( filename ), "%s/%s.%s", TICK_REPLAY_PATH, pszName, TICK_REPLAY_EXTENSION );
+
+	if ( !filesystem->ReadFile( filename, "MOD", m_data ) )
+	{
+		Warning( "%s: unable to read\n", filename );
+		return false;
+	}
+
+	TickReplayHeader_t header;
+	if ( m_data.TellMaxPut() < (int)sizeof( header ) )
+	{
+		Warning( "%s: truncated\n", filename );
+		Reset();
+		return false;
+	}
+
+	m_data.Get( &header, sizeof( header ) );
+
+	if ( header.m_nVersion != TICK_REPLAY_VERSION || header.m_nCommandSize != (int)sizeof( CUserCmd ) )
+	{
+		Warning( "%s: written by a different build\n", filename );
+		Reset();
+		return false;
+	}
+
+	if ( V_stricmp( header.m_szMap, STRING( gpGlobals->mapname ) ) )
+	{
+		Warning( "%s: recorded on %s\n", filename, header.m_szMap );
+		Reset();
+		return false;
+	}
+
+	if ( header.m_flTickInterval != gpGlobals->interval_per_tick )
+	{
+		Warning( "%s: recorded at a tick interval of %f, the server is running at %f\n", filename, header.m_flTickInterval, gpGlobals->interval_per_tick );
+	}
+
+	m_name = pszName;
+	m_nSeed = header.m_nSeed;
+	m_nRecordedTicks = header.m_nTicks;
+	m_mode = MODE_REPLAYING;
+
+	Msg( "Replaying %d ticks from '%s'\n", m_nRecordedTicks, filename );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+void CServerTickReplay::StopReplay( void )
+{
+	if ( m_mode != MODE_REPLAYING )
+		return;
+
+	m_mode = MODE_NONE;
+	Reset();
+}
+
+//-----------------------------------------------------------------------------
+bool CServerTickReplay::ReadTick( CUtlVector< TickReplayCommand_t > *pCommands )
+{
+	pCommands->RemoveAll();
+
+	if ( m_mode != MODE_REPLAYING || m_nTick >= m_nRecordedTicks || m_data.GetBytesRemaining() < 4 )
+		return false;
+
+	int nCommands = m_data.GetUnsignedShort();
+	int nBytes = m_data.GetUnsignedShort();
+
+	if ( m_data.GetBytesRemaining() < nBytes )
+	{
+		Warning( "Tick recording is truncated at tick %d\n", m_nTick );
+		return false;
+	}
+
+	bf_read bits( m_data.PeekGet(), nBytes );
+	m_data.SeekGet( CUtlBuffer::SEEK_CURRENT, nBytes );
+
+	for ( int i = 0; i < nCommands; ++i )
+	{
+		TickReplayCommand_t &command = pCommands->Element( pCommands->AddToTail() );
+
+		int slot = bits.ReadUBitLong( 8 );
+		if ( slot >= MAX_PLAYERS )
+		{
+			Warning( "Tick recording is corrupt at tick %d\n", m_nTick );
+			pCommands->RemoveAll();
+			return false;
+		}
+
+		command.m_iPlayerSlot = slot;
+		command.m_bTeamChanged = bits.ReadOneBit() != 0;
+		if ( command.m_bTeamChanged )
+		{
+			m_lastTeam[ slot ] = bits.ReadUBitLong( 8 );
+			m_lastClass[ slot ] = bits.ReadUBitLong( 8 );
+		}
+		command.m_iTeam = m_lastTeam[ slot ];
+		command.m_iClass = m_lastClass[ slot ];
+
+		ReadUsercmd( &bits, &command.m_cmd, &m_lastCmd[ slot ] );
+		command.m_cmd.server_random_seed = bits.ReadUBitLong( 32 );
+
+		m_lastCmd[ slot ] = command.m_cmd;
+	}
+
+	++m_nTick;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_benchmark_record, "Record the commands all players run, for replay with sv_benchmark_replay. Arguments: <name>" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: sv_benchmark_record <name>\n" );
+		return;
+	}
+
+	ServerTickReplay().StartRecording( args[1] );
+}
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_benchmark_record_stop, "Stop recording and write the file" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( !ServerTickReplay().IsRecording() )
+	{
+		Msg( "Not recording\n" );
+		return;
+	}
+
+	ServerTickReplay().StopRecording();
+}
@@ -0,0 +1,96 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Record the commands players run on a live server so the server
+//			benchmark can replay them offline
+//
+//=============================================================================
+
+#ifndef SERVERBENCHMARK_REPLAY_H
+#define SERVERBENCHMARK_REPLAY_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+#include "usercmd.h"
+#include "tier1/bitbuf.h"
+#include "tier1/utlbuffer.h"
+
+#define TICK_REPLAY_PATH		"benchmark"
+#define TICK_REPLAY_EXTENSION	"ticks"
+
+// Largest amount of command data recorded for a single tick
+#define TICK_REPLAY_MAX_TICK_BYTES	65535
+
+// One command as read back from a recording
+struct TickReplayCommand_t
+{
+	int			m_iPlayerSlot;		// entindex - 1 of the player that ran it
+	bool		m_bTeamChanged;		// first command from this player, or their team or class changed since the last one
+	int			m_iTeam;
+	int			m_iClass;
+	CUserCmd	m_cmd;
+};
+
+//-----------------------------------------------------------------------------
+// Records every command run through CBasePlayer::PlayerRunCommand(), bots
+// included, delta compressed the way the engine sends them, grouped by tick.
+// The global random stream is reseeded every tick from a seed stored in the
+// recording, so the replay can reseed it the same way.
+//-----------------------------------------------------------------------------
+class CServerTickReplay : public CAutoGameSystemPerFrame
+{
+public:
+	CServerTickReplay( void );
+
+	// CAutoGameSystemPerFrame
+	virtual void LevelShutdownPreEntity( void );
+	virtual void FrameUpdatePreEntityThink( void );
+	virtual void FrameUpdatePostEntityThink( void );
+
+	// Recording on a live server
+	bool StartRecording( const char *pszName );
+	void StopRecording( void );
+	bool IsRecording( void ) const { return m_mode == MODE_RECORDING; }
+	void RecordCommand( CBasePlayer *pPlayer, const CUserCmd *pCmd );
+
+	// Replaying, driven by the server benchmark
+	bool StartReplay( const char *pszName );
+	void StopReplay( void );
+	bool IsReplaying( void ) const { return m_mode == MODE_REPLAYING; }
+	int GetRecordedTicks( void ) const { return m_nRecordedTicks; }
+
+	// The commands for the next tick in the recording, false once there are none left
+	bool ReadTick( CUtlVector< TickReplayCommand_t > *pCommands );
+
+private:
+	void Reset( void );
+
+	enum ReplayMode_t
+	{
+		MODE_NONE,
+		MODE_RECORDING,
+		MODE_REPLAYING
+	};
+	ReplayMode_t m_mode;
+
+	CUtlString m_name;
+	CUtlBuffer m_data;
+	int m_nSeed;
+	int m_nTick;
+	int m_nRecordedTicks;
+
+	// each player's last command, which the next one is delta compressed against
+	CUserCmd m_lastCmd[ MAX_PLAYERS ];
+	int m_lastTeam[ MAX_PLAYERS ];
+	int m_lastClass[ MAX_PLAYERS ];
+
+	// the commands run so far this tick
+	bf_write m_tickBits;
+	int m_nTickCommands;
+	unsigned char m_tickData[ TICK_REPLAY_MAX_TICK_BYTES ];
+};
+
+extern CServerTickReplay &ServerTickReplay( void );
+
+#endif // SERVERBENCHMARK_REPLAY_H
@@ -237,7 +237,10 @@ ActionResult< CTFBot > CTFBotDeliverFlag::Update( CTFBot *me, float interval )
 		}
 
 		CTFBotPathCost cost( me, FASTEST_ROUTE );
-		m_path.Compute( me, zone->WorldSpaceCenter(), cost );
+		if ( !TheTFNavMesh()->GetFlowFields()->ComputePath( me, &m_path, zone->WorldSpaceCenter() ) )
+		{
+			m_path.Compute( me, zone->WorldSpaceCenter(), cost );
+		}
 
 		float flOldTravelDistance = m_flTotalTravelDistance;
 
@@ -382,7 +385,10 @@ ActionResult< CTFBot > CTFBotPushToCapturePoint::Update( CTFBot *me, float inter
 	if ( m_repathTimer.IsElapsed() )
 	{
 		CTFBotPathCost cost( me, FASTEST_ROUTE );
-		m_path.Compute( me, zone->WorldSpaceCenter(), cost );
+		if ( !TheTFNavMesh()->GetFlowFields()->ComputePath( me, &m_path, zone->WorldSpaceCenter() ) )
+		{
+			m_path.Compute( me, zone->WorldSpaceCenter(), cost );
+		}
 
 		m_repathTimer.Start( RandomFloat( 1.0f, 2.0f ) );
 	}
@@ -18,6 +18,7 @@
 #include "tf_weapon_compound_bow.h"
 #include "bot/tf_bot.h"
 #include "bot/tf_bot_manager.h"
+#include "bot/tf_bot_threat_field.h"
 #include "bot/behavior/tf_bot_behavior.h"
 #include "bot/behavior/tf_bot_dead.h"
 #include "NextBot/NavMeshEntities/func_nav_prerequisite.h"
@@ -880,7 +881,7 @@ bool CTFBotMainAction::IsImmediateThreat( const CBaseCombatCharacter *subject, c
 		return false;
 
 	// if they can't hurt me, they aren't an immediate threat
-	if ( !me->IsLineOfFireClear( threat->GetEntity() ) )
+	if ( !TheTFBotThreatField().IsLineOfFireClear( me, threat->GetEntity() ) )
 		return false;
 
 	CTFPlayer *threatPlayer = ToTFPlayer( threat->GetEntity() );
@@ -21,6 +21,7 @@
 #include "tier3/tier3.h"
 #include "vgui/ILocalize.h"
 #include "econ_item_system.h"
+#include "tier1/UtlStringMap.h"
 #include "bot/behavior/tf_bot_use_item.h"
 #include "tf_wearable_weapons.h"
 #include "tf_weapon_buff_item.h"
@@ -4894,13 +4895,67 @@ void CTFBot::OnEventChangeAttributes( const CTFBot::EventChangeAttributes_t* pEv
 }
 
 
+// What each item name given to bots matched in the item schema
+struct BotItemMatch_t
+{
+	item_definition_index_t m_itemDefIndex;
+	int m_matchCount;
+};
+static CUtlStringMap< BotItemMatch_t > s_botItemMatches( false );
+static uint32 s_botItemMatchesSchemaGeneration = 0;
+
+static void BuildBotItemCriteria( CItemSelectionCriteria *pCriteria, const char* pszItemName )
+{
+	pCriteria->SetQuality( AE_USE_SCRIPT_VALUE );
+	pCriteria->BAddCondition( "name", k_EOperator_String_EQ, pszItemName, true );
+}
+
+static const BotItemMatch_t &FindBotItemMatch( const char* pszItemName )
+{
+	if ( s_botItemMatchesSchemaGeneration != GEconItemSchema().GetResetCount() )
+	{
+		s_botItemMatches.Purge();
+		s_botItemMatchesSchemaGeneration = GEconItemSchema().GetResetCount();
+	}
+
+	UtlSymId_t id = s_botItemMatches.Find( pszItemName );
+	if ( id != s_botItemMatches.InvalidIndex() )
+		return s_botItemMatches[ id ];
+
+	CItemSelectionCriteria criteria;
+	BuildBotItemCriteria( &criteria, pszItemName );
+
+	BotItemMatch_t &match = s_botItemMatches[ pszItemName ];
+	match.m_itemDefIndex = ItemSystem()->FindUniqueItemMatchingCriteria( &criteria, &match.m_matchCount );
+	return match;
+}
+
+
+bool CTFBot::PrecacheItem( const char* pszItemName )
+{
+	if ( !pszItemName || !pszItemName[0] )
+		return false;
+
+	return FindBotItemMatch( pszItemName ).m_matchCount > 0;
+}
+
+
 void CTFBot::AddItem( const char* pszItemName )
 {
 	CItemSelectionCriteria criteria;
-	criteria.SetQuality( AE_USE_SCRIPT_VALUE );
-	criteria.BAddCondition( "name", k_EOperator_String_EQ, pszItemName, true );
+	BuildBotItemCriteria( &criteria, pszItemName );
 
-	CBaseEntity *pItem = ItemGeneration()->GenerateRandomItem( &criteria, WorldSpaceCenter(), vec3_angle );
+	CBaseEntity *pItem = NULL;
+	const BotItemMatch_t &match = FindBotItemMatch( pszItemName ? pszItemName : "" );
+	if ( match.m_matchCount == 1 )
+	{
+		pItem = ItemGeneration()->GenerateItemFromCriteria( match.m_itemDefIndex, &criteria, WorldSpaceCenter(), vec3_angle );
+	}
+	else if ( match.m_matchCount > 1 )
+	{
+		// several items share this name, pick one at random as always
+		pItem = ItemGeneration()->GenerateRandomItem( &criteria, WorldSpaceCenter(), vec3_angle );
+	}
 	if ( pItem )
 	{
 		CEconItemView *pScriptItem = static_cast< CBaseCombatWeapon * >( pItem )->GetAttributeContainer()->GetItem();
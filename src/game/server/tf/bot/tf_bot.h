@@ -483,6 +483,10 @@ public:
 
 	void AddItem( const char* pszItemName );
 
+	// Matching an item by name tests every item in the schema, so the result is kept until the schema
+	// changes. Population files resolve their items up front; returns false if the name matches no item.
+	static bool PrecacheItem( const char* pszItemName );
+
 	int GetUberHealthThreshold();
 	float GetUberDeployDelayDuration();
 
@@ -11,6 +11,7 @@
 #include "Player/NextBotPlayer.h"
 #include "team.h"
 #include "tf_bot.h"
+#include "tf_bot_threat_field.h"
 #include "tf_gamerules.h"
 #include "bot/map_entities/tf_bot_hint.h"
 #include "bot/map_entities/tf_bot_hint_sentrygun.h"
@@ -28,6 +29,7 @@ ConVar tf_bot_quota_mode( "tf_bot_quota_mode", "normal", FCVAR_NONE, "Determines
 ConVar tf_bot_join_after_player( "tf_bot_join_after_player", "1", FCVAR_NONE, "If nonzero, bots wait until a player joins before entering the game." );
 ConVar tf_bot_auto_vacate( "tf_bot_auto_vacate", "1", FCVAR_NONE, "If nonzero, bots will automatically leave to make room for human players." );
 ConVar tf_bot_offline_practice( "tf_bot_offline_practice", "0", FCVAR_NONE, "Tells the server that it is in offline practice mode." );
+ConVar tf_bot_threat_field_debug( "tf_bot_threat_field_debug", "0", FCVAR_CHEAT, "Draw the nav areas containing bots of the given team, shaded by how many enemies can potentially see them" );
 ConVar tf_bot_melee_only( "tf_bot_melee_only", "0", FCVAR_GAMEDLL, "If nonzero, TFBots will only use melee weapons" );
 
 extern const char *GetRandomBotName( void );
@@ -111,6 +113,8 @@ void CTFBotManager::OnMapLoaded( void )
 	NextBotManager::OnMapLoaded();
 
 	ClearStuckBotData();
+
+	TheTFBotThreatField().Reset();
 }
 
 
@@ -155,6 +159,11 @@ void CTFBotManager::Update()
 
 	DrawStuckBotData();
 
+	if ( tf_bot_threat_field_debug.GetInt() )
+	{
+		TheTFBotThreatField().DrawDanger( tf_bot_threat_field_debug.GetInt() );
+	}
+
 #ifdef TF_CREEP_MODE
 	UpdateCreepWaves();
 #endif
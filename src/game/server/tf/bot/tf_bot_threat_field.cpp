@@ -0,0 +1,281 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_bot_threat_field.cpp
+// Per-team sensing data shared by all TFBots on a team
+
+#include "cbase.h"
+#include "vprof.h"
+#include "nav_mesh.h"
+#include "tf_player.h"
+#include "tf_bot.h"
+#include "tf_bot_threat_field.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar tf_bot_threat_field( "tf_bot_threat_field", "1", FCVAR_CHEAT, "If nonzero, TFBots share nav visibility and line of fire results computed once per tick for their team" );
+
+
+//----------------------------------------------------------------------------------------------
+CTFBotThreatField &TheTFBotThreatField( void )
+{
+	static CTFBotThreatField field;
+	return field;
+}
+
+
+//----------------------------------------------------------------------------------------------
+CTFBotThreatField::CTFBotThreatField( void )
+{
+	Reset();
+}
+
+
+//----------------------------------------------------------------------------------------------
+void CTFBotThreatField::Reset( void )
+{
+	m_tick = -1;
+
+	for( int t=0; t<TF_TEAM_COUNT; ++t )
+	{
+		TeamField &field = m_team[t];
+
+		field.m_botAreaVector.RemoveAll();
+		field.m_botAreaMap.RemoveAll();
+		field.m_dangerVector.RemoveAll();
+		field.m_wordsPerSubject = 0;
+		field.m_subjectMap.RemoveAll();
+		field.m_subjectVector.RemoveAll();
+		field.m_visibleBits.RemoveAll();
+	}
+
+	m_lineOfFireMap.RemoveAll();
+}
+
+
+//----------------------------------------------------------------------------------------------
+void CTFBotThreatField::Update( void )
+{
+	if ( m_tick == gpGlobals->tickcount )
+		return;
+
+	VPROF_BUDGET( "CTFBotThreatField::Update", "NextBot" );
+
+	Reset();
+	m_tick = gpGlobals->tickcount;
+
+	for( int t=FIRST_GAME_TEAM; t<TF_TEAM_COUNT; ++t )
+	{
+		BuildTeam( t );
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------
+// Collect the areas containing the team's bots, then find which of them each living enemy can be seen from
+void CTFBotThreatField::BuildTeam( int team )
+{
+	TeamField &field = m_team[ team ];
+
+	for( int i=1; i<=gpGlobals->maxClients; ++i )
+	{
+		CTFBot *bot = ToTFBot( UTIL_PlayerByIndex( i ) );
+		if ( bot == NULL || !bot->IsAlive() || bot->GetTeamNumber() != team )
+			continue;
+
+		CNavArea *area = bot->GetLastKnownArea();
+		if ( area == NULL )
+			continue;
+
+		bool inserted;
+		field.m_botAreaMap.Insert( area->GetID(), field.m_botAreaVector.Count(), &inserted );
+		if ( inserted )
+		{
+			field.m_botAreaVector.AddToTail( area );
+			field.m_dangerVector.AddToTail( 0 );
+		}
+	}
+
+	if ( field.m_botAreaVector.Count() == 0 )
+		return;
+
+	field.m_wordsPerSubject = ( field.m_botAreaVector.Count() + 31 ) / 32;
+
+	CUtlVector< CTFPlayer * > enemyVector;
+	CollectPlayers( &enemyVector, GetEnemyTeam( team ), COLLECT_ONLY_LIVING_PLAYERS );
+
+	FOR_EACH_VEC( enemyVector, e )
+	{
+		const Subject &subject = FindOrAddSubject( field, enemyVector[e] );
+		if ( subject.m_area == NULL )
+			continue;
+
+		FOR_EACH_VEC( field.m_botAreaVector, a )
+		{
+			if ( field.m_visibleBits[ subject.m_firstWord + ( a >> 5 ) ] & ( 1u << ( a & 31 ) ) )
+			{
+				++field.m_dangerVector[a];
+			}
+		}
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------
+// Return the visibility row for the subject, computing it if the subject is new this tick or has changed areas
+const CTFBotThreatField::Subject &CTFBotThreatField::FindOrAddSubject( TeamField &field, CBaseCombatCharacter *subject )
+{
+	CNavArea *subjectArea = subject->GetLastKnownArea();
+
+	int index;
+	UtlHashHandle_t h = field.m_subjectMap.Find( subject->entindex() );
+	if ( h != field.m_subjectMap.InvalidHandle() )
+	{
+		index = field.m_subjectMap.Element( h );
+		if ( field.m_subjectVector[ index ].m_area == subjectArea )
+			return field.m_subjectVector[ index ];
+	}
+	else
+	{
+		index = field.m_subjectVector.AddToTail();
+		field.m_subjectVector[ index ].m_firstWord = field.m_visibleBits.AddMultipleToTail( field.m_wordsPerSubject );
+		field.m_subjectMap.Insert( subject->entindex(), index );
+	}
+
+	Subject &row = field.m_subjectVector[ index ];
+	row.m_area = subjectArea;
+
+	uint32 *bits = field.m_visibleBits.Base() + row.m_firstWord;
+	V_memset( bits, 0, field.m_wordsPerSubject * sizeof( uint32 ) );
+
+	if ( subjectArea )
+	{
+		FOR_EACH_VEC( field.m_botAreaVector, a )
+		{
+			if ( field.m_botAreaVector[a]->IsPotentiallyVisible( subjectArea ) )
+			{
+				bits[ a >> 5 ] |= 1u << ( a & 31 );
+			}
+		}
+	}
+
+	return row;
+}
+
+
+//----------------------------------------------------------------------------------------------
+bool CTFBotThreatField::IsPotentiallyVisible( CBaseCombatCharacter *viewer, CBaseCombatCharacter *subject )
+{
+	CNavArea *viewerArea = viewer->GetLastKnownArea();
+	CNavArea *subjectArea = subject->GetLastKnownArea();
+
+	if ( viewerArea == NULL || subjectArea == NULL )
+	{
+		// no nav data to reject with
+		return true;
+	}
+
+	int team = viewer->GetTeamNumber();
+	if ( !tf_bot_threat_field.GetBool() || team < FIRST_GAME_TEAM || team >= TF_TEAM_COUNT )
+	{
+		return viewerArea->IsPotentiallyVisible( subjectArea );
+	}
+
+	Update();
+
+	TeamField &field = m_team[ team ];
+
+	// the viewer may have entered an area after the field was built this tick
+	UtlHashHandle_t h = field.m_botAreaMap.Find( viewerArea->GetID() );
+	if ( h == field.m_botAreaMap.InvalidHandle() )
+	{
+		return viewerArea->IsPotentiallyVisible( subjectArea );
+	}
+
+	int a = field.m_botAreaMap.Element( h );
+	const Subject &row = FindOrAddSubject( field, subject );
+
+	return ( field.m_visibleBits[ row.m_firstWord + ( a >> 5 ) ] & ( 1u << ( a & 31 ) ) ) != 0;
+}
+
+
+//----------------------------------------------------------------------------------------------
+int CTFBotThreatField::GetDanger( int team, const CNavArea *area )
+{
+	if ( area == NULL || team < FIRST_GAME_TEAM || team >= TF_TEAM_COUNT )
+		return -1;
+
+	Update();
+
+	TeamField &field = m_team[ team ];
+
+	UtlHashHandle_t h = field.m_botAreaMap.Find( area->GetID() );
+	if ( h == field.m_botAreaMap.InvalidHandle() )
+		return -1;
+
+	return field.m_dangerVector[ field.m_botAreaMap.Element( h ) ];
+}
+
+
+//----------------------------------------------------------------------------------------------
+unsigned int CTFBotThreatField::GetLineOfFireKey( CTFBot *me, CBaseEntity *who )
+{
+	return ( (unsigned int)me->entindex() << 16 ) | (unsigned int)( who->entindex() & 0xFFFF );
+}
+
+
+//----------------------------------------------------------------------------------------------
+/**
+ * Threat selection compares each known threat against the current best one, so the same bot
+ * ends up tracing to the same threat many times per tick.
+ */
+bool CTFBotThreatField::IsLineOfFireClear( CTFBot *me, CBaseEntity *who )
+{
+	if ( !tf_bot_threat_field.GetBool() )
+	{
+		return me->IsLineOfFireClear( who );
+	}
+
+	Update();
+
+	Vector from = me->EyePosition();
+	Vector to = who->WorldSpaceCenter();
+
+	unsigned int key = GetLineOfFireKey( me, who );
+	UtlHashHandle_t h = m_lineOfFireMap.Find( key );
+	bool isNew = ( h == m_lineOfFireMap.InvalidHandle() );
+	if ( isNew )
+	{
+		h = m_lineOfFireMap.Insert( key );
+	}
+
+	LineOfFire &result = m_lineOfFireMap.Element( h );
+
+	if ( isNew || result.m_from != from || result.m_to != to )
+	{
+		result.m_from = from;
+		result.m_to = to;
+		result.m_isClear = me->IsLineOfFireClear( from, who );
+	}
+
+	return result.m_isClear;
+}
+
+
+//----------------------------------------------------------------------------------------------
+void CTFBotThreatField::DrawDanger( int team )
+{
+	if ( team < FIRST_GAME_TEAM || team >= TF_TEAM_COUNT )
+		return;
+
+	Update();
+
+	TeamField &field = m_team[ team ];
+
+	FOR_EACH_VEC( field.m_botAreaVector, a )
+	{
+		int danger = field.m_dangerVector[a];
+		int red = MIN( 255, 64 * danger );
+
+		field.m_botAreaVector[a]->DrawFilled( red, 255 - red, 0, 128, NDEBUG_PERSIST_TILL_NEXT_SERVER );
+	}
+}
@@ -0,0 +1,80 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_bot_threat_field.h
+// Per-team sensing data shared by all TFBots on a team
+
+#ifndef TF_BOT_THREAT_FIELD_H
+#define TF_BOT_THREAT_FIELD_H
+
+#include "tier1/utlhashtable.h"
+#include "tf_shareddefs.h"
+
+class CNavArea;
+class CTFBot;
+
+
+//----------------------------------------------------------------------------------------------
+/**
+ * Rebuilt once per tick. For each team, collects the nav areas that contain that team's bots and,
+ * once per subject, which of those areas the subject is potentially visible from. Every bot on the
+ * team reads from this instead of scanning the nav PVS itself.
+ */
+class CTFBotThreatField
+{
+public:
+	CTFBotThreatField( void );
+
+	void Reset( void );
+
+	// return true if 'subject' is potentially visible from 'viewer's nav area (same as CNavArea::IsPotentiallyVisible)
+	bool IsPotentiallyVisible( CBaseCombatCharacter *viewer, CBaseCombatCharacter *subject );
+
+	// return the number of living enemies of 'team' potentially visible from 'area', or -1 if no bot on 'team' is in 'area'
+	int GetDanger( int team, const CNavArea *area );
+
+	// same as me->IsLineOfFireClear( who ), remembered for the rest of the tick while neither end moves
+	bool IsLineOfFireClear( CTFBot *me, CBaseEntity *who );
+
+	void DrawDanger( int team );
+
+private:
+	void Update( void );							// rebuild if from a previous tick
+	void BuildTeam( int team );
+
+	struct Subject
+	{
+		CNavArea *m_area;
+		int m_firstWord;							// into m_visibleBits
+	};
+
+	struct TeamField
+	{
+		CUtlVector< CNavArea * > m_botAreaVector;
+		CUtlHashtable< unsigned int, int > m_botAreaMap;		// nav area ID -> index into m_botAreaVector
+		CUtlVector< int > m_dangerVector;						// living enemies potentially visible from each bot area
+		int m_wordsPerSubject;
+
+		CUtlHashtable< int, int > m_subjectMap;				// subject entindex -> index into m_subjectVector
+		CUtlVector< Subject > m_subjectVector;
+		CUtlVector< uint32 > m_visibleBits;						// one bit per bot area, per subject
+	};
+
+	const Subject &FindOrAddSubject( TeamField &field, CBaseCombatCharacter *subject );
+
+	struct LineOfFire
+	{
+		Vector m_from;
+		Vector m_to;
+		bool m_isClear;
+	};
+
+	static unsigned int GetLineOfFireKey( CTFBot *me, CBaseEntity *who );
+
+	int m_tick;
+	TeamField m_team[ TF_TEAM_COUNT ];
+	CUtlHashtable< unsigned int, LineOfFire > m_lineOfFireMap;	// bot and subject entindex -> last trace this tick
+};
+
+extern CTFBotThreatField &TheTFBotThreatField( void );
+
+
+#endif // TF_BOT_THREAT_FIELD_H
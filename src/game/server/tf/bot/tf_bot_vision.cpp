@@ -8,6 +8,7 @@
 
 #include "tf_bot.h"
 #include "tf_bot_vision.h"
+#include "tf_bot_threat_field.h"
 #include "tf_player.h"
 #include "tf_gamerules.h"
 #include "tf_obj_sentrygun.h"
@@ -68,18 +69,12 @@ void CTFBotVision::CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity *
 	potentiallyVisible->RemoveAll();
 
 	// include all players
-	for( int i=1; i<=gpGlobals->maxClients; ++i )
-	{
-		CBasePlayer *player = UTIL_PlayerByIndex( i );
-
-		if ( player == NULL )
-			continue;
+	CPlayerRegistry &registry = PlayerRegistry();
+	int playerCount = registry.GetPlayerCount();
 
-		if ( FNullEnt( player->edict() ) )
-			continue;
-
-		if ( !player->IsPlayer() )
-			continue;
+	for( int i=0; i<playerCount; ++i )
+	{
+		CBasePlayer *player = registry.GetPlayer( i );
 
 		if ( !player->IsConnected() )
 			continue;
@@ -434,6 +429,14 @@ bool CTFBotVision::IsVisibleEntityNoticed( CBaseEntity *subject ) const
 }
 
 
+//------------------------------------------------------------------------------------------
+// Nav visibility is looked up in the team's shared threat field
+bool CTFBotVision::IsPotentiallyVisible( CBaseCombatCharacter *subject ) const
+{
+	return TheTFBotThreatField().IsPotentiallyVisible( GetBot()->GetEntity(), subject );
+}
+
+
 //------------------------------------------------------------------------------------------
 // Return VISUAL reaction time
 float CTFBotVision::GetMinRecognizeTime( void ) const
@@ -38,6 +38,7 @@ LINK_ENTITY_TO_CLASS( item_currencypack_medium, CCurrencyPackMedium );
 LINK_ENTITY_TO_CLASS( item_currencypack_small, CCurrencyPackSmall );
 
 LINK_ENTITY_TO_CLASS( item_currencypack_custom, CCurrencyPackCustom );
+DEFINE_ENTITY_POOL( CCurrencyPack, 32 );
 
 IMPLEMENT_SERVERCLASS_ST( CCurrencyPack, DT_CurrencyPack )
 	SendPropBool( SENDINFO( m_bDistributed ) ),
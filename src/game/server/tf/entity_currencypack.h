@@ -13,6 +13,7 @@
 #include "tf_powerup.h"
 #include "player.h"
 #include "tf_shareddefs.h"
+#include "entity_pool.h"
 
 
 //=============================================================================
@@ -59,6 +60,9 @@ protected:
 	bool	m_bTouched;
 	bool	m_bClaimed;
 	CNetworkVar( bool, m_bDistributed );
+
+	// the medium, small and custom packs are the same size and share the pool
+	DECLARE_ENTITY_POOL( CCurrencyPack );
 };
 
 class CCurrencyPackMedium : public CCurrencyPack
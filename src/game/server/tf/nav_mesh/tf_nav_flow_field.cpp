@@ -0,0 +1,662 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_nav_flow_field.cpp
+// Shared goal-directed flow fields, so bots heading to the same place don't each run A*
+
+#include "cbase.h"
+#include "tf_nav_flow_field.h"
+#include "tf_nav_mesh.h"
+#include "tf_gamerules.h"
+#include "tf_player.h"
+#include "NextBot.h"
+#include "Path/NextBotPath.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar tf_bot_path_flow_fields( "tf_bot_path_flow_fields", "1", FCVAR_CHEAT, "If nonzero, bots heading to a shared goal follow a shared flow field instead of each running A*" );
+ConVar tf_bot_path_flow_field_max( "tf_bot_path_flow_field_max", "8", FCVAR_CHEAT, "Maximum number of flow fields kept at once" );
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowGraph::Clear( void )
+{
+	m_areaVector.RemoveAll();
+	m_areaIndexMap.RemoveAll();
+	m_firstEdge.RemoveAll();
+	m_edgeVector.RemoveAll();
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Add the connection from area 'from' to area 'to', with the same length the A* cost functor would see
+ */
+void CTFNavFlowGraph::AddOutgoingEdge( CUtlVector< OutgoingEdge > *outgoing, int from, const CNavArea *toArea, float length, NavTraverseType how ) const
+{
+	int to = GetAreaIndex( toArea );
+	if ( to < 0 || to == from )
+		return;
+
+	const CTFNavArea *fromArea = m_areaVector[ from ];
+
+	OutgoingEdge &out = outgoing->Element( outgoing->AddToTail() );
+	out.m_to = to;
+	out.m_edge.m_from = from;
+	out.m_edge.m_length = ( length > 0.0f ) ? length : ( toArea->GetCenter() - fromArea->GetCenter() ).Length();
+	out.m_edge.m_deltaZ = fromArea->ComputeAdjacentConnectionHeightChange( toArea );
+	out.m_edge.m_how = how;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Collect every area's connections the way NavAreaBuildPath() walks them - floor, then ladders,
+ * then elevators - and store them per destination area.
+ */
+void CTFNavFlowGraph::Build( void )
+{
+	Clear();
+
+	m_areaVector.EnsureCapacity( TheNavAreas.Count() );
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+		m_areaIndexMap.Insert( area, m_areaVector.AddToTail( area ) );
+	}
+
+	int areaCount = m_areaVector.Count();
+
+	CUtlVector< OutgoingEdge > outgoing;
+	for( int i=0; i<areaCount; ++i )
+	{
+		const CTFNavArea *from = m_areaVector[i];
+
+		for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+		{
+			const NavConnectVector *adjVector = from->GetAdjacentAreas( (NavDirType)dir );
+			FOR_EACH_VEC( (*adjVector), bit )
+			{
+				AddOutgoingEdge( &outgoing, i, (*adjVector)[ bit ].area, (*adjVector)[ bit ].length, (NavTraverseType)dir );
+			}
+		}
+
+		// as in the A* walk, the BEHIND area at the top of a ladder isn't used
+		const NavLadderConnectVector *ladderVector = from->GetLadders( CNavLadder::LADDER_UP );
+		FOR_EACH_VEC( (*ladderVector), lit )
+		{
+			const CNavLadder *ladder = (*ladderVector)[ lit ].ladder;
+			CNavArea *topArea[] = { ladder->m_topForwardArea, ladder->m_topLeftArea, ladder->m_topRightArea };
+			for( int t=0; t<ARRAYSIZE( topArea ); ++t )
+			{
+				if ( topArea[t] )
+				{
+					AddOutgoingEdge( &outgoing, i, topArea[t], ladder->m_length, GO_LADDER_UP );
+				}
+			}
+		}
+
+		ladderVector = from->GetLadders( CNavLadder::LADDER_DOWN );
+		FOR_EACH_VEC( (*ladderVector), lit )
+		{
+			const CNavLadder *ladder = (*ladderVector)[ lit ].ladder;
+			if ( ladder->m_bottomArea )
+			{
+				AddOutgoingEdge( &outgoing, i, ladder->m_bottomArea, ladder->m_length, GO_LADDER_DOWN );
+			}
+		}
+
+		if ( from->GetElevator() )
+		{
+			const NavConnectVector &elevatorVector = from->GetElevatorAreas();
+			FOR_EACH_VEC( elevatorVector, eit )
+			{
+				const CNavArea *toArea = elevatorVector[ eit ].area;
+				AddOutgoingEdge( &outgoing, i, toArea, -1.0f, ( toArea->GetCenter().z > from->GetCenter().z ) ? GO_ELEVATOR_UP : GO_ELEVATOR_DOWN );
+			}
+		}
+	}
+
+	// count incoming edges, then fill them in
+	m_firstEdge.SetCount( areaCount + 1 );
+	for( int i=0; i<=areaCount; ++i )
+	{
+		m_firstEdge[i] = 0;
+	}
+
+	FOR_EACH_VEC( outgoing, it )
+	{
+		++m_firstEdge[ outgoing[ it ].m_to + 1 ];
+	}
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		m_firstEdge[ i + 1 ] += m_firstEdge[i];
+	}
+
+	CUtlVector< int > fillPos;
+	fillPos.CopyArray( m_firstEdge.Base(), areaCount );
+	m_edgeVector.SetCount( m_firstEdge[ areaCount ] );
+
+	FOR_EACH_VEC( outgoing, it )
+	{
+		m_edgeVector[ fillPos[ outgoing[ it ].m_to ]++ ] = outgoing[ it ].m_edge;
+	}
+}
+
+
+//-------------------------------------------------------------------------
+int CTFNavFlowGraph::GetAreaIndex( const CNavArea *area ) const
+{
+	UtlHashHandle_t h = m_areaIndexMap.Find( area );
+	return ( h == m_areaIndexMap.InvalidHandle() ) ? -1 : m_areaIndexMap.Element( h );
+}
+
+
+//-------------------------------------------------------------------------
+CTFNavFlowField::CTFNavFlowField( void ) : m_open( 0, 0, IsLowerPriority )
+{
+	m_lastUseTime = 0.0f;
+	V_memset( &m_key, 0, sizeof( m_key ) );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Same rules as CTFBotLocomotion::IsAreaTraversable() and the spawn room check in CTFBotPathCost
+ */
+bool CTFNavFlowField::IsEnterable( const CTFNavArea *area ) const
+{
+	if ( area->IsBlocked( m_key.m_team ) )
+		return false;
+
+	if ( !TFGameRules()->RoundHasBeenWon() || TFGameRules()->GetWinningTeam() != m_key.m_team )
+	{
+		if ( ( area->HasAttributeTF( TF_NAV_SPAWN_ROOM_RED ) && m_key.m_team == TF_TEAM_BLUE ) ||
+			 ( area->HasAttributeTF( TF_NAV_SPAWN_ROOM_BLUE ) && m_key.m_team == TF_TEAM_RED ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Cost of reaching the goal from the edge's source area by stepping into area 'to'.
+ * Returns false if the step can't be taken.
+ */
+bool CTFNavFlowField::RelaxEdge( const CTFNavFlowGraph::Edge &edge, int to, float *newCost ) const
+{
+	if ( !m_enterable[ to ] )
+		return false;
+
+	float dist = edge.m_length;
+
+	if ( edge.m_deltaZ >= m_key.m_stepHeight )
+	{
+		if ( edge.m_deltaZ >= m_key.m_maxJumpHeight )
+		{
+			// too high to reach
+			return false;
+		}
+
+		// jumping is slower than flat ground
+		const float jumpPenalty = 2.0f;
+		dist *= jumpPenalty;
+	}
+	else if ( edge.m_deltaZ < -m_key.m_maxDropHeight )
+	{
+		// too far to drop
+		return false;
+	}
+
+	*newCost = m_cost[ to ] + dist;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowField::Propagate( const CTFNavFlowGraph &graph )
+{
+	while( m_open.Count() )
+	{
+		OpenEntry entry = m_open.ElementAtHead();
+		m_open.RemoveAtHead();
+
+		if ( entry.m_cost > m_cost[ entry.m_index ] )
+		{
+			// stale entry, this area was reached more cheaply since
+			continue;
+		}
+
+		int end = graph.GetIncomingEdgeEnd( entry.m_index );
+		for( int e = graph.GetFirstIncomingEdge( entry.m_index ); e < end; ++e )
+		{
+			const CTFNavFlowGraph::Edge &edge = graph.GetEdge( e );
+
+			float newCost;
+			if ( !RelaxEdge( edge, entry.m_index, &newCost ) )
+				continue;
+
+			if ( newCost < m_cost[ edge.m_from ] )
+			{
+				m_cost[ edge.m_from ] = newCost;
+				m_next[ edge.m_from ] = entry.m_index;
+				m_nextHow[ edge.m_from ] = edge.m_how;
+
+				OpenEntry open;
+				open.m_cost = newCost;
+				open.m_index = edge.m_from;
+				m_open.Insert( open );
+			}
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowField::Build( const CTFNavFlowGraph &graph, const Key &key )
+{
+	VPROF_BUDGET( "CTFNavFlowField::Build", "NextBot" );
+
+	m_key = key;
+
+	int areaCount = graph.GetAreaCount();
+	m_cost.SetCount( areaCount );
+	m_next.SetCount( areaCount );
+	m_nextHow.SetCount( areaCount );
+	m_enterable.SetCount( areaCount );
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		m_cost[i] = FLT_MAX;
+		m_next[i] = -1;
+		m_nextHow[i] = NUM_TRAVERSE_TYPES;
+		m_enterable[i] = IsEnterable( graph.GetArea( i ) );
+	}
+
+	m_cost[ key.m_goalIndex ] = 0.0f;
+
+	OpenEntry open;
+	open.m_cost = 0.0f;
+	open.m_index = key.m_goalIndex;
+	m_open.RemoveAll();
+	m_open.Insert( open );
+
+	Propagate( graph );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Areas that became blocked invalidate every area whose route ran through them. Those are
+ * re-seeded from their still valid neighbors. Areas that became unblocked can only make
+ * routes cheaper, so the search just continues outward from them.
+ */
+void CTFNavFlowField::UpdateBlockedAreas( const CTFNavFlowGraph &graph )
+{
+	VPROF_BUDGET( "CTFNavFlowField::UpdateBlockedAreas", "NextBot" );
+
+	int areaCount = graph.GetAreaCount();
+
+	CUtlVector< int > nowOpen;
+	bool anyClosed = false;
+	for( int i=0; i<areaCount; ++i )
+	{
+		bool enterable = IsEnterable( graph.GetArea( i ) );
+		if ( enterable == m_enterable[i] )
+			continue;
+
+		m_enterable[i] = enterable;
+		if ( enterable )
+		{
+			nowOpen.AddToTail( i );
+		}
+		else
+		{
+			anyClosed = true;
+		}
+	}
+
+	m_open.RemoveAll();
+
+	if ( anyClosed )
+	{
+		// find every area whose next hop chain enters a closed area (0 = unknown, 1 = valid, 2 = invalid)
+		CUtlVector< unsigned char > state;
+		state.SetCount( areaCount );
+		V_memset( state.Base(), 0, areaCount );
+		state[ m_key.m_goalIndex ] = 1;
+
+		CUtlVector< int > chain;
+		for( int i=0; i<areaCount; ++i )
+		{
+			chain.RemoveAll();
+			int at = i;
+			while( state[ at ] == 0 )
+			{
+				if ( m_next[ at ] < 0 )
+				{
+					// unreachable, leave it alone
+					state[ at ] = 1;
+					break;
+				}
+
+				chain.AddToTail( at );
+				if ( !m_enterable[ m_next[ at ] ] )
+				{
+					state[ at ] = 2;
+					break;
+				}
+				at = m_next[ at ];
+			}
+
+			unsigned char result = state[ at ];
+			FOR_EACH_VEC( chain, c )
+			{
+				state[ chain[c] ] = result;
+			}
+		}
+
+		for( int i=0; i<areaCount; ++i )
+		{
+			if ( state[i] == 2 )
+			{
+				m_cost[i] = FLT_MAX;
+				m_next[i] = -1;
+				m_nextHow[i] = NUM_TRAVERSE_TYPES;
+			}
+		}
+
+		// restart the search from valid areas that border invalidated ones
+		for( int to=0; to<areaCount; ++to )
+		{
+			if ( state[ to ] == 2 || m_cost[ to ] == FLT_MAX )
+				continue;
+
+			int end = graph.GetIncomingEdgeEnd( to );
+			for( int e = graph.GetFirstIncomingEdge( to ); e < end; ++e )
+			{
+				if ( state[ graph.GetEdge( e ).m_from ] == 2 )
+				{
+					OpenEntry open;
+					open.m_cost = m_cost[ to ];
+					open.m_index = to;
+					m_open.Insert( open );
+					break;
+				}
+			}
+		}
+	}
+
+	FOR_EACH_VEC( nowOpen, it )
+	{
+		int index = nowOpen[ it ];
+		if ( m_cost[ index ] < FLT_MAX )
+		{
+			OpenEntry open;
+			open.m_cost = m_cost[ index ];
+			open.m_index = index;
+			m_open.Insert( open );
+		}
+	}
+
+	Propagate( graph );
+}
+
+
+//-------------------------------------------------------------------------
+CTFNavFlowFieldCache::CTFNavFlowFieldCache( void )
+{
+	m_blockedAreasChanged = false;
+	m_roundWon = false;
+	ResetStats();
+}
+
+
+//-------------------------------------------------------------------------
+CTFNavFlowFieldCache::~CTFNavFlowFieldCache()
+{
+	m_fieldVector.PurgeAndDeleteElements();
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowFieldCache::Reset( void )
+{
+	m_fieldVector.PurgeAndDeleteElements();
+	m_graph.Clear();
+	m_blockedAreasChanged = false;
+	m_roundWon = false;
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowFieldCache::OnBlockedAreasChanged( void )
+{
+	m_blockedAreasChanged = true;
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowFieldCache::OnAttributesChanged( void )
+{
+	// spawn room attributes change which areas are enterable, same as blocking
+	m_blockedAreasChanged = true;
+}
+
+
+//-------------------------------------------------------------------------
+CTFNavFlowField *CTFNavFlowFieldCache::FindOrCreateField( const CTFNavFlowField::Key &key )
+{
+	FOR_EACH_VEC( m_fieldVector, it )
+	{
+		if ( m_fieldVector[ it ]->GetKey() == key )
+		{
+			++m_hitCount;
+			return m_fieldVector[ it ];
+		}
+	}
+
+	CTFNavFlowField *field = NULL;
+	if ( m_fieldVector.Count() >= MAX( tf_bot_path_flow_field_max.GetInt(), 1 ) )
+	{
+		// reuse the least recently used field
+		int oldest = 0;
+		FOR_EACH_VEC( m_fieldVector, it )
+		{
+			if ( m_fieldVector[ it ]->m_lastUseTime < m_fieldVector[ oldest ]->m_lastUseTime )
+			{
+				oldest = it;
+			}
+		}
+		field = m_fieldVector[ oldest ];
+	}
+	else
+	{
+		field = new CTFNavFlowField;
+		m_fieldVector.AddToTail( field );
+	}
+
+	double startTime = Plat_FloatTime();
+	field->Build( m_graph, key );
+	double buildTime = Plat_FloatTime() - startTime;
+
+	++m_buildCount;
+	m_buildTime += buildTime;
+	m_maxBuildTime = MAX( m_maxBuildTime, buildTime );
+
+	return field;
+}
+
+
+//-------------------------------------------------------------------------
+bool CTFNavFlowFieldCache::ComputePath( INextBot *bot, Path *path, const Vector &goal )
+{
+	VPROF_BUDGET( "CTFNavFlowFieldCache::ComputePath", "NextBot" );
+
+	if ( !tf_bot_path_flow_fields.GetBool() || TFGameRules()->IsInTraining() || TheNavMesh->IsGenerating() )
+		return false;
+
+	// spies path differently (see CTFBotPathCost)
+	CTFPlayer *player = ToTFPlayer( bot->GetEntity() );
+	if ( !player || player->IsPlayerClass( TF_CLASS_SPY ) )
+		return false;
+
+	++m_requestCount;
+
+	CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
+
+	// same goal area selection as Path::Compute()
+	const float maxDistanceToArea = 200.0f;
+	CNavArea *goalArea = TheNavMesh->GetNearestNavArea( goal, true, maxDistanceToArea, true );
+
+	if ( !startArea || !goalArea )
+	{
+		++m_fallbackCount;
+		return false;
+	}
+
+	if ( !m_graph.IsBuilt() )
+	{
+		// the mesh calls Reset() whenever areas are loaded, generated, or edited
+		m_fieldVector.PurgeAndDeleteElements();
+		m_graph.Build();
+		m_blockedAreasChanged = false;
+	}
+
+	if ( m_roundWon != TFGameRules()->RoundHasBeenWon() )
+	{
+		m_roundWon = TFGameRules()->RoundHasBeenWon();
+		m_blockedAreasChanged = true;
+	}
+
+	if ( m_blockedAreasChanged )
+	{
+		double startTime = Plat_FloatTime();
+		FOR_EACH_VEC( m_fieldVector, it )
+		{
+			m_fieldVector[ it ]->UpdateBlockedAreas( m_graph );
+			++m_repairCount;
+		}
+		m_repairTime += Plat_FloatTime() - startTime;
+		m_blockedAreasChanged = false;
+	}
+
+	int startIndex = m_graph.GetAreaIndex( startArea );
+	int goalIndex = m_graph.GetAreaIndex( goalArea );
+	if ( startIndex < 0 || goalIndex < 0 )
+	{
+		++m_fallbackCount;
+		return false;
+	}
+
+	ILocomotion *mover = bot->GetLocomotionInterface();
+
+	CTFNavFlowField::Key key;
+	V_memset( &key, 0, sizeof( key ) );
+	key.m_goalIndex = goalIndex;
+	key.m_team = bot->GetEntity()->GetTeamNumber();
+	key.m_stepHeight = (int)mover->GetStepHeight();
+	key.m_maxJumpHeight = (int)mover->GetMaxJumpHeight();
+	key.m_maxDropHeight = (int)mover->GetDeathDropHeight();
+
+	CTFNavFlowField *field = FindOrCreateField( key );
+	field->m_lastUseTime = gpGlobals->curtime;
+
+	if ( field->GetCost( startIndex ) == FLT_MAX )
+	{
+		// let A* build the partial path
+		++m_fallbackCount;
+		return false;
+	}
+
+	path->Invalidate();
+
+	if ( startArea == goalArea )
+	{
+		path->BuildTrivialPath( bot, goal );
+		return true;
+	}
+
+	// walk the field, setting up parent links the same way a search would
+	startArea->SetParent( NULL );
+	int at = startIndex;
+	int steps = 0;
+	while( at != goalIndex )
+	{
+		int next = field->GetNextArea( at );
+		CTFNavArea *nextArea = m_graph.GetArea( next );
+
+		if ( nextArea->HasAttributes( NAV_MESH_FUNC_COST ) || ++steps > m_graph.GetAreaCount() )
+		{
+			// func_nav_cost depends on the bot, so the shared costs don't apply here
+			++m_fallbackCount;
+			return false;
+		}
+
+		nextArea->SetParent( m_graph.GetArea( at ), field->GetNextHow( at ) );
+		at = next;
+	}
+
+	// make sure path end position is on the ground
+	Vector pathEndPosition = goal;
+	pathEndPosition.z = goalArea->GetZ( pathEndPosition );
+
+	path->AssemblePrecomputedPath( bot, pathEndPosition, goalArea );
+
+	return path->IsValid();
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowFieldCache::ResetStats( void )
+{
+	m_requestCount = 0;
+	m_hitCount = 0;
+	m_buildCount = 0;
+	m_repairCount = 0;
+	m_fallbackCount = 0;
+	m_buildTime = 0.0;
+	m_maxBuildTime = 0.0;
+	m_repairTime = 0.0;
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavFlowFieldCache::PrintStats( void ) const
+{
+	int fieldRequests = m_hitCount + m_buildCount;
+
+	Msg( "Flow fields: %d in use, %d areas, %d incoming connections\n", m_fieldVector.Count(), m_graph.GetAreaCount(), m_graph.IsBuilt() ? m_graph.GetIncomingEdgeEnd( m_graph.GetAreaCount() - 1 ) : 0 );
+	Msg( "  path requests:  %d (%d fell back to A*)\n", m_requestCount, m_fallbackCount );
+	Msg( "  field hit rate: %.1f%% (%d hits, %d builds)\n", fieldRequests ? 100.0f * m_hitCount / fieldRequests : 0.0f, m_hitCount, m_buildCount );
+	Msg( "  build time:     %.2f ms total, %.3f ms average, %.3f ms max\n", m_buildTime * 1000.0, m_buildCount ? m_buildTime * 1000.0 / m_buildCount : 0.0, m_maxBuildTime * 1000.0 );
+	Msg( "  repairs:        %d, %.2f ms total\n", m_repairCount, m_repairTime * 1000.0 );
+
+	FOR_EACH_VEC( m_fieldVector, it )
+	{
+		const CTFNavFlowField::Key &key = m_fieldVector[ it ]->GetKey();
+		Msg( "  field %d: goal area #%d, team %d, last used %.1f seconds ago\n", it, m_graph.GetArea( key.m_goalIndex )->GetID(), key.m_team, gpGlobals->curtime - m_fieldVector[ it ]->m_lastUseTime );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+CON_COMMAND_F( tf_nav_flow_field_stats, "Show how often bot paths come from shared flow fields. 'tf_nav_flow_field_stats reset' clears the counts.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	CTFNavFlowFieldCache *flowFields = TheTFNavMesh()->GetFlowFields();
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		flowFields->ResetStats();
+		return;
+	}
+
+	flowFields->PrintStats();
+}
@@ -0,0 +1,159 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_nav_flow_field.h
+// Shared goal-directed flow fields, so bots heading to the same place don't each run A*
+
+#ifndef TF_NAV_FLOW_FIELD_H
+#define TF_NAV_FLOW_FIELD_H
+
+#include "nav.h"
+#include "utlpriorityqueue.h"
+#include "tier1/utlhashtable.h"
+
+class CNavArea;
+class CTFNavArea;
+class INextBot;
+class Path;
+
+
+//-------------------------------------------------------------------------
+/**
+ * The area graph in index form, with every area's INCOMING connections, which is what a
+ * search outward from a goal needs. Holds area pointers, so the mesh clears it whenever
+ * areas are loaded, generated, or edited.
+ */
+class CTFNavFlowGraph
+{
+public:
+	struct Edge
+	{
+		int m_from;									// index of the area the connection leaves from
+		float m_length;								// same as the A* cost functor uses
+		float m_deltaZ;								// from->ComputeAdjacentConnectionHeightChange( to )
+		NavTraverseType m_how;						// how to get from 'm_from' to us
+	};
+
+	void Build( void );
+	void Clear( void );
+	bool IsBuilt( void ) const							{ return m_areaVector.Count() > 0; }
+
+	int GetAreaCount( void ) const						{ return m_areaVector.Count(); }
+	CTFNavArea *GetArea( int index ) const				{ return m_areaVector[ index ]; }
+	int GetAreaIndex( const CNavArea *area ) const;		// -1 if not in the graph
+
+	int GetFirstIncomingEdge( int index ) const			{ return m_firstEdge[ index ]; }
+	int GetIncomingEdgeEnd( int index ) const			{ return m_firstEdge[ index + 1 ]; }
+	const Edge &GetEdge( int edge ) const				{ return m_edgeVector[ edge ]; }
+
+private:
+	struct OutgoingEdge
+	{
+		int m_to;
+		Edge m_edge;
+	};
+	void AddOutgoingEdge( CUtlVector< OutgoingEdge > *outgoing, int from, const CNavArea *toArea, float length, NavTraverseType how ) const;
+
+	CUtlVector< CTFNavArea * > m_areaVector;
+	CUtlHashtable< const CNavArea *, int > m_areaIndexMap;
+	CUtlVector< int > m_firstEdge;						// per area, plus one at the end
+	CUtlVector< Edge > m_edgeVector;
+};
+
+
+//-------------------------------------------------------------------------
+/**
+ * Travel cost from every area to one goal area for one team, and the next area to move to.
+ * Costs match CTFBotPathCost with FASTEST_ROUTE, except for func_nav_cost entities, which
+ * depend on the individual bot (paths that cross those fall back to A*).
+ */
+class CTFNavFlowField
+{
+public:
+	CTFNavFlowField( void );
+
+	struct Key
+	{
+		int m_goalIndex;
+		int m_team;
+		int m_stepHeight;
+		int m_maxJumpHeight;
+		int m_maxDropHeight;
+
+		bool operator==( const Key &other ) const
+		{
+			return V_memcmp( this, &other, sizeof( Key ) ) == 0;
+		}
+	};
+
+	void Build( const CTFNavFlowGraph &graph, const Key &key );		// full reverse search from the goal
+	void UpdateBlockedAreas( const CTFNavFlowGraph &graph );		// repair the field after areas were (un)blocked
+
+	const Key &GetKey( void ) const						{ return m_key; }
+	float GetCost( int index ) const					{ return m_cost[ index ]; }
+	int GetNextArea( int index ) const					{ return m_next[ index ]; }
+	NavTraverseType GetNextHow( int index ) const		{ return m_nextHow[ index ]; }
+
+	float m_lastUseTime;
+
+private:
+	bool IsEnterable( const CTFNavArea *area ) const;	// can our team move into this area
+	bool RelaxEdge( const CTFNavFlowGraph::Edge &edge, int to, float *newCost ) const;
+	void Propagate( const CTFNavFlowGraph &graph );		// run the search from whatever is in the open set
+
+	struct OpenEntry
+	{
+		float m_cost;
+		int m_index;
+	};
+	static bool IsLowerPriority( const OpenEntry &a, const OpenEntry &b )	{ return a.m_cost > b.m_cost; }
+
+	Key m_key;
+	CUtlVector< float > m_cost;							// FLT_MAX if the goal can't be reached
+	CUtlVector< int > m_next;							// -1 at the goal and where unreachable
+	CUtlVector< NavTraverseType > m_nextHow;
+	CUtlVector< bool > m_enterable;						// IsEnterable() of each area when last computed
+	CUtlPriorityQueue< OpenEntry > m_open;
+};
+
+
+//-------------------------------------------------------------------------
+/**
+ * The flow fields in use, shared by all bots. Fields are built on demand, repaired when
+ * blocked areas change, and the least recently used one is dropped when there are too many.
+ */
+class CTFNavFlowFieldCache
+{
+public:
+	CTFNavFlowFieldCache( void );
+	~CTFNavFlowFieldCache();
+
+	void Reset( void );									// mesh changed, throw everything away
+	void OnBlockedAreasChanged( void );					// repair fields the next time they are used
+	void OnAttributesChanged( void );					// spawn room etc changed, rebuild fields when next used
+
+	// Build a path for 'bot' to 'goal' by walking the shared field, instead of running A*.
+	// Returns false if no field can be used, and the caller should Compute() the path itself.
+	bool ComputePath( INextBot *bot, Path *path, const Vector &goal );
+
+	void PrintStats( void ) const;
+	void ResetStats( void );
+
+private:
+	CTFNavFlowField *FindOrCreateField( const CTFNavFlowField::Key &key );
+
+	CTFNavFlowGraph m_graph;
+	CUtlVector< CTFNavFlowField * > m_fieldVector;
+	bool m_blockedAreasChanged;
+	bool m_roundWon;									// spawn rooms open up to the winners
+
+	// statistics
+	int m_requestCount;
+	int m_hitCount;										// path came from an up to date field
+	int m_buildCount;
+	int m_repairCount;
+	int m_fallbackCount;								// caller had to run A*
+	double m_buildTime;
+	double m_maxBuildTime;
+	double m_repairTime;
+};
+
+#endif // TF_NAV_FLOW_FIELD_H
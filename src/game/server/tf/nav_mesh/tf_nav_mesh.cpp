@@ -473,6 +473,12 @@ void CTFNavMesh::Update( void )
 {
 	CNavMesh::Update();
 
+	if ( IsGenerating() || nav_edit.GetBool() )
+	{
+		// areas and connections are changing underneath the flow fields
+		m_flowFields.Reset();
+	}
+
 	if ( !TheNavAreas.Count() )
 		return;
 
@@ -504,6 +510,57 @@ void CTFNavMesh::Update( void )
 }
 
 
+//-------------------------------------------------------------------------
+/**
+ * Destroy Navigation Mesh data and revert to initial state
+ */
+void CTFNavMesh::Reset( void )
+{
+	m_flowFields.Reset();
+
+	CNavMesh::Reset();
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * (EXTEND) invoked after all areas have been loaded
+ */
+NavErrorType CTFNavMesh::PostLoad( unsigned int version )
+{
+	m_flowFields.Reset();
+
+	return CNavMesh::PostLoad( version );
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavMesh::OnEditCreateNotify( CNavArea *newArea )
+{
+	m_flowFields.Reset();
+
+	CNavMesh::OnEditCreateNotify( newArea );
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavMesh::OnEditDestroyNotify( CNavArea *deadArea )
+{
+	m_flowFields.Reset();
+
+	CNavMesh::OnEditDestroyNotify( deadArea );
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavMesh::OnEditDestroyNotify( CNavLadder *deadLadder )
+{
+	m_flowFields.Reset();
+
+	CNavMesh::OnEditDestroyNotify( deadLadder );
+}
+
+
 //-------------------------------------------------------------------------
 /**
  * (EXTEND) invoked when server loads a new map
@@ -513,6 +570,7 @@ void CTFNavMesh::OnServerActivate( void )
 	CNavMesh::OnServerActivate();
 
 	m_sentryAreas.RemoveAll();
+	m_flowFields.Reset();
 
 	ResetMeshAttributes( true );
 	m_priorBotCount = 0;
@@ -629,6 +687,8 @@ void CTFNavMesh::OnBlockedAreasChanged( void )
 {
 	VPROF_BUDGET( "CTFNavMesh::OnBlockedAreasChanged", "NextBot" );
 
+	m_flowFields.OnBlockedAreasChanged();
+
 	if ( TheNextBots().GetNextBotCount() == 0 )
 		return;
 
@@ -1132,6 +1192,7 @@ void CTFNavMesh::RecomputeInternalData( void )
 	ComputeInvasionAreas();
 	ComputeLegalBombDropAreas();
 	ComputeBombTargetDistance();	// for MvM
+	m_flowFields.OnAttributesChanged();
 
 	if ( m_recomputeReason == RESET || m_recomputeReason == SETUP_FINISHED )
 	{
@@ -1390,7 +1451,8 @@ void CTFNavMesh::PostCustomAnalysis( void )
 //-------------------------------------------------------------------------
 void CTFNavMesh::EndCustomAnalysis()
 {
-
+	// generation and analysis rebuilt the areas
+	m_flowFields.Reset();
 }
 
 
@@ -9,6 +9,7 @@
 #include "nav_mesh.h"
 #include "tf_nav_area.h"
 #include "tf_obj_teleporter.h"
+#include "tf_nav_flow_field.h"
 
 #define TF_PLAYER_JUMP_HEIGHT	45.0f			// non crouch-jumping
 
@@ -45,9 +46,16 @@ public:
 	virtual void SaveCustomData( CUtlBuffer &fileBuffer ) const;							// store custom mesh data for derived classes
 	virtual void LoadCustomData( CUtlBuffer &fileBuffer, unsigned int subVersion );			// load custom mesh data for derived classes
 
+	virtual void Reset( void );											// destroy Navigation Mesh data and revert to initial state
+	virtual NavErrorType PostLoad( unsigned int version );				// (EXTEND) invoked after all areas have been loaded - for pointer binding, etc
+
 	virtual void OnServerActivate( void );								// (EXTEND) invoked when server loads a new map
 	virtual void OnRoundRestart( void );								// invoked when a game round restarts
 
+	virtual void OnEditCreateNotify( CNavArea *newArea );				// invoked when given area has just been added to the mesh in edit mode
+	virtual void OnEditDestroyNotify( CNavArea *deadArea );				// invoked when given area has just been deleted from the mesh in edit mode
+	virtual void OnEditDestroyNotify( CNavLadder *deadLadder );			// invoked when given ladder has just been deleted from the mesh in edit mode
+
 	virtual void FireGameEvent( IGameEvent *event );
 
 	/**
@@ -110,6 +118,8 @@ public:
 
 	virtual void OnDoorCreated( CBaseEntity *door );					// invoked when a door is created
 
+	CTFNavFlowFieldCache *GetFlowFields( void )	{ return &m_flowFields; }	// flow fields shared by bots moving to the same goal
+
 protected:
 	virtual void BeginCustomAnalysis( bool bIncremental );
 	virtual void PostCustomAnalysis( void );							// invoked when custom analysis step is complete
@@ -151,6 +161,8 @@ private:
 	CountdownTimer m_watchCartTimer;
 
 	int m_priorBotCount;
+
+	CTFNavFlowFieldCache m_flowFields;
 };
 
 
@@ -77,6 +77,7 @@ ConVar tf_mvm_endless_tank_boost( "tf_mvm_endless_tank_boost", "0.2", FCVAR_DONT
 
 ConVar tf_populator_health_multiplier( "tf_populator_health_multiplier", "1.0", FCVAR_DONTRECORD | FCVAR_REPLICATED | FCVAR_CHEAT );
 ConVar tf_populator_damage_multiplier( "tf_populator_damage_multiplier", "1.0", FCVAR_DONTRECORD | FCVAR_REPLICATED | FCVAR_CHEAT );
+ConVar tf_mvm_spawn_budget_per_tick( "tf_mvm_spawn_budget_per_tick", "0", FCVAR_CHEAT, "Maximum number of WaveSpawn groups spawned in a single tick. Further spawns wait for the next tick, which changes spawn order and timing. 0 = unlimited" );
 
 static bool HaveMap( const char *pszMapName )
 {
@@ -226,6 +227,21 @@ CON_COMMAND_F( tf_mvm_debugstats, "Dumpout MvM Data", FCVAR_CHEAT )
 	}
 }
 
+//-------------------------------------------------------------------------
+CON_COMMAND_F( tf_mvm_spawn_stats, "Show per-wave bot spawn cost. Pass 'reset' to clear.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		CPopulationManager::ResetSpawnStats();
+		return;
+	}
+
+	CPopulationManager::PrintSpawnStats();
+}
+
 //-------------------------------------------------------------------------
 // CPopulationManager
 //-------------------------------------------------------------------------
@@ -270,6 +286,8 @@ CPopulationManager::CPopulationManager( void )
 	m_bEndlessOn = false;
 	m_bIsWaveJumping = false;
 	m_bSpawningPaused = false;
+	m_spawnBudgetTick = -1;
+	m_spawnBudgetUsed = 0;
 
 	m_iCurrentWaveIndex = 0;
 	m_nNumConsecutiveWipes = 0;
@@ -1287,28 +1305,76 @@ void CPopulationManager::SetCheckpoint( int waveNumber )
 	DevMsg( "Checkpoint Saved\n" );
 
 	// snapshot each player's state
-	// Save off all upgrades and purge it, copy back in existing players
+	// Upgrade histories normally only grow between checkpoints, so only the entries past the
+	// part that still matches the previous snapshot need to be copied
+	int nChanged = 0;
 	for( int i=0; i<m_playerUpgrades.Count(); ++i )
 	{
+		PlayerUpgradeHistory *history = m_playerUpgrades[i];
+
 		// Get this players check point
-		CheckpointSnapshotInfo *snapshot = FindCheckpointSnapshot( m_playerUpgrades[i]->m_steamId );
+		CheckpointSnapshotInfo *snapshot = FindCheckpointSnapshot( history->m_steamId );
 		if ( snapshot == NULL )
 		{
+			// players who never bought anything restore to the same state with or without a snapshot
+			if ( history->m_upgradeVector.Count() == 0 && history->m_currencySpent == 0 )
+				continue;
+
 			// New SnapshotInfo, save the player id
 			snapshot = new CheckpointSnapshotInfo;
-			snapshot->m_steamId = m_playerUpgrades[i]->m_steamId;
+			snapshot->m_steamId = history->m_steamId;
 			m_checkpointSnapshot.AddToTail( snapshot );
 		}
 
 		// Save the Player upgrade history
-		snapshot->m_currencySpent = m_playerUpgrades[i]->m_currencySpent;
-		snapshot->m_upgradeVector.RemoveAll();
-		// copy in to upgrade history
-		for( int j = 0; j < m_playerUpgrades[i]->m_upgradeVector.Count(); ++j )
+		snapshot->m_currencySpent = history->m_currencySpent;
+		nChanged += CopyUpgradeDelta( &snapshot->m_upgradeVector, history->m_upgradeVector );
+	}
+
+	// drop snapshots that no longer hold anything
+	FOR_EACH_VEC_BACK( m_checkpointSnapshot, i )
+	{
+		CheckpointSnapshotInfo *snapshot = m_checkpointSnapshot[i];
+		if ( snapshot->m_upgradeVector.Count() == 0 && snapshot->m_currencySpent == 0 )
 		{
-			snapshot->m_upgradeVector.AddToTail( m_playerUpgrades[i]->m_upgradeVector[j]);
+			delete snapshot;
+			m_checkpointSnapshot.FastRemove( i );
 		}
 	}
+
+	if ( tf_populator_debug.GetBool() )
+	{
+		DevMsg( "%3.2f: CHECKPOINT_SAVE: %d snapshots, %d upgrade entries changed\n", gpGlobals->curtime, m_checkpointSnapshot.Count(), nChanged );
+	}
+}
+
+//-------------------------------------------------------------------------
+// Make 'dest' match 'src', keeping the leading entries they already share.
+// Returns the number of entries removed or added.
+int CPopulationManager::CopyUpgradeDelta( CUtlVector< CUpgradeInfo > *dest, const CUtlVector< CUpgradeInfo > &src )
+{
+	int nCommon = 0;
+	int nMax = MIN( dest->Count(), src.Count() );
+	while ( nCommon < nMax )
+	{
+		const CUpgradeInfo &a = dest->Element( nCommon );
+		const CUpgradeInfo &b = src[ nCommon ];
+		if ( a.m_iPlayerClass != b.m_iPlayerClass || a.m_itemDefIndex != b.m_itemDefIndex || a.m_upgrade != b.m_upgrade || a.m_nCost != b.m_nCost )
+			break;
+
+		++nCommon;
+	}
+
+	int nRemoved = dest->Count() - nCommon;
+	int nAdded = src.Count() - nCommon;
+
+	dest->RemoveMultipleFromTail( nRemoved );
+	if ( nAdded > 0 )
+	{
+		dest->AddMultipleToTail( nAdded, src.Base() + nCommon );
+	}
+
+	return nRemoved + nAdded;
 }
 
 //-------------------------------------------------------------------------
@@ -1451,25 +1517,34 @@ void CPopulationManager::RestoreCheckpoint( void )
 		m_iCurrentWaveIndex = m_checkpointWaveIndex;
 	}
 
-	// Purge all player upgrades
-	// Set them to the checkpoint state
-	m_playerUpgrades.PurgeAndDeleteElements();
-
+	// Set all player upgrades to the checkpoint state.
 	// We must clear each player's upgrade history to get rid of upgrades they
-	// purchased since the last checkpoint. The history will be rebuilt
-	// as the checkpoint snapshot is restored.
+	// purchased since the last checkpoint. Only the entries that differ from
+	// the snapshot are rewritten.
+	int nChanged = 0;
+	FOR_EACH_VEC_BACK( m_playerUpgrades, i )
+	{
+		// no snapshot means no upgrades at the checkpoint
+		if ( FindCheckpointSnapshot( m_playerUpgrades[i]->m_steamId ) == NULL )
+		{
+			nChanged += m_playerUpgrades[i]->m_upgradeVector.Count();
+			delete m_playerUpgrades[i];
+			m_playerUpgrades.FastRemove( i );
+		}
+	}
+
 	for( int i=0; i<m_checkpointSnapshot.Count(); ++i )
 	{
 		CheckpointSnapshotInfo *snapshot = m_checkpointSnapshot[i];
 
-		// Create new Entry since we Purged the list
 		PlayerUpgradeHistory *history = FindOrAddPlayerUpgradeHistory( snapshot->m_steamId );
 		history->m_currencySpent = snapshot->m_currencySpent;
-		
-		for (int j = 0; j < snapshot->m_upgradeVector.Count(); ++j )
-		{
-			history->m_upgradeVector.AddToTail( snapshot->m_upgradeVector[j] );
-		}
+		nChanged += CopyUpgradeDelta( &history->m_upgradeVector, snapshot->m_upgradeVector );
+	}
+
+	if ( tf_populator_debug.GetBool() )
+	{
+		DevMsg( "%3.2f: CHECKPOINT_RESTORE: %d upgrade entries changed\n", gpGlobals->curtime, nChanged );
 	}
 
 	// Iterate over play
@@ -1995,6 +2070,104 @@ void CPopulationManager::PostInitialize( void )
 	{
 		m_waveVector[i]->PostInitialize();
 	}
+
+	// resolve the items every invader is given so the first spawns don't pay for the schema search
+	if ( TFGameRules() && TFGameRules()->IsMannVsMachineMode() )
+	{
+		CTFBot::PrecacheItem( "tw_sentrybuster" );
+
+		for ( int iClass = TF_FIRST_NORMAL_CLASS; iClass < TF_LAST_NORMAL_CLASS; ++iClass )
+		{
+			CTFBot::PrecacheItem( g_szRomePromoItems_Hat[iClass] );
+			CTFBot::PrecacheItem( g_szRomePromoItems_Misc[iClass] );
+
+			if ( IsPopFileEventType( MVM_EVENT_POPFILE_HALLOWEEN ) )
+			{
+				CTFBot::PrecacheItem( CFmtStr( "Zombie %s", g_aRawPlayerClassNamesShort[iClass] ) );
+			}
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+// Per-tick spawn budget and spawn cost accounting
+//-------------------------------------------------------------------------
+struct MvMSpawnStats_t
+{
+	int m_attempts;
+	int m_spawned;
+	int m_deferred;
+	double m_totalTime;
+	double m_maxTime;
+};
+
+static CUtlVector< MvMSpawnStats_t > s_spawnStats;		// indexed by wave number
+
+static MvMSpawnStats_t &GetSpawnStats( int waveNumber )
+{
+	waveNumber = Max( waveNumber, 0 );
+
+	while ( s_spawnStats.Count() <= waveNumber )
+	{
+		MvMSpawnStats_t &stats = s_spawnStats[ s_spawnStats.AddToTail() ];
+		V_memset( &stats, 0, sizeof( stats ) );
+	}
+
+	return s_spawnStats[ waveNumber ];
+}
+
+//-------------------------------------------------------------------------
+bool CPopulationManager::CanSpawnThisTick()
+{
+	if ( m_spawnBudgetTick != gpGlobals->tickcount )
+	{
+		m_spawnBudgetTick = gpGlobals->tickcount;
+		m_spawnBudgetUsed = 0;
+	}
+
+	int budget = tf_mvm_spawn_budget_per_tick.GetInt();
+	return ( budget <= 0 || m_spawnBudgetUsed < budget );
+}
+
+//-------------------------------------------------------------------------
+void CPopulationManager::OnSpawnAttempted( int nSpawned, double flSeconds )
+{
+	++m_spawnBudgetUsed;
+
+	MvMSpawnStats_t &stats = GetSpawnStats( GetWaveNumber() );
+	++stats.m_attempts;
+	stats.m_spawned += nSpawned;
+	stats.m_totalTime += flSeconds;
+	stats.m_maxTime = MAX( stats.m_maxTime, flSeconds );
+}
+
+//-------------------------------------------------------------------------
+void CPopulationManager::OnSpawnDeferred()
+{
+	++GetSpawnStats( GetWaveNumber() ).m_deferred;
+}
+
+//-------------------------------------------------------------------------
+void CPopulationManager::PrintSpawnStats()
+{
+	Msg( "Wave  Attempts  Spawned  Deferred  Avg(ms)  Max(ms)\n" );
+
+	FOR_EACH_VEC( s_spawnStats, i )
+	{
+		const MvMSpawnStats_t &stats = s_spawnStats[i];
+		if ( stats.m_attempts == 0 && stats.m_deferred == 0 )
+			continue;
+
+		double avg = stats.m_attempts ? stats.m_totalTime / stats.m_attempts : 0.0;
+		Msg( "%4d  %8d  %7d  %8d  %7.3f  %7.3f\n", i + 1, stats.m_attempts, stats.m_spawned, stats.m_deferred, avg * 1000.0, stats.m_maxTime * 1000.0 );
+	}
+}
+
+//-------------------------------------------------------------------------
+void CPopulationManager::ResetSpawnStats()
+{
+	s_spawnStats.Purge();
 }
 
 //-------------------------------------------------------------------------
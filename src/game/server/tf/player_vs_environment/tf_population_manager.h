@@ -134,6 +134,13 @@ public:
 	void UnpauseSpawning();
 	bool IsSpawningPaused() const { return m_bSpawningPaused; }
 
+	// limits how many spawn groups WaveSpawns may create in a single tick
+	bool CanSpawnThisTick();
+	void OnSpawnAttempted( int nSpawned, double flSeconds );
+	void OnSpawnDeferred();
+	static void PrintSpawnStats();
+	static void ResetSpawnStats();
+
 	bool IsBonusRound() const { return m_bBonusRound; }
 	CBaseCombatCharacter* GetBonusBoss() const { return m_hBonusBoss; }
 
@@ -184,6 +191,7 @@ private:
 	CheckpointSnapshotInfo *FindCheckpointSnapshot( CSteamID id ) const;
 	PlayerUpgradeHistory *FindOrAddPlayerUpgradeHistory ( CTFPlayer *player );
 	PlayerUpgradeHistory *FindOrAddPlayerUpgradeHistory ( CSteamID steamId );
+	static int CopyUpgradeDelta( CUtlVector< CUpgradeInfo > *dest, const CUtlVector< CUpgradeInfo > &src );
 
 	void LoadLastKnownMission();
 	bool LoadMvMMission( KeyValues *pNextMission );
@@ -231,6 +239,8 @@ private:
 	KeyValues *m_pKvpMvMMapCycle;
 
 	bool m_bSpawningPaused;
+	int m_spawnBudgetTick;
+	int m_spawnBudgetUsed;
 	bool m_bIsWaveJumping;
 	bool m_bEndlessOn;
 	CUtlVector< CMvMBotUpgrade > m_BotUpgradesList;
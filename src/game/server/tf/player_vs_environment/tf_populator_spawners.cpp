@@ -763,6 +763,12 @@ static bool ParseDynamicAttributes( CTFBot::EventChangeAttributes_t& event, KeyV
 	else if ( !Q_stricmp( name, "Item" ) )
 	{
 		event.m_items.CopyAndAddToTail( value );
+
+		// resolve the item now so spawning this bot doesn't have to search the schema
+		if ( !CTFBot::PrecacheItem( value ) )
+		{
+			Warning( "TFBotSpawner: Unknown item '%s'\n", value );
+		}
 	}
 	else if ( !Q_stricmp( name, "ItemAttributes" ) )
 	{
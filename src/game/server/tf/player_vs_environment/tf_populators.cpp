@@ -1590,6 +1590,13 @@ void CWaveSpawnPopulator::Update( void )
 				m_myReservedSlotCount = m_spawnCount;
 			}
 
+			// spread large spawn bursts across ticks
+			if ( !g_pPopulationManager->CanSpawnThisTick() )
+			{
+				g_pPopulationManager->OnSpawnDeferred();
+				return;
+			}
+
 			bool bTeleported = ( m_spawnLocationResult == SPAWN_LOCATION_TELEPORTER );
 
 			Vector vSpawnPosition = vec3_origin;
@@ -1617,7 +1624,11 @@ void CWaveSpawnPopulator::Update( void )
 			}
 
 			EntityHandleVector_t m_justSpawnedVector;
-			if ( m_spawner && m_spawner->Spawn( vSpawnPosition, &m_justSpawnedVector ) )
+			double spawnStartTime = Plat_FloatTime();
+			bool bSpawned = ( m_spawner && m_spawner->Spawn( vSpawnPosition, &m_justSpawnedVector ) );
+			g_pPopulationManager->OnSpawnAttempted( m_justSpawnedVector.Count(), Plat_FloatTime() - spawnStartTime );
+
+			if ( bSpawned )
 			{
 				// successfully spawned
 
@@ -224,6 +224,37 @@ public:
 		return pPlayer;
 	}
 
+	virtual int GetReplayPlayerClass( CBasePlayer *pPlayer )
+	{
+		return ToTFPlayer( pPlayer )->GetPlayerClass()->GetClassIndex();
+	}
+
+	virtual void SetupReplayBot( CBasePlayer *pBot, int iTeam, int iClass )
+	{
+		CTFPlayer *pTFBot = ToTFPlayer( pBot );
+
+		if ( pTFBot->GetTeamNumber() != iTeam )
+		{
+			switch ( iTeam )
+			{
+			case TF_TEAM_RED:
+				pTFBot->HandleCommand_JoinTeam( "red" );
+				break;
+			case TF_TEAM_BLUE:
+				pTFBot->HandleCommand_JoinTeam( "blue" );
+				break;
+			default:
+				pTFBot->HandleCommand_JoinTeam( "spectator" );
+				break;
+			}
+		}
+
+		if ( iClass > TF_CLASS_UNDEFINED && iClass < TF_CLASS_COUNT_ALL && !pTFBot->GetPlayerClass()->IsClass( iClass ) )
+		{
+			pTFBot->HandleCommand_JoinClass( GetPlayerClassData( iClass )->m_szClassName );
+		}
+	}
+
 private:
 	int m_nBotsCreated;
 	bool m_bSetupLocalPlayer;
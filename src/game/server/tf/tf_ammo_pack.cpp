@@ -34,6 +34,7 @@ BEGIN_DATADESC( CTFAmmoPack )
 END_DATADESC();
 
 LINK_ENTITY_TO_CLASS( tf_ammo_pack, CTFAmmoPack );
+DEFINE_ENTITY_POOL( CTFAmmoPack, 32 );
 
 PRECACHE_REGISTER( tf_ammo_pack );
 
@@ -42,7 +43,10 @@ PRECACHE_REGISTER( tf_ammo_pack );
 
 void CTFAmmoPack::Spawn( void )
 {
-	Precache();
+	if ( EntityNeedsPrecache( this ) )
+	{
+		Precache();
+	}
 	SetModel( STRING( GetModelName() ) );
 	BaseClass::Spawn();
 
@@ -11,6 +11,7 @@
 #endif
 
 #include "items.h"
+#include "entity_pool.h"
 
 typedef enum
 {	
@@ -78,6 +79,7 @@ private:
 	CTFAmmoPack( const CTFAmmoPack & );
 
 	DECLARE_DATADESC();
+	DECLARE_ENTITY_POOL( CTFAmmoPack );
 };
 
 #endif //TF_AMMO_PACK_H
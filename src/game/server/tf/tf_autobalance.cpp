@@ -212,9 +212,12 @@ double CTFAutobalance::GetTeamAutoBalanceScore( int nTeam ) const
 	if ( pTFPlayerResource && pTeam )
 	{
 		// Tally up total score across everyone and for the specified team
-		for ( int i = 1; i <= MAX_PLAYERS; i++ )
+		CPlayerRegistry &registry = PlayerRegistry();
+		int nPlayerCount = registry.GetPlayerCount();
+
+		for ( int i = 0; i < nPlayerCount; i++ )
 		{
-			CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+			CTFPlayer *pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 			if ( !pPlayer )
 				continue;
 
@@ -260,9 +263,12 @@ double CTFAutobalance::GetPlayerAutoBalanceScore( CTFPlayer *pTFPlayer ) const
 	if ( pTFPlayerResource )
 	{
 		// Tally up total score across everyone and find the particular player's score
-		for ( int i = 1; i <= MAX_PLAYERS; i++ )
+		CPlayerRegistry &registry = PlayerRegistry();
+		int nPlayerCount = registry.GetPlayerCount();
+
+		for ( int i = 0; i < nPlayerCount; i++ )
 		{
-			CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+			CTFPlayer *pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 			if ( !pPlayer )
 				continue;
 
@@ -641,6 +641,10 @@ inline bool isTempBot( CTFPlayer* pPlayer )
 //-----------------------------------------------------------------------------
 void Bot_RunAll( void )
 {
+	// the bots run the recorded commands instead
+	if ( g_pServerBenchmark->IsReplayRunning() )
+		return;
+
 	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
 	{
 		CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
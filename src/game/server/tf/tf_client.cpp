@@ -36,6 +36,7 @@
 #include "tf_gamerules.h"
 #include "tier0/vprof.h"
 #include "tf_bot_temp.h"
+#include "tick_time_stats.h"
 #include "filesystem.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -255,6 +256,7 @@ void GameStartFrame( void )
 
 	gpGlobals->teamplay = teamplay.GetInt() ? true : false;
 
+	TICK_PHASE( TICK_PHASE_BOTS );
 	Bot_RunAll();
 }
 
@@ -0,0 +1,495 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Record player movement commands and replay them through CTFGameMovement
+//
+// tf_movement_record captures, for every command a player runs, the CMoveData and
+// player state handed to CTFGameMovement::ProcessMovement() along with a CRC of the
+// result. tf_movement_bench feeds each command back through ProcessMovement() on a
+// player of the same class, timing it, counting hull traces, and checking the result
+// against the recorded CRC so movement changes can be shown to be bit-exact.
+//
+//=============================================================================
+#include "cbase.h"
+#include "tf_player.h"
+#include "tf_movement_replay.h"
+#include "movehelper_server.h"
+#include "filesystem.h"
+#include "tier0/fasttimer.h"
+#include "tier1/checksum_crc.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+extern IGameMovement *g_pGameMovement;
+
+#define TF_MOVEMENT_REPLAY_VERSION		2
+#define TF_MOVEMENT_REPLAY_PATH			"movement"
+#define TF_MOVEMENT_REPLAY_EXTENSION	"tfmove"
+
+struct TFMovementReplayHeader_t
+{
+	int		m_nVersion;
+	int		m_nMoveDataSize;			// the records are raw structs, so only replay them with the build that wrote them
+	int		m_nCommandSize;
+	int		m_nClass;
+	int		m_nCommands;
+	char	m_szMap[ MAX_MAP_NAME ];
+};
+
+struct TFMovementReplayCommand_t
+{
+	CMoveData			m_move;			// as passed to ProcessMovement()
+	TFMovementState_t	m_state;
+	CRC32_t				m_nResultCRC;	// of the player after ProcessMovement()
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Everything a replayed command has to reproduce exactly
+//-----------------------------------------------------------------------------
+static CRC32_t ComputeResultCRC( CTFPlayer *pPlayer, const CMoveData *pMove )
+{
+	TFMovementState_t state;
+	TFGameMovement_CaptureState( pPlayer, &state );
+
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, &pMove->GetAbsOrigin(), sizeof( Vector ) );
+	CRC32_ProcessBuffer( &crc, &pMove->m_vecVelocity, sizeof( Vector ) );
+	CRC32_ProcessBuffer( &crc, &state.m_vecViewOffset, sizeof( Vector ) );
+	CRC32_ProcessBuffer( &crc, &state.m_fFlags, sizeof( state.m_fFlags ) );
+	CRC32_ProcessBuffer( &crc, &state.m_bOnGround, sizeof( state.m_bOnGround ) );
+	CRC32_ProcessBuffer( &crc, &state.m_nWaterLevel, sizeof( state.m_nWaterLevel ) );
+	CRC32_ProcessBuffer( &crc, &state.m_flFallVelocity, sizeof( state.m_flFallVelocity ) );
+	CRC32_ProcessBuffer( &crc, &state.m_bDucked, sizeof( state.m_bDucked ) );
+	CRC32_ProcessBuffer( &crc, &state.m_bDucking, sizeof( state.m_bDucking ) );
+	CRC32_ProcessBuffer( &crc, &state.m_nAirDash, sizeof( state.m_nAirDash ) );
+	CRC32_Final( &crc );
+
+	return crc;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The recording in progress, if any
+//-----------------------------------------------------------------------------
+class CTFMovementRecorder
+{
+public:
+	CTFMovementRecorder( void )
+	{
+		m_isRecording = false;
+	}
+
+	bool IsRecording( void ) const { return m_isRecording; }
+	bool IsRecording( CTFPlayer *pPlayer ) const { return m_isRecording && m_hPlayer == pPlayer; }
+
+	void Start( CTFPlayer *pPlayer, const char *pszName )
+	{
+		m_hPlayer = pPlayer;
+		m_name = pszName;
+		m_commands.RemoveAll();
+		m_nClass = pPlayer->GetPlayerClass()->GetClassIndex();
+		m_isRecording = true;
+	}
+
+	void RecordInput( CTFPlayer *pPlayer, const CMoveData *pMove )
+	{
+		TFMovementReplayCommand_t &command = m_commands[ m_commands.AddToTail() ];
+		command.m_move = *pMove;
+		TFGameMovement_CaptureState( pPlayer, &command.m_state );
+		command.m_nResultCRC = 0;
+	}
+
+	void RecordOutput( CTFPlayer *pPlayer, const CMoveData *pMove )
+	{
+		if ( m_commands.Count() )
+		{
+			m_commands.Tail().m_nResultCRC = ComputeResultCRC( pPlayer, pMove );
+		}
+
+		// the recording is only good for one class
+		if ( pPlayer->GetPlayerClass()->GetClassIndex() != m_nClass )
+		{
+			Warning( "Player changed class, stopping movement recording\n" );
+			Stop();
+		}
+	}
+
+	void Stop( void )
+	{
+		if ( !m_isRecording )
+			return;
+
+		m_isRecording = false;
+
+		TFMovementReplayHeader_t header;
+		V_memset( &header, 0, sizeof( header ) );
+		header.m_nVersion = TF_MOVEMENT_REPLAY_VERSION;
+		header.m_nMoveDataSize = sizeof( CMoveData );
+		header.m_nCommandSize = sizeof( TFMovementReplayCommand_t );
+		header.m_nClass = m_nClass;
+		header.m_nCommands = m_commands.Count();
+		V_strncpy( header.m_szMap, STRING( gpGlobals->mapname ), sizeof( header.m_szMap ) );
+
+		CUtlBuffer buf;
+		buf.Put( &header, sizeof( header ) );
+		buf.Put( m_commands.Base(), m_commands.Count() * sizeof( TFMovementReplayCommand_t ) );
+
+		char filename[ MAX_PATH ];
+		V_snprintf( filename, sizeof( filename ), "%s/%s.%s", TF_MOVEMENT_REPLAY_PATH, m_name.Get(), TF_MOVEMENT_REPLAY_EXTENSION );
+
+		filesystem->CreateDirHierarchy( TF_MOVEMENT_REPLAY_PATH, "MOD" );
+		if ( !filesystem->WriteFile( filename, "MOD", buf ) )
+		{
+			Warning( "Unable to write '%s'\n", filename );
+		}
+		else
+		{
+			Msg( "Wrote %d movement commands to '%s'\n", m_commands.Count(), filename );
+		}
+
+		m_commands.Purge();
+	}
+
+private:
+	bool m_isRecording;
+	CHandle< CTFPlayer > m_hPlayer;
+	CUtlString m_name;
+	int m_nClass;
+	CUtlVector< TFMovementReplayCommand_t > m_commands;
+};
+
+static CTFMovementRecorder &TheMovementRecorder( void )
+{
+	static CTFMovementRecorder recorder;
+	return recorder;
+}
+
+
+//-----------------------------------------------------------------------------
+bool TFMovementReplay_IsRecording( CTFPlayer *pPlayer )
+{
+	return TheMovementRecorder().IsRecording( pPlayer );
+}
+
+void TFMovementReplay_RecordInput( CTFPlayer *pPlayer, const CMoveData *pMove )
+{
+	TheMovementRecorder().RecordInput( pPlayer, pMove );
+}
+
+void TFMovementReplay_RecordOutput( CTFPlayer *pPlayer, const CMoveData *pMove )
+{
+	TheMovementRecorder().RecordOutput( pPlayer, pMove );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Load a recording, rejecting ones written by a different build or on a different map
+//-----------------------------------------------------------------------------
+static bool LoadMovementReplay( const char *filename, TFMovementReplayHeader_t *pHeader, CUtlVector< TFMovementReplayCommand_t > *pCommands )
+{
+	CUtlBuffer buf;
+	if ( !filesystem->ReadFile( filename, "MOD", buf ) )
+	{
+		Warning( "%s: unable to read\n", filename );
+		return false;
+	}
+
+	if ( buf.TellMaxPut() < (int)sizeof( TFMovementReplayHeader_t ) )
+	{
+		Warning( "%s: truncated\n", filename );
+		return false;
+	}
+
+	buf.Get( pHeader, sizeof( TFMovementReplayHeader_t ) );
+
+	if ( pHeader->m_nVersion != TF_MOVEMENT_REPLAY_VERSION ||
+		 pHeader->m_nMoveDataSize != (int)sizeof( CMoveData ) ||
+		 pHeader->m_nCommandSize != (int)sizeof( TFMovementReplayCommand_t ) )
+	{
+		Warning( "%s: recorded by an incompatible build\n", filename );
+		return false;
+	}
+
+	if ( V_stricmp( pHeader->m_szMap, STRING( gpGlobals->mapname ) ) )
+	{
+		Warning( "%s: recorded on '%s'\n", filename, pHeader->m_szMap );
+		return false;
+	}
+
+	if ( pHeader->m_nCommands <= 0 || buf.GetBytesRemaining() != pHeader->m_nCommands * (int)sizeof( TFMovementReplayCommand_t ) )
+	{
+		Warning( "%s: truncated\n", filename );
+		return false;
+	}
+
+	pCommands->SetCount( pHeader->m_nCommands );
+	buf.Get( pCommands->Base(), pHeader->m_nCommands * sizeof( TFMovementReplayCommand_t ) );
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Find a living player of the given class to move, preferring whoever asked
+//-----------------------------------------------------------------------------
+static CTFPlayer *FindReplayPlayer( int nClass )
+{
+	CTFPlayer *pCaller = ToTFPlayer( UTIL_GetCommandClient() );
+	if ( pCaller && pCaller->IsAlive() && pCaller->IsPlayerClass( nClass ) )
+		return pCaller;
+
+	CUtlVector< CTFPlayer * > playerVector;
+	CollectPlayers( &playerVector, TEAM_ANY, COLLECT_ONLY_LIVING_PLAYERS );
+
+	FOR_EACH_VEC( playerVector, i )
+	{
+		if ( playerVector[i]->IsPlayerClass( nClass ) )
+			return playerVector[i];
+	}
+
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move helper used while benchmarking. Replayed landings must not hurt
+//			the player, and sounds, events and animation would only add noise to
+//			the timings, so those do nothing. Everything movement reads is passed
+//			through to the server's helper.
+//-----------------------------------------------------------------------------
+class CBenchMoveHelper : public IMoveHelperServer
+{
+public:
+	void Install( CBasePlayer *pHost )
+	{
+		m_pPrevious = GetSingleton();
+		MoveHelperServer()->SetHost( pHost );
+		SetSingleton( this );
+	}
+
+	void Uninstall( void )
+	{
+		MoveHelperServer()->SetHost( NULL );
+		SetSingleton( m_pPrevious );
+		m_pPrevious = NULL;
+	}
+
+	virtual	char const *GetName( EntityHandle_t handle ) const			{ return MoveHelperServer()->GetName( handle ); }
+
+	virtual void ResetTouchList( void )										{ }
+	virtual bool AddToTouched( const CGameTrace &tr, const Vector &impactvelocity )	{ return false; }
+	virtual void ProcessImpacts( void )										{ }
+
+	virtual void Con_NPrintf( int idx, char const *fmt, ... )				{ }
+
+	virtual void StartSound( const Vector &origin, int channel, char const *sample, float volume, soundlevel_t soundlevel, int fFlags, int pitch ) { }
+	virtual void StartSound( const Vector &origin, const char *soundname )	{ }
+	virtual void PlaybackEventFull( int flags, int clientindex, unsigned short eventindex, float delay, Vector &origin, Vector &angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 ) { }
+
+	virtual bool PlayerFallingDamage( void )								{ return true; }
+	virtual void PlayerSetAnimation( PLAYER_ANIM playerAnim )				{ }
+
+	virtual IPhysicsSurfaceProps *GetSurfaceProps( void )					{ return MoveHelperServer()->GetSurfaceProps(); }
+	virtual bool IsWorldEntity( const CBaseHandle &handle )					{ return MoveHelperServer()->IsWorldEntity( handle ); }
+
+	virtual void SetHost( CBasePlayer *host )								{ MoveHelperServer()->SetHost( host ); }
+
+private:
+	IMoveHelper *m_pPrevious;
+};
+
+static CBenchMoveHelper s_BenchMoveHelper;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replay one recording, returning false if there was nobody to replay it on
+//-----------------------------------------------------------------------------
+static bool BenchMovementReplay( const char *filename, int nPasses )
+{
+	TFMovementReplayHeader_t header;
+	CUtlVector< TFMovementReplayCommand_t > commands;
+	if ( !LoadMovementReplay( filename, &header, &commands ) )
+		return false;
+
+	CTFPlayer *pPlayer = FindReplayPlayer( header.m_nClass );
+	if ( !pPlayer )
+	{
+		Warning( "%s: no living %s to replay on\n", filename, GetPlayerClassData( header.m_nClass )->m_szClassName );
+		return false;
+	}
+
+	// Put everything back the way it was when we're done
+	TFMovementState_t savedState;
+	TFGameMovement_CaptureState( pPlayer, &savedState );
+	Vector vecSavedOrigin = pPlayer->GetAbsOrigin();
+	Vector vecSavedVelocity = pPlayer->GetAbsVelocity();
+	QAngle angSavedAngles = pPlayer->GetLocalAngles();
+	QAngle angSavedViewAngles = pPlayer->pl.v_angle;
+	EHANDLE hSavedGround = pPlayer->GetGroundEntity();
+	float flSavedFrameTime = gpGlobals->frametime;
+	int nSavedHealth = pPlayer->GetHealth();
+
+	s_BenchMoveHelper.Install( pPlayer );
+
+	int nTraces = 0;
+	int nTracesSaved = 0;
+	int nMismatches = 0;
+	int iFirstMismatch = -1;
+	CCycleCount moveTime;
+	CRC32_t checksum = 0;
+
+	for ( int p = 0; p < nPasses; ++p )
+	{
+		CRC32_Init( &checksum );
+
+		FOR_EACH_VEC( commands, i )
+		{
+			const TFMovementReplayCommand_t &command = commands[i];
+
+			CMoveData move = command.m_move;
+			move.m_nPlayerHandle = pPlayer;
+
+			TFGameMovement_ApplyState( pPlayer, command.m_state );
+			pPlayer->SetAbsOrigin( move.GetAbsOrigin() );
+			pPlayer->SetAbsVelocity( move.m_vecVelocity );
+			pPlayer->SetLocalAngles( move.m_vecAngles );
+			pPlayer->pl.v_angle = move.m_vecViewAngles;
+
+			int nTracesBefore = TFGameMovement_GetTraceCount();
+			int nTracesSavedBefore = TFGameMovement_GetTracesSavedCount();
+
+			CFastTimer timer;
+			timer.Start();
+			g_pGameMovement->ProcessMovement( pPlayer, &move );
+			timer.End();
+
+			moveTime += timer.GetDuration();
+			nTraces += TFGameMovement_GetTraceCount() - nTracesBefore;
+			nTracesSaved += TFGameMovement_GetTracesSavedCount() - nTracesSavedBefore;
+
+			CRC32_t result = ComputeResultCRC( pPlayer, &move );
+			CRC32_ProcessBuffer( &checksum, &result, sizeof( result ) );
+
+			if ( result != command.m_nResultCRC && p == 0 )
+			{
+				++nMismatches;
+				if ( iFirstMismatch < 0 )
+				{
+					iFirstMismatch = i;
+				}
+			}
+		}
+
+		CRC32_Final( &checksum );
+	}
+
+	s_BenchMoveHelper.Uninstall();
+
+	TFGameMovement_ApplyState( pPlayer, savedState );
+	pPlayer->SetGroundEntity( hSavedGround );
+	pPlayer->SetAbsOrigin( vecSavedOrigin );
+	pPlayer->SetAbsVelocity( vecSavedVelocity );
+	pPlayer->SetLocalAngles( angSavedAngles );
+	pPlayer->pl.v_angle = angSavedViewAngles;
+	gpGlobals->frametime = flSavedFrameTime;
+	pPlayer->SetHealth( nSavedHealth );
+
+	int nRun = commands.Count() * nPasses;
+
+	Msg( "%s (%s, %d commands x %d)\n", filename, GetPlayerClassData( header.m_nClass )->m_szClassName, commands.Count(), nPasses );
+	Msg( "  fall damage, sounds and touches are not applied while replaying\n" );
+	Msg( "  %.1f traces/command (%.1f saved), %.0f ns/command, checksum %08X\n", (float)nTraces / nRun, (float)nTracesSaved / nRun, moveTime.GetMicrosecondsF() * 1000.0 / nRun, checksum );
+
+	if ( nMismatches )
+	{
+		Warning( "  %d commands did not match the recording, first at command %d\n", nMismatches, iFirstMismatch );
+	}
+	else
+	{
+		Msg( "  all commands match the recording\n" );
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( tf_movement_record, "Record the movement commands of a player to " TF_MOVEMENT_REPLAY_PATH "/<name>." TF_MOVEMENT_REPLAY_EXTENSION ". Arguments: <name> [player entindex]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: %s <name> [player entindex]\n", args[0] );
+		return;
+	}
+
+	CTFPlayer *pPlayer = ( args.ArgC() > 2 ) ? ToTFPlayer( UTIL_PlayerByIndex( atoi( args[2] ) ) ) : ToTFPlayer( UTIL_GetCommandClient() );
+	if ( !pPlayer )
+	{
+		Msg( "No player to record\n" );
+		return;
+	}
+
+	TheMovementRecorder().Stop();
+	TheMovementRecorder().Start( pPlayer, args[1] );
+
+	Msg( "Recording movement of %s\n", pPlayer->GetPlayerName() );
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( tf_movement_record_stop, "Stop recording movement and write it out", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TheMovementRecorder().Stop();
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( tf_movement_bench, "Replay recorded movement through the movement code and report traces and time per command. Arguments: [passes] [name]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( TheMovementRecorder().IsRecording() )
+	{
+		Msg( "Stop recording first\n" );
+		return;
+	}
+
+	int nPasses = ( args.ArgC() > 1 ) ? MAX( 1, atoi( args[1] ) ) : 10;
+
+	if ( args.ArgC() > 2 )
+	{
+		char filename[ MAX_PATH ];
+		V_snprintf( filename, sizeof( filename ), "%s/%s.%s", TF_MOVEMENT_REPLAY_PATH, args[2], TF_MOVEMENT_REPLAY_EXTENSION );
+		BenchMovementReplay( filename, nPasses );
+		return;
+	}
+
+	int nReplayed = 0;
+
+	FileFindHandle_t hFind;
+	const char *pszFile = filesystem->FindFirstEx( TF_MOVEMENT_REPLAY_PATH "/*." TF_MOVEMENT_REPLAY_EXTENSION, "MOD", &hFind );
+	while ( pszFile )
+	{
+		char filename[ MAX_PATH ];
+		V_snprintf( filename, sizeof( filename ), "%s/%s", TF_MOVEMENT_REPLAY_PATH, pszFile );
+
+		if ( BenchMovementReplay( filename, nPasses ) )
+		{
+			++nReplayed;
+		}
+
+		pszFile = filesystem->FindNext( hFind );
+	}
+	filesystem->FindClose( hFind );
+
+	Msg( "Replayed %d recordings\n", nReplayed );
+}
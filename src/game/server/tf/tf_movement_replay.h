@@ -0,0 +1,57 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Record player movement commands and replay them through CTFGameMovement
+//
+//=============================================================================
+
+#ifndef TF_MOVEMENT_REPLAY_H
+#define TF_MOVEMENT_REPLAY_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamemovement.h"
+
+class CTFPlayer;
+
+//-----------------------------------------------------------------------------
+// Player state CTFGameMovement reads besides what is in CMoveData. Standing on
+// anything other than the world is replayed as standing on the world.
+//-----------------------------------------------------------------------------
+struct TFMovementState_t
+{
+	Vector	m_vecBaseVelocity;
+	Vector	m_vecViewOffset;
+	int		m_fFlags;
+	int		m_nMoveType;
+	int		m_nWaterLevel;
+	int		m_nWaterType;
+	bool	m_bOnGround;
+	float	m_flGravity;
+	float	m_flSurfaceFriction;
+	float	m_flFallVelocity;
+	bool	m_bDucked;
+	bool	m_bDucking;
+	bool	m_bInDuckJump;
+	float	m_flDucktime;
+	float	m_flDuckJumpTime;
+	float	m_flJumpTime;
+	int		m_nAirDash;
+	int		m_nAirDucked;
+	int		m_nCond[5];
+	float	m_flCurTime;
+	int		m_nTickCount;
+};
+
+// Implemented by CTFGameMovement, which is allowed to see all of the state it moves
+void TFGameMovement_CaptureState( CTFPlayer *pPlayer, TFMovementState_t *pState );
+void TFGameMovement_ApplyState( CTFPlayer *pPlayer, const TFMovementState_t &state );
+int TFGameMovement_GetTraceCount( void );
+int TFGameMovement_GetTracesSavedCount( void );
+
+// Called by CTFGameMovement::ProcessMovement() before and after each command
+bool TFMovementReplay_IsRecording( CTFPlayer *pPlayer );
+void TFMovementReplay_RecordInput( CTFPlayer *pPlayer, const CMoveData *pMove );
+void TFMovementReplay_RecordOutput( CTFPlayer *pPlayer, const CMoveData *pMove );
+
+#endif // TF_MOVEMENT_REPLAY_H
@@ -938,15 +938,9 @@ bool CObjectSentrygun::FindTarget()
 			if ( pTargetPlayer == NULL )
 				continue;
 
-			// Make sure the player is alive.
-			if ( !pTargetPlayer->IsAlive() )
-				continue;
-
-			if ( pTargetPlayer->GetFlags() & FL_NOTARGET )
-				continue;
-
-			vecTargetCenter = pTargetPlayer->GetAbsOrigin();
-			vecTargetCenter += pTargetPlayer->GetViewOffset();
+			// Reject by range first; the registry only recomputes an eye position after that player moves,
+			// so every sentry this tick shares it.
+			vecTargetCenter = PlayerRegistry().GetEyePosition( pTargetPlayer );
 			VectorSubtract( vecTargetCenter, vecSentryOrigin, vecSegment );
 			float flDist2 = vecSegment.LengthSqr();
 
@@ -954,6 +948,13 @@ bool CObjectSentrygun::FindTarget()
 			if ( flDist2 > flMinDist2 )
 				continue;
 
+			// Make sure the player is alive.
+			if ( !pTargetPlayer->IsAlive() )
+				continue;
+
+			if ( pTargetPlayer->GetFlags() & FL_NOTARGET )
+				continue;
+
 			// It is closer, check to see if the target is valid.
 			if ( ValidTargetPlayer( pTargetPlayer, vecSentryOrigin, vecTargetCenter ) )
 			{
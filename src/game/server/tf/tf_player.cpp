@@ -8599,16 +8599,18 @@ CTFPlayer *CTFPlayer::TeamFortress_GetDisguiseTarget( int nTeam, int nClass )
 	CTFPlayer *pPlayer = NULL;
 
 	// Loop through players and attempt to find a player as the team/class we're disguising as
+	CPlayerRegistry &registry = PlayerRegistry();
+	int nPlayers = registry.GetPlayerCount();
 	int i;
-	for ( i = 1; i <= gpGlobals->maxClients; i++ )
+	for ( i = 0; i < nPlayers; i++ )
 	{
-		pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+		pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 		if ( pPlayer && ( pPlayer != pLastTarget ) )
 		{
 			// First, try to find a player with the same color AND skin
 			if ( ( pPlayer->GetTeamNumber() == nTeam ) && ( pPlayer->GetPlayerClass()->GetClassIndex() == nClass ) )
 			{
-				potentialTargets.AddToHead( i );
+				potentialTargets.AddToHead( pPlayer->entindex() );
 			}
 		}
 	}
@@ -8621,12 +8623,12 @@ CTFPlayer *CTFPlayer::TeamFortress_GetDisguiseTarget( int nTeam, int nClass )
 	}
 
 	// we didn't find someone with the class, so just find someone with the same team color
-	for ( i = 1; i <= gpGlobals->maxClients; i++ )
+	for ( i = 0; i < nPlayers; i++ )
 	{
-		pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+		pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 		if ( pPlayer && ( pPlayer->GetTeamNumber() == nTeam ) )
 		{
-			potentialTargets.AddToHead( i );
+			potentialTargets.AddToHead( pPlayer->entindex() );
 		}
 	}
 
@@ -120,6 +120,8 @@ void CTFPlayerResource::UpdatePlayerData( void )
 {
 	m_vecRedPlayers.RemoveAll();
 	m_vecBluePlayers.RemoveAll();
+	m_setRedPlayers.RemoveAll();
+	m_setBluePlayers.RemoveAll();
 	m_vecFreeSlots.RemoveAll();
 
 	BaseClass::UpdatePlayerData();
@@ -135,10 +137,10 @@ void CTFPlayerResource::UpdatePlayerData( void )
 			CMatchInfo::PlayerMatchData_t *pData = pMatch->GetMatchDataForPlayer( i );
 			uint32 unAccountID = pData->steamID.GetAccountID();
 			int iTeam = TFGameRules()->GetGameTeamForGCTeam( pData->eGCTeam );
-			CUtlVector< uint32 >* pVecPlayers = iTeam == TF_TEAM_RED ? &m_vecRedPlayers : &m_vecBluePlayers;
+			CUtlHashtable< uint32 >* pSetPlayers = iTeam == TF_TEAM_RED ? &m_setRedPlayers : &m_setBluePlayers;
 
 			// add players that are not yet connected to the server
-			if ( !pData->bDropped && pVecPlayers->Find( unAccountID ) == pVecPlayers->InvalidIndex() && m_vecFreeSlots.Count() > 0 )
+			if ( !pData->bDropped && !pSetPlayers->HasElement( unAccountID ) && m_vecFreeSlots.Count() > 0 )
 			{
 				int iIndex = m_vecFreeSlots[0];
 				m_vecFreeSlots.Remove( 0 );
@@ -317,11 +319,13 @@ void CTFPlayerResource::UpdateConnectedPlayer( int iIndex, CBasePlayer *pPlayer
 	}
 
 	CUtlVector< uint32 >* pVecPlayers = ( iTeam == TF_TEAM_RED ) ? &m_vecRedPlayers : ( ( iTeam == TF_TEAM_BLUE ) ? &m_vecBluePlayers : NULL );
+	CUtlHashtable< uint32 >* pSetPlayers = ( iTeam == TF_TEAM_RED ) ? &m_setRedPlayers : &m_setBluePlayers;
 	if ( pVecPlayers )
 	{
-		if ( pVecPlayers->Find( steamID.GetAccountID() ) == pVecPlayers->InvalidIndex()	)
+		if ( !pSetPlayers->HasElement( steamID.GetAccountID() ) )
 		{
 			pVecPlayers->AddToTail( steamID.GetAccountID() );
+			pSetPlayers->Insert( steamID.GetAccountID() );
 		}
 	}
 
@@ -361,7 +365,9 @@ void CTFPlayerResource::UpdateDisconnectedPlayer( int iIndex )
 					m_bValid.Set( iIndex, 1 );
 
 					CUtlVector< uint32 >* pVecPlayers = iTeam == TF_TEAM_RED ? &m_vecRedPlayers : &m_vecBluePlayers;
+					CUtlHashtable< uint32 >* pSetPlayers = iTeam == TF_TEAM_RED ? &m_setRedPlayers : &m_setBluePlayers;
 					pVecPlayers->AddToTail( unAccountID );
+					pSetPlayers->Insert( unAccountID );
 					return;
 				}
 			}
@@ -374,6 +380,15 @@ void CTFPlayerResource::UpdateDisconnectedPlayer( int iIndex )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Without a match an empty slot is always reset to the same state, but
+//			during one it may be preserved for, or handed to, a match player.
+//-----------------------------------------------------------------------------
+bool CTFPlayerResource::CanSkipDisconnectedSlots( void )
+{
+	return GTFGCClientSystem()->GetMatch() == NULL;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
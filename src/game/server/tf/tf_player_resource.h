@@ -12,6 +12,7 @@
 #endif
 
 #include "tf_player_shared.h"
+#include "tier1/utlhashtable.h"
 
 class CTFPlayerResource : public CPlayerResource, public CGameEventListener
 {
@@ -40,6 +41,7 @@ public:
 protected:
 	virtual void UpdateConnectedPlayer( int iIndex, CBasePlayer *pPlayer ) OVERRIDE;
 	virtual void UpdateDisconnectedPlayer( int iIndex ) OVERRIDE;
+	virtual bool CanSkipDisconnectedSlots( void ) OVERRIDE;
 
 	CNetworkArray( int,	m_iTotalScore, MAX_PLAYERS_ARRAY_SAFE );
 	CNetworkArray( int, m_iPlayerClass, MAX_PLAYERS_ARRAY_SAFE );
@@ -80,6 +82,10 @@ protected:
 	CUtlVector< uint32 > m_vecRedPlayers;
 	CUtlVector< uint32 > m_vecBluePlayers;
 	CUtlVector< int > m_vecFreeSlots;
+
+	// same account IDs as m_vecRedPlayers and m_vecBluePlayers, for membership tests
+	CUtlHashtable< uint32 > m_setRedPlayers;
+	CUtlHashtable< uint32 > m_setBluePlayers;
 };
 
 #endif // TF_PLAYER_RESOURCE_H
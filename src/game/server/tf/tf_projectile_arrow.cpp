@@ -51,6 +51,7 @@
 #define CLAW_REPAIR_EFFECT_RED		"repair_claw_heal_red"
 //-----------------------------------------------------------------------------
 LINK_ENTITY_TO_CLASS( tf_projectile_arrow, CTFProjectile_Arrow );
+DEFINE_ENTITY_POOL( CTFProjectile_Arrow, 16 );
 PRECACHE_WEAPON_REGISTER( tf_projectile_arrow );
 
 IMPLEMENT_NETWORKCLASS_ALIASED( TFProjectile_Arrow, DT_TFProjectile_Arrow )
@@ -12,6 +12,7 @@
 #include "tf_player.h"
 #include "tf_weaponbase_rocket.h"
 #include "iscorer.h"
+#include "entity_pool.h"
 
 class CTFProjectile_Arrow : public CTFBaseRocket, public IScorer
 {
@@ -111,6 +112,8 @@ protected:
 	float			m_flInitTime;
 
 	bool			m_bApplyMilkOnHit;		// For Apothacary's Arrow which can sometimes be special
+
+	DECLARE_ENTITY_POOL( CTFProjectile_Arrow );
 };
 
 class CTFProjectile_HealingBolt : public CTFProjectile_Arrow
@@ -0,0 +1,164 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Fire a ring of TF projectiles and time the ticks they fly in
+//
+//=============================================================================
+#include "cbase.h"
+#include "tf_player.h"
+#include "tf_projectile_rocket.h"
+#include "tf_projectile_arrow.h"
+#include "tf_projectile_flare.h"
+#include "tier0/fasttimer.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+//-----------------------------------------------------------------------------
+// Times the entity think and simulation pass of every tick while the bench
+// projectiles are in flight. Nothing is hooked into the projectiles themselves,
+// so the times include every other entity too; compare runs with different
+// projectile counts to get the cost per projectile.
+//-----------------------------------------------------------------------------
+class CTFProjectileBench : public CAutoGameSystemPerFrame
+{
+public:
+	CTFProjectileBench( void ) : CAutoGameSystemPerFrame( "CTFProjectileBench" )
+	{
+		m_endTick = -1;
+		m_timing = false;
+	}
+
+	virtual void LevelShutdownPostEntity( void )
+	{
+		m_endTick = -1;
+		m_timing = false;
+		m_projectiles.Purge();
+	}
+
+	virtual void FrameUpdatePreEntityThink( void )
+	{
+		if ( m_endTick < 0 )
+			return;
+
+		m_timing = true;
+		m_timer.Start();
+	}
+
+	virtual void FrameUpdatePostEntityThink( void );
+
+	void Start( int nTicks )
+	{
+		m_endTick = gpGlobals->tickcount + nTicks;
+		m_ticks = 0;
+		m_projectileTicks = 0;
+		m_seconds = 0.0;
+		m_maxTickSeconds = 0.0;
+	}
+
+	CUtlVector< EHANDLE > m_projectiles;
+
+private:
+	int m_endTick;
+	bool m_timing;				// the timer was started this frame
+	int m_ticks;
+	int m_projectileTicks;		// sum over ticks of the bench projectiles alive
+	double m_seconds;
+	double m_maxTickSeconds;
+	CFastTimer m_timer;
+};
+
+static CTFProjectileBench g_TFProjectileBench;
+
+//-----------------------------------------------------------------------------
+void CTFProjectileBench::FrameUpdatePostEntityThink( void )
+{
+	if ( m_endTick < 0 || !m_timing )
+		return;
+
+	m_timer.End();
+	m_timing = false;
+
+	int nAlive = 0;
+	FOR_EACH_VEC( m_projectiles, i )
+	{
+		CBaseEntity *pProjectile = m_projectiles[i];
+		if ( pProjectile && !pProjectile->IsMarkedForDeletion() )
+		{
+			++nAlive;
+		}
+	}
+
+	double seconds = m_timer.GetDuration().GetSeconds();
+	++m_ticks;
+	m_projectileTicks += nAlive;
+	m_seconds += seconds;
+	m_maxTickSeconds = MAX( m_maxTickSeconds, seconds );
+
+	if ( gpGlobals->tickcount < m_endTick )
+		return;
+
+	m_endTick = -1;
+	m_projectiles.Purge();
+
+	Msg( "%d ticks, %.1f bench projectiles alive per tick on average\n", m_ticks, (float)m_projectileTicks / m_ticks );
+	Msg( "  entity simulation %.3f ms per tick, %.3f ms worst tick (includes all other entities)\n",
+		m_seconds * 1000.0 / m_ticks, m_maxTickSeconds * 1000.0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Fire projectiles in a ring around the issuing player and time their flight
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( tf_projectile_bench, "Fire projectiles in a ring around you and report the server cost of the ticks they fly in. Arguments: <count> [rocket|arrow|flare] [seconds]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	CTFPlayer *pPlayer = ToTFPlayer( UTIL_GetCommandClient() );
+	if ( !pPlayer || !pPlayer->IsAlive() )
+	{
+		Msg( "Must be run by a live player\n" );
+		return;
+	}
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: tf_projectile_bench <count> [rocket|arrow|flare] [seconds]\n" );
+		return;
+	}
+
+	int nCount = clamp( atoi( args[1] ), 0, 1024 );
+	const char *pszType = ( args.ArgC() > 2 ) ? args[2] : "rocket";
+	float flSeconds = ( args.ArgC() > 3 ) ? MAX( atof( args[3] ), TICK_INTERVAL ) : 2.0f;
+
+	CBaseEntity *pLauncher = pPlayer->GetActiveTFWeapon();
+	Vector vecSrc = pPlayer->EyePosition();
+
+	g_TFProjectileBench.m_projectiles.RemoveAll();
+
+	for ( int i = 0; i < nCount; ++i )
+	{
+		// spread over several pitches so a ring doesn't all land at once
+		QAngle angFire( -5.0f * ( i % 4 ), 360.0f * i / nCount, 0.0f );
+
+		CBaseEntity *pProjectile = NULL;
+		if ( FStrEq( pszType, "arrow" ) )
+		{
+			pProjectile = CTFProjectile_Arrow::Create( vecSrc, angFire, 2400.0f, 0.2f, TF_PROJECTILE_ARROW, pPlayer, pPlayer );
+		}
+		else if ( FStrEq( pszType, "flare" ) )
+		{
+			pProjectile = CTFProjectile_Flare::Create( pLauncher, vecSrc, angFire, pPlayer, pPlayer );
+		}
+		else
+		{
+			pProjectile = CTFProjectile_Rocket::Create( pLauncher, vecSrc, angFire, pPlayer, pPlayer );
+		}
+
+		if ( pProjectile )
+		{
+			g_TFProjectileBench.m_projectiles.AddToTail( pProjectile );
+		}
+	}
+
+	g_TFProjectileBench.Start( TIME_TO_TICKS( flSeconds ) );
+}
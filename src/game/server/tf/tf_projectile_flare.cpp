@@ -22,6 +22,7 @@
 #define FLARE_THINK_CONTEXT			"CTFProjectile_FlareThink"
 
 LINK_ENTITY_TO_CLASS( tf_projectile_flare, CTFProjectile_Flare );
+DEFINE_ENTITY_POOL( CTFProjectile_Flare, 16 );
 PRECACHE_WEAPON_REGISTER( tf_projectile_flare );
 
 IMPLEMENT_NETWORKCLASS_ALIASED( TFProjectile_Flare, DT_TFProjectile_Flare )
@@ -506,10 +507,11 @@ void CTFProjectile_Flare::PerformCustomPhysics( Vector *pNewPosition, Vector *pN
 		float flBestDistance = flMaxSeekDistanceSqr;
 
 		// Loop through players and attempt to find a seek target
-		int i;
-		for ( i = 1; i <= gpGlobals->maxClients; i++ )
+		CPlayerRegistry &registry = PlayerRegistry();
+		int nPlayers = registry.GetPlayerCount();
+		for ( int i = 0; i < nPlayers; i++ )
 		{
-			CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+			CTFPlayer *pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 			if ( !pPlayer )
 				continue;
 
@@ -11,6 +11,7 @@
 
 #include "tf_weaponbase_rocket.h"
 #include "iscorer.h"
+#include "entity_pool.h"
 
 // Base force scaler
 #define TF_FLARE_PELLET_FORCE 20.0f
@@ -86,6 +87,8 @@ private:
 	bool		m_bImpact;
 
 	float		m_flNextSeekUpdate;
+
+	DECLARE_ENTITY_POOL( CTFProjectile_Flare );
 };
 
 #endif	//TF_PROJECTILE_FLARE_H
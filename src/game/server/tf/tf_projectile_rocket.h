@@ -11,6 +11,7 @@
 
 #include "tf_weaponbase_rocket.h"
 #include "iscorer.h"
+#include "entity_pool.h"
 
 
 //=============================================================================
@@ -55,6 +56,8 @@ private:
 	bool m_bDirectHit;
 	bool m_bEyeBallRocket;
 	bool m_bSpell;
+
+	DECLARE_ENTITY_POOL( CTFProjectile_Rocket );
 };
 
 #endif	//TF_PROJECTILE_ROCKET_H
@@ -0,0 +1,377 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Always-on histograms of how long each server tick takes, by phase
+//
+//=============================================================================
+#include "cbase.h"
+#include "tick_time_stats.h"
+#include "filesystem.h"
+#include "tier0/fasttimer.h"
+#include "KeyValues.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar sv_tick_stats( "sv_tick_stats", "1", 0, "If nonzero, time every server tick by phase for sv_tick_stats_print and sv_tick_stats_dump" );
+ConVar sv_tick_budget_ms( "sv_tick_budget_ms", "0", 0, "Warn when a server tick takes longer than this many milliseconds. 0 uses the tick interval, negative never warns." );
+ConVar sv_tick_budget_warn_interval( "sv_tick_budget_warn_interval", "5", 0, "Seconds between warnings about ticks over sv_tick_budget_ms" );
+
+static const char *s_pszTickPhaseNames[ TICK_PHASE_COUNT ] =
+{
+	"systems",
+	"gamerules",
+	"nav",
+	"bots",
+	"entities",
+	"events",
+	"vscript",
+	"clientdata",
+	"other",
+};
+
+static CTickTimeStats g_TickTimeStats;
+
+//-----------------------------------------------------------------------------
+CTickTimeStats &TickTimeStats( void )
+{
+	return g_TickTimeStats;
+}
+
+static uint64 SampleCycles( void )
+{
+	CCycleCount now;
+	now.Sample();
+	return now.GetLongCycles();
+}
+
+static uint32 CyclesToMicroseconds( uint64 cycles )
+{
+	CCycleCount count( cycles );
+	return (uint32)MIN( count.GetUlMicroseconds(), (uint64)0xffffffff );
+}
+
+
+//-----------------------------------------------------------------------------
+CTickTimeHistogram::CTickTimeHistogram( void )
+{
+	Reset();
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeHistogram::Reset( void )
+{
+	V_memset( m_counts, 0, sizeof( m_counts ) );
+	m_nCount = 0;
+	m_nMax = 0;
+	m_nTotal = 0;
+}
+
+//-----------------------------------------------------------------------------
+int CTickTimeHistogram::GetBucket( uint32 nMicroseconds )
+{
+	if ( nMicroseconds < LINEAR_BUCKETS )
+		return nMicroseconds;
+
+	// shift the value down to 64..127, the top 6 bits below the leading one pick the sub bucket
+	int shift = 0;
+	while ( nMicroseconds >= 2 * SUB_BUCKETS )
+	{
+		nMicroseconds >>= 1;
+		++shift;
+	}
+
+	return LINEAR_BUCKETS + ( shift - 1 ) * SUB_BUCKETS + ( nMicroseconds - SUB_BUCKETS );
+}
+
+//-----------------------------------------------------------------------------
+uint32 CTickTimeHistogram::GetBucketMax( int bucket )
+{
+	if ( bucket < LINEAR_BUCKETS )
+		return bucket;
+
+	int shift = ( bucket - LINEAR_BUCKETS ) / SUB_BUCKETS + 1;
+	uint64 nSub = ( bucket - LINEAR_BUCKETS ) % SUB_BUCKETS + SUB_BUCKETS;
+
+	return (uint32)( ( ( nSub + 1 ) << shift ) - 1 );
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeHistogram::Add( uint32 nMicroseconds )
+{
+	++m_counts[ GetBucket( nMicroseconds ) ];
+	++m_nCount;
+	m_nTotal += nMicroseconds;
+	m_nMax = MAX( m_nMax, nMicroseconds );
+}
+
+//-----------------------------------------------------------------------------
+uint32 CTickTimeHistogram::GetPercentile( float flPercentile ) const
+{
+	if ( m_nCount == 0 )
+		return 0;
+
+	int64 nWanted = (int64)ceil( flPercentile * 0.01 * m_nCount );
+	nWanted = clamp( nWanted, (int64)1, (int64)m_nCount );
+
+	int64 nSeen = 0;
+	for ( int i = 0; i < NUM_BUCKETS; ++i )
+	{
+		nSeen += m_counts[i];
+		if ( nSeen >= nWanted )
+		{
+			// the bucket's range can reach past anything actually recorded
+			return MIN( GetBucketMax( i ), m_nMax );
+		}
+	}
+
+	return m_nMax;
+}
+
+
+//-----------------------------------------------------------------------------
+CTickTimeStats::CTickTimeStats( void )
+{
+	m_isTiming = false;
+	m_nPhaseDepth = 0;
+	Reset();
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::Reset( void )
+{
+	m_total.Reset();
+	for ( int i = 0; i < TICK_PHASE_COUNT; ++i )
+	{
+		m_phases[i].Reset();
+	}
+
+	m_nSlowTicks = 0;
+	m_nSlowTicksNotWarned = 0;
+	m_flLastWarnTime = -FLT_MAX;
+}
+
+//-----------------------------------------------------------------------------
+const char *CTickTimeStats::GetPhaseName( int phase )
+{
+	return ( phase >= 0 && phase < TICK_PHASE_COUNT ) ? s_pszTickPhaseNames[ phase ] : "total";
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::BeginTick( void )
+{
+	m_isTiming = sv_tick_stats.GetBool();
+	if ( !m_isTiming )
+		return;
+
+	m_tickStart = m_phaseStart = SampleCycles();
+	m_nPhaseDepth = 0;
+	V_memset( m_phaseCycles, 0, sizeof( m_phaseCycles ) );
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::BeginPhase( TickPhase_t phase )
+{
+	if ( !m_isTiming )
+		return;
+
+	// too deep to track, leave the time with the deepest phase that is
+	if ( m_nPhaseDepth >= ARRAYSIZE( m_phaseStack ) )
+	{
+		++m_nPhaseDepth;
+		return;
+	}
+
+	uint64 now = SampleCycles();
+
+	// stop the clock on the phase this one is inside of
+	TickPhase_t outer = ( m_nPhaseDepth > 0 ) ? m_phaseStack[ m_nPhaseDepth - 1 ] : TICK_PHASE_OTHER;
+	m_phaseCycles[ outer ] += now - m_phaseStart;
+	m_phaseStart = now;
+
+	m_phaseStack[ m_nPhaseDepth ] = phase;
+	++m_nPhaseDepth;
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::EndPhase( void )
+{
+	if ( !m_isTiming || m_nPhaseDepth == 0 )
+		return;
+
+	--m_nPhaseDepth;
+	if ( m_nPhaseDepth >= ARRAYSIZE( m_phaseStack ) )
+		return;
+
+	uint64 now = SampleCycles();
+	m_phaseCycles[ m_phaseStack[ m_nPhaseDepth ] ] += now - m_phaseStart;
+	m_phaseStart = now;
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::EndTick( void )
+{
+	if ( !m_isTiming )
+		return;
+
+	m_isTiming = false;
+
+	uint64 now = SampleCycles();
+	m_phaseCycles[ TICK_PHASE_OTHER ] += now - m_phaseStart;
+
+	uint32 nTotal = CyclesToMicroseconds( now - m_tickStart );
+	m_total.Add( nTotal );
+
+	uint32 phases[ TICK_PHASE_COUNT ];
+	for ( int i = 0; i < TICK_PHASE_COUNT; ++i )
+	{
+		phases[i] = CyclesToMicroseconds( m_phaseCycles[i] );
+		m_phases[i].Add( phases[i] );
+	}
+
+	float flBudget = sv_tick_budget_ms.GetFloat();
+	if ( flBudget == 0.0f )
+	{
+		flBudget = gpGlobals->interval_per_tick * 1000.0f;
+	}
+
+	if ( flBudget > 0.0f && nTotal > flBudget * 1000.0f )
+	{
+		ReportSlowTick( nTotal, phases, flBudget );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Keep the slow tick for the dump and warn about it, at most once
+//			every sv_tick_budget_warn_interval seconds
+//-----------------------------------------------------------------------------
+void CTickTimeStats::ReportSlowTick( uint32 nTotal, const uint32 *pPhases, float flBudget )
+{
+	SlowTick_t &slowTick = m_slowTicks[ m_nSlowTicks % ARRAYSIZE( m_slowTicks ) ];
+	slowTick.m_nTick = gpGlobals->tickcount;
+	slowTick.m_nTotal = nTotal;
+	V_memcpy( slowTick.m_phases, pPhases, sizeof( slowTick.m_phases ) );
+	++m_nSlowTicks;
+
+	double flNow = Plat_FloatTime();
+	if ( flNow - m_flLastWarnTime < sv_tick_budget_warn_interval.GetFloat() )
+	{
+		++m_nSlowTicksNotWarned;
+		return;
+	}
+
+	m_flLastWarnTime = flNow;
+
+	char szPhases[ 512 ];
+	szPhases[0] = '\0';
+	for ( int i = 0; i < TICK_PHASE_COUNT; ++i )
+	{
+		V_strncat( szPhases, CFmtStr( " %s %.2f", s_pszTickPhaseNames[i], pPhases[i] * 0.001f ), sizeof( szPhases ) );
+	}
+
+	Warning( "Tick %d took %.2f ms (budget %.2f ms), %d more slow ticks since the last warning:%s\n",
+		gpGlobals->tickcount, nTotal * 0.001f, flBudget, m_nSlowTicksNotWarned, szPhases );
+
+	m_nSlowTicksNotWarned = 0;
+}
+
+//-----------------------------------------------------------------------------
+void CTickTimeStats::PrintStats( void ) const
+{
+	Msg( "%d ticks timed, %d over budget\n", m_total.GetCount(), m_nSlowTicks );
+	Msg( "%-12s %10s %10s %10s %10s %10s\n", "phase (ms)", "mean", "p50", "p99", "p99.9", "max" );
+
+	for ( int i = -1; i < TICK_PHASE_COUNT; ++i )
+	{
+		const CTickTimeHistogram &histogram = ( i < 0 ) ? m_total : m_phases[i];
+
+		Msg( "%-12s %10.3f %10.3f %10.3f %10.3f %10.3f\n", GetPhaseName( i ),
+			histogram.GetMean() * 0.001,
+			histogram.GetPercentile( 50.0f ) * 0.001f,
+			histogram.GetPercentile( 99.0f ) * 0.001f,
+			histogram.GetPercentile( 99.9f ) * 0.001f,
+			histogram.GetMax() * 0.001f );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Percentiles for each phase and the recent slow ticks, as KeyValues
+//-----------------------------------------------------------------------------
+bool CTickTimeStats::WriteStats( const char *pszFilename ) const
+{
+	KeyValues *pStats = new KeyValues( "tick_stats" );
+	pStats->SetString( "map", STRING( gpGlobals->mapname ) );
+	pStats->SetFloat( "tick_interval_ms", gpGlobals->interval_per_tick * 1000.0f );
+	pStats->SetInt( "ticks", m_total.GetCount() );
+	pStats->SetInt( "slow_ticks", m_nSlowTicks );
+
+	KeyValues *pPhases = pStats->FindKey( "phases", true );
+	for ( int i = -1; i < TICK_PHASE_COUNT; ++i )
+	{
+		const CTickTimeHistogram &histogram = ( i < 0 ) ? m_total : m_phases[i];
+
+		KeyValues *pPhase = pPhases->FindKey( GetPhaseName( i ), true );
+		pPhase->SetFloat( "mean_ms", histogram.GetMean() * 0.001 );
+		pPhase->SetFloat( "p50_ms", histogram.GetPercentile( 50.0f ) * 0.001f );
+		pPhase->SetFloat( "p90_ms", histogram.GetPercentile( 90.0f ) * 0.001f );
+		pPhase->SetFloat( "p99_ms", histogram.GetPercentile( 99.0f ) * 0.001f );
+		pPhase->SetFloat( "p99.9_ms", histogram.GetPercentile( 99.9f ) * 0.001f );
+		pPhase->SetFloat( "max_ms", histogram.GetMax() * 0.001f );
+	}
+
+	KeyValues *pSlowTicks = pStats->FindKey( "recent_slow_ticks", true );
+	int nRecorded = MIN( m_nSlowTicks, (int)ARRAYSIZE( m_slowTicks ) );
+	for ( int i = m_nSlowTicks - nRecorded; i < m_nSlowTicks; ++i )
+	{
+		const SlowTick_t &slowTick = m_slowTicks[ i % ARRAYSIZE( m_slowTicks ) ];
+
+		KeyValues *pSlowTick = pSlowTicks->CreateNewKey();
+		pSlowTick->SetInt( "tick", slowTick.m_nTick );
+		pSlowTick->SetFloat( "total_ms", slowTick.m_nTotal * 0.001f );
+		for ( int j = 0; j < TICK_PHASE_COUNT; ++j )
+		{
+			pSlowTick->SetFloat( CFmtStr( "%s_ms", s_pszTickPhaseNames[j] ), slowTick.m_phases[j] * 0.001f );
+		}
+	}
+
+	bool bWritten = pStats->SaveToFile( filesystem, pszFilename, "MOD" );
+	pStats->deleteThis();
+
+	return bWritten;
+}
+
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_tick_stats_print, "Print server tick time percentiles by phase" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TickTimeStats().PrintStats();
+}
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_tick_stats_dump, "Write server tick time percentiles by phase and the recent slow ticks to a KeyValues file. Arguments: [filename]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	const char *pszFilename = ( args.ArgC() > 1 ) ? args[1] : "tick_stats.txt";
+
+	if ( TickTimeStats().WriteStats( pszFilename ) )
+	{
+		Msg( "Wrote tick stats to '%s'\n", pszFilename );
+	}
+	else
+	{
+		Warning( "Unable to write '%s'\n", pszFilename );
+	}
+}
+
+//-----------------------------------------------------------------------------
+CON_COMMAND( sv_tick_stats_reset, "Clear the server tick time histograms" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TickTimeStats().Reset();
+}
@@ -0,0 +1,130 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Always-on histograms of how long each server tick takes, by phase
+//
+//=============================================================================
+
+#ifndef TICK_TIME_STATS_H
+#define TICK_TIME_STATS_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+// The parts of CServerGameDLL::GameFrame() timed separately. A phase started
+// inside another is not counted in the outer one.
+enum TickPhase_t
+{
+	TICK_PHASE_SYSTEMS,			// game system frame updates
+	TICK_PHASE_GAMERULES,		// GameStartFrame()
+	TICK_PHASE_NAV,				// nav mesh update
+	TICK_PHASE_BOTS,			// NextBot and temp bot updates
+	TICK_PHASE_ENTITIES,		// entity think and simulation
+	TICK_PHASE_EVENTS,			// entity I/O event queue
+	TICK_PHASE_VSCRIPT,			// script VM frame
+	TICK_PHASE_CLIENTDATA,		// UpdateAllClientData()
+	TICK_PHASE_OTHER,			// everything else in the tick
+
+	TICK_PHASE_COUNT
+};
+
+//-----------------------------------------------------------------------------
+// Counts of durations in microseconds, kept to within about 1.5% of the value
+// from 1us to over an hour. Values below 128us get a bucket each; above that
+// each power of two is split into 64 buckets.
+//-----------------------------------------------------------------------------
+class CTickTimeHistogram
+{
+public:
+	CTickTimeHistogram( void );
+
+	void Reset( void );
+	void Add( uint32 nMicroseconds );
+
+	int GetCount( void ) const { return m_nCount; }
+	uint32 GetMax( void ) const { return m_nMax; }
+	double GetMean( void ) const { return m_nCount ? (double)m_nTotal / m_nCount : 0.0; }
+
+	// Highest value in the bucket holding the given percentile of the values
+	uint32 GetPercentile( float flPercentile ) const;
+
+private:
+	enum
+	{
+		LINEAR_BUCKETS = 128,
+		SUB_BUCKETS = 64,
+		NUM_BUCKETS = LINEAR_BUCKETS + 25 * SUB_BUCKETS,
+	};
+
+	static int GetBucket( uint32 nMicroseconds );
+	static uint32 GetBucketMax( int bucket );
+
+	uint32 m_counts[ NUM_BUCKETS ];
+	int m_nCount;
+	uint32 m_nMax;
+	uint64 m_nTotal;
+};
+
+//-----------------------------------------------------------------------------
+// Times every tick and each phase in it, and warns about ticks that go over
+// sv_tick_budget_ms.
+//-----------------------------------------------------------------------------
+class CTickTimeStats
+{
+public:
+	CTickTimeStats( void );
+
+	void Reset( void );
+
+	void BeginTick( void );
+	void EndTick( void );
+	void BeginPhase( TickPhase_t phase );
+	void EndPhase( void );
+
+	void PrintStats( void ) const;
+	bool WriteStats( const char *pszFilename ) const;
+
+	static const char *GetPhaseName( int phase );
+
+private:
+	void ReportSlowTick( uint32 nTotal, const uint32 *pPhases, float flBudget );
+
+	bool m_isTiming;
+	uint64 m_tickStart;
+	uint64 m_phaseStart;
+	uint64 m_phaseCycles[ TICK_PHASE_COUNT ];
+
+	// the phases entered and not left yet
+	TickPhase_t m_phaseStack[ 8 ];
+	int m_nPhaseDepth;
+
+	CTickTimeHistogram m_total;
+	CTickTimeHistogram m_phases[ TICK_PHASE_COUNT ];
+
+	// the most recent ticks over budget
+	struct SlowTick_t
+	{
+		int m_nTick;
+		uint32 m_nTotal;
+		uint32 m_phases[ TICK_PHASE_COUNT ];
+	};
+	SlowTick_t m_slowTicks[ 16 ];
+	int m_nSlowTicks;
+	int m_nSlowTicksNotWarned;
+	double m_flLastWarnTime;
+};
+
+extern CTickTimeStats &TickTimeStats( void );
+
+//-----------------------------------------------------------------------------
+// Times the rest of the enclosing scope as the given phase
+//-----------------------------------------------------------------------------
+class CTickPhaseScope
+{
+public:
+	CTickPhaseScope( TickPhase_t phase )	{ TickTimeStats().BeginPhase( phase ); }
+	~CTickPhaseScope()						{ TickTimeStats().EndPhase(); }
+};
+
+#define TICK_PHASE( phase )		CTickPhaseScope tickPhaseScope( phase )
+
+#endif // TICK_TIME_STATS_H
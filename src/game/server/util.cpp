@@ -37,6 +37,7 @@
 #include "util.h"
 #include "cdll_int.h"
 #include "vscript_server.h"
+#include "asynclog.h"
 
 #ifdef PORTAL
 #include "PortalSimulation.h"
@@ -475,10 +476,8 @@ void UTIL_Remove( IServerNetworkable *oldObj )
 	CBaseEntity *pBaseEnt = oldObj->GetBaseEntity();
 	if ( pBaseEnt )
 	{
-#if 0
-		if ( g_pScriptVM )
+		if ( g_pScriptVM && g_VScriptGameEventListener.HasListener( SCRIPT_EVENT_ON_ENTITY_REMOVE ) )
 			g_VScriptGameEventListener.RunGameEventCallbacks( "OnEntityRemove", ToHScript( pBaseEnt ) );
-#endif
 
 #ifdef PORTAL //make sure entities are in the primary physics environment for the portal mod, this code should be safe even if the entity is in neither extra environment
 		CPortalSimulator::Pre_UTIL_Remove( pBaseEnt );
@@ -1755,6 +1754,12 @@ void UTIL_LogPrintf( const char *fmt, ... )
 	char		tempString[1024];
 	
 	va_start ( argptr, fmt );
+	if ( AsyncLog_LogPrintV( fmt, argptr ) )
+	{
+		// the log thread will format and print it
+		va_end( argptr );
+		return;
+	}
 	Q_vsnprintf( tempString, sizeof(tempString), fmt, argptr );
 	va_end   ( argptr );
 
@@ -1830,10 +1835,8 @@ int DispatchSpawn( CBaseEntity *pEntity, bool bRunVScripts )
 	{
 		MDLCACHE_CRITICAL_SECTION();
 
-#if 0
-		if ( g_pScriptVM )
+		if ( g_pScriptVM && g_VScriptGameEventListener.HasListener( SCRIPT_EVENT_ON_ENTITY_PRE_SPAWN ) )
 			g_VScriptGameEventListener.RunGameEventCallbacks( "OnEntityPreSpawn", ToHScript( pEntity ) );
-#endif
 
 		// keep a smart pointer that will now if the object gets deleted
 		EHANDLE pEntSafe;
@@ -1922,10 +1925,8 @@ int DispatchSpawn( CBaseEntity *pEntity, bool bRunVScripts )
 			pEntity->RunOnPostSpawnScripts();
 		}
 
-#if 0
-		if ( g_pScriptVM )
+		if ( g_pScriptVM && g_VScriptGameEventListener.HasListener( SCRIPT_EVENT_ON_ENTITY_POST_SPAWN ) )
 			g_VScriptGameEventListener.RunGameEventCallbacks( "OnEntityPostSpawn", ToHScript( pEntity ) );
-#endif
 	}
 
 	return 0;
@@ -11,6 +11,7 @@
 #include "tier1/fmtstr.h"
 #include "filesystem.h"
 #include "eventqueue.h"
+#include "tick_time_stats.h"
 #include "GameEventListener.h"
 #include "gameinterface.h"
 #include "functorutils.h"
@@ -676,27 +677,113 @@ END_SCRIPTDESC();
 
 CVScriptGameEventListener g_VScriptGameEventListener;
 
+ConVar script_pool_params_tables( "script_pool_params_tables", "0", 0, "Reuse one parameter table per game event or script hook instead of creating a new table each time it fires. Scripts that keep a reference to the table will see it change." );
+
+// Names of the events and hooks in ScriptHookID_t
+static const char *s_pszScriptHookNames[ NUM_SCRIPT_HOOK_IDS ] =
+{
+	"OnEntityCreated",
+	"OnEntityPreSpawn",
+	"OnEntityPostSpawn",
+	"OnEntityRemove",
+	"OnTakeDamage",
+};
+
+// Whether each entry in ScriptHookID_t is a script hook, as opposed to a game event
+static const bool s_bIsScriptHook[ NUM_SCRIPT_HOOK_IDS ] =
+{
+	false,
+	false,
+	false,
+	false,
+	true,
+};
+
+CVScriptGameEventListener::CVScriptGameEventListener() : m_ParamsTables( false ), m_Profile( false )
+{
+	m_nListenerBits = 0;
+	m_RunGameEventCallbacksFunc = INVALID_HSCRIPT;
+	m_CollectGameEventCallbacksFunc = INVALID_HSCRIPT;
+	m_ScriptHookCallbacksFunc = INVALID_HSCRIPT;
+}
+
 void CVScriptGameEventListener::Init()
 {
 	m_RunGameEventCallbacksFunc = INVALID_HSCRIPT;
 	m_CollectGameEventCallbacksFunc = INVALID_HSCRIPT;
 	m_ScriptHookCallbacksFunc = INVALID_HSCRIPT;
 }
+
 void CVScriptGameEventListener::FireGameEvent( IGameEvent *event )
 {
+	const char *pszName = event->GetName();
+	if ( !g_pScriptVM || !HasGameEventListener( pszName ) )
+		return;
+
 	// Pass all keyvales as a table of parameters
-	HSCRIPT paramsTable = ScriptTableFromKeyValues( g_pScriptVM, event->GetDataKeys() );
-	RunGameEventCallbacks( event->GetName(), paramsTable );
+	HSCRIPT paramsTable = AcquireParamsTable( pszName );
+	ScriptTableFromKeyValues( g_pScriptVM, event->GetDataKeys(), paramsTable );
+	RunGameEventCallbacks( pszName, paramsTable );
+	ReleaseParamsTable( pszName, paramsTable );
+}
+
+void CVScriptGameEventListener::SetListenerBit( const char *szName, bool bScriptHook )
+{
+	for ( int i = 0; i < NUM_SCRIPT_HOOK_IDS; ++i )
+	{
+		if ( s_bIsScriptHook[i] == bScriptHook && !V_strcmp( s_pszScriptHookNames[i], szName ) )
+		{
+			m_nListenerBits |= ( 1u << i );
+			return;
+		}
+	}
+}
+
+void CVScriptGameEventListener::ListenForScriptGameEvent( const char *szName )
+{
+	m_GameEvents.AddString( szName );
+	SetListenerBit( szName, false );
+
+	// Script-only events such as OnEntityCreated aren't known to the event manager; they are
+	// still tracked above so the game knows to run them.
+	ListenForGameEvent( szName );
+}
+
+void CVScriptGameEventListener::ClearAllGameEventListeners()
+{
+	StopListeningForAllEvents();
+	m_GameEvents.RemoveAll();
+
+	for ( int i = 0; i < NUM_SCRIPT_HOOK_IDS; ++i )
+	{
+		if ( !s_bIsScriptHook[i] )
+			m_nListenerBits &= ~( 1u << i );
+	}
+}
+
+bool CVScriptGameEventListener::HasGameEventListener( const char *szName )
+{
+	if ( !szName || !*szName )
+		return false;
+
+	return m_GameEvents.Find( szName ).IsValid();
 }
 
 void CVScriptGameEventListener::ListenForScriptHook( const char* szName )
 {
 	m_ScriptHooks.AddString( szName );
+	SetListenerBit( szName, true );
 }
 
 void CVScriptGameEventListener::ClearAllScriptHooks()
 {
 	m_ScriptHooks.RemoveAll();
+
+	for ( int i = 0; i < NUM_SCRIPT_HOOK_IDS; ++i )
+	{
+		if ( s_bIsScriptHook[i] )
+			m_nListenerBits &= ~( 1u << i );
+	}
 }
 
 bool CVScriptGameEventListener::HasScriptHook( const char *szName )
@@ -716,6 +803,185 @@ bool CVScriptGameEventListener::FireScriptHook( const char *pszHookName, HSCRIPT
 	return true;
 }
 
+HSCRIPT CVScriptGameEventListener::AcquireParamsTable( const char *szName )
+{
+	Assert( g_pScriptVM );
+
+	ParamsTable_t *pPooled = NULL;
+	if ( script_pool_params_tables.GetBool() )
+	{
+		UtlSymId_t id = m_ParamsTables.Find( szName );
+		if ( id == m_ParamsTables.InvalidIndex() )
+		{
+			pPooled = &m_ParamsTables[ szName ];
+			pPooled->m_hTable = NULL;
+			pPooled->m_bInUse = false;
+		}
+		else
+		{
+			pPooled = &m_ParamsTables[ id ];
+		}
+
+		// the hook fired again from inside one of its own callbacks
+		if ( pPooled->m_bInUse )
+			pPooled = NULL;
+	}
+
+	if ( pPooled && pPooled->m_hTable )
+	{
+		// callbacks can add their own keys, and events don't always set every key, so
+		// nothing from the last time it fired may be left behind
+		if ( g_pScriptVM->GetNumTableEntries( pPooled->m_hTable ) > 0 )
+		{
+			CUtlVector< ScriptVariant_t > keys;
+			ScriptVariant_t varKey, varValue;
+			for ( int nIterator = 0; ( nIterator = g_pScriptVM->GetKeyValue( pPooled->m_hTable, nIterator, &varKey, &varValue ) ) != -1; )
+			{
+				keys.AddToTail( varKey );
+				g_pScriptVM->ReleaseValue( varValue );
+			}
+
+			FOR_EACH_VEC( keys, i )
+			{
+				if ( keys[i].GetType() == FIELD_CSTRING )
+					g_pScriptVM->ClearValue( pPooled->m_hTable, keys[i] );
+				g_pScriptVM->ReleaseValue( keys[i] );
+			}
+
+			// only string keys can be cleared through the VM interface, so a table that
+			// was given any other kind of key is thrown away
+			if ( g_pScriptVM->GetNumTableEntries( pPooled->m_hTable ) > 0 )
+			{
+				ScriptVariant_t varOldTable( pPooled->m_hTable );
+				g_pScriptVM->ReleaseValue( varOldTable );
+				pPooled->m_hTable = NULL;
+			}
+		}
+
+		if ( pPooled->m_hTable )
+		{
+			pPooled->m_bInUse = true;
+			return pPooled->m_hTable;
+		}
+	}
+
+	ScriptVariant_t varTable;
+	g_pScriptVM->CreateTable( varTable );
+
+	if ( pPooled )
+	{
+		pPooled->m_hTable = varTable;
+		pPooled->m_bInUse = true;
+	}
+
+	return varTable;
+}
+
+void CVScriptGameEventListener::ReleaseParamsTable( const char *szName, HSCRIPT hTable )
+{
+	if ( !hTable || !g_pScriptVM )
+		return;
+
+	UtlSymId_t id = m_ParamsTables.Find( szName );
+	if ( id != m_ParamsTables.InvalidIndex() && m_ParamsTables[ id ].m_hTable == hTable )
+	{
+		m_ParamsTables[ id ].m_bInUse = false;
+		return;
+	}
+
+	ScriptVariant_t varTable( hTable );
+	g_pScriptVM->ReleaseValue( varTable );
+}
+
+void CVScriptGameEventListener::ReleaseAllParamsTables()
+{
+	for ( unsigned int i = 0; i < m_ParamsTables.Count(); ++i )
+	{
+		ParamsTable_t &table = m_ParamsTables[ (UtlSymId_t)i ];
+		Assert( !table.m_bInUse );
+		if ( table.m_hTable && g_pScriptVM )
+		{
+			ScriptVariant_t varTable( table.m_hTable );
+			g_pScriptVM->ReleaseValue( varTable );
+		}
+	}
+
+	m_ParamsTables.Purge();
+}
+
+void CVScriptGameEventListener::RecordCall( const char *szName, bool bScriptHook, double flSeconds )
+{
+	UtlSymId_t id = m_Profile.Find( szName );
+	if ( id == m_Profile.InvalidIndex() )
+	{
+		HookProfile_t &profile = m_Profile[ szName ];
+		profile.m_bScriptHook = bScriptHook;
+		profile.m_nCalls = 0;
+		profile.m_flTotalTime = 0.0;
+		profile.m_flMaxTime = 0.0;
+		id = m_Profile.Find( szName );
+	}
+
+	HookProfile_t &profile = m_Profile[ id ];
+	++profile.m_nCalls;
+	profile.m_flTotalTime += flSeconds;
+	profile.m_flMaxTime = MAX( profile.m_flMaxTime, flSeconds );
+}
+
+void CVScriptGameEventListener::PrintProfile()
+{
+	struct ProfileEntry_t
+	{
+		const char *m_pszName;
+		const HookProfile_t *m_pProfile;
+
+		static int __cdecl SortByTotalTime( const ProfileEntry_t *a, const ProfileEntry_t *b )
+		{
+			if ( a->m_pProfile->m_flTotalTime != b->m_pProfile->m_flTotalTime )
+				return ( a->m_pProfile->m_flTotalTime > b->m_pProfile->m_flTotalTime ) ? -1 : 1;
+			return V_strcmp( a->m_pszName, b->m_pszName );
+		}
+	};
+
+	CUtlVector< ProfileEntry_t > entries;
+	double flTotal = 0.0;
+	for ( unsigned int i = 0; i < m_Profile.Count(); ++i )
+	{
+		ProfileEntry_t &entry = entries[ entries.AddToTail() ];
+		entry.m_pszName = m_Profile.String( i );
+		entry.m_pProfile = &m_Profile[ (UtlSymId_t)i ];
+		flTotal += entry.m_pProfile->m_flTotalTime;
+	}
+	entries.Sort( ProfileEntry_t::SortByTotalTime );
+
+	Msg( "%-32s %5s %8s %10s %9s %9s\n", "name", "type", "calls", "total ms", "avg ms", "max ms" );
+	FOR_EACH_VEC( entries, i )
+	{
+		const HookProfile_t *pProfile = entries[i].m_pProfile;
+		Msg( "%-32s %5s %8d %10.3f %9.4f %9.4f\n",
+			 entries[i].m_pszName,
+			 pProfile->m_bScriptHook ? "hook" : "event",
+			 pProfile->m_nCalls,
+			 pProfile->m_flTotalTime * 1000.0,
+			 pProfile->m_nCalls ? pProfile->m_flTotalTime * 1000.0 / pProfile->m_nCalls : 0.0,
+			 pProfile->m_flMaxTime * 1000.0 );
+	}
+	Msg( "%d events/hooks, %.3f ms in the VM\n", entries.Count(), flTotal * 1000.0 );
+
+	Msg( "Listening for:" );
+	for ( int i = 0; i < NUM_SCRIPT_HOOK_IDS; ++i )
+	{
+		if ( HasListener( (ScriptHookID_t)i ) )
+			Msg( " %s", s_pszScriptHookNames[i] );
+	}
+	Msg( "%s (+%d other events, %d other hooks)\n", m_nListenerBits ? "" : " nothing precompiled", m_GameEvents.GetNumStrings(), m_ScriptHooks.GetNumStrings() );
+}
+
+void CVScriptGameEventListener::ResetProfile()
+{
+	m_Profile.Purge();
+}
+
 // Calls a squirrel func (see vscript_server.nut) to call each
 // registered script function associated with this game event.
 void CVScriptGameEventListener::RunGameEventCallbacks( const char* szName, HSCRIPT params )
@@ -729,7 +995,9 @@ void CVScriptGameEventListener::RunGameEventCallbacks( const char* szName, HSCRI
 
 	if ( m_RunGameEventCallbacksFunc )
 	{
+		double flStart = Plat_FloatTime();
 		g_pScriptVM->Call( m_RunGameEventCallbacksFunc, NULL, true, NULL, szName, params );
+		RecordCall( szName, false, Plat_FloatTime() - flStart );
 	}
 }
 
@@ -744,7 +1012,9 @@ void CVScriptGameEventListener::RunScriptHookCallbacks( const char* szName, HSCR
 
 	if ( m_ScriptHookCallbacksFunc )
 	{
+		double flStart = Plat_FloatTime();
 		g_pScriptVM->Call( m_ScriptHookCallbacksFunc, NULL, true, NULL, szName, params );
+		RecordCall( szName, true, Plat_FloatTime() - flStart );
 	}
 }
 
@@ -767,7 +1037,7 @@ void RegisterScriptGameEventListener( const char* pszEventName )
 		return;
 	}
 
-	g_VScriptGameEventListener.ListenForGameEvent( pszEventName );
+	g_VScriptGameEventListener.ListenForScriptGameEvent( pszEventName );
 }
 
 void RegisterScriptHookListener( const char* pszEventName )
@@ -788,7 +1058,7 @@ void CollectGameEventCallbacksInScope( HSCRIPT scope )
 
 void ClearScriptGameEventListeners( void )
 {
-	g_VScriptGameEventListener.StopListeningForAllEvents();
+	g_VScriptGameEventListener.ClearAllGameEventListeners();
 	g_VScriptGameEventListener.ClearAllScriptHooks();
 }
 
@@ -813,6 +1083,11 @@ bool ScriptHookEnabled( const char *pszName )
 	return g_VScriptGameEventListener.HasScriptHook( pszName );
 }
 
+bool ScriptHookEnabled( ScriptHookID_t id )
+{
+	return g_VScriptGameEventListener.HasListener( id ) && ScriptHooksEnabled();
+}
+
 bool RunScriptHook( const char *pszHookName, HSCRIPT params )
 {
 	if ( !pszHookName || !*pszHookName )
@@ -1126,7 +1401,10 @@ bool ScriptFireGameEvent( const char* szName, HSCRIPT params )
 	if ( !szName || !*szName )
 		return false;
 
-	g_VScriptGameEventListener.RunGameEventCallbacks( szName, params );
+	if ( g_VScriptGameEventListener.HasGameEventListener( szName ) )
+	{
+		g_VScriptGameEventListener.RunGameEventCallbacks( szName, params );
+	}
 	return true;
 }
 
@@ -3532,6 +3810,8 @@ void VScriptServerTerm()
 {
 	if( g_pScriptVM != NULL )
 	{
+		g_VScriptGameEventListener.ReleaseAllParamsTables();
+
 		if( g_pScriptVM )
 		{
 			scriptmanager->DestroyVM( g_pScriptVM );
@@ -3599,6 +3879,20 @@ CON_COMMAND_F( script_attach_debugger, "Connect the vscript VM to the script deb
 	g_pScriptVM->ConnectDebugger();
 }
 
+CON_COMMAND( script_profile, "Report time spent in the VM per game event and script hook. Use 'script_profile reset' to clear" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		g_VScriptGameEventListener.ResetProfile();
+		return;
+	}
+
+	g_VScriptGameEventListener.PrintProfile();
+}
+
 CON_COMMAND_F( script_debug, "Toggle the in-game script debug features", FCVAR_CHEAT )
 {
 	if ( !UTIL_IsCommandIssuedByServerAdmin() )
@@ -3985,7 +4279,10 @@ public:
 	virtual void FrameUpdatePostEntityThink() 
 	{ 
 		if ( g_pScriptVM )
+		{
+			TICK_PHASE( TICK_PHASE_VSCRIPT );
 			g_pScriptVM->Frame( gpGlobals->frametime );
+		}
 
 		g_ScriptErrorScreenOverlay.Draw();
 	}
@@ -11,6 +11,7 @@
 #include "tier1/KeyValues.h"
 #include "vscript_shared.h"
 #include "tier1/utlsymbol.h"
+#include "tier1/UtlStringMap.h"
 #include "GameEventListener.h"
 
 #if defined( _WIN32 )
@@ -72,9 +73,23 @@ public:
 	KeyValues *m_pKeyValues;	// actual KeyValue entity
 };
 
+// Events and hooks the game fires often enough that looking up their listeners by name would show up
+enum ScriptHookID_t
+{
+	SCRIPT_EVENT_ON_ENTITY_CREATED,
+	SCRIPT_EVENT_ON_ENTITY_PRE_SPAWN,
+	SCRIPT_EVENT_ON_ENTITY_POST_SPAWN,
+	SCRIPT_EVENT_ON_ENTITY_REMOVE,
+	SCRIPT_HOOK_ON_TAKE_DAMAGE,
+
+	NUM_SCRIPT_HOOK_IDS
+};
+
 class CVScriptGameEventListener : public CGameEventListener
 {
 public:
+	CVScriptGameEventListener();
+
 	virtual void FireGameEvent( IGameEvent *event );
 	bool FireScriptHook( const char *pszHookName, HSCRIPT params );
 	
@@ -84,13 +99,51 @@ public:
 	void Init();
 	void CollectGameEventCallbacksInScope( HSCRIPT scope );
 
+	void ListenForScriptGameEvent( const char *szName );
+	bool HasGameEventListener( const char *szName );
+	void ClearAllGameEventListeners();
+
 	void ListenForScriptHook( const char *szName );
 	bool HasScriptHook( const char *szName );
 	void ClearAllScriptHooks();
 
+	// true if script has registered for this event or hook, without a name lookup
+	bool HasListener( ScriptHookID_t id ) const		{ return ( m_nListenerBits & ( 1u << id ) ) != 0; }
+	bool HasAnyListeners( void ) const				{ return m_nListenerBits || m_GameEvents.GetNumStrings() || m_ScriptHooks.GetNumStrings(); }
+
+	// With script_pool_params_tables, parameter tables are kept per event and emptied each time
+	// it fires. If the pooled table is already in use further up the stack, or pooling is off,
+	// a new one is returned instead.
+	HSCRIPT AcquireParamsTable( const char *szName );
+	void ReleaseParamsTable( const char *szName, HSCRIPT hTable );
+	void ReleaseAllParamsTables();				// must be called before the VM goes away
+
+	void PrintProfile();
+	void ResetProfile();
+
 private:
+	void SetListenerBit( const char *szName, bool bScriptHook );
+	void RecordCall( const char *szName, bool bScriptHook, double flSeconds );
 
+	CUtlSymbolTable m_GameEvents;
 	CUtlSymbolTable m_ScriptHooks;
+	uint32 m_nListenerBits;
+
+	struct ParamsTable_t
+	{
+		HSCRIPT m_hTable;
+		bool m_bInUse;
+	};
+	CUtlStringMap< ParamsTable_t > m_ParamsTables;
+
+	struct HookProfile_t
+	{
+		bool m_bScriptHook;
+		int m_nCalls;
+		double m_flTotalTime;
+		double m_flMaxTime;
+	};
+	CUtlStringMap< HookProfile_t > m_Profile;
 
 	HSCRIPT m_RunGameEventCallbacksFunc;
 	HSCRIPT m_CollectGameEventCallbacksFunc;
@@ -101,6 +154,7 @@ extern CVScriptGameEventListener g_VScriptGameEventListener;
 
 bool ScriptHooksEnabled( void );
 bool ScriptHookEnabled( const char *pszName );
+bool ScriptHookEnabled( ScriptHookID_t id );
 bool RunScriptHook( const char *pszHookName, HSCRIPT params );
 
 #endif // VSCRIPT_SERVER_H
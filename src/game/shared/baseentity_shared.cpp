@@ -19,6 +19,8 @@
 #include "debugoverlay_shared.h"
 #include "coordsize.h"
 #include "vphysics/performance.h"
+#include "tier1/utldict.h"
+#include "tier1/utlhashtable.h"
 
 #ifdef CLIENT_DLL
 	#include "c_te_effect_dispatch.h"
@@ -35,6 +37,7 @@
 #endif
 
 	#include "gamestats.h"
+	#include "player_registry.h"
 
 #endif
 
@@ -153,6 +156,13 @@ Vector CBaseEntity::EarPosition( void )
 void CBaseEntity::SetViewOffset( const Vector& v ) 
 { 
 	m_vecViewOffset = v; 
+
+#ifndef CLIENT_DLL
+	if ( IsPlayer() )
+	{
+		PlayerRegistry().MarkPositionDirty( this );
+	}
+#endif
 }
 
 const Vector& CBaseEntity::GetViewOffset() const 
@@ -720,14 +730,56 @@ char const *CBaseEntity::DamageDecal( int bitsDamageType, int gameMaterial )
 	return "Impact.Concrete";
 }
 
+// Every think context name gets an ID the first time it is seen, so an entity's contexts can be
+// matched by integer. Names are almost always literals, so they are looked up by address first.
+static CUtlDict< int, int > s_ThinkContextIDs( k_eDictCompareTypeCaseSensitive );
+static CUtlHashtable< uintp, int > s_ThinkContextAddresses;
+
+//-----------------------------------------------------------------------------
+// Purpose: Return the ID shared by every think context with this name
+//-----------------------------------------------------------------------------
+int CBaseEntity::GetThinkContextID( const char *szContext )
+{
+	UtlHashHandle_t hAddress = s_ThinkContextAddresses.Find( (uintp)szContext );
+	if ( hAddress != s_ThinkContextAddresses.InvalidHandle() )
+	{
+		// a buffer that isn't a literal can hold a different name by now
+		int nID = s_ThinkContextAddresses.Element( hAddress );
+		if ( !Q_strncmp( s_ThinkContextIDs.GetElementName( nID ), szContext, MAX_CONTEXT_LENGTH ) )
+			return nID;
+	}
+
+	// contexts are compared up to MAX_CONTEXT_LENGTH characters
+	char szName[ MAX_CONTEXT_LENGTH + 1 ];
+	Q_strncpy( szName, szContext, sizeof( szName ) );
+
+	int nID = s_ThinkContextIDs.Find( szName );
+	if ( nID == s_ThinkContextIDs.InvalidIndex() )
+	{
+		nID = s_ThinkContextIDs.Insert( szName, 0 );
+	}
+
+	if ( hAddress != s_ThinkContextAddresses.InvalidHandle() )
+	{
+		s_ThinkContextAddresses.Element( hAddress ) = nID;
+	}
+	else
+	{
+		s_ThinkContextAddresses.Insert( (uintp)szContext, nID );
+	}
+
+	return nID;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
 int	CBaseEntity::GetIndexForThinkContext( const char *pszContext )
 {
+	int nID = GetThinkContextID( pszContext );
 	for ( int i = 0; i < m_aThinkFunctions.Size(); i++ )
 	{
-		if ( !Q_strncmp( STRING( m_aThinkFunctions[i].m_iszContext ), pszContext, MAX_CONTEXT_LENGTH ) )
+		if ( m_aThinkFunctions[i].m_nContextID == nID )
 			return i;
 	}
 
@@ -749,6 +801,7 @@ int CBaseEntity::RegisterThinkContext( const char *szContext )
 	sNewFunc.m_pfnThink = NULL;
 	sNewFunc.m_nNextThinkTick = 0;
 	sNewFunc.m_iszContext = AllocPooledString(szContext);
+	sNewFunc.m_nContextID = GetThinkContextID( szContext );
 
 	// Insert it into our list
 	return m_aThinkFunctions.AddToTail( sNewFunc );
@@ -1433,6 +1486,11 @@ void CBaseEntity::InvalidatePhysicsRecursive( int nChangeFlags )
 
 #ifndef CLIENT_DLL
 		NetworkProp()->MarkPVSInformationDirty();
+
+		if ( IsPlayer() )
+		{
+			PlayerRegistry().MarkPositionDirty( this );
+		}
 #endif
 
 		// NOTE: This will also mark shadow projection + client leaf dirty
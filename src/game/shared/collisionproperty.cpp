@@ -24,6 +24,7 @@
 #include "baseanimating.h"
 #include "sendproxy.h"
 #include "hierarchy.h"
+#include "projectile_registry.h"
 #endif
 
 #include "predictable_entity.h"
@@ -1388,6 +1389,11 @@ void CCollisionProperty::MarkPartitionHandleDirty()
 #ifdef CLIENT_DLL
 	GetOuter()->MarkRenderHandleDirty();
 	g_pClientShadowMgr->AddToDirtyShadowList( GetOuter() );
+#else
+	if ( m_pOuter->GetFlags() & FL_GRENADE )
+	{
+		ProjectileRegistry().MarkBoundsDirty( m_pOuter );
+	}
 #endif
 }
 
@@ -48,6 +48,19 @@ CBaseEntity *CItemGeneration::GenerateRandomItem( CItemSelectionCriteria *pCrite
 	return SpawnItem( iChosenItem, vecOrigin, vecAngles, pCriteria->GetItemLevel(), iQuality, pszOverrideClassName );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Generate an item whose definition was already chosen against the criteria
+//-----------------------------------------------------------------------------
+CBaseEntity *CItemGeneration::GenerateItemFromCriteria( item_definition_index_t iChosenItem, CItemSelectionCriteria *pCriteria, const Vector &vecOrigin, const QAngle &vecAngles )
+{
+	const CEconItemDefinition *pItemDef = ItemSystem()->GetStaticDataForItemByDefIndex( iChosenItem );
+	if ( !pItemDef )
+		return NULL;
+
+	entityquality_t iQuality = ItemSystem()->FinishItemSelection( pCriteria, pItemDef );
+	return SpawnItem( iChosenItem, vecOrigin, vecAngles, pCriteria->GetItemLevel(), iQuality, NULL );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Generate a random item matching the specified definition index
 //-----------------------------------------------------------------------------
@@ -29,6 +29,10 @@ public:
 	// Generate a random item matching the specified criteria
 	CBaseEntity *GenerateRandomItem( CItemSelectionCriteria *pCriteria, const Vector &vecOrigin, const QAngle &vecAngles, const char* pszOverrideClassName = NULL );
 
+	// Generate an item of a definition already chosen against the criteria, e.g. by CEconItemSystem::FindUniqueItemMatchingCriteria().
+	// Produces the same item GenerateRandomItem() would if that definition were the only match.
+	CBaseEntity *GenerateItemFromCriteria( item_definition_index_t iChosenItem, CItemSelectionCriteria *pCriteria, const Vector &vecOrigin, const QAngle &vecAngles );
+
 	// Generate a random item matching the specified definition index
 	CBaseEntity *GenerateItemFromDefIndex( int iDefIndex, const Vector &vecOrigin, const QAngle &vecAngles );
 
@@ -339,6 +339,48 @@ HackMakeValidList:
 	if ( !pItemDef )
 		return INVALID_ITEM_DEF_INDEX;
 
+	entityquality_t iQuality = FinishItemSelection( pCriteria, pItemDef );
+	if ( outEntityQuality )
+	{
+		*outEntityQuality = iQuality;
+	}
+	return iChosenItem;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Find the single item matching the criteria. Unlike GenerateRandomItem()
+//			this doesn't touch the random number stream, so the result can be
+//			looked up once and reused.
+//-----------------------------------------------------------------------------
+item_definition_index_t CEconItemSystem::FindUniqueItemMatchingCriteria( CItemSelectionCriteria *pCriteria, int *pMatchCount )
+{
+	pCriteria->SetIgnoreEnabledFlag( true );
+
+	int nMatches = 0;
+	item_definition_index_t iMatch = INVALID_ITEM_DEF_INDEX;
+	const CEconItemSchema::ItemDefinitionMap_t &mapDefs = m_itemSchema.GetItemDefinitionMap();
+	FOR_EACH_MAP_FAST( mapDefs, i )
+	{
+		if ( pCriteria->BEvaluate( mapDefs[i] ) )
+		{
+			iMatch = mapDefs.Key( i );
+			++nMatches;
+		}
+	}
+
+	if ( pMatchCount )
+	{
+		*pMatchCount = nMatches;
+	}
+
+	return ( nMatches == 1 ) ? iMatch : INVALID_ITEM_DEF_INDEX;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Fill in whatever quality and level the criteria left up to the item
+//-----------------------------------------------------------------------------
+entityquality_t CEconItemSystem::FinishItemSelection( CItemSelectionCriteria *pCriteria, const CEconItemDefinition *pItemDef )
+{
 	// If we haven't specified an entity quality, we want to use the item's specified one
 	if ( pCriteria->GetQuality() == AE_USE_SCRIPT_VALUE )
 	{
@@ -352,11 +394,7 @@ HackMakeValidList:
 		pCriteria->SetItemLevel( RandomInt( pItemDef->GetMinLevel(), pItemDef->GetMaxLevel() ) );
 	}
 
-	if ( outEntityQuality )
-	{
-		*outEntityQuality = pCriteria->GetQuality();
-	}
-	return iChosenItem;
+	return pCriteria->GetQuality();
 }
 
 //-----------------------------------------------------------------------------
@@ -54,6 +54,13 @@ public:
 	// Select and return a random item's definition index matching the specified criteria
 	item_definition_index_t	GenerateRandomItem( CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality );
 
+	// Return the definition index of the only item matching the criteria, without choosing quality or level.
+	// Returns INVALID_ITEM_DEF_INDEX if nothing or more than one item matches; pMatchCount says which.
+	item_definition_index_t	FindUniqueItemMatchingCriteria( CItemSelectionCriteria *pCriteria, int *pMatchCount );
+
+	// Choose the quality and level for an item picked against the criteria, as GenerateRandomItem() does
+	entityquality_t	FinishItemSelection( CItemSelectionCriteria *pCriteria, const CEconItemDefinition *pItemDef );
+
 	// Select and return the base item definition index for a class's load-out slot 
 	// Note: baseitemcriteria_t is game-specific and/or may not exist!
 	virtual item_definition_index_t GenerateBaseItem( struct baseitemcriteria_t *pCriteria ) { return INVALID_ITEM_DEF_INDEX; }
@@ -29,6 +29,7 @@ ConVar tf_dropped_weapon_lifetime( "tf_dropped_weapon_lifetime", "30", FCVAR_CHE
 EXTERN_SEND_TABLE( DT_ScriptCreatedItem );
 
 LINK_ENTITY_TO_CLASS( tf_dropped_weapon, CTFDroppedWeapon );
+DEFINE_ENTITY_POOL( CTFDroppedWeapon, 16 );
 
 PRECACHE_REGISTER( tf_dropped_weapon );
 #else
@@ -16,6 +16,8 @@
 #endif // CLIENT_DLL
 
 #ifdef GAME_DLL
+#include "entity_pool.h"
+
 class CTFPlayer;
 #endif // GAME_DLL
 
@@ -82,6 +84,8 @@ private:
 	float m_flNextSecondaryAttack;
 	bool m_bBroken;
 	float m_flMeter;
+
+	DECLARE_ENTITY_POOL( CTFDroppedWeapon );
 #endif // GAME_DLL
 
 #ifdef CLIENT_DLL
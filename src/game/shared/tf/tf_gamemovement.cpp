@@ -36,6 +36,8 @@
 	#include "team.h"
 	#include "bot/tf_bot.h"
 	#include "tf_fx.h"
+	#include "world.h"
+	#include "tf_movement_replay.h"
 #endif
 
 
@@ -76,6 +78,8 @@ ConVar tf_movement_lost_footing_restick( "tf_movement_lost_footing_restick", "50
                                          "Early escape the lost footing condition if the player is moving slower than this across the ground" );
 ConVar tf_movement_lost_footing_friction( "tf_movement_lost_footing_friction", "0.1", FCVAR_REPLICATED | FCVAR_CHEAT,
                                           "Ground friction for players who have lost their footing" );
+ConVar tf_movement_trace_cache( "tf_movement_trace_cache", "1", FCVAR_REPLICATED | FCVAR_CHEAT,
+                                "Reuse a player's ground trace when it is repeated within a tick, and skip repeating the step move when stepping up could not raise the player" );
 
 extern ConVar cl_forwardspeed;
 extern ConVar cl_backspeed;
@@ -93,6 +97,9 @@ extern ConVar mp_tournament_readymode_countdown;
 
 #define	NUM_CROUCH_HINTS	3
 
+static int s_nMovementTraceCount = 0;		// player hull traces, for the movement replay benchmark
+static int s_nMovementTracesSaved = 0;		// player hull traces avoided by tf_movement_trace_cache
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -128,6 +135,7 @@ public:
 	virtual float	GetAirSpeedCap( void );
 
 	virtual void	TracePlayerBBox( const Vector& start, const Vector& end, unsigned int fMask, int collisionGroup, trace_t& pm );
+	virtual void	TryTouchGround( const Vector& start, const Vector& end, const Vector& mins, const Vector& maxs, unsigned int fMask, int collisionGroup, trace_t& pm );
 	virtual CBaseHandle	TestPlayerPosition( const Vector& pos, int collisionGroup, trace_t& pm );
 	virtual void	StepMove( Vector &vecDestination, trace_t &trace );
 	virtual bool	GameHasLadders() const;
@@ -135,6 +143,12 @@ public:
 	virtual void PlayerRoughLandingEffects( float fvol );
 
 	virtual void HandleDuckingSpeedCrop( void );
+
+#ifdef GAME_DLL
+	void		CaptureReplayState( CTFPlayer *pPlayer, TFMovementState_t *pState );
+	void		ApplyReplayState( CTFPlayer *pPlayer, const TFMovementState_t &state );
+#endif
+
 protected:
 
 	virtual void CheckWaterJump( void );
@@ -159,12 +173,29 @@ private:
 	void OnDuck( int nButtonsPressed );
 	void OnUnDuck( int nButtonsReleased );
 
+	void		TracePlayerGround( const Vector& start, const Vector& end, trace_t& pm );
+
 
 private:
 
 	Vector		m_vecWaterPoint;
 	CTFPlayer  *m_pTFPlayer;
 	bool		m_isPassingThroughEnemies;
+
+#ifdef GAME_DLL
+	// Last ground trace for each player, by entindex-1
+	struct GroundTrace_t
+	{
+		int				m_nTick;
+		Vector			m_vecStart;
+		Vector			m_vecEnd;
+		Vector			m_vecMins;
+		Vector			m_vecMaxs;
+		unsigned int	m_fMask;
+		trace_t			m_trace;
+	};
+	GroundTrace_t	m_groundTrace[ MAX_PLAYERS ];
+#endif
 };
 
 
@@ -184,6 +215,12 @@ CTFGameMovement::CTFGameMovement()
 	m_pTFPlayer = NULL;
 	m_isPassingThroughEnemies = false;
 
+#ifdef GAME_DLL
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		m_groundTrace[i].m_nTick = -1;
+	}
+#endif
 }
 
 //----------------------------------------------------------------------------------------
@@ -307,6 +344,14 @@ void CTFGameMovement::ProcessMovement( CBasePlayer *pBasePlayer, CMoveData *pMov
 	player = m_pTFPlayer;
 	mv = pMove;
 
+#if defined(GAME_DLL)
+	bool bRecording = TFMovementReplay_IsRecording( m_pTFPlayer );
+	if ( bRecording )
+	{
+		TFMovementReplay_RecordInput( m_pTFPlayer, pMove );
+	}
+#endif
+
 	// The max speed is currently set to the scout - if this changes we need to change this!
 	mv->m_flMaxSpeed = TF_MAX_SPEED;
 
@@ -333,6 +378,11 @@ void CTFGameMovement::ProcessMovement( CBasePlayer *pBasePlayer, CMoveData *pMov
 
 #if defined(GAME_DLL)
 	m_pTFPlayer->m_bTakenBlastDamageSinceLastMovement = false;
+
+	if ( bRecording )
+	{
+		TFMovementReplay_RecordOutput( m_pTFPlayer, pMove );
+	}
 #endif
 }
 
@@ -2297,6 +2347,8 @@ bool CTraceFilterObject::ShouldHitEntity( IHandleEntity *pHandleEntity, int cont
 //-----------------------------------------------------------------------------
 CBaseHandle CTFGameMovement::TestPlayerPosition( const Vector& pos, int collisionGroup, trace_t& pm )
 {
+	++s_nMovementTraceCount;
+
 	if( tf_solidobjects.GetBool() == false )
 		return BaseClass::TestPlayerPosition( pos, collisionGroup, pm );
 
@@ -2321,6 +2373,8 @@ CBaseHandle CTFGameMovement::TestPlayerPosition( const Vector& pos, int collisio
 //-----------------------------------------------------------------------------
 void CTFGameMovement::TracePlayerBBox( const Vector& start, const Vector& end, unsigned int fMask, int collisionGroup, trace_t& pm )
 {
+	++s_nMovementTraceCount;
+
 	if( tf_solidobjects.GetBool() == false )
 		return BaseClass::TracePlayerBBox( start, end, fMask, collisionGroup, pm );
 
@@ -2332,6 +2386,147 @@ void CTFGameMovement::TracePlayerBBox( const Vector& start, const Vector& end, u
 	enginetrace->TraceRay( ray, fMask, &traceFilter, &pm );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Counted like the other hull traces
+//-----------------------------------------------------------------------------
+void CTFGameMovement::TryTouchGround( const Vector& start, const Vector& end, const Vector& mins, const Vector& maxs, unsigned int fMask, int collisionGroup, trace_t& pm )
+{
+	++s_nMovementTraceCount;
+
+	BaseClass::TryTouchGround( start, end, mins, maxs, fMask, collisionGroup, pm );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Trace for the ground under the player. A player standing still, or
+//			running several commands in one tick, repeats the same ground trace;
+//			nothing else moves while a player's commands are being run, so within
+//			a tick a repeated trace that hit the world can be reused.
+//-----------------------------------------------------------------------------
+void CTFGameMovement::TracePlayerGround( const Vector& start, const Vector& end, trace_t& pm )
+{
+#ifdef GAME_DLL
+	int iSlot = player->entindex() - 1;
+	if ( tf_movement_trace_cache.GetBool() && iSlot >= 0 && iSlot < MAX_PLAYERS )
+	{
+		GroundTrace_t &ground = m_groundTrace[ iSlot ];
+		unsigned int fMask = PlayerSolidMask();
+
+		if ( ground.m_nTick == gpGlobals->tickcount &&
+			 ground.m_fMask == fMask &&
+			 ground.m_vecStart == start &&
+			 ground.m_vecEnd == end &&
+			 ground.m_vecMins == GetPlayerMins() &&
+			 ground.m_vecMaxs == GetPlayerMaxs() &&
+			 ground.m_trace.m_pEnt == GetWorldEntity() )
+		{
+			pm = ground.m_trace;
+			++s_nMovementTracesSaved;
+			return;
+		}
+
+		TracePlayerBBox( start, end, fMask, COLLISION_GROUP_PLAYER_MOVEMENT, pm );
+
+		if ( pm.DidHitWorld() && !pm.startsolid )
+		{
+			ground.m_nTick = gpGlobals->tickcount;
+			ground.m_fMask = fMask;
+			ground.m_vecStart = start;
+			ground.m_vecEnd = end;
+			ground.m_vecMins = GetPlayerMins();
+			ground.m_vecMaxs = GetPlayerMaxs();
+			ground.m_trace = pm;
+		}
+		else
+		{
+			ground.m_nTick = -1;
+		}
+		return;
+	}
+#endif
+
+	TracePlayerBBox( start, end, PlayerSolidMask(), COLLISION_GROUP_PLAYER_MOVEMENT, pm );
+}
+
+#ifdef GAME_DLL
+//-----------------------------------------------------------------------------
+// Purpose: Snapshot the player state the movement code reads outside of CMoveData
+//-----------------------------------------------------------------------------
+void CTFGameMovement::CaptureReplayState( CTFPlayer *pPlayer, TFMovementState_t *pState )
+{
+	pState->m_vecBaseVelocity = pPlayer->GetBaseVelocity();
+	pState->m_vecViewOffset = pPlayer->GetViewOffset();
+	pState->m_fFlags = pPlayer->GetFlags();
+	pState->m_nMoveType = pPlayer->GetMoveType();
+	pState->m_nWaterLevel = pPlayer->GetWaterLevel();
+	pState->m_nWaterType = pPlayer->GetWaterType();
+	pState->m_bOnGround = ( pPlayer->GetGroundEntity() != NULL );
+	pState->m_flGravity = pPlayer->GetGravity();
+	pState->m_flSurfaceFriction = pPlayer->m_surfaceFriction;
+	pState->m_flFallVelocity = pPlayer->m_Local.m_flFallVelocity;
+	pState->m_bDucked = pPlayer->m_Local.m_bDucked;
+	pState->m_bDucking = pPlayer->m_Local.m_bDucking;
+	pState->m_bInDuckJump = pPlayer->m_Local.m_bInDuckJump;
+	pState->m_flDucktime = pPlayer->m_Local.m_flDucktime;
+	pState->m_flDuckJumpTime = pPlayer->m_Local.m_flDuckJumpTime;
+	pState->m_flJumpTime = pPlayer->m_Local.m_flJumpTime;
+	pState->m_nAirDash = pPlayer->m_Shared.GetAirDash();
+	pState->m_nAirDucked = pPlayer->m_Shared.AirDuckedCount();
+	pPlayer->m_Shared.GetCondBits( pState->m_nCond );
+	pState->m_flCurTime = gpGlobals->curtime;
+	pState->m_nTickCount = gpGlobals->tickcount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Put the player back into a state captured by CaptureReplayState()
+//-----------------------------------------------------------------------------
+void CTFGameMovement::ApplyReplayState( CTFPlayer *pPlayer, const TFMovementState_t &state )
+{
+	pPlayer->SetBaseVelocity( state.m_vecBaseVelocity );
+	pPlayer->SetViewOffset( state.m_vecViewOffset );
+	pPlayer->ClearFlags();
+	pPlayer->AddFlag( state.m_fFlags );
+	pPlayer->SetMoveType( (MoveType_t)state.m_nMoveType );
+	pPlayer->SetWaterLevel( state.m_nWaterLevel );
+	pPlayer->SetWaterType( state.m_nWaterType );
+	pPlayer->SetGroundEntity( state.m_bOnGround ? GetWorldEntity() : NULL );
+	pPlayer->SetGravity( state.m_flGravity );
+	pPlayer->m_surfaceFriction = state.m_flSurfaceFriction;
+	pPlayer->m_Local.m_flFallVelocity = state.m_flFallVelocity;
+	pPlayer->m_Local.m_bDucked = state.m_bDucked;
+	pPlayer->m_Local.m_bDucking = state.m_bDucking;
+	pPlayer->m_Local.m_bInDuckJump = state.m_bInDuckJump;
+	pPlayer->m_Local.m_flDucktime = state.m_flDucktime;
+	pPlayer->m_Local.m_flDuckJumpTime = state.m_flDuckJumpTime;
+	pPlayer->m_Local.m_flJumpTime = state.m_flJumpTime;
+	pPlayer->m_Shared.SetAirDash( state.m_nAirDash );
+	pPlayer->m_Shared.SetAirDucked( state.m_nAirDucked );
+	pPlayer->m_Shared.SetCondBits( state.m_nCond );
+	gpGlobals->curtime = state.m_flCurTime;
+	gpGlobals->tickcount = state.m_nTickCount;
+	gpGlobals->frametime = TICK_INTERVAL;
+}
+
+void TFGameMovement_CaptureState( CTFPlayer *pPlayer, TFMovementState_t *pState )
+{
+	g_GameMovement.CaptureReplayState( pPlayer, pState );
+}
+
+void TFGameMovement_ApplyState( CTFPlayer *pPlayer, const TFMovementState_t &state )
+{
+	g_GameMovement.ApplyReplayState( pPlayer, state );
+}
+
+int TFGameMovement_GetTraceCount( void )
+{
+	return s_nMovementTraceCount;
+}
+
+int TFGameMovement_GetTracesSavedCount( void )
+{
+	return s_nMovementTracesSaved;
+}
+#endif // GAME_DLL
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : &input - 
@@ -2389,7 +2584,7 @@ void CTFGameMovement::CategorizePosition( void )
 	}
 
 	trace_t trace;
-	TracePlayerBBox( vecStartPos, vecEndPos, PlayerSolidMask(), COLLISION_GROUP_PLAYER_MOVEMENT, trace );
+	TracePlayerGround( vecStartPos, vecEndPos, trace );
 
 	bool bInAir = false;
 	float flGroundFrictionMult = 1.f;
@@ -2846,6 +3041,12 @@ void CTFGameMovement::StepMove( Vector &vecDestination, trace_t &trace )
 	bool bLowRoad = false;
 	bool bUpRoad = true;
 
+	// If stepping up can't raise us, moving over from there is the same move as the
+	// "low road" below, so remember where it went instead of doing it twice.
+	bool bOverIsLowRoad = false;
+	Vector vecOverPos, vecOverVel;
+	int nOverTraces = 0;
+
 	// First try the "high road" where we move up and over obstacles
 	if ( player->m_Local.m_bAllowAutoMovement )
 	{
@@ -2859,7 +3060,22 @@ void CTFGameMovement::StepMove( Vector &vecDestination, trace_t &trace )
 		}
 
 		// Trace over from there
-		TryPlayerMove();
+		if ( tf_movement_trace_cache.GetBool() && VectorCompare( mv->GetAbsOrigin(), vecPos ) )
+		{
+			nOverTraces = s_nMovementTraceCount;
+
+			// still at the start, so the trace we were given is the first one this would do
+			TryPlayerMove( &vecDestination, &saveTrace );
+
+			bOverIsLowRoad = true;
+			nOverTraces = s_nMovementTraceCount - nOverTraces;
+			VectorCopy( mv->GetAbsOrigin(), vecOverPos );
+			VectorCopy( mv->m_vecVelocity, vecOverVel );
+		}
+		else
+		{
+			TryPlayerMove();
+		}
 
 		// Then trace back down by step height to get final position
 		VectorCopy( mv->GetAbsOrigin(), vecEndPos );
@@ -2896,10 +3112,19 @@ void CTFGameMovement::StepMove( Vector &vecDestination, trace_t &trace )
 		}
 
 		// Take the "low" road
-		mv->SetAbsOrigin( vecPos );
-		VectorCopy( vecVel, mv->m_vecVelocity );
-		VectorCopy( vecDestination, vecEndPos );
-		TryPlayerMove( &vecEndPos, &saveTrace );
+		if ( bOverIsLowRoad )
+		{
+			mv->SetAbsOrigin( vecOverPos );
+			VectorCopy( vecOverVel, mv->m_vecVelocity );
+			s_nMovementTracesSaved += nOverTraces;
+		}
+		else
+		{
+			mv->SetAbsOrigin( vecPos );
+			VectorCopy( vecVel, mv->m_vecVelocity );
+			VectorCopy( vecDestination, vecEndPos );
+			TryPlayerMove( &vecEndPos, &saveTrace );
+		}
 
 		// Down results.
 		Vector vecDownPos, vecDownVel;
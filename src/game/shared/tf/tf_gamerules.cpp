@@ -127,6 +127,8 @@
 	#include "tf_party.h"
 	#include "tf_autobalance.h"
 	#include "player_voice_listener.h"
+	#include "vscript_server.h"
+	#include "mathlib/ssemath.h"
 #endif
 
 #include "tf_mann_vs_machine_stats.h"
@@ -5580,11 +5582,151 @@ public:
 	const IHandleEntity *m_pExceptionEntity;
 };
 
+ConVar tf_radiusdamage_batch( "tf_radiusdamage_batch", "1", FCVAR_CHEAT, "Evaluate falloff and line of sight for every target of an explosion before applying any of its damage" );
+
+// One entity in range of an explosion
+struct TFRadiusDamageTarget_t
+{
+	CBaseEntity *m_pEntity;
+	Vector m_vecSpot;				// BodyTarget(), where the occlusion trace goes
+	Vector m_vecNear[2];			// falloff is measured to the closer of these
+	float m_flDamage;				// after falloff, before self damage is scaled down
+	bool m_bInRange;				// close enough and able to take damage
+	bool m_bBlocked;
+	trace_t m_trace;
+};
+
+typedef CUtlVectorFixedGrowable< TFRadiusDamageTarget_t, 32 > TFRadiusDamageTargetVector;
+
+static struct TFRadiusDamageStats_t
+{
+	int m_nExplosions;
+	int m_nTargets;
+	int m_nTraces;
+	int m_nTracesSkipped;			// falloff already took the damage to zero
+	int m_nFallbacks;				// targets re-evaluated because the world changed mid-explosion
+	double m_flTotalTime;
+	double m_flMaxTime;
+} s_radiusDamageStats;
+
+// Notices entities created while an explosion is being applied (gibs, ammo packs, currency, script spawns)
+class CTFRadiusDamageEntityListener : public IEntityListener
+{
+public:
+	CTFRadiusDamageEntityListener( void ) : m_bCreated( false )		{ gEntList.AddListenerEntity( this ); }
+	~CTFRadiusDamageEntityListener()								{ gEntList.RemoveListenerEntity( this ); }
+
+	virtual void OnEntityCreated( CBaseEntity *pEntity )			{ m_bCreated = true; }
+
+	bool m_bCreated;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Compute falloff for every target and trace the ones that can still be hurt,
+//			before any damage is applied. Produces exactly what ApplyToEntity() would
+//			have for each target, as long as applying damage doesn't change the world.
+//-----------------------------------------------------------------------------
+static void EvaluateRadiusDamageTargets( CTFRadiusDamageInfo &info, TFRadiusDamageTargetVector &targets )
+{
+	CBaseEntity *pInflictor = info.dmgInfo->GetInflictor();
+	CBaseEntity *pEnemy = pInflictor ? pInflictor->GetEnemy() : NULL;
+
+	// Only non-players measure falloff from where the trace ended, so trace those first
+	FOR_EACH_VEC( targets, i )
+	{
+		TFRadiusDamageTarget_t &target = targets[i];
+		if ( !target.m_bInRange )
+		{
+			target.m_vecNear[0] = target.m_vecNear[1] = info.vecSrc;
+			target.m_bBlocked = true;
+		}
+		else if ( target.m_pEntity->IsPlayer() )
+		{
+			target.m_vecNear[0] = target.m_pEntity->WorldSpaceCenter();
+			target.m_vecNear[1] = target.m_pEntity->GetAbsOrigin();
+			target.m_bBlocked = false;
+		}
+		else
+		{
+			target.m_bBlocked = !info.TraceToEntity( target.m_pEntity, target.m_vecSpot, &target.m_trace );
+			target.m_vecNear[0] = target.m_vecNear[1] = target.m_trace.endpos;
+			++s_radiusDamageStats.m_nTraces;
+		}
+
+		// Rockets store the ent they hit as the enemy and have already dealt full damage to them by this time
+		if ( target.m_pEntity == pEnemy )
+		{
+			target.m_vecNear[0] = target.m_vecNear[1] = info.vecSrc;
+		}
+	}
+
+	// RemapValClamped( dist, 0, radius, damage, damage * falloff ), four targets at a time.
+	// Every operation is the IEEE one the scalar code performs, in the same order.
+	const float flDamage = info.dmgInfo->GetDamage();
+	const fltx4 fl4Src[3] = { ReplicateX4( info.vecSrc.x ), ReplicateX4( info.vecSrc.y ), ReplicateX4( info.vecSrc.z ) };
+	const fltx4 fl4Radius = ReplicateX4( info.flRadius );
+	const fltx4 fl4Damage = ReplicateX4( flDamage );
+	const fltx4 fl4DamageRange = ReplicateX4( flDamage * info.GetFalloff() - flDamage );
+
+	for ( int i = 0; i < targets.Count(); i += 4 )
+	{
+		fltx4 fl4Dist[2];
+		for ( int n = 0; n < 2; ++n )
+		{
+			const Vector &v0 = targets[i].m_vecNear[n];
+			const Vector &v1 = targets[ MIN( i + 1, targets.Count() - 1 ) ].m_vecNear[n];
+			const Vector &v2 = targets[ MIN( i + 2, targets.Count() - 1 ) ].m_vecNear[n];
+			const Vector &v3 = targets[ MIN( i + 3, targets.Count() - 1 ) ].m_vecNear[n];
+
+			FourVectors delta;
+			delta.LoadAndSwizzle( v0, v1, v2, v3 );
+			delta.x = SubSIMD( fl4Src[0], delta.x );
+			delta.y = SubSIMD( fl4Src[1], delta.y );
+			delta.z = SubSIMD( fl4Src[2], delta.z );
+
+			fltx4 fl4LengthSqr = MulSIMD( delta.x, delta.x );
+			fl4LengthSqr = AddSIMD( fl4LengthSqr, MulSIMD( delta.y, delta.y ) );
+			fl4LengthSqr = AddSIMD( fl4LengthSqr, MulSIMD( delta.z, delta.z ) );
+			fl4Dist[n] = SqrtSIMD( fl4LengthSqr );
+		}
+
+		fltx4 fl4Fraction = DivSIMD( MinSIMD( fl4Dist[0], fl4Dist[1] ), fl4Radius );
+		fl4Fraction = MaxSIMD( MinSIMD( fl4Fraction, Four_Ones ), Four_Zeros );
+		fltx4 fl4Adjusted = AddSIMD( fl4Damage, MulSIMD( fl4DamageRange, fl4Fraction ) );
+
+		for ( int n = 0; n < 4 && i + n < targets.Count(); ++n )
+		{
+			targets[ i + n ].m_flDamage = SubFloat( fl4Adjusted, n );
+		}
+	}
+
+	// Players trace last, and only if there is damage left to deal after falloff
+	FOR_EACH_VEC( targets, i )
+	{
+		TFRadiusDamageTarget_t &target = targets[i];
+		if ( !target.m_bInRange || !target.m_pEntity->IsPlayer() )
+			continue;
+
+		if ( target.m_flDamage <= 0.f )
+		{
+			target.m_bBlocked = true;
+			++s_radiusDamageStats.m_nTracesSkipped;
+			continue;
+		}
+
+		target.m_bBlocked = !info.TraceToEntity( target.m_pEntity, target.m_vecSpot, &target.m_trace );
+		++s_radiusDamageStats.m_nTraces;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
 void CTFGameRules::RadiusDamage( CTFRadiusDamageInfo &info )
 {
+	VPROF_BUDGET( "CTFGameRules::RadiusDamage", VPROF_BUDGETGROUP_GAME );
+
+	double flStartTime = Plat_FloatTime();
 	float flRadSqr = (info.flRadius * info.flRadius);
 
 	int iDamageEnemies = 0;
@@ -5592,7 +5734,8 @@ void CTFGameRules::RadiusDamage( CTFRadiusDamageInfo &info )
 	// Some weapons pass a radius of 0, since their only goal is to give blast jumping ability
 	if ( info.flRadius > 0 )
 	{
-		// Find all the entities in the radius, and attempt to damage them.
+		// Find all the entities in the radius
+		TFRadiusDamageTargetVector targets;
 		CBaseEntity *pEntity = NULL;
 		for ( CEntitySphereQuery sphere( info.vecSrc, info.flRadius ); (pEntity = sphere.GetCurrentEntity()) != NULL; sphere.NextEntity() )
 		{
@@ -5600,13 +5743,75 @@ void CTFGameRules::RadiusDamage( CTFRadiusDamageInfo &info )
 			if ( info.flRJRadius && pEntity == info.dmgInfo->GetAttacker() )
 				continue;
 
+			TFRadiusDamageTarget_t &target = targets[ targets.AddToTail() ];
+			target.m_pEntity = pEntity;
+		}
+
+		// Script callbacks can move or spawn anything while damage is applied, so only
+		// evaluate targets up front when nothing is listening.
+		bool bBatch = tf_radiusdamage_batch.GetBool() && info.dmgInfo->GetInflictor() && !( g_pScriptVM && g_VScriptGameEventListener.HasAnyListeners() );
+		if ( bBatch )
+		{
 			// CEntitySphereQuery actually does a box test. So we need to make sure the distance is less than the radius first.
-			Vector vecPos;
-			pEntity->CollisionProp()->CalcNearestPoint( info.vecSrc, &vecPos );
-			if ( (info.vecSrc - vecPos).LengthSqr() > flRadSqr )
-				continue;
+			FOR_EACH_VEC( targets, i )
+			{
+				TFRadiusDamageTarget_t &target = targets[i];
+				Vector vecPos;
+				target.m_pEntity->CollisionProp()->CalcNearestPoint( info.vecSrc, &vecPos );
+				target.m_bInRange = (info.vecSrc - vecPos).LengthSqr() <= flRadSqr && target.m_pEntity != info.pEntityIgnore && target.m_pEntity->m_takedamage != DAMAGE_NO;
+				if ( target.m_bInRange )
+				{
+					target.m_vecSpot = target.m_pEntity->BodyTarget( info.vecSrc, false );
+					++s_radiusDamageStats.m_nTargets;
+				}
+			}
+
+			EvaluateRadiusDamageTargets( info, targets );
+		}
+
+		// Attempt to damage them
+		CTFRadiusDamageEntityListener listener;
+		bool bEvaluated = bBatch;
+		FOR_EACH_VEC( targets, i )
+		{
+			TFRadiusDamageTarget_t &target = targets[i];
+			pEntity = target.m_pEntity;
+
+			if ( listener.m_bCreated )
+			{
+				bBatch = false;
+			}
+
+			int iDamageToEntity;
+			if ( bBatch )
+			{
+				if ( target.m_bBlocked )
+					continue;
+
+				iDamageToEntity = info.ApplyTracedDamage( pEntity, target.m_vecSpot, target.m_trace, target.m_flDamage );
+
+				// Breaking a building or prop can open up lines of sight evaluated above
+				if ( !pEntity->IsPlayer() )
+				{
+					bBatch = false;
+				}
+			}
+			else
+			{
+				if ( bEvaluated )
+				{
+					++s_radiusDamageStats.m_nFallbacks;
+				}
+
+				// CEntitySphereQuery actually does a box test. So we need to make sure the distance is less than the radius first.
+				Vector vecPos;
+				pEntity->CollisionProp()->CalcNearestPoint( info.vecSrc, &vecPos );
+				if ( (info.vecSrc - vecPos).LengthSqr() > flRadSqr )
+					continue;
+
+				iDamageToEntity = info.ApplyToEntity( pEntity );
+			}
 
-			int iDamageToEntity = info.ApplyToEntity( pEntity );
 			if ( iDamageToEntity )
 			{
 				// Keep track of any enemies we damaged
@@ -5673,6 +5878,29 @@ void CTFGameRules::RadiusDamage( CTFRadiusDamageInfo &info )
 			info.ApplyToEntity( info.dmgInfo->GetAttacker() );
 		}
 	}
+
+	double flElapsed = Plat_FloatTime() - flStartTime;
+	++s_radiusDamageStats.m_nExplosions;
+	s_radiusDamageStats.m_flTotalTime += flElapsed;
+	s_radiusDamageStats.m_flMaxTime = MAX( s_radiusDamageStats.m_flMaxTime, flElapsed );
+}
+
+CON_COMMAND_F( tf_radiusdamage_stats, "Show the cost of explosion damage. 'tf_radiusdamage_stats reset' clears the counts.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		V_memset( &s_radiusDamageStats, 0, sizeof( s_radiusDamageStats ) );
+		return;
+	}
+
+	const TFRadiusDamageStats_t &stats = s_radiusDamageStats;
+	int nExplosions = MAX( stats.m_nExplosions, 1 );
+	Msg( "%d explosions, %.3f ms total, %.4f ms avg, %.4f ms max\n", stats.m_nExplosions, stats.m_flTotalTime * 1000.0, stats.m_flTotalTime * 1000.0 / nExplosions, stats.m_flMaxTime * 1000.0 );
+	Msg( "%d targets (%.1f per explosion), %d occlusion traces, %d skipped by falloff, %d re-evaluated after the world changed\n",
+		 stats.m_nTargets, (float)stats.m_nTargets / nExplosions, stats.m_nTraces, stats.m_nTracesSkipped, stats.m_nFallbacks );
 }
 
 //-----------------------------------------------------------------------------
@@ -5718,41 +5946,18 @@ int CTFRadiusDamageInfo::ApplyToEntity( CBaseEntity *pEntity )
 	if ( pEntity == pEntityIgnore || pEntity->m_takedamage == DAMAGE_NO )
 		return 0;
 
-	trace_t	tr;
-	CBaseEntity *pInflictor = dmgInfo->GetInflictor();
-
 	// Check that the explosion can 'see' this entity.
+	trace_t	tr;
 	Vector vecSpot = pEntity->BodyTarget( vecSrc, false );
-	CTraceFilterIgnorePlayers filterPlayers( pInflictor, COLLISION_GROUP_PROJECTILE );
-	CTraceFilterIgnoreProjectiles filterProjectiles( pInflictor, COLLISION_GROUP_PROJECTILE );
-	CTraceFilterIgnoreFriendlyCombatItems filterCombatItems( pInflictor, COLLISION_GROUP_PROJECTILE, pInflictor->GetTeamNumber() );
-	CTraceFilterChain filterPlayersAndProjectiles( &filterPlayers, &filterProjectiles );
-	CTraceFilterChain filter( &filterPlayersAndProjectiles, &filterCombatItems );
-
-	UTIL_TraceLine( vecSrc, vecSpot, MASK_RADIUS_DAMAGE, &filter, &tr );
-	if ( tr.startsolid && tr.m_pEnt )
-	{
-		// Return when inside an enemy combat shield and tracing against a player of that team ("absorbed")
-		if ( tr.m_pEnt->IsCombatItem() && pEntity->InSameTeam( tr.m_pEnt ) && ( pEntity != tr.m_pEnt ) )
-			return 0;
-
-		filterPlayers.SetPassEntity( tr.m_pEnt );
-		CTraceFilterChain filterSelf( &filterPlayers, &filterCombatItems );
-		UTIL_TraceLine( vecSrc, vecSpot, MASK_RADIUS_DAMAGE, &filterSelf, &tr );
-	}
-
-	// If we don't trace the whole way to the target, and we didn't hit the target entity, we're blocked
-	if ( tr.fraction != 1.f && tr.m_pEnt != pEntity )
-	{
-		// Don't let projectiles block damage
+	if ( !TraceToEntity( pEntity, vecSpot, &tr ) )
 		return 0;
-	}
 
 	// Adjust the damage - apply falloff.
 	float flAdjustedDamage = 0.0f;
 	float flDistanceToEntity;
 
 	// Rockets store the ent they hit as the enemy and have already dealt full damage to them by this time
+	CBaseEntity *pInflictor = dmgInfo->GetInflictor();
 	if ( pInflictor && ( pEntity == pInflictor->GetEnemy() ) )
 	{
 		// Full damage, we hit this entity directly
@@ -5773,6 +5978,51 @@ int CTFRadiusDamageInfo::ApplyToEntity( CBaseEntity *pEntity )
 
 	flAdjustedDamage = RemapValClamped( flDistanceToEntity, 0, flRadius, dmgInfo->GetDamage(), dmgInfo->GetDamage() * flFalloff );
 
+	return ApplyTracedDamage( pEntity, vecSpot, tr, flAdjustedDamage );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Trace from the explosion to vecSpot on the entity. Returns false if
+//			the entity is shielded from the explosion.
+//-----------------------------------------------------------------------------
+bool CTFRadiusDamageInfo::TraceToEntity( CBaseEntity *pEntity, const Vector &vecSpot, trace_t *pTrace )
+{
+	trace_t	&tr = *pTrace;
+	CBaseEntity *pInflictor = dmgInfo->GetInflictor();
+
+	CTraceFilterIgnorePlayers filterPlayers( pInflictor, COLLISION_GROUP_PROJECTILE );
+	CTraceFilterIgnoreProjectiles filterProjectiles( pInflictor, COLLISION_GROUP_PROJECTILE );
+	CTraceFilterIgnoreFriendlyCombatItems filterCombatItems( pInflictor, COLLISION_GROUP_PROJECTILE, pInflictor->GetTeamNumber() );
+	CTraceFilterChain filterPlayersAndProjectiles( &filterPlayers, &filterProjectiles );
+	CTraceFilterChain filter( &filterPlayersAndProjectiles, &filterCombatItems );
+
+	UTIL_TraceLine( vecSrc, vecSpot, MASK_RADIUS_DAMAGE, &filter, &tr );
+	if ( tr.startsolid && tr.m_pEnt )
+	{
+		// Return when inside an enemy combat shield and tracing against a player of that team ("absorbed")
+		if ( tr.m_pEnt->IsCombatItem() && pEntity->InSameTeam( tr.m_pEnt ) && ( pEntity != tr.m_pEnt ) )
+			return false;
+
+		filterPlayers.SetPassEntity( tr.m_pEnt );
+		CTraceFilterChain filterSelf( &filterPlayers, &filterCombatItems );
+		UTIL_TraceLine( vecSrc, vecSpot, MASK_RADIUS_DAMAGE, &filterSelf, &tr );
+	}
+
+	// If we don't trace the whole way to the target, and we didn't hit the target entity, we're blocked
+	if ( tr.fraction != 1.f && tr.m_pEnt != pEntity )
+	{
+		// Don't let projectiles block damage
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Deal damage after falloff to an entity the explosion can see
+//-----------------------------------------------------------------------------
+int CTFRadiusDamageInfo::ApplyTracedDamage( CBaseEntity *pEntity, const Vector &vecSpot, trace_t &tr, float flAdjustedDamage )
+{
 	CTFWeaponBase *pWeapon = dynamic_cast<CTFWeaponBase *>(dmgInfo->GetWeapon());
 	
 	// Grenades & Pipebombs do less damage to ourselves.
@@ -9230,9 +9480,12 @@ void CTFGameRules::LoadNextTrainingMap()
 //Need to do this here instead of the player so players that crash still run their important thinks
 void CTFGameRules::RunPlayerConditionThink ( void )
 {
-	for ( int i = 1 ; i <= gpGlobals->maxClients ; i++ )
+	CPlayerRegistry &registry = PlayerRegistry();
+	int nPlayerCount = registry.GetPlayerCount();
+
+	for ( int i = 0 ; i < nPlayerCount ; i++ )
 	{
-		CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+		CTFPlayer *pPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 
 		if ( pPlayer )
 		{
@@ -9442,9 +9695,12 @@ void CTFGameRules::CheckRespawnWaves()
 	BaseClass::CheckRespawnWaves();
 
 	// Look for overrides
-	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
+	CPlayerRegistry &registry = PlayerRegistry();
+	int nPlayerCount = registry.GetPlayerCount();
+
+	for ( int i = 0; i < nPlayerCount; i++ )
 	{
-		CTFPlayer *pTFPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+		CTFPlayer *pTFPlayer = ToTFPlayer( registry.GetPlayer( i ) );
 		if ( !pTFPlayer )
 			continue;
 
@@ -246,6 +246,11 @@ public:
 	void CalculateFalloff( void );
 	int ApplyToEntity( CBaseEntity *pEntity );
 
+	// The pieces of ApplyToEntity(), for callers that evaluate many targets at once
+	bool TraceToEntity( CBaseEntity *pEntity, const Vector &vecSpot, trace_t *pTrace );
+	int ApplyTracedDamage( CBaseEntity *pEntity, const Vector &vecSpot, trace_t &tr, float flAdjustedDamage );
+	float GetFalloff( void ) const { return flFalloff; }
+
 public:
 	// Fill these in & call RadiusDamage()
 	CTakeDamageInfo	*dmgInfo;
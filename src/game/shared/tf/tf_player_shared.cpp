@@ -1202,6 +1202,31 @@ bool CTFPlayerShared::InCond( ETFCond eCond ) const
 	return (cPlayerCond.CondVar() & cPlayerCond.CondBit()) != 0;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Copy out the condition bits. Conditions kept in m_ConditionList are not included.
+//-----------------------------------------------------------------------------
+void CTFPlayerShared::GetCondBits( int nBits[5] ) const
+{
+	nBits[0] = m_nPlayerCond;
+	nBits[1] = m_nPlayerCondEx;
+	nBits[2] = m_nPlayerCondEx2;
+	nBits[3] = m_nPlayerCondEx3;
+	nBits[4] = m_nPlayerCondEx4;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Overwrite the condition bits without running OnConditionAdded/Removed.
+//			Only for putting a player back into a previously captured state.
+//-----------------------------------------------------------------------------
+void CTFPlayerShared::SetCondBits( const int nBits[5] )
+{
+	m_nPlayerCond = nBits[0];
+	m_nPlayerCondEx = nBits[1];
+	m_nPlayerCondEx2 = nBits[2];
+	m_nPlayerCondEx3 = nBits[3];
+	m_nPlayerCondEx4 = nBits[4];
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Return whether or not we were in this condition before.
 //-----------------------------------------------------------------------------
@@ -306,6 +306,8 @@ public:
 	bool	InCond( ETFCond eCond ) const;
 	bool	WasInCond( ETFCond eCond ) const;
 	void	ForceRecondNextSync( ETFCond eCond );
+	void	GetCondBits( int nBits[5] ) const;			// raw bits, for recording movement
+	void	SetCondBits( const int nBits[5] );			// raw bits without add/remove callbacks, for replaying movement
 	void	RemoveAllCond();
 	void	OnConditionAdded( ETFCond eCond );
 	void	OnConditionRemoved( ETFCond eCond );
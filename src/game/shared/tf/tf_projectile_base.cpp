@@ -23,6 +23,7 @@
 #define CRecipientFilter C_RecipientFilter
 #else
 #include "tf_player.h"
+#include "entity_pool.h"
 #endif
 
 #ifdef _DEBUG
@@ -107,7 +108,10 @@ void CTFBaseProjectile::Spawn( void )
 #else
 
 	// Precache.
-	Precache();
+	if ( EntityNeedsPrecache( this ) )
+	{
+		Precache();
+	}
 
 	SetModel( GetProjectileModelName() );
 
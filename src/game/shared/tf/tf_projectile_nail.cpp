@@ -31,6 +31,10 @@
 LINK_ENTITY_TO_CLASS( tf_projectile_syringe, CTFProjectile_Syringe );
 PRECACHE_REGISTER( tf_projectile_syringe );
 
+#ifdef GAME_DLL
+DEFINE_ENTITY_POOL( CTFProjectile_Syringe, 64 );
+#endif
+
 
 short g_sModelIndexSyringe;
 void PrecacheSyringe(void *pUser)
@@ -13,6 +13,10 @@
 #include "tf_projectile_base.h"
 #include "tf_weaponbase_gun.h"
 
+#ifdef GAME_DLL
+#include "entity_pool.h"
+#endif
+
 //-----------------------------------------------------------------------------
 // Purpose: Identical to a nail except for model used
 //-----------------------------------------------------------------------------
@@ -27,6 +31,10 @@ public:
 	virtual unsigned int PhysicsSolidMaskForEntity( void ) const;
 	virtual const char *GetProjectileModelName( void )	{ return "models/weapons/w_models/w_syringe_proj.mdl"; }
 	virtual float GetGravity( void );
+
+#ifdef GAME_DLL
+	DECLARE_ENTITY_POOL( CTFProjectile_Syringe );
+#endif
 };
 
 
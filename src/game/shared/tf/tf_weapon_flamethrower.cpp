@@ -2774,6 +2774,7 @@ END_NETWORK_TABLE()
 
 #ifdef GAME_DLL
 LINK_ENTITY_TO_CLASS( tf_flame, CTFFlameEntity );
+DEFINE_ENTITY_POOL( CTFFlameEntity, 64 );
 IMPLEMENT_AUTO_LIST( ITFFlameEntityAutoList );
 
 //-----------------------------------------------------------------------------
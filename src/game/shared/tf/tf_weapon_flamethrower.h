@@ -26,6 +26,7 @@
 	#include "tf_projectile_rocket.h"
 	#include "baseentity.h"
 	#include "iscorer.h"
+	#include "entity_pool.h"
 #endif
 
 enum FlameThrowerState_t
@@ -294,6 +295,8 @@ private:
 	bool					m_bBurnedEnemy;			// We track hitting to calculate hit/miss ratio in the Flamethrower
 
 	CHandle< CTFFlameThrower > m_hFlameThrower;
+
+	DECLARE_ENTITY_POOL( CTFFlameEntity );
 };
 #endif // GAME_DLL
 
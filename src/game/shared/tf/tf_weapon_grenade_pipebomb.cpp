@@ -36,6 +36,7 @@
 #include "player_vs_environment/boss_alpha/boss_alpha.h"
 #endif // TF_RAID_MODE
 #include "tf_weapon_medigun.h"
+#include "projectile_registry.h"
 #endif
 
 #define TF_WEAPON_PIPEBOMB_TIMER		3.0f //Seconds
@@ -409,6 +410,8 @@ PRECACHE_WEAPON_REGISTER( tf_projectile_pipe_remote );
 LINK_ENTITY_TO_CLASS( tf_projectile_pipe, CTFGrenadePipebombProjectile );
 PRECACHE_WEAPON_REGISTER( tf_projectile_pipe );
 
+DEFINE_ENTITY_POOL( CTFGrenadePipebombProjectile, 32 );
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -632,7 +635,7 @@ bool CTFGrenadePipebombProjectile::DetonateStickies()
 	Vector vecOrigin = GetAbsOrigin();
 	const int maxEntities = 64;
 	CBaseEntity	*pObjects[ maxEntities ];
-	int count = UTIL_EntitiesInSphere( pObjects, maxEntities, vecOrigin, GetDamageRadius(), FL_GRENADE );
+	int count = ProjectileRegistry().GetProjectilesInSphere( pObjects, maxEntities, vecOrigin, GetDamageRadius() );
 
 	int iStickiesRemoved = 0;
 
@@ -11,6 +11,10 @@
 
 #include "tf_weaponbase_grenadeproj.h"
 
+#ifdef GAME_DLL
+#include "entity_pool.h"
+#endif
+
 // Client specific.
 #ifdef CLIENT_DLL
 #define CTFGrenadePipebombProjectile C_TFGrenadePipebombProjectile
@@ -156,6 +160,8 @@ private:
 
 	CUtlVector < CHandle <CTFPlayer> > m_CritMedics;
 	CUtlVector < CHandle <CBaseEntity> > m_penetratedEntities;
+
+	DECLARE_ENTITY_POOL( CTFGrenadePipebombProjectile );
 #endif
 };
 
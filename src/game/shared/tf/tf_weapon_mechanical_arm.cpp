@@ -18,6 +18,7 @@
 #include "tf_team.h"
 #include "tf_passtime_logic.h"
 #include "tf_gamerules.h"
+#include "projectile_registry.h"
 #else
 #include "c_tf_player.h"
 #endif
@@ -816,7 +817,7 @@ void CTFProjectile_MechanicalArmOrb::CheckForProjectiles( void )
 
 	Vector vecPos = GetAbsOrigin();
 	CBaseEntity	*pObjects[nMaxEnts];
-	int nCount = UTIL_EntitiesInSphere( pObjects, nMaxEnts, vecPos, flRadius, FL_GRENADE );
+	int nCount = ProjectileRegistry().GetProjectilesInSphere( pObjects, nMaxEnts, vecPos, flRadius );
 
 	//NDebugOverlay::Sphere( vecPos, flRadius, 0, 255, 0, false, 0.35f );
 
@@ -29,6 +29,7 @@
 #include "particle_parse.h"
 #include "tf_gamestats.h"
 #include "baseprojectile.h"
+#include "projectile_registry.h"
 #endif
 
 #define MAX_BARREL_SPIN_VELOCITY	20
@@ -593,7 +594,7 @@ void CTFMinigun::AttackEnemyProjectiles( void )
 	// Iterate through each grenade/rocket in the sphere
 	const int nMaxEnts = 32;
 	CBaseEntity	*pObjects[ nMaxEnts ];
-	int nCount = UTIL_EntitiesInSphere( pObjects, nMaxEnts, vecGunPos, nSweepDist, FL_GRENADE );
+	int nCount = ProjectileRegistry().GetProjectilesInSphere( pObjects, nMaxEnts, vecGunPos, nSweepDist );
 	for ( int i = 0; i < nCount; i++ )
 	{
 		if ( InSameTeam( pObjects[i] ) )
@@ -604,15 +605,15 @@ void CTFMinigun::AttackEnemyProjectiles( void )
 		float flDistToLine = CalcDistanceToLineSegment( vecGrenadePos, vecGunPos, vecGunAimEnd );
 		if ( flDistToLine <= nHitDist )
 		{
-			if ( pPlayer->FVisible( pObjects[i], MASK_SOLID ) == false )
-				continue;
-
 			if ( ( pObjects[i]->GetFlags() & FL_ONGROUND ) )
 				continue;
 				
 			if ( !pObjects[i]->IsDeflectable() )
 				continue;
 
+			if ( pPlayer->FVisible( pObjects[i], MASK_SOLID ) == false )
+				continue;
+
 			CBaseProjectile *pProjectile = dynamic_cast< CBaseProjectile* >( pObjects[i] );
 			if ( pProjectile && pProjectile->IsDestroyable() )
 			{
@@ -45,6 +45,7 @@
 #include "halloween/halloween_base_boss.h"
 #include "tf_fx.h"
 #include "tf_gamestats.h"
+#include "projectile_registry.h"
 // Client specific.
 #else
 #include "c_tf_player.h"
@@ -5799,11 +5800,12 @@ bool CTFWeaponBase::DeflectProjectiles()
 	AngleVectors( pOwner->EyeAngles(), &vecForward, &vecRight, &vecUp );
 	Vector vecCenter = vecEye + vecForward * GetDeflectionRadius();
 
-	// Get a list of entities in the box defined by vecSize at VecCenter.
-	// We will then try to deflect everything in the box.
+	// Get a list of players and projectiles in the sphere at vecCenter.
+	// We will then try to deflect everything in the sphere.
 	const int maxCollectedEntities = 64;
 	CBaseEntity	*pObjects[ maxCollectedEntities ];
-	int count = UTIL_EntitiesInSphere( pObjects, maxCollectedEntities, vecCenter, GetDeflectionRadius(), FL_CLIENT | FL_GRENADE );
+	int count = UTIL_EntitiesInSphere( pObjects, maxCollectedEntities, vecCenter, GetDeflectionRadius(), FL_CLIENT );
+	count += ProjectileRegistry().GetProjectilesInSphere( pObjects + count, maxCollectedEntities - count, vecCenter, GetDeflectionRadius() );
 
 	//NDebugOverlay::Sphere( vecCenter, GetDeflectionRadius(), 0, 255, 0, 40, 3 );
 
@@ -5821,15 +5823,16 @@ bool CTFWeaponBase::DeflectProjectiles()
 		if ( pObjects[i]->IsPlayer() && pObjects[i]->GetTeamNumber() == TEAM_SPECTATOR )
 			continue;
 
-		if ( pOwner->FVisible( pObjects[i], MASK_SOLID ) == false )
-			continue;
-
 		if ( bTruce && ( pObjects[i]->GetTeamNumber() == iEnemyTeam ) )
 			continue;
 
 		if ( !pObjects[i]->IsDeflectable() && !FClassnameIs( pObjects[i], "prop_physics" ) )
 			continue;
 
+		// trace last, only for what could actually be deflected
+		if ( pOwner->FVisible( pObjects[i], MASK_SOLID ) == false )
+			continue;
+
 		if ( pObjects[i]->IsPlayer() == true )
 		{
 			CTFPlayer *pTarget = ToTFPlayer( pObjects[i] );
@@ -15,6 +15,7 @@
 #include "tf_gamerules.h"
 #include "func_nogrenades.h"
 #include "tf_obj_sentrygun.h"
+#include "entity_pool.h"
 
 extern void SendProxy_Origin( const SendProp *pProp, const void *pStruct, const void *pData, DVariant *pOut, int iElement, int objectID );
 extern void SendProxy_Angles( const SendProp *pProp, const void *pStruct, const void *pData, DVariant *pOut, int iElement, int objectID );
@@ -125,7 +126,12 @@ void CTFBaseRocket::Spawn( void )
 	BaseClass::Spawn();
 
 	// Precache.
-	Precache();
+#ifdef GAME_DLL
+	if ( EntityNeedsPrecache( this ) )
+#endif
+	{
+		Precache();
+	}
 	UseClientSideAnimation();
 	
 	if ( GetLauncher() )
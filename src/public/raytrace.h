@@ -193,6 +193,25 @@ protected:
 };
 
 
+// node of the 8-wide bvh (RTE_FLAGS_USE_BVH8). child bounds are stored as structure-of-arrays so
+// a whole node can be tested against a ray with a handful of loads.
+#define BVH8_WIDTH 8
+
+struct CacheOptimizedBVH8Node
+{
+	float m_flMinX[BVH8_WIDTH];
+	float m_flMinY[BVH8_WIDTH];
+	float m_flMinZ[BVH8_WIDTH];
+	float m_flMaxX[BVH8_WIDTH];
+	float m_flMaxY[BVH8_WIDTH];
+	float m_flMaxZ[BVH8_WIDTH];
+	int32 m_nChildren[BVH8_WIDTH];							// node index, or first entry in
+															// BVH8TriangleIndexList for leaves
+	int32 m_nLeafTriangleCount[BVH8_WIDTH];					// 0 for inner nodes
+	int32 m_nNumChildren;
+};
+
+
 struct RayTracingSingleResult
 {
 	Vector surface_normal;									// surface normal at intersection
@@ -220,6 +239,8 @@ public:
 #define RTE_FLAGS_FAST_TREE_GENERATION 1
 #define RTE_FLAGS_DONT_STORE_TRIANGLE_COLORS 2				// saves memory if not needed
 #define RTE_FLAGS_DONT_STORE_TRIANGLE_MATERIALS 4
+#define RTE_FLAGS_USE_BVH8 8								// trace against the bvh instead of the kdtree
+#define RTE_FLAGS_BUILD_KDTREE_AND_BVH8 16					// build both, for comparing them
 
 enum RayTraceLightingMode_t {
 	DIRECT_LIGHTING,										// just dot product lighting
@@ -243,6 +264,45 @@ public:
 	}
 };
 
+// results of rays traced through a RayQueue are handed to this, one call per ray
+class IRayQueueCallback
+{
+public:
+	virtual void RayTraced( int32 nUserData, const RayTracingSingleResult &result ) = 0;
+};
+
+// large batch ray queue. unlike RayStream, which only buckets rays by direction sign, rays are
+// sorted by direction octant and origin cell before being traced 8 at a time, so packets stay
+// coherent even when the rays are added in a scattered order. results are delivered through the
+// callback in sorted order, not in the order the rays were added.
+class RayQueue
+{
+	friend class RayTracingEnvironment;
+
+	struct QueuedRay_t
+	{
+		Vector m_vecStart;
+		Vector m_vecDelta;
+		int32 m_nUserData;
+		uint32 m_nSortKey;
+	};
+
+	IRayQueueCallback *m_pCallback;
+	int m_nBatchSize;										// traced automatically when this many are queued
+	int32 m_nSkipID;
+	CUtlVector<QueuedRay_t> m_Rays;
+	CUtlVector<QueuedRay_t> m_SortScratch;
+
+public:
+	RayQueue( IRayQueueCallback *pCallback, int nBatchSize = 4096, int32 nSkipID = -1 )
+	{
+		m_pCallback = pCallback;
+		m_nBatchSize = nBatchSize;
+		m_nSkipID = nSkipID;
+		m_Rays.EnsureCapacity( nBatchSize );
+	}
+};
+
 // When transparent triangles are in the list, the caller can provide a callback that will get called at each triangle
 // allowing the callback to stop processing if desired.
 // UNDONE: This is not currently SIMD - it really only supports single rays
@@ -262,6 +322,8 @@ public:
 
 	FourVectors BackgroundColor;							//< color where no intersection
 	CUtlVector<CacheOptimizedKDNode> OptimizedKDTree;		//< the packed kdtree. root is 0
+	CUtlVector<CacheOptimizedBVH8Node> OptimizedBVH8;		//< the 8-wide bvh. root is 0
+	CUtlVector<int32> BVH8TriangleIndexList;				//< triangle indices for bvh leaves
 	CUtlBlockVector<CacheOptimizedTriangle> OptimizedTriangleList; //< the packed triangles
 	CUtlVector<int32> TriangleIndexList;					//< the list of triangle indices.
 	CUtlVector<LightDesc_t> LightList;						//< the list of lights
@@ -310,6 +372,24 @@ public:
 					RayTracingResult *rslt_out,
 					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
 
+	// trace 8 rays (two packets) at once. uses AVX2 against the bvh when it's available,
+	// otherwise it's the same as calling Trace4Rays twice. rays don't need matching signs.
+	void Trace8Rays(const FourRays *rays, const fltx4 *TMin, const fltx4 *TMax,
+					RayTracingResult *rslt_out,
+					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
+
+	// bvh versions of the above, used when RTE_FLAGS_USE_BVH8 is set
+	void Trace4RaysBVH8(const FourRays &rays, fltx4 TMin, fltx4 TMax,
+						RayTracingResult *rslt_out,
+						int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
+	void BuildBVH8(void);
+
+	static bool CanUseAVX2(void);
+
+	// trace a fixed set of random rays with the kdtree and bvh and print the speeds. needs
+	// RTE_FLAGS_BUILD_KDTREE_AND_BVH8.
+	void BenchmarkAccelerationStructures(int nRays);
+
 	// compute virtual light sources to model inter-reflection
 	void ComputeVirtualLightSources(void);
 
@@ -341,6 +421,14 @@ public:
 	/// previously passed to AddToRaySteam will have been filled in.
 	void FinishRayStream(RayStream &s);
 
+	/// ray queue - queue up rays, which are traced in sorted batches. the queue's callback is
+	/// called for each ray when its batch is traced. call FlushRayQueue to trace what's left.
+	/// SetupAccelerationStructure must have been called first, since the sort uses the bounds.
+	void AddToRayQueue(RayQueue &q,
+					   Vector const &start,Vector const &end,int32 nUserData);
+
+	void FlushRayQueue(RayQueue &q);
+
 
 	int MakeLeafNode(int first_tri, int last_tri);
 
@@ -0,0 +1,882 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id:$
+//
+// 8-wide bounding volume hierarchy for RayTracingEnvironment. This is an alternative to the
+// kd-tree, selected with RTE_FLAGS_USE_BVH8. The tree is built as a binary tree using a binned
+// surface area heuristic (large subtrees are built in parallel) and then collapsed so that
+// every node has up to 8 children. Unlike the kd-tree it does not need all rays in a packet to
+// have the same direction signs.
+
+#include "raytrace.h"
+#include "raytrace_triangle.h"
+#include <filesystem_tools.h>
+#include <cmdlib.h>
+#include <threads.h>
+#include <vstdlib/random.h>
+#include <stdio.h>
+
+#if defined( PLATFORM_INTEL ) && defined( _WIN32 )
+#include <intrin.h>
+#include <immintrin.h>
+#define RT_HAS_AVX2_PATH
+#define RT_AVX2_TARGET
+#elif defined( PLATFORM_INTEL ) && defined( COMPILER_GCC )
+#include <cpuid.h>
+#include <immintrin.h>
+#define RT_HAS_AVX2_PATH
+// no fma, so that the 8-wide path rounds exactly like the 4-wide one
+#define RT_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#endif
+
+
+#define BVH_NUM_BINS 16
+#define BVH_MAX_LEAF_TRIS 8
+#define BVH_MAX_DEPTH 64
+#define BVH_MAX_STACK_LEN ( ( BVH8_WIDTH - 1 ) * BVH_MAX_DEPTH + 1 )
+
+// subtrees with fewer triangles than this are not split into further parallel build tasks
+#define BVH_MIN_PARALLEL_TASK_TRIS 2048
+
+#define BVH_COST_OF_TRAVERSAL 75							// approximate #operations
+#define BVH_COST_OF_INTERSECTION 167						// approximate #operations
+
+
+static float BVHBoxSurfaceArea( Vector const &boxmin, Vector const &boxmax )
+{
+	Vector boxdim=boxmax-boxmin;
+	return 2.0*((boxdim[0]*boxdim[2])+(boxdim[0]*boxdim[1])+(boxdim[1]*boxdim[2]));
+}
+
+
+//-----------------------------------------------------------------------------
+// Binary tree used while building
+//-----------------------------------------------------------------------------
+struct BVHBuildTri_t
+{
+	Vector m_vecMins;
+	Vector m_vecMaxs;
+	Vector m_vecCentroid;
+};
+
+struct BVHBuildNode_t
+{
+	Vector m_vecMins;
+	Vector m_vecMaxs;
+	int32 m_nLeft;											// -1 for leaves
+	int32 m_nRight;
+	int32 m_nFirstTri;										// range of CBVH8Builder::m_TriIndices
+	int32 m_nTriCount;
+
+	bool IsLeaf( void ) const
+	{
+		return m_nLeft < 0;
+	}
+};
+
+struct BVHBuildTask_t
+{
+	int m_nNode;											// placeholder node in the top level tree
+	int m_nFirstTri;
+	int m_nTriCount;
+	int m_nDepth;
+	CUtlVector<BVHBuildNode_t> m_Nodes;						// subtree, root at 0
+};
+
+
+class CBVH8Builder
+{
+public:
+	CBVH8Builder( RayTracingEnvironment *pEnv ) : m_pEnv( pEnv ), m_nMaxTaskTris( 0 )
+	{
+	}
+
+	~CBVH8Builder()
+	{
+		m_Tasks.PurgeAndDeleteElements();
+	}
+
+	void Build( void );
+
+private:
+	int BuildNode( CUtlVector<BVHBuildNode_t> &nodes, int nFirst, int nCount, int nDepth, bool bTopLevel );
+	int Partition( int nFirst, int nCount, Vector const &mins, Vector const &maxs );
+	static void BuildTaskThread( int iThread, void *pUserData );
+	int CollapseNode( int nBinaryNode );
+
+	RayTracingEnvironment *m_pEnv;
+	CUtlVector<BVHBuildTri_t> m_Tris;
+	CUtlVector<int32> m_TriIndices;
+	CUtlVector<BVHBuildNode_t> m_Nodes;
+	CUtlVector<BVHBuildTask_t *> m_Tasks;
+	int m_nMaxTaskTris;
+};
+
+
+void CBVH8Builder::Build( void )
+{
+	int nTris = m_pEnv->OptimizedTriangleList.Count();
+	m_Tris.SetCount( nTris );
+	m_TriIndices.SetCount( nTris );
+	for ( int t = 0; t < nTris; t++ )
+	{
+		CacheOptimizedTriangle const &tri = m_pEnv->OptimizedTriangleList[t];
+		BVHBuildTri_t &buildTri = m_Tris[t];
+		ClearBounds( buildTri.m_vecMins, buildTri.m_vecMaxs );
+		for ( int v = 0; v < 3; v++ )
+		{
+			AddPointToBounds( tri.Vertex( v ), buildTri.m_vecMins, buildTri.m_vecMaxs );
+		}
+		buildTri.m_vecCentroid = 0.5f * ( buildTri.m_vecMins + buildTri.m_vecMaxs );
+		m_TriIndices[t] = t;
+	}
+
+	m_pEnv->OptimizedBVH8.RemoveAll();
+	m_pEnv->BVH8TriangleIndexList.RemoveAll();
+	if ( !nTris )
+		return;
+
+	// build the top of the tree here, and hand out subtrees of about this size to the threads
+	if ( numthreads == -1 )
+		ThreadSetDefault();
+	m_nMaxTaskTris = MAX( BVH_MIN_PARALLEL_TASK_TRIS, nTris / ( 8 * MAX( numthreads, 1 ) ) );
+	BuildNode( m_Nodes, 0, nTris, 0, true );
+
+	if ( m_Tasks.Count() )
+	{
+		RunThreads_SetPhaseName( "BuildBVH8" );
+		( RunThreadsOn )( m_Tasks.Count(), false, BuildTaskThread, this );
+
+		// stitch the subtrees in, in task order so the result doesn't depend on the thread count
+		for ( int i = 0; i < m_Tasks.Count(); i++ )
+		{
+			BVHBuildTask_t *pTask = m_Tasks[i];
+			int nBase = m_Nodes.Count();
+			for ( int n = 0; n < pTask->m_Nodes.Count(); n++ )
+			{
+				BVHBuildNode_t node = pTask->m_Nodes[n];
+				if ( !node.IsLeaf() )
+				{
+					node.m_nLeft += nBase;
+					node.m_nRight += nBase;
+				}
+				m_Nodes.AddToTail( node );
+			}
+			m_Nodes[pTask->m_nNode] = m_Nodes[nBase];
+		}
+	}
+
+	m_pEnv->BVH8TriangleIndexList.EnsureCapacity( nTris );
+	CollapseNode( 0 );
+}
+
+
+void CBVH8Builder::BuildTaskThread( int iThread, void *pUserData )
+{
+	CBVH8Builder *pBuilder = (CBVH8Builder *)pUserData;
+	while ( 1 )
+	{
+		int nTask = GetThreadWork( iThread );
+		if ( nTask == -1 )
+			break;
+
+		BVHBuildTask_t *pTask = pBuilder->m_Tasks[nTask];
+		pBuilder->BuildNode( pTask->m_Nodes, pTask->m_nFirstTri, pTask->m_nTriCount, pTask->m_nDepth, false );
+	}
+}
+
+
+int CBVH8Builder::BuildNode( CUtlVector<BVHBuildNode_t> &nodes, int nFirst, int nCount, int nDepth, bool bTopLevel )
+{
+	int nNode = nodes.AddToTail();
+	BVHBuildNode_t &node = nodes[nNode];
+	node.m_nLeft = node.m_nRight = -1;
+	node.m_nFirstTri = nFirst;
+	node.m_nTriCount = nCount;
+	ClearBounds( node.m_vecMins, node.m_vecMaxs );
+	for ( int t = nFirst; t < nFirst + nCount; t++ )
+	{
+		BVHBuildTri_t const &tri = m_Tris[m_TriIndices[t]];
+		VectorMin( tri.m_vecMins, node.m_vecMins, node.m_vecMins );
+		VectorMax( tri.m_vecMaxs, node.m_vecMaxs, node.m_vecMaxs );
+	}
+
+	if ( bTopLevel && nCount <= m_nMaxTaskTris )
+	{
+		// leave this as a leaf for now, a build thread will fill it in
+		BVHBuildTask_t *pTask = new BVHBuildTask_t;
+		pTask->m_nNode = nNode;
+		pTask->m_nFirstTri = nFirst;
+		pTask->m_nTriCount = nCount;
+		pTask->m_nDepth = nDepth;
+		m_Tasks.AddToTail( pTask );
+		return nNode;
+	}
+
+	int nLeft = ( nDepth < BVH_MAX_DEPTH ) ? Partition( nFirst, nCount, node.m_vecMins, node.m_vecMaxs ) : 0;
+	if ( nLeft == 0 )
+		return nNode;
+
+	// nodes may be reallocated by the recursion, so don't hang on to node
+	int nLeftChild = BuildNode( nodes, nFirst, nLeft, nDepth + 1, bTopLevel );
+	int nRightChild = BuildNode( nodes, nFirst + nLeft, nCount - nLeft, nDepth + 1, bTopLevel );
+	nodes[nNode].m_nLeft = nLeftChild;
+	nodes[nNode].m_nRight = nRightChild;
+	nodes[nNode].m_nTriCount = 0;
+	return nNode;
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds the best binned SAH split, and partitions m_TriIndices accordingly. Returns the number
+// of triangles on the left side, or 0 if this should be a leaf.
+//-----------------------------------------------------------------------------
+int CBVH8Builder::Partition( int nFirst, int nCount, Vector const &mins, Vector const &maxs )
+{
+	if ( nCount <= 1 )
+		return 0;
+
+	Vector centroidMins, centroidMaxs;
+	ClearBounds( centroidMins, centroidMaxs );
+	for ( int t = nFirst; t < nFirst + nCount; t++ )
+	{
+		AddPointToBounds( m_Tris[m_TriIndices[t]].m_vecCentroid, centroidMins, centroidMaxs );
+	}
+
+	float flBestCost = FLT_MAX;
+	int nBestAxis = -1;
+	int nBestBin = -1;
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		float flExtent = centroidMaxs[axis] - centroidMins[axis];
+		if ( flExtent <= 1.0e-6f )
+			continue;
+
+		int nBinCounts[BVH_NUM_BINS];
+		Vector binMins[BVH_NUM_BINS], binMaxs[BVH_NUM_BINS];
+		for ( int b = 0; b < BVH_NUM_BINS; b++ )
+		{
+			nBinCounts[b] = 0;
+			ClearBounds( binMins[b], binMaxs[b] );
+		}
+
+		float flScale = BVH_NUM_BINS / flExtent;
+		for ( int t = nFirst; t < nFirst + nCount; t++ )
+		{
+			BVHBuildTri_t const &tri = m_Tris[m_TriIndices[t]];
+			int b = clamp( (int)( ( tri.m_vecCentroid[axis] - centroidMins[axis] ) * flScale ), 0, BVH_NUM_BINS - 1 );
+			nBinCounts[b]++;
+			VectorMin( tri.m_vecMins, binMins[b], binMins[b] );
+			VectorMax( tri.m_vecMaxs, binMaxs[b], binMaxs[b] );
+		}
+
+		// sweep from the right to get the cost of everything right of each split
+		float flRightCosts[BVH_NUM_BINS];
+		Vector rightMins, rightMaxs;
+		ClearBounds( rightMins, rightMaxs );
+		int nRight = 0;
+		for ( int b = BVH_NUM_BINS - 1; b > 0; b-- )
+		{
+			nRight += nBinCounts[b];
+			VectorMin( binMins[b], rightMins, rightMins );
+			VectorMax( binMaxs[b], rightMaxs, rightMaxs );
+			flRightCosts[b] = nRight ? nRight * BVHBoxSurfaceArea( rightMins, rightMaxs ) : 0.0f;
+		}
+
+		// and from the left to evaluate each split (split after bin b)
+		Vector leftMins, leftMaxs;
+		ClearBounds( leftMins, leftMaxs );
+		int nLeft = 0;
+		for ( int b = 0; b < BVH_NUM_BINS - 1; b++ )
+		{
+			nLeft += nBinCounts[b];
+			VectorMin( binMins[b], leftMins, leftMins );
+			VectorMax( binMaxs[b], leftMaxs, leftMaxs );
+			if ( !nLeft || nLeft == nCount )
+				continue;
+			float flCost = nLeft * BVHBoxSurfaceArea( leftMins, leftMaxs ) + flRightCosts[b + 1];
+			if ( flCost < flBestCost )
+			{
+				flBestCost = flCost;
+				nBestAxis = axis;
+				nBestBin = b;
+			}
+		}
+	}
+
+	if ( nBestAxis == -1 )
+	{
+		// all the centroids are in the same place. split by count so leaves stay small.
+		return ( nCount <= BVH_MAX_LEAF_TRIS ) ? 0 : nCount / 2;
+	}
+
+	float flLeafCost = BVH_COST_OF_INTERSECTION * nCount;
+	float flSplitCost = BVH_COST_OF_TRAVERSAL +
+		BVH_COST_OF_INTERSECTION * flBestCost / MAX( BVHBoxSurfaceArea( mins, maxs ), 1.0e-6f );
+	if ( ( nCount <= BVH_MAX_LEAF_TRIS ) && ( flLeafCost <= flSplitCost ) )
+		return 0;
+
+	// partition in place
+	float flScale = BVH_NUM_BINS / ( centroidMaxs[nBestAxis] - centroidMins[nBestAxis] );
+	int i = nFirst;
+	int j = nFirst + nCount - 1;
+	while ( i <= j )
+	{
+		BVHBuildTri_t const &tri = m_Tris[m_TriIndices[i]];
+		int b = clamp( (int)( ( tri.m_vecCentroid[nBestAxis] - centroidMins[nBestAxis] ) * flScale ), 0, BVH_NUM_BINS - 1 );
+		if ( b <= nBestBin )
+		{
+			i++;
+		}
+		else
+		{
+			V_swap( m_TriIndices[i], m_TriIndices[j] );
+			j--;
+		}
+	}
+
+	int nLeft = i - nFirst;
+	if ( nLeft == 0 || nLeft == nCount )
+		return nCount / 2;
+	return nLeft;
+}
+
+
+//-----------------------------------------------------------------------------
+// Turns a binary subtree into 8-wide nodes by repeatedly opening the largest inner child.
+// Returns the index of the new node in OptimizedBVH8.
+//-----------------------------------------------------------------------------
+int CBVH8Builder::CollapseNode( int nBinaryNode )
+{
+	int nChildren[BVH8_WIDTH];
+	int nNumChildren = 0;
+	if ( m_Nodes[nBinaryNode].IsLeaf() )
+	{
+		nChildren[nNumChildren++] = nBinaryNode;
+	}
+	else
+	{
+		nChildren[nNumChildren++] = m_Nodes[nBinaryNode].m_nLeft;
+		nChildren[nNumChildren++] = m_Nodes[nBinaryNode].m_nRight;
+	}
+
+	while ( nNumChildren < BVH8_WIDTH )
+	{
+		int nBest = -1;
+		float flBestArea = -1.0f;
+		for ( int i = 0; i < nNumChildren; i++ )
+		{
+			BVHBuildNode_t const &child = m_Nodes[nChildren[i]];
+			if ( child.IsLeaf() )
+				continue;
+			float flArea = BVHBoxSurfaceArea( child.m_vecMins, child.m_vecMaxs );
+			if ( flArea > flBestArea )
+			{
+				flBestArea = flArea;
+				nBest = i;
+			}
+		}
+		if ( nBest == -1 )
+			break;
+
+		BVHBuildNode_t const &opened = m_Nodes[nChildren[nBest]];
+		nChildren[nBest] = opened.m_nLeft;
+		nChildren[nNumChildren++] = opened.m_nRight;
+	}
+
+	CacheOptimizedBVH8Node newNode;
+	memset( &newNode, 0, sizeof( newNode ) );
+	newNode.m_nNumChildren = nNumChildren;
+	for ( int i = 0; i < BVH8_WIDTH; i++ )
+	{
+		newNode.m_nChildren[i] = -1;
+	}
+
+	int nNewNode = m_pEnv->OptimizedBVH8.AddToTail( newNode );
+	for ( int i = 0; i < nNumChildren; i++ )
+	{
+		BVHBuildNode_t const &child = m_Nodes[nChildren[i]];
+		newNode.m_flMinX[i] = child.m_vecMins.x;
+		newNode.m_flMinY[i] = child.m_vecMins.y;
+		newNode.m_flMinZ[i] = child.m_vecMins.z;
+		newNode.m_flMaxX[i] = child.m_vecMaxs.x;
+		newNode.m_flMaxY[i] = child.m_vecMaxs.y;
+		newNode.m_flMaxZ[i] = child.m_vecMaxs.z;
+		if ( child.IsLeaf() )
+		{
+			newNode.m_nChildren[i] = m_pEnv->BVH8TriangleIndexList.Count();
+			newNode.m_nLeafTriangleCount[i] = child.m_nTriCount;
+			for ( int t = child.m_nFirstTri; t < child.m_nFirstTri + child.m_nTriCount; t++ )
+			{
+				m_pEnv->BVH8TriangleIndexList.AddToTail( m_TriIndices[t] );
+			}
+		}
+		else
+		{
+			newNode.m_nChildren[i] = CollapseNode( nChildren[i] );
+		}
+	}
+	m_pEnv->OptimizedBVH8[nNewNode] = newNode;
+	return nNewNode;
+}
+
+
+void RayTracingEnvironment::BuildBVH8( void )
+{
+	CBVH8Builder builder( this );
+	builder.Build();
+}
+
+
+//-----------------------------------------------------------------------------
+// 4-wide traversal
+//-----------------------------------------------------------------------------
+struct BVH8StackEntry_t
+{
+	int32 m_nIndex;											// node, or first triangle of a leaf
+	int32 m_nTriCount;										// 0 for inner nodes
+	float m_flDistance;										// nearest entry distance, for ordering
+};
+
+// insert into a list of children kept sorted farthest first, which is the order to push them
+static FORCEINLINE void InsertChildByDistance( BVH8StackEntry_t *pChildren, int &nChildren, BVH8StackEntry_t const &child )
+{
+	int i = nChildren++;
+	while ( ( i > 0 ) && ( pChildren[i - 1].m_flDistance < child.m_flDistance ) )
+	{
+		pChildren[i] = pChildren[i - 1];
+		i--;
+	}
+	pChildren[i] = child;
+}
+
+
+void RayTracingEnvironment::Trace4RaysBVH8( const FourRays &rays, fltx4 TMin, fltx4 TMax,
+											RayTracingResult *rslt_out,
+											int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	memset(rslt_out->HitIds,0xff,sizeof(rslt_out->HitIds));
+	rslt_out->HitDistance=ReplicateX4(1.0e23);
+	rslt_out->surface_normal.DuplicateVector(Vector(0.,0.,0.));
+
+	if ( !OptimizedBVH8.Count() )
+		return;
+
+	FourVectors OneOverRayDir=rays.direction;
+	OneOverRayDir.MakeReciprocalSaturate();
+
+	BVH8StackEntry_t stack[BVH_MAX_STACK_LEN];
+	int nStack = 0;
+	stack[nStack].m_nIndex = 0;
+	stack[nStack].m_nTriCount = 0;
+	stack[nStack].m_flDistance = 0;
+	nStack++;
+
+	while ( nStack )
+	{
+		BVH8StackEntry_t const entry = stack[--nStack];
+		if ( entry.m_nTriCount )
+		{
+			int32 const *pTris = &( BVH8TriangleIndexList[entry.m_nIndex] );
+			for ( int t = 0; t < entry.m_nTriCount; t++ )
+			{
+				int tnum = pTris[t];
+				TriIntersectData_t const *tri = &( OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+				if ( tri->m_nTriangleID != skip_id )
+				{
+					IntersectTriangle4Rays( tri, tnum, rays, rslt_out, pCallback );
+				}
+			}
+			continue;
+		}
+
+		CacheOptimizedBVH8Node const &node = OptimizedBVH8[entry.m_nIndex];
+		fltx4 TLimit = MinSIMD( TMax, rslt_out->HitDistance );
+
+		BVH8StackEntry_t children[BVH8_WIDTH];
+		int nChildren = 0;
+		for ( int c = 0; c < node.m_nNumChildren; c++ )
+		{
+			fltx4 t0 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMinX[c] ), rays.origin.x ), OneOverRayDir.x );
+			fltx4 t1 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMaxX[c] ), rays.origin.x ), OneOverRayDir.x );
+			fltx4 tnear = MaxSIMD( TMin, MinSIMD( t0, t1 ) );
+			fltx4 tfar = MinSIMD( TLimit, MaxSIMD( t0, t1 ) );
+			t0 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMinY[c] ), rays.origin.y ), OneOverRayDir.y );
+			t1 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMaxY[c] ), rays.origin.y ), OneOverRayDir.y );
+			tnear = MaxSIMD( tnear, MinSIMD( t0, t1 ) );
+			tfar = MinSIMD( tfar, MaxSIMD( t0, t1 ) );
+			t0 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMinZ[c] ), rays.origin.z ), OneOverRayDir.z );
+			t1 = MulSIMD( SubSIMD( ReplicateX4( node.m_flMaxZ[c] ), rays.origin.z ), OneOverRayDir.z );
+			tnear = MaxSIMD( tnear, MinSIMD( t0, t1 ) );
+			tfar = MinSIMD( tfar, MaxSIMD( t0, t1 ) );
+
+			fltx4 hit = CmpLeSIMD( tnear, tfar );
+			if ( ! IsAnyNegative( hit ) )
+				continue;
+
+			fltx4 entry_t = OrSIMD( AndSIMD( hit, tnear ), AndNotSIMD( hit, Four_FLT_MAX ) );
+			BVH8StackEntry_t child;
+			child.m_nIndex = node.m_nChildren[c];
+			child.m_nTriCount = node.m_nLeafTriangleCount[c];
+			child.m_flDistance = MIN( MIN( SubFloat( entry_t, 0 ), SubFloat( entry_t, 1 ) ),
+									  MIN( SubFloat( entry_t, 2 ), SubFloat( entry_t, 3 ) ) );
+			InsertChildByDistance( children, nChildren, child );
+		}
+
+		Assert( nStack + nChildren <= BVH_MAX_STACK_LEN );
+		for ( int c = 0; c < nChildren; c++ )
+		{
+			stack[nStack++] = children[c];
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// 8-wide AVX2 traversal
+//-----------------------------------------------------------------------------
+bool RayTracingEnvironment::CanUseAVX2( void )
+{
+#ifdef RT_HAS_AVX2_PATH
+	static int s_nHasAVX2 = -1;
+	if ( s_nHasAVX2 == -1 )
+	{
+		bool bOSXSAVE, bAVX, bAVX2;
+		uint64 nXCR0 = 0;
+#ifdef _WIN32
+		int regs[4];
+		__cpuid( regs, 1 );
+		bOSXSAVE = ( regs[2] & ( 1 << 27 ) ) != 0;
+		bAVX = ( regs[2] & ( 1 << 28 ) ) != 0;
+		__cpuidex( regs, 7, 0 );
+		bAVX2 = ( regs[1] & ( 1 << 5 ) ) != 0;
+		if ( bOSXSAVE )
+			nXCR0 = _xgetbv( 0 );
+#else
+		unsigned int eax, ebx, ecx, edx;
+		__get_cpuid( 1, &eax, &ebx, &ecx, &edx );
+		bOSXSAVE = ( ecx & ( 1 << 27 ) ) != 0;
+		bAVX = ( ecx & ( 1 << 28 ) ) != 0;
+		bAVX2 = __get_cpuid_count( 7, 0, &eax, &ebx, &ecx, &edx ) && ( ebx & ( 1 << 5 ) );
+		if ( bOSXSAVE )
+		{
+			__asm__ __volatile__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+			nXCR0 = ( (uint64)edx << 32 ) | eax;
+		}
+#endif
+		// the os has to save the ymm registers for us too
+		s_nHasAVX2 = ( bOSXSAVE && bAVX && bAVX2 && ( ( nXCR0 & 6 ) == 6 ) ) ? 1 : 0;
+	}
+	return s_nHasAVX2 != 0;
+#else
+	return false;
+#endif
+}
+
+
+#ifdef RT_HAS_AVX2_PATH
+
+RT_AVX2_TARGET static FORCEINLINE __m256 CombineFourFloats( fltx4 const &lo, fltx4 const &hi )
+{
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+}
+
+// same math as ReciprocalSaturateSIMD, so both paths get the same answers
+RT_AVX2_TARGET static FORCEINLINE __m256 ReciprocalSaturate8( __m256 a )
+{
+	__m256 zero_mask = _mm256_cmp_ps( a, _mm256_setzero_ps(), _CMP_EQ_OQ );
+	a = _mm256_or_ps( a, _mm256_and_ps( _mm256_set1_ps( FLT_EPSILON ), zero_mask ) );
+	__m256 ret = _mm256_rcp_ps( a );
+	return _mm256_sub_ps( _mm256_add_ps( ret, ret ), _mm256_mul_ps( a, _mm256_mul_ps( ret, ret ) ) );
+}
+
+struct EightRayState_t
+{
+	__m256 m_Origin[3];
+	__m256 m_Direction[3];
+	__m256 m_OneOverDirection[3];
+	__m256 m_HitDistance;
+	__m256 m_HitIds;										// really ints
+	__m256 m_Normal[3];
+};
+
+RT_AVX2_TARGET static FORCEINLINE void IntersectTriangle8Rays( TriIntersectData_t const *tri, int tnum, EightRayState_t &state )
+{
+	__m256 Nx = _mm256_set1_ps( tri->m_flNx );
+	__m256 Ny = _mm256_set1_ps( tri->m_flNy );
+	__m256 Nz = _mm256_set1_ps( tri->m_flNz );
+
+	__m256 DDotN = _mm256_mul_ps( state.m_Direction[0], Nx );
+	DDotN = _mm256_add_ps( _mm256_mul_ps( state.m_Direction[1], Ny ), DDotN );
+	DDotN = _mm256_add_ps( _mm256_mul_ps( state.m_Direction[2], Nz ), DDotN );
+	// mask off zero or near zero (ray parallel to surface)
+	__m256 did_hit = _mm256_or_ps( _mm256_cmp_ps( DDotN, _mm256_set1_ps( 1.0e-10f ), _CMP_GT_OQ ),
+								   _mm256_cmp_ps( DDotN, _mm256_set1_ps( -1.0e-10f ), _CMP_LT_OQ ) );
+
+	__m256 ODotN = _mm256_mul_ps( state.m_Origin[0], Nx );
+	ODotN = _mm256_add_ps( _mm256_mul_ps( state.m_Origin[1], Ny ), ODotN );
+	ODotN = _mm256_add_ps( _mm256_mul_ps( state.m_Origin[2], Nz ), ODotN );
+	__m256 isect_t = _mm256_div_ps( _mm256_sub_ps( _mm256_set1_ps( tri->m_flD ), ODotN ), DDotN );
+
+	did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( isect_t, _mm256_set1_ps( 1.0e-10f ), _CMP_GT_OQ ) );
+	did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( isect_t, state.m_HitDistance, _CMP_LT_OQ ) );
+	if ( !_mm256_movemask_ps( did_hit ) )
+		return;
+
+	// now, check 3 edges
+	__m256 hitc1 = _mm256_add_ps( state.m_Origin[tri->m_nCoordSelect0],
+								  _mm256_mul_ps( isect_t, state.m_Direction[tri->m_nCoordSelect0] ) );
+	__m256 hitc2 = _mm256_add_ps( state.m_Origin[tri->m_nCoordSelect1],
+								  _mm256_mul_ps( isect_t, state.m_Direction[tri->m_nCoordSelect1] ) );
+
+	__m256 B0 = _mm256_mul_ps( _mm256_set1_ps( tri->m_ProjectedEdgeEquations[0] ), hitc1 );
+	B0 = _mm256_add_ps( B0, _mm256_mul_ps( _mm256_set1_ps( tri->m_ProjectedEdgeEquations[1] ), hitc2 ) );
+	B0 = _mm256_add_ps( B0, _mm256_set1_ps( tri->m_ProjectedEdgeEquations[2] ) );
+	did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B0, _mm256_set1_ps( 1.0e-10f ), _CMP_GE_OQ ) );
+
+	__m256 B1 = _mm256_mul_ps( _mm256_set1_ps( tri->m_ProjectedEdgeEquations[3] ), hitc1 );
+	B1 = _mm256_add_ps( B1, _mm256_mul_ps( _mm256_set1_ps( tri->m_ProjectedEdgeEquations[4] ), hitc2 ) );
+	B1 = _mm256_add_ps( B1, _mm256_set1_ps( tri->m_ProjectedEdgeEquations[5] ) );
+	did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B1, _mm256_set1_ps( 1.0e-10f ), _CMP_GE_OQ ) );
+
+	__m256 B2 = _mm256_add_ps( B1, B0 );
+	did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B2, _mm256_set1_ps( 1.0f ), _CMP_LE_OQ ) );
+	if ( !_mm256_movemask_ps( did_hit ) )
+		return;
+
+	state.m_HitIds = _mm256_blendv_ps( state.m_HitIds, _mm256_castsi256_ps( _mm256_set1_epi32( tnum ) ), did_hit );
+	state.m_HitDistance = _mm256_blendv_ps( state.m_HitDistance, isect_t, did_hit );
+	state.m_Normal[0] = _mm256_blendv_ps( state.m_Normal[0], Nx, did_hit );
+	state.m_Normal[1] = _mm256_blendv_ps( state.m_Normal[1], Ny, did_hit );
+	state.m_Normal[2] = _mm256_blendv_ps( state.m_Normal[2], Nz, did_hit );
+}
+
+RT_AVX2_TARGET static void Trace8RaysBVH8_AVX2( RayTracingEnvironment *pEnv, const FourRays *rays,
+												const fltx4 *pTMin, const fltx4 *pTMax,
+												RayTracingResult *rslt_out, int32 skip_id )
+{
+	EightRayState_t state;
+	for ( int c = 0; c < 3; c++ )
+	{
+		state.m_Origin[c] = CombineFourFloats( rays[0].origin[c], rays[1].origin[c] );
+		state.m_Direction[c] = CombineFourFloats( rays[0].direction[c], rays[1].direction[c] );
+		state.m_OneOverDirection[c] = ReciprocalSaturate8( state.m_Direction[c] );
+		state.m_Normal[c] = _mm256_setzero_ps();
+	}
+	state.m_HitDistance = _mm256_set1_ps( 1.0e23f );
+	state.m_HitIds = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+	__m256 TMin = CombineFourFloats( pTMin[0], pTMin[1] );
+	__m256 TMax = CombineFourFloats( pTMax[0], pTMax[1] );
+
+	if ( pEnv->OptimizedBVH8.Count() )
+	{
+		BVH8StackEntry_t stack[BVH_MAX_STACK_LEN];
+		int nStack = 0;
+		stack[nStack].m_nIndex = 0;
+		stack[nStack].m_nTriCount = 0;
+		stack[nStack].m_flDistance = 0;
+		nStack++;
+
+		while ( nStack )
+		{
+			BVH8StackEntry_t const entry = stack[--nStack];
+			if ( entry.m_nTriCount )
+			{
+				int32 const *pTris = &( pEnv->BVH8TriangleIndexList[entry.m_nIndex] );
+				for ( int t = 0; t < entry.m_nTriCount; t++ )
+				{
+					int tnum = pTris[t];
+					TriIntersectData_t const *tri = &( pEnv->OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+					if ( tri->m_nTriangleID != skip_id )
+					{
+						IntersectTriangle8Rays( tri, tnum, state );
+					}
+				}
+				continue;
+			}
+
+			CacheOptimizedBVH8Node const &node = pEnv->OptimizedBVH8[entry.m_nIndex];
+			__m256 TLimit = _mm256_min_ps( TMax, state.m_HitDistance );
+
+			BVH8StackEntry_t children[BVH8_WIDTH];
+			int nChildren = 0;
+			for ( int c = 0; c < node.m_nNumChildren; c++ )
+			{
+				__m256 t0 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMinX[c] ), state.m_Origin[0] ), state.m_OneOverDirection[0] );
+				__m256 t1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMaxX[c] ), state.m_Origin[0] ), state.m_OneOverDirection[0] );
+				__m256 tnear = _mm256_max_ps( TMin, _mm256_min_ps( t0, t1 ) );
+				__m256 tfar = _mm256_min_ps( TLimit, _mm256_max_ps( t0, t1 ) );
+				t0 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMinY[c] ), state.m_Origin[1] ), state.m_OneOverDirection[1] );
+				t1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMaxY[c] ), state.m_Origin[1] ), state.m_OneOverDirection[1] );
+				tnear = _mm256_max_ps( tnear, _mm256_min_ps( t0, t1 ) );
+				tfar = _mm256_min_ps( tfar, _mm256_max_ps( t0, t1 ) );
+				t0 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMinZ[c] ), state.m_Origin[2] ), state.m_OneOverDirection[2] );
+				t1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( node.m_flMaxZ[c] ), state.m_Origin[2] ), state.m_OneOverDirection[2] );
+				tnear = _mm256_max_ps( tnear, _mm256_min_ps( t0, t1 ) );
+				tfar = _mm256_min_ps( tfar, _mm256_max_ps( t0, t1 ) );
+
+				__m256 hit = _mm256_cmp_ps( tnear, tfar, _CMP_LE_OQ );
+				if ( !_mm256_movemask_ps( hit ) )
+					continue;
+
+				// nearest entry of the rays that hit
+				__m256 entry_t = _mm256_blendv_ps( _mm256_set1_ps( FLT_MAX ), tnear, hit );
+				__m128 entry4 = _mm_min_ps( _mm256_castps256_ps128( entry_t ), _mm256_extractf128_ps( entry_t, 1 ) );
+				entry4 = _mm_min_ps( entry4, _mm_movehl_ps( entry4, entry4 ) );
+				entry4 = _mm_min_ss( entry4, _mm_shuffle_ps( entry4, entry4, 1 ) );
+
+				BVH8StackEntry_t child;
+				child.m_nIndex = node.m_nChildren[c];
+				child.m_nTriCount = node.m_nLeafTriangleCount[c];
+				child.m_flDistance = _mm_cvtss_f32( entry4 );
+				InsertChildByDistance( children, nChildren, child );
+			}
+
+			Assert( nStack + nChildren <= BVH_MAX_STACK_LEN );
+			for ( int c = 0; c < nChildren; c++ )
+			{
+				stack[nStack++] = children[c];
+			}
+		}
+	}
+
+	// split back into two 4 ray results
+	for ( int i = 0; i < 2; i++ )
+	{
+		__m128 ids = i ? _mm256_extractf128_ps( state.m_HitIds, 1 ) : _mm256_castps256_ps128( state.m_HitIds );
+		StoreAlignedSIMD( (float *)rslt_out[i].HitIds, ids );
+		rslt_out[i].HitDistance = i ? _mm256_extractf128_ps( state.m_HitDistance, 1 ) : _mm256_castps256_ps128( state.m_HitDistance );
+		rslt_out[i].surface_normal.x = i ? _mm256_extractf128_ps( state.m_Normal[0], 1 ) : _mm256_castps256_ps128( state.m_Normal[0] );
+		rslt_out[i].surface_normal.y = i ? _mm256_extractf128_ps( state.m_Normal[1], 1 ) : _mm256_castps256_ps128( state.m_Normal[1] );
+		rslt_out[i].surface_normal.z = i ? _mm256_extractf128_ps( state.m_Normal[2], 1 ) : _mm256_castps256_ps128( state.m_Normal[2] );
+	}
+}
+
+#endif // RT_HAS_AVX2_PATH
+
+
+void RayTracingEnvironment::Trace8Rays( const FourRays *rays, const fltx4 *TMin, const fltx4 *TMax,
+										RayTracingResult *rslt_out,
+										int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+#ifdef RT_HAS_AVX2_PATH
+	// the transparency callback works on FourRays, so only the 4-wide path supports it
+	if ( ( Flags & RTE_FLAGS_USE_BVH8 ) && !pCallback && CanUseAVX2() )
+	{
+		Trace8RaysBVH8_AVX2( this, rays, TMin, TMax, rslt_out, skip_id );
+		return;
+	}
+#endif
+	Trace4Rays( rays[0], TMin[0], TMax[0], &rslt_out[0], skip_id, pCallback );
+	Trace4Rays( rays[1], TMin[1], TMax[1], &rslt_out[1], skip_id, pCallback );
+}
+
+
+//-----------------------------------------------------------------------------
+// Traces the same pseudo-random rays through the kd-tree and the bvh and reports rays/sec.
+// Needs RTE_FLAGS_BUILD_KDTREE_AND_BVH8 to have been set before SetupAccelerationStructure.
+//-----------------------------------------------------------------------------
+void RayTracingEnvironment::BenchmarkAccelerationStructures( int nRays )
+{
+	if ( !OptimizedKDTree.Count() || !OptimizedBVH8.Count() )
+	{
+		Warning( "BenchmarkAccelerationStructures: both the kd-tree and the bvh need to be built\n" );
+		return;
+	}
+
+	// fixed seed so runs are comparable. rays start anywhere inside the world bounds and go in
+	// any direction, which is a rough stand-in for vrad's mix of short and long rays.
+	int nPackets = ( nRays + 7 ) / 8 * 2;
+	nRays = nPackets * 4;
+	CUtlVector<FourRays> rays;
+	rays.SetCount( nPackets );
+	CUniformRandomStream random;
+	random.SetSeed( 12345 );
+	Vector vecExtent = m_MaxBound - m_MinBound;
+	float flRayLength = vecExtent.Length();
+	for ( int p = 0; p < nPackets; p++ )
+	{
+		for ( int i = 0; i < 4; i++ )
+		{
+			Vector vecOrigin( random.RandomFloat( m_MinBound.x, m_MaxBound.x ),
+							  random.RandomFloat( m_MinBound.y, m_MaxBound.y ),
+							  random.RandomFloat( m_MinBound.z, m_MaxBound.z ) );
+			Vector vecDir;
+			do
+			{
+				vecDir.Init( random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ) );
+			} while ( vecDir.LengthSqr() > 1.0f || vecDir.LengthSqr() < 1.0e-4f );
+			vecDir.NormalizeInPlace();
+			rays[p].origin.X( i ) = vecOrigin.x;
+			rays[p].origin.Y( i ) = vecOrigin.y;
+			rays[p].origin.Z( i ) = vecOrigin.z;
+			rays[p].direction.X( i ) = vecDir.x;
+			rays[p].direction.Y( i ) = vecDir.y;
+			rays[p].direction.Z( i ) = vecDir.z;
+		}
+	}
+
+	fltx4 TMin[2] = { Four_Zeros, Four_Zeros };
+	fltx4 TMax[2] = { ReplicateX4( flRayLength ), ReplicateX4( flRayLength ) };
+
+	const char *pNames[3] = { "kd-tree (4 rays)", "bvh8 (4 rays)", "bvh8 (8 rays, avx2)" };
+	CUtlVector<RayTracingResult> results[3];
+	double flSeconds[3] = { 0, 0, 0 };
+	uint32 nSavedFlags = Flags;
+	int nModes = CanUseAVX2() ? 3 : 2;
+	for ( int nMode = 0; nMode < nModes; nMode++ )
+	{
+		if ( nMode == 0 )
+			Flags &= ~RTE_FLAGS_USE_BVH8;
+		else
+			Flags |= RTE_FLAGS_USE_BVH8;
+
+		results[nMode].SetCount( nPackets );
+		double flStart = Plat_FloatTime();
+		for ( int p = 0; p < nPackets; p += 2 )
+		{
+			if ( nMode == 2 )
+			{
+				Trace8Rays( &rays[p], TMin, TMax, &results[nMode][p] );
+			}
+			else
+			{
+				Trace4Rays( rays[p], TMin[0], TMax[0], &results[nMode][p] );
+				Trace4Rays( rays[p + 1], TMin[1], TMax[1], &results[nMode][p + 1] );
+			}
+		}
+		flSeconds[nMode] = Plat_FloatTime() - flStart;
+	}
+	Flags = nSavedFlags;
+
+	Msg( "Tracing %d rays against %d triangles (single thread):\n", nRays, OptimizedTriangleList.Count() );
+	for ( int nMode = 0; nMode < nModes; nMode++ )
+	{
+		// a ray only counts as a mismatch if the structures disagree about a hit inside the ray
+		int nMismatches = 0;
+		for ( int p = 0; nMode && p < nPackets; p++ )
+		{
+			for ( int i = 0; i < 4; i++ )
+			{
+				float flRef = SubFloat( results[0][p].HitDistance, i );
+				float flTest = SubFloat( results[nMode][p].HitDistance, i );
+				bool bRefHit = flRef < flRayLength;
+				bool bTestHit = flTest < flRayLength;
+				if ( ( bRefHit != bTestHit ) || ( bRefHit && fabs( flRef - flTest ) > 1.0e-3f * MAX( 1.0f, flRef ) ) )
+				{
+					nMismatches++;
+				}
+			}
+		}
+		Msg( "  %-22s %8.2f s  %12.0f rays/sec  %5.2fx", pNames[nMode], flSeconds[nMode],
+			 nRays / MAX( flSeconds[nMode], 1.0e-6 ), flSeconds[0] / MAX( flSeconds[nMode], 1.0e-6 ) );
+		if ( nMode )
+		{
+			Msg( "  %d mismatches", nMismatches );
+		}
+		Msg( "\n" );
+	}
+	if ( nModes < 3 )
+	{
+		Msg( "  %-22s skipped, cpu has no avx2\n", pNames[2] );
+	}
+}
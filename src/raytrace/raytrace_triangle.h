@@ -0,0 +1,113 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id:$
+//
+// 4-wide ray/triangle intersection shared by the kd-tree and bvh traversals.
+
+#ifndef RAYTRACE_TRIANGLE_H
+#define RAYTRACE_TRIANGLE_H
+
+#include "raytrace.h"
+
+static const fltx4 RT_FourEpsilons={1.0e-10,1.0e-10,1.0e-10,1.0e-10};
+static const fltx4 RT_FourZeros={1.0e-10,1.0e-10,1.0e-10,1.0e-10};
+static const fltx4 RT_FourNegativeEpsilons={-1.0e-10,-1.0e-10,-1.0e-10,-1.0e-10};
+
+// intersect 4 rays with triangle tnum, and update rslt_out for any ray that hits it closer than
+// its current hit.
+FORCEINLINE void IntersectTriangle4Rays( TriIntersectData_t const *tri, int tnum, const FourRays &rays,
+										 RayTracingResult *rslt_out, ITransparentTriangleCallback *pCallback )
+{
+	// compute plane intersection
+	FourVectors N;
+	N.x = ReplicateX4( tri->m_flNx );
+	N.y = ReplicateX4( tri->m_flNy );
+	N.z = ReplicateX4( tri->m_flNz );
+
+	fltx4 DDotN = rays.direction * N;
+	// mask off zero or near zero (ray parallel to surface)
+	fltx4 did_hit = OrSIMD( CmpGtSIMD( DDotN,RT_FourEpsilons ),
+							CmpLtSIMD( DDotN, RT_FourNegativeEpsilons ) );
+
+	fltx4 numerator=SubSIMD( ReplicateX4( tri->m_flD ), rays.origin * N );
+
+	fltx4 isect_t=DivSIMD( numerator,DDotN );
+	// now, we have the distance to the plane. lets update our mask
+	did_hit = AndSIMD( did_hit, CmpGtSIMD( isect_t, RT_FourZeros ) );
+	//did_hit=AndSIMD(did_hit,CmpLtSIMD(isect_t,TMax));
+	did_hit = AndSIMD( did_hit, CmpLtSIMD( isect_t, rslt_out->HitDistance ) );
+
+	if ( ! IsAnyNegative( did_hit ) )
+		return;
+
+	// now, check 3 edges
+	fltx4 hitc1 = AddSIMD( rays.origin[tri->m_nCoordSelect0],
+						   MulSIMD( isect_t, rays.direction[ tri->m_nCoordSelect0] ) );
+	fltx4 hitc2 = AddSIMD( rays.origin[tri->m_nCoordSelect1],
+						   MulSIMD( isect_t, rays.direction[tri->m_nCoordSelect1] ) );
+
+	// do barycentric coordinate check
+	fltx4 B0 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[0] ), hitc1 );
+
+	B0 = AddSIMD(
+		B0,
+		MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[1] ), hitc2 ) );
+	B0 = AddSIMD(
+		B0, ReplicateX4( tri->m_ProjectedEdgeEquations[2] ) );
+
+	did_hit = AndSIMD( did_hit, CmpGeSIMD( B0, RT_FourZeros ) );
+
+	fltx4 B1 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[3] ), hitc1 );
+	B1 = AddSIMD(
+		B1,
+		MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[4]), hitc2 ) );
+
+	B1 = AddSIMD(
+		B1, ReplicateX4( tri->m_ProjectedEdgeEquations[5] ) );
+
+	did_hit = AndSIMD( did_hit, CmpGeSIMD( B1, RT_FourZeros ) );
+
+	fltx4 B2 = AddSIMD( B1, B0 );
+	did_hit = AndSIMD( did_hit, CmpLeSIMD( B2, Four_Ones ) );
+
+	if ( ! IsAnyNegative( did_hit ) )
+		return;
+
+	// if the triangle is transparent
+	if ( tri->m_nFlags & FCACHETRI_TRANSPARENT )
+	{
+		if ( pCallback )
+		{
+			// assuming a triangle indexed as v0, v1, v2
+			// the projected edge equations are set up such that the vert opposite the first
+			// equation is v2, and the vert opposite the second equation is v0
+			// Therefore we pass them back in 1, 2, 0 order
+			// Also B2 is currently B1 + B0 and needs to be 1 - (B1+B0) in order to be a real
+			// barycentric coordinate.  Compute that now and pass it to the callback
+			fltx4 b2 = SubSIMD( Four_Ones, B2 );
+			if ( pCallback->VisitTriangle_ShouldContinue( *tri, rays, &did_hit, &B1, &b2, &B0, tnum ) )
+			{
+				did_hit = Four_Zeros;
+			}
+		}
+	}
+	// now, set the hit_id and closest_hit fields for any enabled rays
+	fltx4 replicated_n = ReplicateIX4(tnum);
+	StoreAlignedSIMD((float *) rslt_out->HitIds,
+					 OrSIMD(AndSIMD(replicated_n,did_hit),
+							AndNotSIMD(did_hit,LoadAlignedSIMD(
+										   (float *) rslt_out->HitIds))));
+	rslt_out->HitDistance=OrSIMD(AndSIMD(isect_t,did_hit),
+								 AndNotSIMD(did_hit,rslt_out->HitDistance));
+
+	rslt_out->surface_normal.x=OrSIMD(
+		AndSIMD(N.x,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.x));
+	rslt_out->surface_normal.y=OrSIMD(
+		AndSIMD(N.y,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.y));
+	rslt_out->surface_normal.z=OrSIMD(
+		AndSIMD(N.z,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.z));
+}
+
+#endif // RAYTRACE_TRIANGLE_H
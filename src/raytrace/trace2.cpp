@@ -202,14 +202,94 @@ void RayTracingEnvironment::RenderScene(
 
 #define SQ(x) ((x)*(x))
 
+struct VirtualLightProbe_t
+{
+	int m_nLight;
+	int m_nDesired;											// # of probes fired from this light
+	Vector m_vecDirection;
+};
+
+// turns probe rays from lights that hit something into virtual lights
+class CVirtualLightMaker : public IRayQueueCallback
+{
+public:
+	CVirtualLightMaker( RayTracingEnvironment *pEnv ) : m_pEnv( pEnv )
+	{
+	}
+
+	virtual void RayTraced( int32 nProbe, const RayTracingSingleResult &result );
+
+	RayTracingEnvironment *m_pEnv;
+	CUtlVector<VirtualLightProbe_t> m_Probes;
+};
+
+void CVirtualLightMaker::RayTraced( int32 nProbe, const RayTracingSingleResult &result )
+{
+	if (result.HitID==-1)
+		return;
+
+	VirtualLightProbe_t const &probe=m_Probes[nProbe];
+	LightDesc_t const &li=m_pEnv->LightList[probe.m_nLight];
+
+	// make sure normal points back towards ray origin
+	Vector normal=result.surface_normal;
+	if (DotProduct(normal,probe.m_vecDirection)>0)
+		normal=-normal;
+
+	// a hit! let's make a virtual light source
+
+	// treat the virtual light as a disk with its center at the hit position
+	// and its radius scaled by the amount of the solid angle this probe
+	// represents.
+	float area_of_virtual_light=
+		4.0*M_PI*SQ( result.HitDistance )*(1.0/probe.m_nDesired);
+
+	FourVectors intens;
+	intens.DuplicateVector(Vector(0,0,0));
+
+	Vector surface_pos=li.m_Position+probe.m_vecDirection*result.HitDistance+normal*0.1;
+	FourVectors surface_pos4;
+	surface_pos4.DuplicateVector(surface_pos);
+	FourVectors normal4;
+	normal4.DuplicateVector(normal);
+	li.ComputeLightAtPoints(surface_pos4,normal4,intens);
+	FourVectors surf_colors;
+	surf_colors.DuplicateVector(m_pEnv->TriangleColors[result.HitID]);
+	intens*=surf_colors;
+	// see if significant
+	LightDesc_t l1;
+	l1.m_Type=MATERIAL_LIGHT_SPOT;
+	l1.m_Position=surface_pos;
+	l1.m_Direction=normal;
+	l1.m_Color=Vector(intens.X(0),intens.Y(0),intens.Z(0));
+	if (l1.m_Color.Length()>0)
+	{
+		l1.m_Color*=area_of_virtual_light/M_PI;
+		l1.m_Range=0.0;
+		l1.m_Falloff=1.0;
+		l1.m_Attenuation0=1.0;
+		l1.m_Attenuation1=0.0;
+		l1.m_Attenuation2=1.0;			// intens falls off as 1/r^2
+		l1.m_Theta=0;
+		l1.m_Phi=M_PI;
+		l1.RecalculateDerivedValues();
+		m_pEnv->LightList.AddToTail(l1);
+	}
+}
+
 void RayTracingEnvironment::ComputeVirtualLightSources(void)
 {
+	CVirtualLightMaker maker(this);
 	int start_pos=0;
 	for(int b=0;b<3;b++)
 	{
 		int nl=LightList.Count();
 		int where_to_start=start_pos;
 		start_pos=nl;
+
+		// fire all of this bounce's probes as one batch. the lights they make are added to
+		// LightList, and are the sources for the next bounce.
+		maker.m_Probes.RemoveAll();
 		for(int l=where_to_start;l<nl;l++)
 		{
 			DirectionalSampler_t sample_generator;
@@ -219,72 +299,24 @@ void RayTracingEnvironment::ComputeVirtualLightSources(void)
 			for(int try1=0;try1<n_desired;try1++)
 			{
 				LightDesc_t const &li=LightList[l];
-				FourRays myrays;
-				myrays.origin.DuplicateVector(li.m_Position);
-				RayTracingResult rslt;
 				Vector trial_dir=sample_generator.NextValue();
 				if (li.IsDirectionWithinLightCone(trial_dir))
 				{
-					myrays.direction.DuplicateVector(trial_dir);
-					Trace4Rays(myrays,all_zeros,ReplicateX4(1000.0), &rslt);
-					if ((rslt.HitIds[0]!=-1))
-					{
-						// make sure normal points back towards ray origin
-						fltx4 ndoti=rslt.surface_normal*myrays.direction;
-						fltx4 bad_dirs=AndSIMD(CmpGtSIMD(ndoti,Four_Zeros),
-												   LoadAlignedSIMD((float *) signmask));
-						
-						// flip signs of all "wrong" normals
-						rslt.surface_normal.x=XorSIMD(bad_dirs,rslt.surface_normal.x);
-						rslt.surface_normal.y=XorSIMD(bad_dirs,rslt.surface_normal.y);
-						rslt.surface_normal.z=XorSIMD(bad_dirs,rslt.surface_normal.z);
-
-						// a hit! let's make a virtual light source
-
-						// treat the virtual light as a disk with its center at the hit position
-						// and its radius scaled by the amount of the solid angle this probe
-						// represents.
-						float area_of_virtual_light=
-							4.0*M_PI*SQ( SubFloat( rslt.HitDistance, 0 ) )*(1.0/n_desired);
-
-						FourVectors intens;
-						intens.DuplicateVector(Vector(0,0,0));
-
-						FourVectors surface_pos=myrays.direction;
-						surface_pos*=rslt.HitDistance;
-						surface_pos+=myrays.origin;
-						FourVectors delta=rslt.surface_normal;
-						delta*=0.1;
-						surface_pos+=delta;
-						LightList[l].ComputeLightAtPoints(surface_pos,rslt.surface_normal,
-														  intens);
-						FourVectors surf_colors;
-						surf_colors.DuplicateVector(TriangleColors[rslt.HitIds[0]]);
-						intens*=surf_colors;
-						// see if significant
-						LightDesc_t l1;
-						l1.m_Type=MATERIAL_LIGHT_SPOT;
-						l1.m_Position=Vector(surface_pos.X(0),surface_pos.Y(0),surface_pos.Z(0));
-						l1.m_Direction=Vector(rslt.surface_normal.X(0),rslt.surface_normal.Y(0),
-											  rslt.surface_normal.Z(0));
-						l1.m_Color=Vector(intens.X(0),intens.Y(0),intens.Z(0));
-						if (l1.m_Color.Length()>0)
-						{
-							l1.m_Color*=area_of_virtual_light/M_PI;
-							l1.m_Range=0.0;
-							l1.m_Falloff=1.0;
-							l1.m_Attenuation0=1.0;
-							l1.m_Attenuation1=0.0;
-							l1.m_Attenuation2=1.0;			// intens falls off as 1/r^2
-							l1.m_Theta=0;
-							l1.m_Phi=M_PI;
-							l1.RecalculateDerivedValues();
-							LightList.AddToTail(l1);
-						}
-					}
+					VirtualLightProbe_t &probe=maker.m_Probes[maker.m_Probes.AddToTail()];
+					probe.m_nLight=l;
+					probe.m_nDesired=n_desired;
+					probe.m_vecDirection=trial_dir;
 				}
 			}
 		}
+
+		RayQueue queue(&maker,MAX(maker.m_Probes.Count(),1));
+		for(int i=0;i<maker.m_Probes.Count();i++)
+		{
+			Vector start=LightList[maker.m_Probes[i].m_nLight].m_Position;
+			AddToRayQueue(queue,start,start+1000.0*maker.m_Probes[i].m_vecDirection,i);
+		}
+		FlushRayQueue(queue);
 	}
 }
 
@@ -374,3 +406,118 @@ void RayTracingEnvironment::FinishRayStream(RayStream &s)
 		}
 	}
 }
+
+
+// spread the low 9 bits of a value out so that there are 2 zero bits between each
+static uint32 SpreadBitsBy3(uint32 v)
+{
+	v&=0x1ff;
+	v=(v|(v<<16))&0x030000ff;
+	v=(v|(v<<8))&0x0300f00f;
+	v=(v|(v<<4))&0x030c30c3;
+	v=(v|(v<<2))&0x09249249;
+	return v;
+}
+
+#define RAYQUEUE_CELL_BITS 9								// per axis
+#define RAYQUEUE_SORT_KEY_BITS ( 3 + 3 * RAYQUEUE_CELL_BITS )
+#define RAYQUEUE_RADIX_BITS 10
+
+void RayTracingEnvironment::AddToRayQueue(RayQueue &q,
+										  Vector const &start,Vector const &end,int32 nUserData)
+{
+	RayQueue::QueuedRay_t &ray=q.m_Rays[q.m_Rays.AddToTail()];
+	ray.m_vecStart=start;
+	ray.m_vecDelta=end;
+	ray.m_vecDelta-=start;
+	ray.m_nUserData=nUserData;
+
+	// sort by direction octant first, then by the morton order of the cell the ray starts in
+	uint32 nCell[3];
+	for(int c=0;c<3;c++)
+	{
+		float flExtent=m_MaxBound[c]-m_MinBound[c];
+		float flFrac=(flExtent>0)?(start[c]-m_MinBound[c])/flExtent:0;
+		nCell[c]=clamp((int)(flFrac*(1<<RAYQUEUE_CELL_BITS)),0,(1<<RAYQUEUE_CELL_BITS)-1);
+	}
+	ray.m_nSortKey=(GetSignMask(ray.m_vecDelta)<<(3*RAYQUEUE_CELL_BITS))|
+		SpreadBitsBy3(nCell[0])|(SpreadBitsBy3(nCell[1])<<1)|(SpreadBitsBy3(nCell[2])<<2);
+
+	if (q.m_Rays.Count()>=q.m_nBatchSize)
+		FlushRayQueue(q);
+}
+
+void RayTracingEnvironment::FlushRayQueue(RayQueue &q)
+{
+	int nRays=q.m_Rays.Count();
+	if (!nRays)
+		return;
+
+	// radix sort on the key. the sort is stable, so the result doesn't depend on anything but
+	// the order the rays were added in.
+	q.m_SortScratch.SetCount(nRays);
+	for(int nShift=0;nShift<RAYQUEUE_SORT_KEY_BITS;nShift+=RAYQUEUE_RADIX_BITS)
+	{
+		int nCounts[1<<RAYQUEUE_RADIX_BITS];
+		memset(nCounts,0,sizeof(nCounts));
+		for(int i=0;i<nRays;i++)
+			nCounts[(q.m_Rays[i].m_nSortKey>>nShift)&((1<<RAYQUEUE_RADIX_BITS)-1)]++;
+		if (nCounts[(q.m_Rays[0].m_nSortKey>>nShift)&((1<<RAYQUEUE_RADIX_BITS)-1)]==nRays)
+			continue;										// all the same, nothing to do
+		int nTotal=0;
+		for(int b=0;b<(1<<RAYQUEUE_RADIX_BITS);b++)
+		{
+			int nCount=nCounts[b];
+			nCounts[b]=nTotal;
+			nTotal+=nCount;
+		}
+		for(int i=0;i<nRays;i++)
+		{
+			RayQueue::QueuedRay_t const &ray=q.m_Rays[i];
+			q.m_SortScratch[nCounts[(ray.m_nSortKey>>nShift)&((1<<RAYQUEUE_RADIX_BITS)-1)]++]=ray;
+		}
+		q.m_Rays.Swap(q.m_SortScratch);
+	}
+
+	// now trace them 8 at a time. the last packets are padded out with copies of the last ray.
+	FourRays rays[2];
+	fltx4 TMin[2]={Four_Zeros,Four_Zeros};
+	fltx4 TMax[2];
+	RayTracingResult results[2];
+	for(int nFirst=0;nFirst<nRays;nFirst+=8)
+	{
+		for(int p=0;p<2;p++)
+		{
+			for(int r=0;r<4;r++)
+			{
+				RayQueue::QueuedRay_t const &ray=q.m_Rays[MIN(nFirst+p*4+r,nRays-1)];
+				rays[p].origin.X(r)=ray.m_vecStart.x;
+				rays[p].origin.Y(r)=ray.m_vecStart.y;
+				rays[p].origin.Z(r)=ray.m_vecStart.z;
+				rays[p].direction.X(r)=ray.m_vecDelta.x;
+				rays[p].direction.Y(r)=ray.m_vecDelta.y;
+				rays[p].direction.Z(r)=ray.m_vecDelta.z;
+			}
+			TMax[p]=rays[p].direction.length();
+			fltx4 scl=ReciprocalSaturateSIMD(TMax[p]);
+			rays[p].direction*=scl;							// normalize
+		}
+		Trace8Rays(rays,TMin,TMax,results,q.m_nSkipID);
+
+		int nInPacket=MIN(8,nRays-nFirst);
+		for(int i=0;i<nInPacket;i++)
+		{
+			int p=i>>2;
+			int r=i&3;
+			RayTracingSingleResult out;
+			out.ray_length=SubFloat(TMax[p],r);
+			out.surface_normal.x=results[p].surface_normal.X(r);
+			out.surface_normal.y=results[p].surface_normal.Y(r);
+			out.surface_normal.z=results[p].surface_normal.Z(r);
+			out.HitID=results[p].HitIds[r];
+			out.HitDistance=SubFloat(results[p].HitDistance,r);
+			q.m_pCallback->RayTraced(q.m_Rays[nFirst+i].m_nUserData,out);
+		}
+	}
+	q.m_Rays.RemoveAll();
+}
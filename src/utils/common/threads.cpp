@@ -1,6 +1,6 @@
 //========= Copyright Valve Corporation, All rights reserved. ============//
 //
-// Purpose: 
+// Purpose:
 //
 // $Workfile:     $
 // $Date:         $
@@ -13,13 +13,19 @@
 
 #define	USED
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
 #include "cmdlib.h"
 #define NO_THREAD_NAMES
 #include "threads.h"
 #include "pacifier.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlvector.h"
 
-#define	MAX_THREADS	16
+#define	MAX_THREADS	MAX_TOOL_THREADS
 
 
 class CRunThreadsData
@@ -33,16 +39,97 @@ public:
 CRunThreadsData g_RunThreadsData[MAX_THREADS];
 
 
-int		dispatch;
+//-----------------------------------------------------------------------------
+// Work items are handed out from one shared cursor in ascending order, a
+// chunk at a time. Some callers depend on that order: vvis's PortalFlow uses
+// the portals that have already finished to prune the ones after them.
+//-----------------------------------------------------------------------------
+struct ALIGN128 CThreadWorkQueue
+{
+	// Chunk this thread has already claimed, only touched by the owner.
+	int m_iChunkNext;
+	int m_iChunkEnd;
+
+	// Stats for the current phase
+	int m_nItemsDone;
+	int m_nChunks;
+} ALIGN128_POST;
+
+CThreadWorkQueue g_ThreadWorkQueues[MAX_THREADS];
+
+// Next item to hand out, on its own cache line.
+static ALIGN128 volatile int32 g_iNextWorkItem ALIGN128_POST;
+
+// Upper bound on the number of items a thread claims at once. Chunks shrink
+// as the work runs out, so the last items still spread across all threads.
+// Bigger chunks mean fewer atomics but less strict ordering.
+#define MAX_WORK_CHUNK	8
+
+
+struct ThreadPhaseTiming_t
+{
+	char m_szName[64];
+	int m_nWorkItems;
+	int m_nThreads;
+	double m_flSeconds;
+	int m_nMinItemsPerThread;
+	int m_nMaxItemsPerThread;
+	int m_nChunks;
+};
+
+static CUtlVector<ThreadPhaseTiming_t> g_ThreadPhaseTimings;
+static char g_szNextPhaseName[64];
+
+static CTHREADLOCALINT g_iCurrentThreadIndex;
+
+
 int		workcount;
+CInterlockedInt	g_nWorkDispatched;
 qboolean		pacifier;
 
 qboolean	threaded;
 bool g_bLowPriorityThreads = false;
 
-HANDLE g_ThreadHandles[MAX_THREADS];
+ThreadHandle_t g_ThreadHandles[MAX_THREADS];
 
 
+static void InitThreadWorkQueues( int nThreads )
+{
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		CThreadWorkQueue &queue = g_ThreadWorkQueues[i];
+		queue.m_iChunkNext = queue.m_iChunkEnd = 0;
+		queue.m_nItemsDone = 0;
+		queue.m_nChunks = 0;
+	}
+
+	g_iNextWorkItem = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Claims the next chunk from the shared cursor.
+//-----------------------------------------------------------------------------
+static bool ClaimWork( CThreadWorkQueue &queue )
+{
+	for (;;)
+	{
+		int iBegin = g_iNextWorkItem;
+		if ( iBegin >= workcount )
+			return false;
+
+		int nChunk = clamp( ( workcount - iBegin ) / ( numthreads * 8 ), 1, MAX_WORK_CHUNK );
+		if ( ThreadInterlockedAssignIf( &g_iNextWorkItem, iBegin + nChunk, iBegin ) )
+		{
+			queue.m_iChunkNext = iBegin;
+			queue.m_iChunkEnd = iBegin + nChunk;
+			queue.m_nChunks++;
+			g_nWorkDispatched += nChunk;
+			return true;
+		}
+	}
+}
+
 
 /*
 =============
@@ -50,25 +137,34 @@ GetThreadWork
 
 =============
 */
-int	GetThreadWork (void)
+int	GetThreadWork ( int iThread )
 {
-	int	r;
-
-	ThreadLock ();
-
-	if (dispatch == workcount)
+	if ( iThread < 0 || iThread >= numthreads )
 	{
-		ThreadUnlock ();
-		return -1;
+		// THREADINDEX_MAIN or a thread we didn't start. Just use the first queue.
+		iThread = 0;
 	}
 
-	UpdatePacifier( (float)dispatch / workcount );
+	CThreadWorkQueue &queue = g_ThreadWorkQueues[iThread];
+	if ( queue.m_iChunkNext >= queue.m_iChunkEnd )
+	{
+		if ( !ClaimWork( queue ) )
+			return -1;
 
-	r = dispatch;
-	dispatch++;
-	ThreadUnlock ();
+		// The pacifier isn't thread safe, so only one thread draws it.
+		if ( iThread == 0 && pacifier )
+		{
+			UpdatePacifier( (float)g_nWorkDispatched / workcount );
+		}
+	}
 
-	return r;
+	queue.m_nItemsDone++;
+	return queue.m_iChunkNext++;
+}
+
+int	GetThreadWork (void)
+{
+	return GetThreadWork( g_iCurrentThreadIndex );
 }
 
 
@@ -80,10 +176,10 @@ void ThreadWorkerFunction( int iThread, void *pUserData )
 
 	while (1)
 	{
-		work = GetThreadWork ();
+		work = GetThreadWork ( iThread );
 		if (work == -1)
 			break;
-		 
+
 		workfunction( iThread, work );
 	}
 }
@@ -92,7 +188,7 @@ void RunThreadsOnIndividual (int workcnt, qboolean showpacifier, ThreadWorkerFn
 {
 	if (numthreads == -1)
 		ThreadSetDefault ();
-	
+
 	workfunction = func;
 	RunThreadsOn (workcnt, showpacifier, ThreadWorkerFunction);
 }
@@ -101,45 +197,38 @@ void RunThreadsOnIndividual (int workcnt, qboolean showpacifier, ThreadWorkerFn
 /*
 ===================================================================
 
-WIN32
+THREADS
 
 ===================================================================
 */
 
 int		numthreads = -1;
-CRITICAL_SECTION		crit;
+CThreadMutex	crit;
 static int enter;
 
 
-class CCritInit
-{
-public:
-	CCritInit()
-	{
-		InitializeCriticalSection (&crit);
-	}
-} g_CritInit;
-
-
-
 void SetLowPriority()
 {
+#ifdef _WIN32
 	SetPriorityClass( GetCurrentProcess(), IDLE_PRIORITY_CLASS );
+#else
+	setpriority( PRIO_PROCESS, 0, TP_PRIORITY_LOWEST );
+#endif
 }
 
 
 void ThreadSetDefault (void)
 {
-	SYSTEM_INFO info;
-
 	if (numthreads == -1)	// not set manually
 	{
-		GetSystemInfo (&info);
-		numthreads = info.dwNumberOfProcessors;
-		if (numthreads < 1 || numthreads > 32)
+		numthreads = GetCPUInformation()->m_nLogicalProcessors;
+		if (numthreads < 1)
 			numthreads = 1;
 	}
 
+	if ( numthreads > MAX_TOOL_THREADS )
+		numthreads = MAX_TOOL_THREADS;
+
 	Msg ("%i threads\n", numthreads);
 }
 
@@ -148,7 +237,7 @@ void ThreadLock (void)
 {
 	if (!threaded)
 		return;
-	EnterCriticalSection (&crit);
+	crit.Lock();
 	if (enter)
 		Error ("Recursive ThreadLock\n");
 	enter = 1;
@@ -161,14 +250,15 @@ void ThreadUnlock (void)
 	if (!enter)
 		Error ("ThreadUnlock without lock\n");
 	enter = 0;
-	LeaveCriticalSection (&crit);
+	crit.Unlock();
 }
 
 
 // This runs in the thread and dispatches a RunThreadsFn call.
-DWORD WINAPI InternalRunThreadsFn( LPVOID pParameter )
+static uintp InternalRunThreadsFn( void *pParameter )
 {
 	CRunThreadsData *pData = (CRunThreadsData*)pParameter;
+	g_iCurrentThreadIndex = pData->m_iThread;
 	pData->m_Fn( pData->m_iThread, pData->m_pUserData );
 	return 0;
 }
@@ -188,23 +278,20 @@ void RunThreads_Start( RunThreadsFn fn, void *pUserData, ERunThreadsPriority ePr
 		g_RunThreadsData[i].m_pUserData = pUserData;
 		g_RunThreadsData[i].m_Fn = fn;
 
-		DWORD dwDummy;
-		g_ThreadHandles[i] = CreateThread(
-		   NULL,	// LPSECURITY_ATTRIBUTES lpsa,
-		   0,		// DWORD cbStack,
-		   InternalRunThreadsFn,	// LPTHREAD_START_ROUTINE lpStartAddr,
-		   &g_RunThreadsData[i],	// LPVOID lpvThreadParm,
-		   0,			// DWORD fdwCreate,
-		   &dwDummy );
+		g_ThreadHandles[i] = CreateSimpleThread( InternalRunThreadsFn, &g_RunThreadsData[i] );
 
 		if ( ePriority == k_eRunThreadsPriority_UseGlobalState )
 		{
 			if( g_bLowPriorityThreads )
-				SetThreadPriority( g_ThreadHandles[i], THREAD_PRIORITY_LOWEST );
+				ThreadSetPriority( g_ThreadHandles[i], TP_PRIORITY_LOWEST );
 		}
 		else if ( ePriority == k_eRunThreadsPriority_Idle )
 		{
-			SetThreadPriority( g_ThreadHandles[i], THREAD_PRIORITY_IDLE );
+#ifdef _WIN32
+			ThreadSetPriority( g_ThreadHandles[i], THREAD_PRIORITY_IDLE );
+#else
+			ThreadSetPriority( g_ThreadHandles[i], TP_PRIORITY_LOWEST );
+#endif
 		}
 	}
 }
@@ -212,13 +299,61 @@ void RunThreads_Start( RunThreadsFn fn, void *pUserData, ERunThreadsPriority ePr
 
 void RunThreads_End()
 {
-	WaitForMultipleObjects( numthreads, g_ThreadHandles, TRUE, INFINITE );
 	for ( int i=0; i < numthreads; i++ )
-		CloseHandle( g_ThreadHandles[i] );
+	{
+		ThreadJoin( g_ThreadHandles[i] );
+		ReleaseThreadHandle( g_ThreadHandles[i] );
+	}
 
 	threaded = false;
 }
-	
+
+
+void RunThreads_SetPhaseName( const char *pName )
+{
+	V_strncpy( g_szNextPhaseName, pName, sizeof( g_szNextPhaseName ) );
+}
+
+
+static void RecordThreadPhase( double flSeconds )
+{
+	ThreadPhaseTiming_t &phase = g_ThreadPhaseTimings[g_ThreadPhaseTimings.AddToTail()];
+	V_strncpy( phase.m_szName, g_szNextPhaseName[0] ? g_szNextPhaseName : "(unnamed)", sizeof( phase.m_szName ) );
+	phase.m_nWorkItems = workcount;
+	phase.m_nThreads = numthreads;
+	phase.m_flSeconds = flSeconds;
+	phase.m_nMinItemsPerThread = INT_MAX;
+	phase.m_nMaxItemsPerThread = 0;
+	phase.m_nChunks = 0;
+	for ( int i = 0; i < numthreads; i++ )
+	{
+		CThreadWorkQueue &queue = g_ThreadWorkQueues[i];
+		phase.m_nMinItemsPerThread = MIN( phase.m_nMinItemsPerThread, queue.m_nItemsDone );
+		phase.m_nMaxItemsPerThread = MAX( phase.m_nMaxItemsPerThread, queue.m_nItemsDone );
+		phase.m_nChunks += queue.m_nChunks;
+	}
+
+	g_szNextPhaseName[0] = 0;
+}
+
+
+void PrintThreadPhaseTimings()
+{
+	if ( !g_ThreadPhaseTimings.Count() )
+		return;
+
+	double flTotal = 0;
+	Msg( "\n%-28s %10s %8s %10s %16s %8s\n", "Phase", "Items", "Threads", "Seconds", "Items/thread", "Chunks" );
+	for ( int i = 0; i < g_ThreadPhaseTimings.Count(); i++ )
+	{
+		const ThreadPhaseTiming_t &phase = g_ThreadPhaseTimings[i];
+		Msg( "%-28s %10d %8d %10.2f %7d - %-7d %8d\n", phase.m_szName, phase.m_nWorkItems, phase.m_nThreads,
+			phase.m_flSeconds, phase.m_nMinItemsPerThread, phase.m_nMaxItemsPerThread, phase.m_nChunks );
+		flTotal += phase.m_flSeconds;
+	}
+	Msg( "%-28s %10s %8s %10.2f\n\n", "Total", "", "", flTotal );
+}
+
 
 /*
 =============
@@ -227,31 +362,36 @@ RunThreadsOn
 */
 void RunThreadsOn( int workcnt, qboolean showpacifier, RunThreadsFn fn, void *pUserData )
 {
-	int		start, end;
+	double	start, end;
+
+	if (numthreads == -1)
+		ThreadSetDefault ();
+	if ( numthreads > MAX_TOOL_THREADS )
+		numthreads = MAX_TOOL_THREADS;
 
 	start = Plat_FloatTime();
-	dispatch = 0;
 	workcount = workcnt;
+	g_nWorkDispatched = 0;
+	InitThreadWorkQueues( numthreads );
 	StartPacifier("");
 	pacifier = showpacifier;
 
 #ifdef _PROFILE
 	threaded = false;
-	(*func)( 0 );
+	fn( 0, pUserData );
 	return;
 #endif
 
-	
+
 	RunThreads_Start( fn, pUserData );
 	RunThreads_End();
 
 
 	end = Plat_FloatTime();
+	RecordThreadPhase( end - start );
 	if (pacifier)
 	{
 		EndPacifier(false);
-		printf (" (%i)\n", end-start);
+		printf (" (%i)\n", (int)( end-start ));
 	}
 }
-
-
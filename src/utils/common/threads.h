@@ -18,7 +18,8 @@
 
 // Arrays that are indexed by thread should always be MAX_TOOL_THREADS+1
 // large so THREADINDEX_MAIN can be used from the main thread.
-#define MAX_TOOL_THREADS	16
+// This only sizes those arrays; ThreadSetDefault uses every logical processor up to it.
+#define MAX_TOOL_THREADS	256
 #define THREADINDEX_MAIN	(MAX_TOOL_THREADS)
 
 
@@ -43,7 +44,12 @@ enum ERunThreadsPriority
 void SetLowPriority();
 
 void ThreadSetDefault (void);
+
+// Returns the next work item for the calling thread, or -1 when all work is done.
+// Items are handed out in ascending order across all threads, in small chunks
+// claimed without a lock. Pass the thread index when you have it, it saves a TLS lookup.
 int	GetThreadWork (void);
+int	GetThreadWork ( int iThread );
 
 void RunThreadsOnIndividual ( int workcnt, qboolean showpacifier, ThreadWorkerFn fn );
 
@@ -56,10 +62,15 @@ void RunThreads_End();
 void ThreadLock (void);
 void ThreadUnlock (void);
 
+// Each RunThreadsOn call is recorded as a phase (named after the worker function).
+// This prints wall time, item count, load balance and chunk count for every phase so far.
+void RunThreads_SetPhaseName( const char *pName );
+void PrintThreadPhaseTimings();
+
 
 #ifndef NO_THREAD_NAMES
-#define RunThreadsOn(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreadsOn(n,p,f); }
-#define RunThreadsOnIndividual(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreadsOnIndividual(n,p,f); }
+#define RunThreadsOn(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreads_SetPhaseName( #f ); RunThreadsOn(n,p,f); }
+#define RunThreadsOnIndividual(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreads_SetPhaseName( #f ); RunThreadsOnIndividual(n,p,f); }
 #endif
 
 #endif // THREADS_H
@@ -34,9 +34,9 @@ Use the PVS to accelerate if available
 #define PLANE_TEST_EPSILON  0.01 // patch must be this much in front of the plane to be considered "in front"
 #define PATCH_FACE_OFFSET  0.1 // push patch origins off from the face by this amount to avoid self collisions
 
-#define STREAM_SIZE 512
+#define RAY_QUEUE_BATCH_SIZE 4096
 
-class CTransferMaker
+class CTransferMaker : public IRayQueueCallback
 {
 public:
 
@@ -45,49 +45,49 @@ public:
 
 	FORCEINLINE void TestMakeTransfer( Vector start, Vector stop, int ndxShooter, int ndxReciever )
 	{
-		g_RtEnv.AddToRayStream( m_RayStream, start, stop, &m_pResults[m_nTests] );
 		m_pShooterPatches[m_nTests] = ndxShooter;
 		m_pRecieverPatches[m_nTests] = ndxReciever;
+		g_RtEnv.AddToRayQueue( m_RayQueue, start, stop, m_nTests );
 		++m_nTests;
 	}
 
 	void Finish();
 
+	virtual void RayTraced( int32 nTest, const RayTracingSingleResult &result );
+
 private:
 
 	int m_nTests;
-	RayTracingSingleResult *m_pResults;
 	int *m_pShooterPatches;
 	int *m_pRecieverPatches;
-	RayStream m_RayStream;
+	RayQueue m_RayQueue;
 	transfer_t *m_AllTransfers;
 };
 
 CTransferMaker::CTransferMaker( transfer_t *all_transfers ) :
-	m_AllTransfers( all_transfers ), m_nTests( 0 )
+	m_nTests( 0 ), m_RayQueue( this, RAY_QUEUE_BATCH_SIZE ), m_AllTransfers( all_transfers )
 {
-	m_pResults = (RayTracingSingleResult *)calloc( 1, MAX_PATCHES * sizeof ( RayTracingSingleResult ) );
 	m_pShooterPatches = (int *)calloc( 1, MAX_PATCHES * sizeof( int ) );
 	m_pRecieverPatches = (int *)calloc( 1, MAX_PATCHES * sizeof( int ) );
 }
 
 CTransferMaker::~CTransferMaker()
 {
-	free ( m_pResults );
 	free ( m_pShooterPatches );
 	free (m_pRecieverPatches );
 }
 
-void CTransferMaker::Finish()
+void CTransferMaker::RayTraced( int32 nTest, const RayTracingSingleResult &result )
 {
-	g_RtEnv.FinishRayStream( m_RayStream );
-	for ( int i = 0; i < m_nTests; ++i )
+	if ( result.HitID == -1 || result.HitDistance >= result.ray_length )
 	{
-		if ( m_pResults[i].HitID == -1 || m_pResults[i].HitDistance >= m_pResults[i].ray_length )
-		{
-			MakeTransfer( m_pShooterPatches[i], m_pRecieverPatches[i], m_AllTransfers );
-		}
+		MakeTransfer( m_pShooterPatches[nTest], m_pRecieverPatches[nTest], m_AllTransfers );
 	}
+}
+
+void CTransferMaker::Finish()
+{
+	g_RtEnv.FlushRayQueue( m_RayQueue );
 	m_nTests = 0;
 }
 
@@ -449,7 +449,7 @@ void BuildVisLeafs( int threadnum, void *pUserData )
 		// covers areas relevent to the PVS
 		//
 		// JAY: Now this returns a cluster index
-		int iCluster = GetThreadWork();
+		int iCluster = GetThreadWork( threadnum );
 		if ( iCluster == -1 )
 			break;
 
@@ -57,6 +57,7 @@ float		g_MaxDispPatchRadius = 1500.0f;			// Maximum radius allowed for displacem
 qboolean	g_bDumpPatches;
 bool	    bDumpNormals = false;
 bool		g_bDumpRtEnv = false;
+bool		g_bRayTraceBenchmark = false;
 bool		bRed2Black = true;
 bool		g_bFastAmbient = false;
 bool        g_bNoSkyRecurse = false;
@@ -1542,7 +1543,7 @@ void GatherLight (int threadnum, void *pUserData)
 
 	while (1)
 	{
-		j = GetThreadWork ();
+		j = GetThreadWork ( threadnum );
 		if (j == -1)
 			break;
 
@@ -2285,10 +2286,18 @@ void VRAD_LoadBSP( char const *pFilename )
 	// Build acceleration structure
 	printf ( "Setting up ray-trace acceleration structure... ");
 	float start = Plat_FloatTime();
+	if ( g_bRayTraceBenchmark )
+		g_RtEnv.Flags |= RTE_FLAGS_BUILD_KDTREE_AND_BVH8;
 	g_RtEnv.SetupAccelerationStructure();
 	float end = Plat_FloatTime();
 	printf ( "Done (%.2f seconds)\n", end-start );
 
+	if ( g_bRayTraceBenchmark )
+	{
+		g_RtEnv.BenchmarkAccelerationStructures( 1 << 20 );
+		exit( 0 );
+	}
+
 #if 0  // To test only k-d build
 	exit(0);
 #endif
@@ -2359,6 +2368,8 @@ void VRAD_Finish()
 
 	double end = Plat_FloatTime();
 	
+	PrintThreadPhaseTimings();
+
 	char str[512];
 	GetHourMinuteSecondsString( (int)( end - g_flStartTime ), str, sizeof( str ) );
 	Msg( "%s elapsed\n", str );
@@ -2432,6 +2443,14 @@ int ParseCommandLine( int argc, char **argv, bool *onlydetail )
 		{
 			g_bDumpRtEnv = true;
 		}
+		else if ( !Q_stricmp( argv[i], "-bvh" ) )
+		{
+			g_RtEnv.Flags |= RTE_FLAGS_USE_BVH8;
+		}
+		else if ( !Q_stricmp( argv[i], "-rtbench" ) )
+		{
+			g_bRayTraceBenchmark = true;
+		}
 		else if ( !Q_stricmp( argv[i], "-LargeDispSampleRadius" ) )
 		{
 			g_bLargeDispSampleRadius = true;
@@ -2836,6 +2855,9 @@ void PrintUsage( int argc, char **argv )
 		"  -dump           : Write debugging .txt files.\n"
 		"  -dumpnormals    : Write normals to debug files.\n"
 		"  -dumptrace      : Write ray-tracing environment to debug files.\n"
+		"  -bvh            : Trace rays against an 8-wide bvh instead of the kd-tree.\n"
+		"  -rtbench        : Build the kd-tree and the bvh, compare their tracing speed\n"
+		"                    with a fixed set of rays, and exit.\n"
 		"  -threads        : Control the number of threads vbsp uses (defaults to the #\n"
 		"                    or processors on your machine).\n"
 		"  -lights <file>  : Load a lights file in addition to lights.rad and the\n"
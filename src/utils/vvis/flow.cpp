@@ -636,6 +636,8 @@ void PortalFlow (int iThread, int portalnum)
 	int				c_might, c_can;
 
 	p = sorted_portals[portalnum];
+	if ( p->status == stat_done )
+		return;			// reused from the portal cache
 	p->status = stat_working;
 				
 	c_might = CountBits (p->portalflood, g_numportals*2);
@@ -0,0 +1,305 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Cache of PortalFlow results between compiles, so a recompile only has
+//			to flow the portals whose surroundings changed.
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+
+#include "vis.h"
+#include "tier1/generichash.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlhashtable.h"
+
+
+//-----------------------------------------------------------------------------
+// A portal's flow result only depends on the portals in its portalflood set (and the
+// leaves they lead into), so that's what it is keyed on. Portal numbers change whenever
+// the map is edited, so portals are identified by a hash of their geometry instead, both
+// in the keys and in the saved results.
+//-----------------------------------------------------------------------------
+#define PORTALCACHE_MAGIC		( ( 'C' << 24 ) | ( 'V' << 16 ) | ( 'V' << 8 ) | 'P' )
+#define PORTALCACHE_VERSION		1
+
+struct PortalCacheHeader_t
+{
+	int m_nMagic;
+	int m_nVersion;
+	int m_nEntries;
+	int m_nVisibleHashes;
+};
+
+struct PortalCacheEntry_t
+{
+	uint64 m_nKey;
+	int m_nFirstVisible;									// into g_PortalCacheVisibleHashes
+	int m_nVisibleCount;
+};
+
+static CUtlVector<PortalCacheEntry_t> g_PortalCacheEntries;
+static CUtlVector<uint64> g_PortalCacheVisibleHashes;
+static CUtlHashtable<uint64, int> g_PortalCacheLookup;		// key -> entry
+
+static uint64 *g_pPortalGeometryHashes;
+static uint64 *g_pPortalFlowKeys;							// 0 if the portal can't be cached
+static CUtlHashtable<uint64, int> g_PortalsByGeometry;		// geometry hash -> portal number
+
+static int g_nPortalsReused;
+static int g_nPortalsStale;
+
+
+//-----------------------------------------------------------------------------
+// Reads the results of the last compile, if there was one
+//-----------------------------------------------------------------------------
+void PortalCache_Load( const char *pFilename )
+{
+	g_PortalCacheEntries.RemoveAll();
+	g_PortalCacheVisibleHashes.RemoveAll();
+	g_PortalCacheLookup.RemoveAll();
+
+	if ( !FileExists( pFilename ) )
+	{
+		Msg( "No portal cache (%s), all portals will be flowed\n", pFilename );
+		return;
+	}
+
+	void *pData = NULL;
+	int nLength = LoadFile( pFilename, &pData );
+	if ( !pData )
+		return;
+
+	CUtlBuffer buf( pData, nLength, CUtlBuffer::READ_ONLY );
+	PortalCacheHeader_t header;
+	buf.Get( &header, sizeof( header ) );
+	int nExpectedLength = sizeof( header ) + header.m_nEntries * ( sizeof( uint64 ) + sizeof( int ) ) + header.m_nVisibleHashes * sizeof( uint64 );
+	if ( !buf.IsValid() || header.m_nMagic != PORTALCACHE_MAGIC || header.m_nVersion != PORTALCACHE_VERSION ||
+		 header.m_nEntries < 0 || header.m_nVisibleHashes < 0 || nLength != nExpectedLength )
+	{
+		Warning( "Ignoring portal cache %s, it is out of date or damaged\n", pFilename );
+		free( pData );
+		return;
+	}
+
+	g_PortalCacheEntries.SetCount( header.m_nEntries );
+	g_PortalCacheVisibleHashes.SetCount( header.m_nVisibleHashes );
+	int nFirstVisible = 0;
+	for ( int i = 0; i < header.m_nEntries; i++ )
+	{
+		PortalCacheEntry_t &entry = g_PortalCacheEntries[i];
+		buf.Get( &entry.m_nKey, sizeof( entry.m_nKey ) );
+		entry.m_nVisibleCount = buf.GetInt();
+		entry.m_nFirstVisible = nFirstVisible;
+		nFirstVisible += entry.m_nVisibleCount;
+		g_PortalCacheLookup.Insert( entry.m_nKey, i );
+	}
+
+	if ( nFirstVisible != header.m_nVisibleHashes )
+	{
+		Warning( "Ignoring portal cache %s, it is damaged\n", pFilename );
+		g_PortalCacheEntries.RemoveAll();
+		g_PortalCacheLookup.RemoveAll();
+		g_PortalCacheVisibleHashes.RemoveAll();
+		free( pData );
+		return;
+	}
+
+	if ( header.m_nVisibleHashes )
+	{
+		buf.Get( g_PortalCacheVisibleHashes.Base(), header.m_nVisibleHashes * sizeof( uint64 ) );
+	}
+	free( pData );
+
+	Msg( "Loaded portal cache %s (%d portals)\n", pFilename, header.m_nEntries );
+}
+
+
+static uint64 HashPortalGeometry( portal_t const *p )
+{
+	// the windings come straight from the .prt file, so unchanged portals hash the same
+	uint64 nHash = MurmurHash64( p->winding->points, p->winding->numpoints * sizeof( Vector ), p->winding->numpoints );
+	nHash ^= HashUint64( MurmurHash64( &p->plane, sizeof( p->plane ), 0 ) );
+	return nHash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Computes the cache key of every portal. Call after BasePortalVis, since the keys
+// depend on portalflood.
+//-----------------------------------------------------------------------------
+void PortalCache_ComputeKeys( void )
+{
+	int nPortals = g_numportals * 2;
+	delete[] g_pPortalGeometryHashes;
+	delete[] g_pPortalFlowKeys;
+	g_pPortalGeometryHashes = new uint64[nPortals];
+	g_pPortalFlowKeys = new uint64[nPortals];
+	g_PortalsByGeometry.RemoveAll();
+
+	CUtlVector<bool> ambiguous;
+	ambiguous.SetCount( nPortals );
+	for ( int i = 0; i < nPortals; i++ )
+	{
+		g_pPortalGeometryHashes[i] = HashPortalGeometry( &portals[i] );
+		ambiguous[i] = false;
+
+		// two portals with the same geometry can't be told apart in the saved results
+		bool bInserted;
+		UtlHashHandle_t h = g_PortalsByGeometry.Insert( g_pPortalGeometryHashes[i], i, &bInserted );
+		if ( !bInserted )
+		{
+			ambiguous[i] = true;
+			ambiguous[g_PortalsByGeometry.Element( h )] = true;
+		}
+	}
+
+	// what each leaf connects to, as seen by a portal flowing into it
+	CUtlVector<uint64> leafHashes;
+	leafHashes.SetCount( portalclusters );
+	for ( int l = 0; l < portalclusters; l++ )
+	{
+		uint64 nHash = 0;
+		for ( int i = 0; i < leafs[l].portals.Count(); i++ )
+		{
+			nHash += HashUint64( g_pPortalGeometryHashes[leafs[l].portals[i] - portals] );
+		}
+		leafHashes[l] = nHash;
+	}
+
+	// the radius settings change the flow results, so they're part of every key
+	uint64 nSettingsHash = MurmurHash64( &g_VisRadius, sizeof( g_VisRadius ), g_bUseRadius ? 1 : 0 );
+	for ( int i = 0; i < nPortals; i++ )
+	{
+		portal_t const *p = &portals[i];
+		if ( ambiguous[i] )
+		{
+			g_pPortalFlowKeys[i] = 0;
+			continue;
+		}
+
+		uint64 nKey = HashUint64( g_pPortalGeometryHashes[i] ^ nSettingsHash ) + leafHashes[p->leaf];
+		for ( int j = 0; j < nPortals; j++ )
+		{
+			if ( !CheckBit( p->portalflood, j ) )
+				continue;
+			if ( ambiguous[j] )
+			{
+				nKey = 0;
+				break;
+			}
+			// order independent, so this doesn't depend on portal numbering
+			nKey += HashUint64( g_pPortalGeometryHashes[j] * 0x9e3779b97f4a7c15ull + leafHashes[portals[j].leaf] );
+		}
+		g_pPortalFlowKeys[i] = nKey;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Fills in portalvis for every portal found in the cache and marks it done, so
+// PortalFlow skips it. Returns the number of portals reused.
+//-----------------------------------------------------------------------------
+int PortalCache_Apply( void )
+{
+	int nPortals = g_numportals * 2;
+	g_nPortalsReused = 0;
+	g_nPortalsStale = 0;
+	if ( !g_PortalCacheEntries.Count() )
+		return 0;
+
+	for ( int i = 0; i < nPortals; i++ )
+	{
+		if ( !g_pPortalFlowKeys[i] )
+			continue;
+
+		UtlHashHandle_t h = g_PortalCacheLookup.Find( g_pPortalFlowKeys[i] );
+		if ( h == g_PortalCacheLookup.InvalidHandle() )
+			continue;
+
+		portal_t *p = &portals[i];
+		PortalCacheEntry_t const &entry = g_PortalCacheEntries[g_PortalCacheLookup.Element( h )];
+		memset( p->portalvis, 0, portalbytes );
+		bool bValid = true;
+		for ( int v = 0; v < entry.m_nVisibleCount; v++ )
+		{
+			UtlHashHandle_t hPortal = g_PortalsByGeometry.Find( g_PortalCacheVisibleHashes[entry.m_nFirstVisible + v] );
+			if ( hPortal == g_PortalsByGeometry.InvalidHandle() )
+			{
+				bValid = false;
+				break;
+			}
+			SetBit( p->portalvis, g_PortalsByGeometry.Element( hPortal ) );
+		}
+
+		if ( !bValid )
+		{
+			// a hash collision, or a damaged file. flow it normally.
+			memset( p->portalvis, 0, portalbytes );
+			g_nPortalsStale++;
+			continue;
+		}
+
+		p->status = stat_done;
+		g_nPortalsReused++;
+	}
+
+	return g_nPortalsReused;
+}
+
+
+//-----------------------------------------------------------------------------
+// Writes every cacheable portal's result for the next compile
+//-----------------------------------------------------------------------------
+void PortalCache_Save( const char *pFilename )
+{
+	int nPortals = g_numportals * 2;
+	CUtlBuffer buf;
+	PortalCacheHeader_t header;
+	header.m_nMagic = PORTALCACHE_MAGIC;
+	header.m_nVersion = PORTALCACHE_VERSION;
+	header.m_nEntries = 0;
+	header.m_nVisibleHashes = 0;
+	buf.Put( &header, sizeof( header ) );
+
+	CUtlVector<uint64> visibleHashes;
+	for ( int i = 0; i < nPortals; i++ )
+	{
+		portal_t const *p = &portals[i];
+		if ( !g_pPortalFlowKeys[i] || p->status != stat_done )
+			continue;
+
+		int nVisible = 0;
+		for ( int j = 0; j < nPortals; j++ )
+		{
+			if ( CheckBit( p->portalvis, j ) )
+			{
+				visibleHashes.AddToTail( g_pPortalGeometryHashes[j] );
+				nVisible++;
+			}
+		}
+		buf.Put( &g_pPortalFlowKeys[i], sizeof( uint64 ) );
+		buf.PutInt( nVisible );
+		header.m_nEntries++;
+	}
+	if ( visibleHashes.Count() )
+	{
+		buf.Put( visibleHashes.Base(), visibleHashes.Count() * sizeof( uint64 ) );
+	}
+	header.m_nVisibleHashes = visibleHashes.Count();
+	memcpy( buf.Base(), &header, sizeof( header ) );
+
+	SaveFile( pFilename, buf.Base(), buf.TellPut() );
+}
+
+
+void PortalCache_PrintStats( void )
+{
+	int nPortals = g_numportals * 2;
+	Msg( "Portal cache: reused %d of %d portals (%.1f%%), flowed %d",
+		 g_nPortalsReused, nPortals, nPortals ? g_nPortalsReused * 100.0f / nPortals : 0.0f, nPortals - g_nPortalsReused );
+	if ( g_nPortalsStale )
+	{
+		Msg( " (%d cached results didn't match this map)", g_nPortalsStale );
+	}
+	Msg( "\n" );
+}
@@ -115,6 +115,13 @@ void BetterPortalVis (int portalnum);
 void PortalFlow (int iThread, int portalnum);
 void WritePortalTrace( const char *source );
 
+// portalcache.cpp - reuses PortalFlow results from the last compile
+void PortalCache_Load( const char *pFilename );
+void PortalCache_ComputeKeys( void );
+int PortalCache_Apply( void );
+void PortalCache_Save( const char *pFilename );
+void PortalCache_PrintStats( void );
+
 extern	portal_t	*sorted_portals[MAX_MAP_PORTALS*2];
 extern int g_TraceClusterStart, g_TraceClusterStop;
 
@@ -56,6 +56,9 @@ double		g_VisRadius = 4096.0f * 4096.0f;
 
 bool		g_bLowPriority = false;
 
+bool		g_bPortalCache = true;
+char		g_szPortalCacheFile[MAX_PATH];
+
 //=============================================================================
 
 void PlaneFromWinding (winding_t *w, plane_t *plane)
@@ -344,10 +347,29 @@ void CalcVis (void)
 	    RunThreadsOnIndividual (g_numportals*2, true, BasePortalVis);
 	}
 
+	bool bUsePortalCache = g_bPortalCache && !fastvis;
+#ifdef MPI
+	// workers don't have the cache file
+	if ( g_bUseMPI )
+		bUsePortalCache = false;
+#endif
+	if ( bUsePortalCache )
+	{
+		PortalCache_ComputeKeys();
+		PortalCache_Load( g_szPortalCacheFile );
+		PortalCache_Apply();
+	}
+
 	SortPortals ();
 
 	CalcPortalVis ();
 
+	if ( bUsePortalCache )
+	{
+		PortalCache_Save( g_szPortalCacheFile );
+		PortalCache_PrintStats();
+	}
+
 	//
 	// assemble the leaf vis lists by oring the portal lists
 	//
@@ -953,6 +975,11 @@ int ParseCommandLine( int argc, char **argv )
 			Msg ("nosort = true\n");
 			nosort = true;
 		}
+		else if (!Q_stricmp (argv[i],"-nocache"))
+		{
+			Msg ("portal cache disabled\n");
+			g_bPortalCache = false;
+		}
 		else if (!Q_stricmp (argv[i],"-tmpin"))
 			strcpy (inbase, "/tmp");
 		else if( !Q_stricmp( argv[i], "-low" ) )
@@ -1042,6 +1069,8 @@ void PrintUsage( int argc, char **argv )
 		"  -threads        : Control the number of threads vbsp uses (defaults to the #\n"
 		"                    or processors on your machine).\n"
 		"  -nosort         : Don't sort portals (sorting is an optimization).\n"
+		"  -nocache        : Don't reuse or save portal results in <mapname>.viscache.\n"
+		"                    Without this, only portals near changed areas are recomputed.\n"
 		"  -tmpin          : Make portals come from \\tmp\\<mapname>.\n"
 		"  -tmpout         : Make portals come from \\tmp\\<mapname>.\n"
 		"  -trace <start cluster> <end cluster> : Writes a linefile that traces the vis from one cluster to another for debugging map vis.\n"
@@ -1172,6 +1201,8 @@ int RunVVis( int argc, char **argv )
 	}
 	strcat (portalfile, ".prt");
 
+	V_snprintf( g_szPortalCacheFile, sizeof( g_szPortalCacheFile ), "%s.viscache", source );
+
 	Msg ("reading %s\n", portalfile);
 	LoadPortals (portalfile);
 
@@ -1212,6 +1243,8 @@ int RunVVis( int argc, char **argv )
 
 	end = Plat_FloatTime();
 
+	PrintThreadPhaseTimings();
+
 	char str[512];
 	GetHourMinuteSecondsString( (int)( end - start ), str, sizeof( str ) );
 	Msg( "%s elapsed\n", str );